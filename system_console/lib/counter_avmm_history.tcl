@@ -0,0 +1,309 @@
+###########################################################################################################
+# @Name 		counter_avmm_history.tcl
+#
+# @Brief		Time-series store of the channel hit counters (counter_avmm). Converts the counter
+#				readings into rates and keeps 1 s, 10 s and 1 min rollups (min/max/mean per channel) in
+#				fixed size rings, so the history of any channel can be queried without re-reading.
+#
+# @Functions	configure, reset, add_sample, query, channel_means, find_outliers
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 17, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package provide counter_avmm::history 	1.0
+
+namespace eval ::counter_avmm::history:: {
+	namespace export \
+	configure \
+	reset \
+	add_sample \
+	query \
+	channel_means \
+	find_outliers
+
+	variable n_channel 32
+	# "delta": free running counters, rate = wrapped difference / time
+	# "gated": the counters already hold the counts of one gate, rate = value / gate
+	variable mode "delta"
+	variable gate_s 1.0
+	# tiers: {resolution (s) depth (slots)}, 1 h of 1 s, 6 h of 10 s and 24 h of 1 min
+	variable tiers [list {1 3600} {10 2160} {60 1440}]
+	# asic -> {timestamp raw counters}
+	variable last
+	# asic,tier -> {bucket min max sum count} of the bucket being filled
+	variable acc
+	# asic,tier,slot -> {bucket record}, record = binary f* of min, max and mean per channel
+	variable ring
+	array set last {}
+	array set acc {}
+	array set ring {}
+}
+
+######################################################################################################
+##  Arguments:
+##		-n_channel <n>   - channels per asic (default 32)
+##		-mode <mode>     - "delta" (default) or "gated", see above
+##		-gate_s <s>      - gate length of the "gated" mode (default 1.0)
+##		-tiers <list>    - list of {resolution_s depth}, finest first
+##
+##  Description:
+##  	Configures the store. Changing the layout resets the history.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::counter_avmm::history::configure {args} {
+	variable n_channel
+	variable mode
+	variable gate_s
+	variable tiers
+	foreach {option value} $args {
+		switch -- $option {
+			-n_channel {
+				set n_channel $value
+			}
+			-mode {
+				if {$value ne "delta" && $value ne "gated"} {
+					error "configure: mode must be delta or gated, got \"${value}\""
+				}
+				set mode $value
+			}
+			-gate_s {
+				set gate_s $value
+			}
+			-tiers {
+				set tiers [lsort -integer -index 0 $value]
+			}
+			default {
+				error "configure: unknown option \"${option}\", must be -n_channel, -mode, -gate_s or -tiers"
+			}
+		}
+	}
+	::counter_avmm::history::reset
+	return -code ok
+}
+
+proc ::counter_avmm::history::reset {} {
+	variable last
+	variable acc
+	variable ring
+	array unset last
+	array unset acc
+	array unset ring
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<asic>     - asic index
+##		<counters> - counter values of all channels of this asic (as read, hex or decimal)
+##		<t>        - time of the reading in s (default: now)
+##
+##  Description:
+##  	Converts the reading into rates (Hz) and adds them to every tier. In "delta" mode the first
+##		reading of an asic only sets the reference, and a counter that went backwards is taken as one
+##		32 bit wraparound. Completed buckets are written to the rings, memory stays constant.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::counter_avmm::history::add_sample {asic counters {t ""}} {
+	variable mode
+	variable gate_s
+	variable last
+	variable tiers
+	if {$t eq ""} {
+		set t [expr {[clock milliseconds]/1000.0}]
+	}
+	# counters -> rates
+	set rates [list]
+	if {$mode eq "gated"} {
+		foreach counter $counters {
+			lappend rates [expr {double($counter)/$gate_s}]
+		}
+	} else {
+		if {![info exists last($asic)]} {
+			set last($asic) [list $t $counters]
+			return -code ok
+		}
+		lassign $last($asic) t_last counters_last
+		set dt [expr {$t - $t_last}]
+		if {$dt <= 0} {
+			return -code ok
+		}
+		foreach counter $counters counter_last $counters_last {
+			lappend rates [expr {(($counter - $counter_last) & 0xffffffff)/$dt}]
+		}
+		set last($asic) [list $t $counters]
+	}
+	# rates -> tiers
+	for {set tier 0} {$tier < [llength $tiers]} {incr tier} {
+		::counter_avmm::history::accumulate $asic $tier $t $rates
+	}
+	return -code ok
+}
+
+proc ::counter_avmm::history::accumulate {asic tier t rates} {
+	variable acc
+	variable ring
+	variable tiers
+	lassign [lindex $tiers $tier] resolution depth
+	set bucket [expr {int(floor($t/$resolution))}]
+	set id "$asic,$tier"
+	if {[info exists acc($id)]} {
+		lassign $acc($id) acc_bucket mins maxs sums count
+		if {$acc_bucket != $bucket} {
+			# bucket completed -> ring
+			set means [list]
+			foreach sum $sums {
+				lappend means [expr {$sum/$count}]
+			}
+			set ring($id,[expr {$acc_bucket % $depth}]) \
+				[list $acc_bucket [binary format f*f*f* $mins $maxs $means]]
+			unset acc($id)
+		}
+	}
+	if {![info exists acc($id)]} {
+		set acc($id) [list $bucket $rates $rates $rates 1]
+		return -code ok
+	}
+	set new_mins [list]
+	set new_maxs [list]
+	set new_sums [list]
+	foreach rate $rates min $mins max $maxs sum $sums {
+		lappend new_mins [expr {min($min, $rate)}]
+		lappend new_maxs [expr {max($max, $rate)}]
+		lappend new_sums [expr {$sum + $rate}]
+	}
+	set acc($id) [list $bucket $new_mins $new_maxs $new_sums [expr {$count + 1}]]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<asic>    - asic index
+##		<channel> - channel index
+##		<seconds> - length of the window ending now
+##		<now>     - end of the window in s (default: now)
+##
+##  Description:
+##  	Gets the history of one channel from the finest tier that covers the window, for example
+##		"channel 17 of ASIC 3 over the last hour" is [query 3 17 3600]. Buckets without data are
+##		skipped. The bucket being filled is not included.
+##
+##	Returns:
+##  	list of {t_start min max mean}, oldest first
+##
+######################################################################################################
+proc ::counter_avmm::history::query {asic channel seconds {now ""}} {
+	variable ring
+	variable tiers
+	variable n_channel
+	if {$now eq ""} {
+		set now [expr {[clock milliseconds]/1000.0}]
+	}
+	# finest tier covering the window
+	set tier [expr {[llength $tiers] - 1}]
+	for {set i 0} {$i < [llength $tiers]} {incr i} {
+		lassign [lindex $tiers $i] resolution depth
+		if {$resolution*$depth >= $seconds} {
+			set tier $i
+			break
+		}
+	}
+	lassign [lindex $tiers $tier] resolution depth
+	set last_bucket [expr {int(floor($now/$resolution)) - 1}]
+	set first_bucket [expr {max($last_bucket - int(ceil(double($seconds)/$resolution)) + 1, $last_bucket - $depth + 1)}]
+	set result [list]
+	for {set bucket $first_bucket} {$bucket <= $last_bucket} {incr bucket} {
+		set key "$asic,$tier,[expr {$bucket % $depth}]"
+		if {![info exists ring($key)]} {
+			continue
+		}
+		lassign $ring($key) ring_bucket record
+		# slot overwritten by a newer bucket or left from an older one
+		if {$ring_bucket != $bucket} {
+			continue
+		}
+		binary scan $record "@[expr {4*$channel}]f@[expr {4*($n_channel + $channel)}]f@[expr {4*(2*$n_channel + $channel)}]f" min max mean
+		lappend result [list [expr {$bucket*$resolution}] $min $max $mean]
+	}
+	return $result
+}
+
+######################################################################################################
+##  Arguments:
+##		<asic>    - asic index
+##		<seconds> - length of the window ending now
+##		<now>     - end of the window in s (default: now)
+##
+##  Description:
+##  	Averages every channel of an asic over the window.
+##
+##	Returns:
+##  	list of mean rates (Hz) per channel, empty if there is no data in the window
+##
+######################################################################################################
+proc ::counter_avmm::history::channel_means {asic seconds {now ""}} {
+	variable n_channel
+	set means [list]
+	for {set channel 0} {$channel < $n_channel} {incr channel} {
+		set sum 0.0
+		set n 0
+		foreach point [::counter_avmm::history::query $asic $channel $seconds $now] {
+			set sum [expr {$sum + [lindex $point 3]}]
+			incr n
+		}
+		if {$n == 0} {
+			return [list]
+		}
+		lappend means [expr {$sum/$n}]
+	}
+	return $means
+}
+
+######################################################################################################
+##  Arguments:
+##		<asics>       - list of asic indices to check
+##		<seconds>     - length of the window ending now
+##		<hot_factor>  - a channel is hot above hot_factor times the median of all channels
+##		<now>         - end of the window in s (default: now)
+##
+##  Description:
+##  	Finds dead (mean rate 0) and hot channels over the window.
+##
+##	Returns:
+##  	list of {asic channel mean "dead"|"hot"}
+##
+######################################################################################################
+proc ::counter_avmm::history::find_outliers {asics seconds {hot_factor 5.0} {now ""}} {
+	set all [list]
+	foreach asic $asics {
+		set channel 0
+		foreach mean [::counter_avmm::history::channel_means $asic $seconds $now] {
+			lappend all [list $asic $channel $mean]
+			incr channel
+		}
+	}
+	if {[llength $all] == 0} {
+		return [list]
+	}
+	set sorted [lsort -real -index 2 $all]
+	set median [lindex $sorted [expr {[llength $sorted]/2}] 2]
+	set outliers [list]
+	foreach entry $all {
+		set mean [lindex $entry 2]
+		if {$mean == 0} {
+			lappend outliers [concat $entry "dead"]
+		} elseif {$median > 0 && $mean > $hot_factor*$median} {
+			lappend outliers [concat $entry "hot"]
+		}
+	}
+	return $outliers
+}
@@ -13,9 +13,25 @@
 ###########################################################################################################
 
 package require mu3e::helpers 1.0
+package require mu3e::monitor 1.0
+package require mu3e::jobs 1.0
+package require mu3e::render 1.0
+package require mu3e::bspmap 1.0
+package require mu3e::snapshot 1.0
+package require counter_avmm::history 1.0
+package require lvds_rx::health 1.0
+package require lvds_rx::sweep 1.0
 package require lvds_rx::bsp 24.0
 package require frame_deassembly::bsp 24.0
+package require frame_deassembly::errors 1.0
 package require histogram_statistics::bsp 24.0
+package require histogram_statistics::acq 1.0
+package require histogram_statistics::histogram 1.0
+package require histogram_statistics::stitch 1.0
+package require histogram_statistics::adaptive 1.0
+package require mu3e::accounting 1.0
+package require ring_buffer_cam::telemetry 1.0
+package require mutrig_injector::stress 1.0
 package require mutrig_injector::bsp 24.0
 package require mts_processor::bsp 24.0
 package require ring_buffer_cam::bsp 24.0
@@ -58,12 +74,19 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
 	#                                                                                                               #
 	#################################################################################################################
 	variable fd_global_variable "globalVariableTable"
+	# bars of the histogram charts (preferredWidth 1000), more bins are rebinned to fit
+	variable hist_chart_width 1000
 	::mu3e::helpers::init_global_variable  $fd_global_variable
 	::mu3e::helpers::append_global_variable $fd_global_variable "n_asic" $n_asic
 	#::mu3e::helpers::append_global_variable $fd_global_variable "doc_xml" "empty..."
 	::mu3e::helpers::append_global_variable $fd_global_variable "slaves" [list "lvds_rx_controller_pro.csr" \
     "mutrig_frame_deassembly.csr" "counter_avmm.avmm_counter_value" "histogram_statistics.csr" "histogram_statistics.hist_bin" \
     "mutrig_injector.csr" "mts_preprocessor.csr" "ring_buffer_cam.csr" "feb_frame_assembly.csr"]
+    # slaves in the board snapshot -> name of their bsp reg map
+    ::mu3e::helpers::append_global_variable $fd_global_variable "snapshot_slaves" [list "lvds_rx_controller_pro.csr" "lvds" \
+    "mutrig_frame_deassembly.csr" "frame_deassembly" "histogram_statistics.csr" "histogram_statistics" \
+    "mutrig_injector.csr" "mutrig_injector" "mts_preprocessor.csr" "mts_processor" "ring_buffer_cam.csr" "ring_buffer_cam" \
+    "feb_frame_assembly.csr" "feb_frame_assembly"]
 	::mu3e::helpers::append_global_variable $fd_global_variable "lvds_rx_controller_pro.csr_base_address" 0x0
 	::mu3e::helpers::append_global_variable $fd_global_variable "lvds_rx_controller_pro.csr_encountered" 0
 	::mu3e::helpers::append_global_variable $fd_global_variable "mutrig_frame_deassembly.csr_base_address" 0x0
@@ -88,11 +111,16 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
     ::mu3e::helpers::append_global_variable $fd_global_variable "feb_frame_assembly.csr_encountered" 0
     ::mu3e::helpers::append_global_variable $fd_global_variable "feb_frame_assembly.csr_copies" 2
     
-    ::mu3e::helpers::append_global_variable $fd_global_variable "lvds_doc_xml" "empty"
-    ::mu3e::helpers::append_global_variable $fd_global_variable "frame_deassembly_doc_xml" "empty"
-    ::mu3e::helpers::append_global_variable $fd_global_variable "mutrig_injector_doc_xml" "empty"
     ::mu3e::helpers::append_global_variable $fd_global_variable "hist_barChart_name" "hist_barChart"
-    ::mu3e::helpers::append_global_variable $fd_global_variable "hist_regpack" 0
+    # monitor periods (ms)
+    ::mu3e::helpers::append_global_variable $fd_global_variable "rate_monitor_period_ms" 1000
+    ::mu3e::helpers::append_global_variable $fd_global_variable "lvds_monitor_period_ms" 5000
+    ::mu3e::helpers::append_global_variable $fd_global_variable "deassembly_monitor_period_ms" 1000
+    ::mu3e::helpers::append_global_variable $fd_global_variable "deassembly_errors_period_ms" 50
+    ::mu3e::helpers::append_global_variable $fd_global_variable "lvds_health_period_ms" 1000
+    ::mu3e::helpers::append_global_variable $fd_global_variable "lvds_health_log" "lvds_health.log"
+    ::mu3e::helpers::append_global_variable $fd_global_variable "accounting_period_ms" 1000
+    ::mu3e::helpers::append_global_variable $fd_global_variable "cam_telemetry_period_ms" 50
     
     #::mu3e::helpers::append_global_variable $fd_global_variable "histogram_statistics_doc_xml" "empty"
 	toolkit_set_property	"globalVariableTable" visible 1
@@ -120,7 +148,6 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
     
     
     # ////////////////////////////////// frame deassembly tab ///////////////////////////////////////////
-    variable deassembly_monitor_fd ""
     set n_deassembly [::mu3e::helpers::get_global_variable $fd_global_variable "mutrig_frame_deassembly.csr_copies"]
     # - frame deassembly tab
     toolkit_add 			"deassemblyTab" 	group 				Tab0	
@@ -154,6 +181,30 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
     toolkit_add             "deassemblyRead_button" button       "deassemblyCtrlGroup"
     toolkit_set_property    "deassemblyRead_button" text         "read"
     toolkit_set_property    "deassemblyRead_button" onClick      {::data_path_bts::gui::device2gui "frame_deassembly" "deassemblyGroup" "mutrig_frame_deassembly.csr" } 
+    toolkit_add            "deassembly_controlPanel_monitor_checkBox"     checkBox      "deassemblyCtrlGroup"
+    toolkit_set_property   "deassembly_controlPanel_monitor_checkBox"     label         "monitor registers"   
+    toolkit_set_property   "deassembly_controlPanel_monitor_checkBox"     onClick      {::data_path_bts::gui::deassembly_monitor_registers_functor}
+    toolkit_add             "deassembly_controlPanel_loading_bitmap"  bitmap          "deassemblyCtrlGroup"
+    toolkit_set_property    "deassembly_controlPanel_loading_bitmap"  path            ../../system_console/figures/loading.gif
+    toolkit_set_property    "deassembly_controlPanel_loading_bitmap"  label           "stopped"
+    toolkit_set_property    "deassembly_controlPanel_loading_bitmap"  visible         0
+    toolkit_add            "deassembly_errors_checkBox"     checkBox      "deassemblyCtrlGroup"
+    toolkit_set_property   "deassembly_errors_checkBox"     label         "monitor error rates"   
+    toolkit_set_property   "deassembly_errors_checkBox"     toolTip       "CRC error and bad frame rates, BER with 95% interval, bursts vs. LVDS lane errors (needs lane health for the correlation)"
+    toolkit_set_property   "deassembly_errors_checkBox"     onClick      {::data_path_bts::gui::deassembly_errors_functor}
+    toolkit_add             "deassembly_errors_loading_bitmap"  bitmap          "deassemblyCtrlGroup"
+    toolkit_set_property    "deassembly_errors_loading_bitmap"  path            ../../system_console/figures/loading.gif
+    toolkit_set_property    "deassembly_errors_loading_bitmap"  label           "stopped"
+    toolkit_set_property    "deassembly_errors_loading_bitmap"  visible         0
+    set columns [list "copy" "CRC err (1/s)" "bad frame (1/s)" "CRC err (total)" "BER" "BER 95% interval" "bursts" "with LVDS err" "LVDS err only"]
+    toolkit_add				deassembly_errors_table 	table			"deassemblyCtrlGroup"
+    toolkit_set_property	deassembly_errors_table    preferredWidth  800
+	toolkit_set_property	deassembly_errors_table	rowCount		0
+	toolkit_set_property	deassembly_errors_table	columnCount		[llength $columns]
+    for {set i 0} {$i < [llength $columns]} {incr i} {
+        toolkit_set_property	deassembly_errors_table	columnIndex		$i
+        toolkit_set_property	deassembly_errors_table	columnHeader	[lindex $columns $i]
+    }
     #::data_path_bts::gui::setup_deassembly_controlPanel "deassemblyCtrlGroup" 
     # /////////////////////////////////////////////////////////////////////////////
     
@@ -164,7 +215,6 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
 	toolkit_set_property 	"rateTab" 	title 				"Rate"
 	toolkit_set_property 	"rateTab" 	itemsPerRow 		2
     # -- control panel 
-    variable rate_monitor_fd ""
     toolkit_add 			"rateCtrlGroup" 	group 		"rateTab"
 	toolkit_set_property	"rateCtrlGroup"	    expandableX	false
 	toolkit_set_property	"rateCtrlGroup"	    expandableY	false
@@ -182,6 +232,11 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
     toolkit_add             "tmp_button" button "rateCtrlGroup"
     toolkit_set_property    "tmp_button" onClick {::data_path_bts::gui::read_rate}
     
+    toolkit_add             "renderStats_button" button "rateCtrlGroup"
+    toolkit_set_property    "renderStats_button" text    "GUI call statistics"
+    toolkit_set_property    "renderStats_button" toolTip "chart items and table cells handed over vs. toolkit calls made since the last press"
+    toolkit_set_property    "renderStats_button" onClick {::data_path_bts::gui::render_stats}
+    
     # -- rate histogram
     toolkit_add 			"rateHistGroup" 	group 		"rateTab"
     toolkit_set_property	"rateHistGroup"		expandableX	true
@@ -206,6 +261,29 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
         toolkit_set_property	$chart_name		expandableX true
         toolkit_set_property	$chart_name		preferredWidth 800
     }
+    
+    # -- rate history
+    toolkit_add 			"rateHistoryGroup" 	group 		"rateTab"
+    toolkit_set_property	"rateHistoryGroup"	itemsPerRow 1
+    toolkit_set_property	"rateHistoryGroup" 	title		"channel rate history"
+    ::mu3e::helpers::toolkit_setup_combobox "rateHistoryGroup" "rateHistory_asic_comboBox" [list 0 [expr $n_asic - 1]] 0 "asic"
+    ::mu3e::helpers::toolkit_setup_combobox "rateHistoryGroup" "rateHistory_ch_comboBox" [list 0 31] 0 "channel"
+    toolkit_add             "rateHistory_window_comboBox"   comboBox    "rateHistoryGroup"
+    toolkit_set_property    "rateHistory_window_comboBox"   options     [list 60 600 3600 21600 86400]
+    toolkit_set_property    "rateHistory_window_comboBox"   label       "last (s)"
+    toolkit_set_property    "rateHistory_window_comboBox"   selectedItem 3600
+    toolkit_add             "rateHistory_plot_button"   button      "rateHistoryGroup"
+    toolkit_set_property    "rateHistory_plot_button"   text        "plot history"
+    toolkit_set_property    "rateHistory_plot_button"   onClick     {::data_path_bts::gui::plot_rate_history}
+    toolkit_add             "rateHistory_outlier_button"   button      "rateHistoryGroup"
+    toolkit_set_property    "rateHistory_outlier_button"   text        "find hot/dead channels"
+    toolkit_set_property    "rateHistory_outlier_button"   onClick     {::data_path_bts::gui::show_rate_outliers}
+    toolkit_add             "rateHistory_text"      text        "rateHistoryGroup"
+    toolkit_set_property    "rateHistory_text"      editable    false
+    toolkit_set_property    "rateHistory_text"      preferredWidth  400
+    toolkit_set_property    "rateHistory_text"      text        ""
+    toolkit_add             "rateHistory_lineChart"     lineChart   "rateHistoryGroup"
+    toolkit_set_property    "rateHistory_lineChart"     preferredWidth 800
     # /////////////////////////////////////////////////////////////////////////////
     
     
@@ -283,6 +361,35 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
         ::data_path_bts::gui::bsp2gui_setup  "ring_buffer_cam" stackGroup${i} 0 [list]
     }
     
+    # -- occupancy telemetry
+    toolkit_add 			"stackTelemetryGroup" 	group 		"stackTab"
+    toolkit_set_property	"stackTelemetryGroup"	itemsPerRow 1
+    toolkit_set_property	"stackTelemetryGroup" 	title		"Occupancy Telemetry"
+    
+    toolkit_add             "cam_telemetry_checkBox"     checkBox      "stackTelemetryGroup"
+    toolkit_set_property    "cam_telemetry_checkBox"     label         "sample occupancy"
+    toolkit_set_property    "cam_telemetry_checkBox"     onClick       {::data_path_bts::gui::cam_telemetry_functor}
+    ::mu3e::helpers::toolkit_setup_combobox "stackTelemetryGroup" "cam_telemetry_copy_comboBox" [list 0 [expr $n_stacks - 1]] 0 "distribution of copy"
+    toolkit_add             "cam_telemetry_loading_bitmap"  bitmap          "stackTelemetryGroup"
+    toolkit_set_property    "cam_telemetry_loading_bitmap"  path            ../../system_console/figures/loading.gif
+    toolkit_set_property    "cam_telemetry_loading_bitmap"  label           "stopped"
+    toolkit_set_property    "cam_telemetry_loading_bitmap"  visible         0
+    
+    set columns [list "copy" "fill" "mean" "p99" "peak (window)" "peak (all)" "push (1/s)" "overwrite (1/s)" "cache miss (1/s)" "residence (ns)" "expected latency (ns)"]
+    toolkit_add				cam_telemetry_table 	table			"stackTelemetryGroup"
+    toolkit_set_property	cam_telemetry_table    preferredWidth  800
+	toolkit_set_property	cam_telemetry_table	rowCount		0
+	toolkit_set_property	cam_telemetry_table	columnCount		[llength $columns]
+    for {set i 0} {$i < [llength $columns]} {incr i} {
+        toolkit_set_property	cam_telemetry_table	columnIndex		$i
+        toolkit_set_property	cam_telemetry_table	columnHeader	[lindex $columns $i]
+    }
+    toolkit_add				"cam_telemetry_barChart"		barChart	"stackTelemetryGroup"
+    toolkit_set_property	"cam_telemetry_barChart"		title		"Fill-level distribution (window)"
+    toolkit_set_property	"cam_telemetry_barChart"		labelX		"fill level (hits)"
+    toolkit_set_property	"cam_telemetry_barChart"		labelY		"samples"
+    toolkit_set_property	"cam_telemetry_barChart"		preferredWidth 800
+    
     # ///////////////////////////////////////////////////////////////////////////////////////////
     
     
@@ -356,8 +463,34 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
     toolkit_set_property    "histPlot_button"   text         "plot"
     toolkit_set_property    "histPlot_button"   onClick     {::data_path_bts::gui::read_hist "histRegGroup"}
     
+    toolkit_add             "histCancel_button"   button      "histCtrlGroup"
+    toolkit_set_property    "histCancel_button"   text         "cancel"
+    toolkit_set_property    "histCancel_button"   enabled      0
+    toolkit_set_property    "histCancel_button"   onClick     {::histogram_statistics::acq::cancel}
+    
+    toolkit_add             "histWindow_textField"   textField      "histCtrlGroup"
+    toolkit_set_property    "histWindow_textField"   label        "window (ms)"
+    toolkit_set_property    "histWindow_textField"   text         1000
+    
+    toolkit_add             "histWindows_textField"   textField      "histCtrlGroup"
+    toolkit_set_property    "histWindows_textField"   label        "windows"
+    toolkit_set_property    "histWindows_textField"   text         1
+    toolkit_set_property    "histWindows_textField"   toolTip      "number of integration windows to accumulate"
+    
+    toolkit_add             "histInfo_text"      text        "histCtrlGroup"
+    toolkit_set_property    "histInfo_text"      editable    false
+    toolkit_set_property    "histInfo_text"      text        ""
+    
     ::mu3e::helpers::toolkit_setup_combobox "histCtrlGroup" "hist_lo_comboBox" [list 0 255] 0 "low"
     ::mu3e::helpers::toolkit_setup_combobox "histCtrlGroup" "hist_hi_comboBox" [list 0 255] 255 "high"
+    toolkit_add             "hist_rebin_comboBox"   comboBox      "histCtrlGroup"
+    toolkit_set_property    "hist_rebin_comboBox"   label         "rebin"
+    toolkit_set_property    "hist_rebin_comboBox"   options       [list 1 2 4 8 16 32]
+    toolkit_set_property    "hist_rebin_comboBox"   selectedItem  1
+    # redraw from the host histogram, no new acquisition
+    foreach comboBoxName {hist_lo_comboBox hist_hi_comboBox hist_rebin_comboBox} {
+        toolkit_set_property    $comboBoxName   onChange    {::data_path_bts::gui::draw_hist}
+    }
     
     
     # create a button for save to xml
@@ -444,6 +577,24 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
     toolkit_set_property auto_nstep_textField toolTip "enter the number of steps of the scan. (default = 256)"
     toolkit_set_property auto_nstep_textField expandableX true
     
+    toolkit_add auto_target_textField textField hitsAutoSetGroup
+    toolkit_set_property auto_target_textField label "target rel. error"
+    toolkit_set_property auto_target_textField text "0.05"
+    toolkit_set_property auto_target_textField toolTip "adaptive scan: relative error of the counts per window to reach (1/sqrt(N))"
+    toolkit_set_property auto_target_textField expandableX true
+    
+    toolkit_add auto_coarse_textField textField hitsAutoSetGroup
+    toolkit_set_property auto_coarse_textField label "coarse dwell (ms)"
+    toolkit_set_property auto_coarse_textField text "100"
+    toolkit_set_property auto_coarse_textField toolTip "adaptive scan: dwell per window of the coarse pass"
+    toolkit_set_property auto_coarse_textField expandableX true
+    
+    toolkit_add auto_max_textField textField hitsAutoSetGroup
+    toolkit_set_property auto_max_textField label "max dwell (ms)"
+    toolkit_set_property auto_max_textField text "10000"
+    toolkit_set_property auto_max_textField toolTip "adaptive scan: dwell limit per window"
+    toolkit_set_property auto_max_textField expandableX true
+    
     # tab group - automation tab - control group
     toolkit_add             "hitsAutoCtrlGroup"      group           "histAutoGroup"
     toolkit_set_property    "hitsAutoCtrlGroup"      preferredWidth  200
@@ -456,6 +607,52 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
 	toolkit_set_property	"auto_start_button"		chooserButtonText 			"Create file sets"
 	toolkit_set_property	"auto_start_button"		onChoose 		{::data_path_bts::gui::scan_hist "auto_start_button" "histRegGroup" "auto_step_textField" "auto_min_textField" "auto_nstep_textField"} 
     
+    toolkit_add             "auto_adaptive_button"   button      "hitsAutoCtrlGroup"
+    toolkit_set_property    "auto_adaptive_button"   text        "Adaptive Scan"
+    toolkit_set_property    "auto_adaptive_button"   toolTip     "coarse pass, then dwell where the counts are; the result goes to the stitched view"
+    toolkit_set_property    "auto_adaptive_button"   onClick     {::data_path_bts::gui::adaptive_scan_hist "histRegGroup"}
+    
+    toolkit_add             "auto_cancel_button"   button      "hitsAutoCtrlGroup"
+    toolkit_set_property    "auto_cancel_button"   text        "Cancel"
+    toolkit_set_property    "auto_cancel_button"   enabled     0
+    toolkit_set_property    "auto_cancel_button"   onClick     {::histogram_statistics::adaptive::cancel; ::mu3e::jobs::cancel "scan_hist"}
+    
+    # tab group - automation tab - stitch group
+    toolkit_add             "hitsAutoStitchGroup"      group           "histAutoGroup"
+    toolkit_set_property    "hitsAutoStitchGroup"      title           "Stitched Scan"
+    toolkit_set_property	"hitsAutoStitchGroup"	    itemsPerRow 4
+    # tab group - automation tab - stitch group - content
+    toolkit_add stitch_lo_textField textField hitsAutoStitchGroup
+    toolkit_set_property stitch_lo_textField label "low"
+    toolkit_set_property stitch_lo_textField text ""
+    toolkit_set_property stitch_lo_textField toolTip "lower edge of the view (empty = whole scan)"
+    
+    toolkit_add stitch_hi_textField textField hitsAutoStitchGroup
+    toolkit_set_property stitch_hi_textField label "high"
+    toolkit_set_property stitch_hi_textField text ""
+    toolkit_set_property stitch_hi_textField toolTip "upper edge of the view (empty = whole scan)"
+    
+    toolkit_add stitch_nbin_textField textField hitsAutoStitchGroup
+    toolkit_set_property stitch_nbin_textField label "bins"
+    toolkit_set_property stitch_nbin_textField text "256"
+    
+    toolkit_add             "stitch_show_button"   button      "hitsAutoStitchGroup"
+    toolkit_set_property    "stitch_show_button"   text        "show"
+    toolkit_set_property    "stitch_show_button"   onClick     {::data_path_bts::gui::draw_stitch}
+    
+    toolkit_add				"stitch_load_button"		fileChooserButton 			"hitsAutoStitchGroup"
+	toolkit_set_property	"stitch_load_button"		text 						"load scan"
+	toolkit_set_property	"stitch_load_button"		paths						"./scan_records/dummy_hist_step-0.txt"; # some default path
+	toolkit_set_property	"stitch_load_button"		chooserButtonText 			"Load file set"
+	toolkit_set_property	"stitch_load_button"		onChoose 		{::data_path_bts::gui::load_stitch "stitch_load_button"} 
+    
+    toolkit_add             "stitch_text"      text        "hitsAutoStitchGroup"
+    toolkit_set_property    "stitch_text"      editable    false
+    toolkit_set_property    "stitch_text"      text        ""
+    
+    toolkit_add             "stitch_barChart"         barChart "hitsAutoStitchGroup"
+    toolkit_set_property    "stitch_barChart"         preferredWidth  1000
+    
 
 
 
@@ -496,6 +693,159 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
     
     # register group - content 
     ::data_path_bts::gui::bsp2gui_setup "mutrig_injector" "injRegGroup" 0 [list -HEADERINFO_CHANNEL_W 4]
+    
+    # stress test group
+    toolkit_add 			"injStressGroup" 	group 		"injTab"
+    toolkit_set_property	"injStressGroup"	itemsPerRow 1
+    toolkit_set_property	"injStressGroup" 	title		"Stress Test"
+    
+    toolkit_add             "inj_stress_mode_comboBox"     comboBox      "injStressGroup"
+    toolkit_set_property    "inj_stress_mode_comboBox"     label         "mode"
+    toolkit_set_property    "inj_stress_mode_comboBox"     options       "header_sync periodic periodic_async random"
+    toolkit_set_property    "inj_stress_mode_comboBox"     selectedItem  "header_sync"
+    toolkit_add             "inj_stress_intervals_textField"   textField      "injStressGroup"
+    toolkit_set_property    "inj_stress_intervals_textField"   label        "intervals"
+    toolkit_set_property    "inj_stress_intervals_textField"   text         "64 32 16 8 4 2 1"
+    toolkit_set_property    "inj_stress_intervals_textField"   toolTip      "header_interval (header_sync) or pulse_interval (periodic modes)"
+    toolkit_add             "inj_stress_multiplicities_textField"   textField      "injStressGroup"
+    toolkit_set_property    "inj_stress_multiplicities_textField"   label        "multiplicities"
+    toolkit_set_property    "inj_stress_multiplicities_textField"   text         "1 4"
+    toolkit_set_property    "inj_stress_multiplicities_textField"   toolTip      "header_multiplicity (header_sync only)"
+    toolkit_add             "inj_stress_settle_textField"   textField      "injStressGroup"
+    toolkit_set_property    "inj_stress_settle_textField"   label        "settle (ms)"
+    toolkit_set_property    "inj_stress_settle_textField"   text         500
+    toolkit_add             "inj_stress_dwell_textField"   textField      "injStressGroup"
+    toolkit_set_property    "inj_stress_dwell_textField"   label        "dwell (ms)"
+    toolkit_set_property    "inj_stress_dwell_textField"   text         1000
+    
+	toolkit_add				"inj_stress_button"		fileChooserButton 			"injStressGroup"
+	toolkit_set_property	"inj_stress_button"		text 						"run stress test"
+	toolkit_set_property	"inj_stress_button"		paths						"./trash_bin/inj_stress.bin"; # some default path
+	toolkit_set_property	"inj_stress_button"		chooserButtonText 			"Save"
+	toolkit_set_property	"inj_stress_button"		onChoose 		{::data_path_bts::gui::inj_stress_functor "inj_stress_button"} 
+    toolkit_add             "inj_stress_cancel_button"   button      "injStressGroup"
+    toolkit_set_property    "inj_stress_cancel_button"   text        "cancel"
+    toolkit_set_property    "inj_stress_cancel_button"   enabled     0
+    toolkit_set_property    "inj_stress_cancel_button"   onClick     {::mutrig_injector::stress::cancel}
+    toolkit_add             "inj_stress_loading_bitmap"  bitmap          "injStressGroup"
+    toolkit_set_property    "inj_stress_loading_bitmap"  path            ../../system_console/figures/loading.gif
+    toolkit_set_property    "inj_stress_loading_bitmap"  label           "stopped"
+    toolkit_set_property    "inj_stress_loading_bitmap"  visible         0
+    
+    set columns [list "interval" "multiplicity" "offered (hits/s)" "delivered (hits/s)" "efficiency (%)" "first stage dropping"]
+    toolkit_add				inj_stress_table 	table			"injStressGroup"
+    toolkit_set_property	inj_stress_table    preferredWidth  600
+	toolkit_set_property	inj_stress_table	rowCount		0
+	toolkit_set_property	inj_stress_table	columnCount		[llength $columns]
+    for {set i 0} {$i < [llength $columns]} {incr i} {
+        toolkit_set_property	inj_stress_table	columnIndex		$i
+        toolkit_set_property	inj_stress_table	columnHeader	[lindex $columns $i]
+    }
+    toolkit_add             "inj_stress_text"      text        "injStressGroup"
+    toolkit_set_property    "inj_stress_text"      editable    false
+    toolkit_set_property    "inj_stress_text"      preferredWidth  600
+    toolkit_set_property    "inj_stress_text"      text        ""
+    # ///////////////////////////////////////////////////////////////////////////////////////////
+    
+    
+    # //////////////////////////////////// hit accounting tab /////////////////////////////////////////
+    # - accounting tab
+    toolkit_add 			"accountingTab" 	group 				Tab0	
+	toolkit_set_property 	"accountingTab" 	title 				"Hit Accounting"
+	toolkit_set_property 	"accountingTab" 	itemsPerRow 		2
+    
+    # panel group
+    toolkit_add 			"accountingCtrlGroup" 	    group 		"accountingTab"
+	toolkit_set_property	"accountingCtrlGroup"	    expandableX	false
+	toolkit_set_property	"accountingCtrlGroup"	    expandableY	false
+    toolkit_set_property	"accountingCtrlGroup"	    maxWidth	200
+	toolkit_set_property	"accountingCtrlGroup"	    itemsPerRow 1
+	toolkit_set_property	"accountingCtrlGroup" 	    title		"Control Panel"
+    
+    # panel group - content 
+    toolkit_add             "accounting_checkBox"     checkBox      "accountingCtrlGroup"
+    toolkit_set_property    "accounting_checkBox"     label         "monitor hit accounting"
+    toolkit_set_property    "accounting_checkBox"     onClick       {::data_path_bts::gui::accounting_functor}
+    
+    toolkit_add             "accounting_window_comboBox"   comboBox    "accountingCtrlGroup"
+    toolkit_set_property    "accounting_window_comboBox"   options     [list 1 10 60 600]
+    toolkit_set_property    "accounting_window_comboBox"   label       "window (s)"
+    toolkit_set_property    "accounting_window_comboBox"   selectedItem 10
+    toolkit_set_property    "accounting_window_comboBox"   onChange    {::data_path_bts::gui::accounting_update}
+    
+    toolkit_add             "accounting_loading_bitmap"  bitmap          "accountingCtrlGroup"
+    toolkit_set_property    "accounting_loading_bitmap"  path            ../../system_console/figures/loading.gif
+    toolkit_set_property    "accounting_loading_bitmap"  label           "stopped"
+    toolkit_set_property    "accounting_loading_bitmap"  visible         0
+    
+    # result group
+    toolkit_add 			"accountingGroup" 	group 		"accountingTab"
+    toolkit_set_property	"accountingGroup"	itemsPerRow 1
+    toolkit_set_property	"accountingGroup" 	title		"Hits along the chain"
+    
+    set columns [list "stage" "in (hits/s)" "out (hits/s)" "transfer loss (%)" "internal loss (%)" "flag"]
+    toolkit_add				accounting_table 	table			"accountingGroup"
+    toolkit_set_property	accounting_table    preferredWidth  600
+	toolkit_set_property	accounting_table	rowCount		0
+	toolkit_set_property	accounting_table	columnCount		[llength $columns]
+    for {set i 0} {$i < [llength $columns]} {incr i} {
+        toolkit_set_property	accounting_table	columnIndex		$i
+        toolkit_set_property	accounting_table	columnHeader	[lindex $columns $i]
+    }
+    toolkit_add             "accounting_text"      text        "accountingGroup"
+    toolkit_set_property    "accounting_text"      editable    false
+    toolkit_set_property    "accounting_text"      preferredWidth  600
+    toolkit_set_property    "accounting_text"      text        ""
+    # ///////////////////////////////////////////////////////////////////////////////////////////
+    
+    
+    # ////////////////////////////////// board snapshot tab /////////////////////////////////////
+    # - snapshot tab
+    toolkit_add 			"snapshotTab" 	group 				Tab0	
+	toolkit_set_property 	"snapshotTab" 	title 				"Board Snapshot"
+	toolkit_set_property 	"snapshotTab" 	itemsPerRow 		2
+    
+    # panel group
+    toolkit_add 			"snapshotCtrlGroup" 	    group 		"snapshotTab"
+	toolkit_set_property	"snapshotCtrlGroup"	    expandableX	false
+	toolkit_set_property	"snapshotCtrlGroup"	    expandableY	false
+    toolkit_set_property	"snapshotCtrlGroup"	    maxWidth	200
+	toolkit_set_property	"snapshotCtrlGroup"	    itemsPerRow 1
+	toolkit_set_property	"snapshotCtrlGroup" 	    title		"Control Panel"
+    
+    # panel group - content 
+	toolkit_add				"snapshot_save_button"		fileChooserButton 			"snapshotCtrlGroup"
+	toolkit_set_property	"snapshot_save_button"		text 						"take snapshot"
+	toolkit_set_property	"snapshot_save_button"		paths						"./trash_bin/board.snap"; # some default path
+	toolkit_set_property	"snapshot_save_button"		chooserButtonText 			"Save"
+	toolkit_set_property	"snapshot_save_button"		toolTip 					"read all registers of all linked IPs into a snapshot file"
+	toolkit_set_property	"snapshot_save_button"		onChoose 		{::data_path_bts::gui::snapshot_save "snapshot_save_button"} 
+	toolkit_add				"snapshot_restore_button"		fileChooserButton 			"snapshotCtrlGroup"
+	toolkit_set_property	"snapshot_restore_button"		text 						"restore snapshot"
+	toolkit_set_property	"snapshot_restore_button"		chooserButtonText 			"Restore"
+	toolkit_set_property	"snapshot_restore_button"		toolTip 					"write back the read-write fields that differ from the snapshot"
+	toolkit_set_property	"snapshot_restore_button"		onChoose 		{::data_path_bts::gui::snapshot_restore "snapshot_restore_button"} 
+    toolkit_add             "snapshot_dry_run_checkBox"     checkBox      "snapshotCtrlGroup"
+    toolkit_set_property    "snapshot_dry_run_checkBox"     label         "dry run (compare only)"
+    
+    # result group
+    toolkit_add 			"snapshotGroup" 	group 		"snapshotTab"
+    toolkit_set_property	"snapshotGroup"	itemsPerRow 1
+    toolkit_set_property	"snapshotGroup" 	title		"Registers restored"
+    
+    set columns [list "ip" "copy" "register" "offset" "current" "restored"]
+    toolkit_add				snapshot_table 	table			"snapshotGroup"
+    toolkit_set_property	snapshot_table    preferredWidth  600
+	toolkit_set_property	snapshot_table	rowCount		0
+	toolkit_set_property	snapshot_table	columnCount		[llength $columns]
+    for {set i 0} {$i < [llength $columns]} {incr i} {
+        toolkit_set_property	snapshot_table	columnIndex		$i
+        toolkit_set_property	snapshot_table	columnHeader	[lindex $columns $i]
+    }
+    toolkit_add             "snapshot_text"      text        "snapshotGroup"
+    toolkit_set_property    "snapshot_text"      editable    false
+    toolkit_set_property    "snapshot_text"      preferredWidth  600
+    toolkit_set_property    "snapshot_text"      text        ""
     # ///////////////////////////////////////////////////////////////////////////////////////////
     
     
@@ -526,55 +876,14 @@ proc ::data_path_bts::gui::setup_all {n_asic n_lane} {
 proc ::data_path_bts::gui::bsp2gui_setup  {bspPkgName baseGroupName isMonitor config_options } {
     variable fd_global_variable
     # 1) PREPARATION  
-    # config bsp...
-    if {[llength $config_options] > 0} {
-        for {set i 0} {$i < [llength $config_options]} {incr i 2} {
-            ::${bspPkgName}::bsp::configure [lindex $config_options $i] [lindex $config_options [expr $i+1]] 
-           
-        }
-    }
-    # bsp -> csr address map
-    array set csr_map [::${bspPkgName}::bsp::get_address_map ]
-    
-    # get opened master service
-    set mpath [::mu3e::helpers::cget_opened_master_path]
-    
-    # complete xml format for reg map, store reg map in tmp file
-    set fd [open "${bspPkgName}_bsp_tmp.xml" w]
-    puts $fd "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
-    puts $fd "<registers>"
-    for {set i 0} {$i<[array size csr_map]} {incr i} {
-        puts $fd $csr_map(${i})
-    }
-    puts $fd "</registers>"
-	close $fd
-    
-    # read this svd (xml) reg map file 
-    set fd [open "${bspPkgName}_bsp_tmp.xml" r]
-    
-    # build dom object
-    set xml_plain_text [read $fd]
-    close $fd
-    
-    # xml -> gvtable 
-    if {![::mu3e::helpers::probe_global_variable $fd_global_variable ${bspPkgName}_doc_xml]} {
-        # create new
-        ::mu3e::helpers::append_global_variable $fd_global_variable ${bspPkgName}_doc_xml "empty"
-        ::mu3e::helpers::set_global_variable $fd_global_variable ${bspPkgName}_doc_xml $xml_plain_text
-    } else {
-        # if already created
-        ::mu3e::helpers::set_global_variable $fd_global_variable ${bspPkgName}_doc_xml $xml_plain_text
-    }
-    set xml_plain_text [::mu3e::helpers::get_global_variable $fd_global_variable ${bspPkgName}_doc_xml]
+    # bsp (configured with the options) -> compiled reg map, parsed once and cached
+    set registers [::mu3e::bspmap::bind $bspPkgName $bspPkgName $config_options]
     
     # 2) BUILD GUI
-    # parse xml tree of reg map and create gui 
-    dom parse $xml_plain_text doc
-    foreach i [$doc selectNodes "/registers/register"] {
-        # dom -> register properties
-        set regName [[[$i selectNodes "name"] childNodes] nodeValue]
-        set regDespt [[[$i selectNodes "description"] childNodes] nodeValue]
-        set regAddrOfst [[[$i selectNodes "addressOffset"] childNodes] nodeValue]
+    # walk the reg map and create gui 
+    foreach reg $registers {
+        # reg map -> register properties
+        lassign $reg regName regAddrOfst regDespt fields
         # register properties -> gui
         toolkit_add ${baseGroupName}_${regName}_group group $baseGroupName
         toolkit_set_property ${baseGroupName}_${regName}_group title "${regName}: ${regAddrOfst}"
@@ -582,25 +891,11 @@ proc ::data_path_bts::gui::bsp2gui_setup  {bspPkgName baseGroupName isMonitor co
         toolkit_set_property ${baseGroupName}_${regName}_group toolTip $regDespt
         toolkit_set_property ${baseGroupName}_${regName}_group preferredWidth 180
         toolkit_set_property ${baseGroupName}_${regName}_group expandableX true
-        # dom -> field properties -> gui
-        foreach j [$i selectNodes "fields/field"] {
+        # reg map -> field properties -> gui
+        foreach field $fields {
             # ---------- parse properties --------------
-            # dom -> field properties
-            set bitName [[[$j selectNodes "name"] childNodes] nodeValue]
-            set bitRange [[[$j selectNodes "bitRange"] childNodes] nodeValue]
-            set bitAccess [[[$j selectNodes "access"] childNodes] nodeValue]
-            if {![catch [ $j selectNodes "description" ]]} {
-                # fail: not existed
-                set bitDescpt "none"
-            } else {
-                # success: enter field description 
-                set bitDescpt [[[$j selectNodes "description"] childNodes] nodeValue]
-            }
-            # [msb:lsb] -> $bitMsb and $bitLsb
-            set bitMsb [lindex [regexp -all -inline {(\d)*:} $bitRange] 0]
-            set bitMsb [lindex [regexp -all -inline {(\d)*} $bitMsb] 0]
-            set bitLsb [lindex [regexp -all -inline {:(\d)*} $bitRange] 0]
-            set bitLsb [lindex [regexp -all -inline {(\w)*} $bitLsb] 2]
+            # reg map -> field properties
+            lassign $field bitName bitLsb bitMsb bitAccess bitDescpt
             # ------------- build gui -----------------
             # field properties -> gui
             # single bit field: comboBox
@@ -664,19 +959,12 @@ proc ::data_path_bts::gui::gui2device {bspPkgName baseGroupName typeName} {
     # gvtable -> base address
     set ipBases [::mu3e::helpers::get_global_variable $fd_global_variable ${typeName}_base_address]
     
-    # gvtable - > xml
-    if {![::mu3e::helpers::probe_global_variable $fd_global_variable ${bspPkgName}_doc_xml]} {
-        # fail: does not exist
+    # registry -> reg map
+    if {[catch {::mu3e::bspmap::registers $bspPkgName} registers]} {
         toolkit_send_message error "gui2device: no bsp reg map found"
         return -code error 
-    } else {
-        # success: exists
-        set xml_plain_text [::mu3e::helpers::get_global_variable $fd_global_variable ${bspPkgName}_doc_xml]
     }
     
-    # xml -> dom 
-    dom parse $xml_plain_text doc
-    
     
     # ---------------------- get multiple copies -------------------------
     foreach ipBase $ipBases {
@@ -691,24 +979,15 @@ proc ::data_path_bts::gui::gui2device {bspPkgName baseGroupName typeName} {
         }
         
         # gui -> regValue
-        foreach i [$doc selectNodes "/registers/register"] {
+        foreach reg $registers {
             set regValue ""
             # --------------- parse register ---------------
-            set regName [[[$i selectNodes "name"] childNodes] nodeValue]
-            set regDespt [[[$i selectNodes "description"] childNodes] nodeValue]
-            set regAddrOfst [[[$i selectNodes "addressOffset"] childNodes] nodeValue]
+            lassign $reg regName regAddrOfst regDespt fields
             # init as "00000......00000" (32 zeros)
             set regValue [::mu3e::helpers::init_register32_value]
-            foreach j [$i selectNodes "fields/field"] {
+            foreach field $fields {
                 # --------------- parse field ---------------
-                set bitName [[[$j selectNodes "name"] childNodes] nodeValue]
-                set bitRange [[[$j selectNodes "bitRange"] childNodes] nodeValue]
-                set bitAccess [[[$j selectNodes "access"] childNodes] nodeValue]
-                # [msb:lsb] -> $bitMsb and $bitLsb
-                set bitMsb [lindex [regexp -all -inline {(\d)*:} $bitRange] 0]
-                set bitMsb [lindex [regexp -all -inline {(\d)*} $bitMsb] 0]
-                set bitLsb [lindex [regexp -all -inline {:(\d)*} $bitRange] 0]
-                set bitLsb [lindex [regexp -all -inline {(\w)*} $bitLsb] 2]
+                lassign $field bitName bitLsb bitMsb bitAccess bitDescpt
                 # gui -> bitValue
                 # single bit: read checkBox 
                 if {$bitLsb == $bitMsb} {
@@ -799,19 +1078,12 @@ proc ::data_path_bts::gui::device2gui {bspPkgName baseGroupName typeName} {
     # gvtable -> base address
     set ipBases [::mu3e::helpers::get_global_variable $fd_global_variable "${typeName}_base_address"]
 
-    # gvtable - > xml (bsp structure)
-    if {![::mu3e::helpers::probe_global_variable $fd_global_variable ${bspPkgName}_doc_xml]} {
-        # fail: does not exist
+    # registry -> reg map
+    if {[catch {::mu3e::bspmap::registers $bspPkgName} registers]} {
         toolkit_send_message error "gui2device: no bsp reg map found"
         return -code error 
-    } else {
-        # success: exists
-        set xml_plain_text [::mu3e::helpers::get_global_variable $fd_global_variable ${bspPkgName}_doc_xml]
     }
     
-    # xml -> dom 
-    dom parse $xml_plain_text doc
-    
     # ---------------------- set multiple copies -------------------------
     foreach ipBase $ipBases {
         # set the 
@@ -825,26 +1097,17 @@ proc ::data_path_bts::gui::device2gui {bspPkgName baseGroupName typeName} {
         
         }
         # regValue -> gui
-        foreach i [$doc selectNodes "/registers/register"] {
+        foreach reg $registers {
             set regValue ""
             # ------------------- parse register --------------------
-            set regName [[[$i selectNodes "name"] childNodes] nodeValue]
-            set regDespt [[[$i selectNodes "description"] childNodes] nodeValue]
-            set regAddrOfst [[[$i selectNodes "addressOffset"] childNodes] nodeValue]
+            lassign $reg regName regAddrOfst regDespt fields
             # master -> regValue (d2h read)
             set regValue [master_read_32 $master_fd [expr ${ipBase}+${regAddrOfst}] 1]
             #puts [format "read: %x from %x" $regValue [expr ${ipBase}+${regAddrOfst}]]
             set regValueBits [::mu3e::helpers::hex2bin $regValue]
-            foreach j [$i selectNodes "fields/field"] {
+            foreach field $fields {
                 #  ------------------- parse field -------------------
-                set bitName [[[$j selectNodes "name"] childNodes] nodeValue]
-                set bitRange [[[$j selectNodes "bitRange"] childNodes] nodeValue]
-                set bitAccess [[[$j selectNodes "access"] childNodes] nodeValue]
-                # [msb:lsb] -> $bitMsb and $bitLsb
-                set bitMsb [lindex [regexp -all -inline {(\d)*:} $bitRange] 0]
-                set bitMsb [lindex [regexp -all -inline {(\d)*} $bitMsb] 0]
-                set bitLsb [lindex [regexp -all -inline {:(\d)*} $bitRange] 0]
-                set bitLsb [lindex [regexp -all -inline {(\w)*} $bitLsb] 2]
+                lassign $field bitName bitLsb bitMsb bitAccess bitDescpt
                 # bitValue -> bitBinary
                 set bitBinary [::mu3e::helpers::binary_trim_little_endien $regValueBits $bitLsb $bitMsb]
                 # bitBinary -> gui
@@ -875,188 +1138,442 @@ proc ::data_path_bts::gui::device2gui {bspPkgName baseGroupName typeName} {
     # histograms 
     ###############################
 proc ::data_path_bts::gui::read_hist {baseGroupName} {
-    # init...
-    set hist_bins 256
-    set bin_index 0
-    # get time for uid
-    set seed_time [clock seconds]
-    # request opened master service
-    set master_fd [::mu3e::helpers::cget_opened_master_path]
     variable fd_global_variable
+    if {[::histogram_statistics::acq::is_running]} {
+        toolkit_send_message warning "read_hist: an acquisition is already running"
+        return -code error
+    }
     # gvtable -> base address
-    set hist_csr_base [::mu3e::helpers::get_global_variable $fd_global_variable "histogram_statistics.csr_base_address"]
-    set hist_bin_base [::mu3e::helpers::get_global_variable $fd_global_variable "histogram_statistics.hist_bin_base_address"]
+    ::histogram_statistics::acq::configure \
+        -csr_base [::mu3e::helpers::get_global_variable $fd_global_variable "histogram_statistics.csr_base_address"] \
+        -bin_base [::mu3e::helpers::get_global_variable $fd_global_variable "histogram_statistics.hist_bin_base_address"] \
+        -window_ms [toolkit_get_property "histWindow_textField" text]
+    set n_window [toolkit_get_property "histWindows_textField" text]
+    if {[catch {::data_path_bts::gui::hold_hist_ip "read_hist" ::histogram_statistics::acq} msg]} {
+        toolkit_send_message warning "read_hist: $msg"
+        return -code error
+    }
+    # every plot is a new measurement, the windows of it are accumulated
+    ::histogram_statistics::acq::reset
+    if {[catch {::histogram_statistics::acq::start -windows $n_window \
+        -progress [list ::data_path_bts::gui::hist_progress] -done [list ::data_path_bts::gui::plot_hist]} msg]} {
+        ::mu3e::jobs::cancel "read_hist"
+        toolkit_send_message error "read_hist: $msg"
+        return -code error
+    }
+    toolkit_set_property "histPlot_button" enabled 0
+    toolkit_set_property "histCancel_button" enabled 1
+    toolkit_set_property "histInfo_text" text "acquiring window 1/${n_window}..."
+    return -code ok
+}
+
+proc ::data_path_bts::gui::hist_progress {n_done n_todo} {
+    toolkit_set_property "histInfo_text" text "acquiring window [expr {$n_done + 1}]/[expr {$n_done + $n_todo}]..."
+    return -code ok
+}
+
+proc ::data_path_bts::gui::plot_hist {completed} {
+    variable hist_handle
+    variable hist_title
+    variable hist_info
+    # release the IP now rather than on the next poll of the job
+    ::mu3e::jobs::cancel "read_hist"
+    toolkit_set_property "histPlot_button" enabled 1
+    toolkit_set_property "histCancel_button" enabled 0
+    set result [::histogram_statistics::acq::get_result]
+    if {[dict size $result] == 0} {
+        toolkit_set_property "histInfo_text" text "cancelled, no complete window"
+        return -code ok
+    }
+    set semantics [dict get $result semantics]
+    # result -> histogram object, the 2d scan has no 2d chart widget and is kept by bin index
+    if {[info exists hist_handle]} {
+        ::histogram_statistics::histogram::destroy $hist_handle
+    }
+    if {[dict get $semantics kind] eq "2d"} {
+        set hist_handle [::histogram_statistics::histogram::create 0 1 [dict get $result counts] -unsigned 1]
+    } else {
+        set hist_handle [::histogram_statistics::histogram::create [dict get $semantics left] [dict get $semantics bin_width] \
+            [dict get $result counts] -unsigned [dict get $result settings unsigned] \
+            -underflow [dict get $result underflow] -overflow [dict get $result overflow]]
+    }
+    set hist_title [list "[dict get $semantics title] ([dict get $result n_window] x [toolkit_get_property "histWindow_textField" text] ms)" \
+        [dict get $semantics unit]]
+    set hist_info [format "windows: %d%s\nlive: %.3f s, dead: %.3f s\nunderflow: %s, overflow: %s\nwindows with error flag: %d" \
+        [dict get $result n_window] [expr {$completed ? "" : " (cancelled)"}] [dict get $result live_s] [dict get $result dead_s] \
+        [dict get $result underflow] [dict get $result overflow] [dict get $result n_error]]
+    ::data_path_bts::gui::draw_hist
+    toolkit_send_message info "read_hist: histogram `rate` plotted"
+    return -code ok
+}
+
+    # ---------------------------------------------------------------------------------------------------
+    # @name             draw_hist 
+    #
+    # @berief           (re)draw the acquired histogram object with the selected bin range and rebin
+    #                   factor, without new acquisition. called after an acquisition and by the range
+    #                   and rebin combo boxes.
+    # @param            none
+    # @return           -code ok
+    # ---------------------------------------------------------------------------------------------------
+proc ::data_path_bts::gui::draw_hist {} {
+    variable fd_global_variable
+    variable hist_chart_width
+    variable hist_handle
+    variable hist_title
+    variable hist_info
+    if {![info exists hist_handle]} {
+        return -code ok
+    }
+    # get clicks for uid, the range and rebin boxes can redraw several times per second
+    set seed_time [clock clicks]
     set hist_barChart_name [::mu3e::helpers::get_global_variable $fd_global_variable "hist_barChart_name"]
-    # get plot range 
+    # get plot range (bins of the IP) and rebin factor
     set low [toolkit_get_property "hist_lo_comboBox" selectedItem]
     set high [toolkit_get_property "hist_hi_comboBox" selectedItem]
-    # get boundary and calc bin size
-    set unsigned [toolkit_get_property ${baseGroupName}_csrrepresentation_checkBox checked]
-    set left [toolkit_get_property ${baseGroupName}_left_boundleft_bound_textField text]
-    set right [toolkit_get_property ${baseGroupName}_right_boundright_bound_textField text]
-    #puts [format "left: %i right: %i" $left $right]
-    if {!$unsigned} {
-        set left [::mu3e::helpers:hex2signed $left]
-        set right [::mu3e::helpers:hex2signed $right]
-    } 
-    #puts [format "left: %i right: %i" $left $right]
-    set bin_sz [expr 1.0*($right - $left)/$hist_bins]
+    set factor [toolkit_get_property "hist_rebin_comboBox" selectedItem]
+    set view [::histogram_statistics::histogram::slice $hist_handle $low $high]
+    # one bar per bin, so the bin width in the label holds: rebin further to fit the chart
+    set n_view [::histogram_statistics::histogram::cget $view n_bin]
+    set factor [expr {max($factor, ($n_view + $hist_chart_width - 1)/$hist_chart_width)}]
+    if {$factor > 1} {
+        set rebinned [::histogram_statistics::histogram::rebin $view $factor]
+        ::histogram_statistics::histogram::destroy $view
+        set view $rebinned
+    }
+    set left [::histogram_statistics::histogram::cget $view left]
+    set bin_sz [::histogram_statistics::histogram::cget $view bin_width]
     
-    # 1) flush (plot and IP)
-    # hide old plot
+    # 1) flush plot: hide old plot
     toolkit_set_property $hist_barChart_name visible 0
     toolkit_set_property $hist_barChart_name enabled 0
+    ::mu3e::render::forget $hist_barChart_name
     # update gvtable
     ::mu3e::helpers::set_global_variable $fd_global_variable "hist_barChart_name" "hist_barChart$seed_time"
     # create new plot
     toolkit_add "hist_barChart$seed_time" barChart "histDisplayGroup"
     toolkit_set_property "hist_barChart$seed_time" preferredWidth 1000
-    toolkit_set_property "hist_barChart$seed_time" title "Histogram Bin Plot"
-    toolkit_set_property "hist_barChart$seed_time" labelX [format "\[%d : %d\]" $left $right]
-    toolkit_set_property "hist_barChart$seed_time" labelY [format "bin count / %.2f" $bin_sz]
-    
-    # sclr the IP 
-    master_write_32 $master_fd $hist_bin_base 0x0
-    # 2) wait 1 s
-    after 1000
-    # 3) read <hist_bin>
-    set csr_pack [master_read_32 $master_fd $hist_bin_base $hist_bins]
-    #puts $csr_pack
-    # 4) plot 
-    foreach regValue $csr_pack {
-        # 1) within range: plot
-        if {[expr $bin_index <= $high && $bin_index >=$low]} {
-            set regValue [format %i $regValue]
-            set bin_mid [expr $bin_index*$bin_sz+0.5*$bin_sz+$left]
-            toolkit_set_property "hist_barChart$seed_time" itemValue [list $bin_mid $regValue]
-        # 2) out of range: do not plot
-        } else {
-            #toolkit_set_property "hist_barChart" itemValue [list $bin_index 0]
-        }
+    toolkit_set_property "hist_barChart$seed_time" title [lindex $hist_title 0]
+    toolkit_set_property "hist_barChart$seed_time" labelX [format "%s \[%s : %s\]" [lindex $hist_title 1] $left [::histogram_statistics::histogram::cget $view right]]
+    toolkit_set_property "hist_barChart$seed_time" labelY [format "bin count / %s" $bin_sz]
+    
+    # 2) plot
+    set points [list]
+    set bin_index 0
+    foreach count [::histogram_statistics::histogram::cget $view counts] {
+        lappend points [list [expr {$left + ($bin_index + 0.5)*$bin_sz}] $count]
         incr bin_index
     }
-    toolkit_send_message info "read_hist: histogram `rate` plotted"
-    ::mu3e::helpers::set_global_variable $fd_global_variable "hist_regpack" $csr_pack
+    ::mu3e::render::series "hist_barChart$seed_time" $points -interval_ms 0 -width 0
+    # 3) statistics of the range
+    set text $hist_info
+    append text [format "\nrange: %s entries, mean: %s, rms: %s" [::histogram_statistics::histogram::integral $view] \
+        [::histogram_statistics::histogram::mean $view] [::histogram_statistics::histogram::rms $view]]
+    foreach peak [lrange [::histogram_statistics::histogram::peaks $view 1 [expr {max(1, [::histogram_statistics::histogram::cget $view n_bin]/32)}]] 0 2] {
+        append text [format "\npeak at %s: %s" [lindex $peak 1] [lindex $peak 2]]
+    }
+    toolkit_set_property "histInfo_text" text $text
+    ::histogram_statistics::histogram::destroy $view
     return -code ok
 }
 
 proc ::data_path_bts::gui::save_hist {fileChooserButtonName baseGroupName} {
-    # init
-    variable fd_global_variable
-    set hist_bins 256
-    set bin_index 0
-    set bin_mids [list]
-    set regValues [list]
-    # get boundary and calc bin size
-    set unsigned [toolkit_get_property ${baseGroupName}_csrrepresentation_checkBox checked]
-    set left [toolkit_get_property ${baseGroupName}_left_boundleft_bound_textField text]
-    set right [toolkit_get_property ${baseGroupName}_right_boundright_bound_textField text]
-    if {!$unsigned} {
-        set left [::mu3e::helpers:hex2signed $left]
-        set right [::mu3e::helpers:hex2signed $right]
-    } 
-    set bin_sz [expr 1.0*($right - $left)/$hist_bins]
-    
-    # get hist content
-    set csr_pack [::mu3e::helpers::get_global_variable $fd_global_variable "hist_regpack"]
-    
+    variable hist_handle
+    if {![info exists hist_handle]} {
+        toolkit_send_message warning "save_hist: no histogram acquired yet"
+        return -code error
+    }
     if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
 		toolkit_send_message warning "save_hist: file selection cancelled, byte~"
 		return -code error
 	} else {
-        # open path and file
 		set file_path [toolkit_get_property $fileChooserButtonName paths]
-		set fd [open "$file_path" w]
-        
-        # get reg value saved by last session -> two lists for x and y
-        foreach regValue $csr_pack {
-            set regValue [format %i $regValue]
-            set bin_mid [expr $bin_index*$bin_sz+0.5*$bin_sz+$left]
-            lappend bin_mids $bin_mid
-            lappend regValues $regValue
-            incr bin_index
-        }
-        # save to file 
-        #puts $bin_mids
-        #puts $regValues
-		puts $fd $bin_mids 
-        puts $fd $regValues 
-		close $fd	
+        ::histogram_statistics::histogram::export $hist_handle $file_path
 		toolkit_send_message info "save_hist: histogram data saved (${file_path}), thank you!"	
 		return -code ok
 	}
 }
 
+# job resource of the histogram_statistics IP, claimed by scan_hist and by hold_hist_ip
+proc ::data_path_bts::gui::hist_ip_resource {} {
+    variable fd_global_variable
+    return "histogram_statistics@[::mu3e::helpers::get_global_variable $fd_global_variable "histogram_statistics.csr_base_address"]"
+}
+
+    # ---------------------------------------------------------------------------------------------------
+    # @name             hold_hist_ip 
+    #
+    # @berief           claim the histogram_statistics IP for an engine that runs on its own timers (acq,
+    #                   adaptive). the claim is a job on the resource of scan_hist that lasts as long as the
+    #                   engine runs, so the scans and the engines exclude each other and the engine is listed
+    #                   by ::mu3e::jobs::get_jobs. cancelling the job cancels the engine.
+    # @param            job     - name of the job
+    #                   engine  - namespace of the engine, with is_running and cancel
+    # @return           -code ok, -code error if the IP is in use
+    # ---------------------------------------------------------------------------------------------------
+proc ::data_path_bts::gui::hold_hist_ip {job engine} {
+    ::mu3e::jobs::start $job [list ::data_path_bts::gui::hold_hist_ip_step $engine] \
+        -resource [::data_path_bts::gui::hist_ip_resource] -cleanup [list ::data_path_bts::gui::hold_hist_ip_cleanup $engine]
+    return -code ok
+}
+
+proc ::data_path_bts::gui::hold_hist_ip_step {engine name state} {
+    if {[${engine}::is_running]} {
+        return [list 100 $state]
+    }
+    return [list done $state]
+}
+
+proc ::data_path_bts::gui::hold_hist_ip_cleanup {engine name state} {
+    ${engine}::cancel
+    return -code ok
+}
+
 proc ::data_path_bts::gui::scan_hist {fileChooserButtonName baseGroupName stepSizeButtonName minButtonName nstepButtonName} {
-    # init
     variable fd_global_variable
-    set hist_bins 256
-    set bin_mids [list]
-    set regValues [list]
-    # request opened master service
-    set master_fd [::mu3e::helpers::cget_opened_master_path]
+    if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
+        toolkit_send_message warning "scan_hist: file selection cancelled, byte~"
+        return -code error
+    }
     # gvtable -> base address
     set hist_csr_base [::mu3e::helpers::get_global_variable $fd_global_variable "histogram_statistics.csr_base_address"]
-    set hist_bin_base [::mu3e::helpers::get_global_variable $fd_global_variable "histogram_statistics.hist_bin_base_address"]
-    # scan related 
-    set step_sz [toolkit_get_property $stepSizeButtonName text]
-    set scan_min [toolkit_get_property $minButtonName text]
-    set nstep [toolkit_get_property $nstepButtonName text]
-    set unsigned [toolkit_get_property ${baseGroupName}_csrrepresentation_checkBox checked]
-    
-    # scan iterations
-    for {set i 0} {$i < $nstep} {incr i} {
-        # allow for abort
-        # ...
-    
+    set state [dict create i 0 phase load t_clear_us 0 \
+        csr_base $hist_csr_base \
+        bin_base [::mu3e::helpers::get_global_variable $fd_global_variable "histogram_statistics.hist_bin_base_address"] \
+        step_sz [toolkit_get_property $stepSizeButtonName text] \
+        scan_min [toolkit_get_property $minButtonName text] \
+        nstep [toolkit_get_property $nstepButtonName text] \
+        unsigned [toolkit_get_property ${baseGroupName}_csrrepresentation_checkBox checked] \
+        file_path [toolkit_get_property $fileChooserButtonName paths]]
+    # the windows of this scan are stitched into one histogram
+    ::histogram_statistics::stitch::reset
+    if {[catch {::mu3e::jobs::start "scan_hist" [list ::data_path_bts::gui::scan_hist_step] -state $state \
+        -resource [::data_path_bts::gui::hist_ip_resource] -progress [list ::data_path_bts::gui::scan_hist_progress] \
+        -done [list ::data_path_bts::gui::scan_hist_done]} msg]} {
+        toolkit_send_message warning "scan_hist: $msg"
+        return -code error
+    }
+    toolkit_set_property "auto_start_button" enabled 0
+    toolkit_set_property "auto_adaptive_button" enabled 0
+    toolkit_set_property "auto_cancel_button" enabled 1
+    return -code ok
+}
+
+# job step of scan_hist: load a window and let it integrate for 1 s, then read it back
+proc ::data_path_bts::gui::scan_hist_step {name state} {
+    set hist_bins 256
+    set master_fd [::mu3e::helpers::cget_opened_master_path]
+    dict with state {}
+    set left [expr {$scan_min + $i*$step_sz}]
+    set right [expr {$scan_min + ($i + 1)*$step_sz}]
+    if {$phase eq "load"} {
         # 1) load new setting
-        master_write_32 $master_fd [expr $hist_csr_base + 0x4] [expr $scan_min + $i*$step_sz]
-        master_write_32 $master_fd [expr $hist_csr_base + 0x8] [expr $scan_min + [expr $i+1]*$step_sz]
+        master_write_32 $master_fd [expr {$csr_base + 0x4}] $left
+        master_write_32 $master_fd [expr {$csr_base + 0x8}] $right
         # 2) sclr the IP 
-        master_write_32 $master_fd $hist_bin_base 0x0
-        set bin_mids [list]
-        set regValues [list]
+        master_write_32 $master_fd $bin_base 0x0
+        dict set state t_clear_us [clock microseconds]
+        dict set state phase read
+        ::mu3e::jobs::progress $name [expr {double($i)/$nstep}] "window ${i}/${nstep}: integrating"
         # 3) wait 1 s
-        after 1000
-        # 4) read <hist_bin>
-        set csr_pack [master_read_32 $master_fd $hist_bin_base $hist_bins]
-        # 5) get boundary and calc bin size
-        set left [expr $scan_min + $i*$step_sz]
-        set right [expr $scan_min + [expr $i+1]*$step_sz]
-        if {!$unsigned} {
-            set left [::mu3e::helpers:hex2signed $left]
-            set right [::mu3e::helpers:hex2signed $right]
-        } 
-        set bin_index 0
-        set bin_sz [expr 1.0*($right - $left)/$hist_bins]
-            
-        if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
-            toolkit_send_message warning "save_hist: file selection cancelled, byte~"
-            return -code error
-        } else {
-            # open path and file
-            set file_path [toolkit_get_property $fileChooserButtonName paths]
-            set file_path "${file_path}_step-${i}.txt"
-            set fd [open "$file_path" w]
-            
-            # get reg value saved by last session -> two lists for x and y
-            foreach regValue $csr_pack {
-                set regValue [format %i $regValue]
-                set bin_mid [expr $bin_index*$bin_sz+0.5*$bin_sz+$left]
-                lappend bin_mids $bin_mid
-                lappend regValues $regValue
-                incr bin_index
-            }
-            # save to file 
-            #puts $bin_mids
-            #puts $regValues
-            puts $fd $bin_mids 
-            puts $fd $regValues 
-            close $fd	
-            toolkit_send_message info "scan_hist: process (${i}/${nstep}), histogram data saved as (${file_path})"	
+        return [list 1000 $state]
+    }
+    # 4) read <hist_bin>
+    set live_s [expr {([clock microseconds] - $t_clear_us)*1.0e-6}]
+    set csr_pack [master_read_32 $master_fd $bin_base $hist_bins]
+    # 5) get boundary and calc bin size
+    if {!$unsigned} {
+        set left [::mu3e::helpers:hex2signed $left]
+        set right [::mu3e::helpers:hex2signed $right]
+    } 
+    set bin_sz [expr 1.0*($right - $left)/$hist_bins]
+    # right bound from the bin width, a signed window across the sign change stays contiguous
+    ::histogram_statistics::stitch::add_window $left [expr {double($step_sz)/$hist_bins}] $csr_pack $live_s 1
+    # 6) save the window
+    set step_path "${file_path}_step-${i}.txt"
+    set bin_mids [list]
+    set regValues [list]
+    set bin_index 0
+    foreach regValue $csr_pack {
+        lappend bin_mids [expr $bin_index*$bin_sz+0.5*$bin_sz+$left]
+        lappend regValues [format %i $regValue]
+        incr bin_index
+    }
+    set fd [open $step_path w]
+    puts $fd $bin_mids 
+    puts $fd $regValues 
+    close $fd	
+    toolkit_send_message info "scan_hist: process (${i}/${nstep}), histogram data saved as (${step_path})"	
+    dict set state i [incr i]
+    dict set state phase load
+    if {$i >= $nstep} {
+        return [list done $state]
+    }
+    return [list 0 $state]
+}
+
+proc ::data_path_bts::gui::scan_hist_progress {name fraction text} {
+    toolkit_set_property "stitch_text" text "scan: $text"
+    return -code ok
+}
+
+proc ::data_path_bts::gui::scan_hist_done {name status result} {
+    toolkit_set_property "auto_start_button" enabled 1
+    toolkit_set_property "auto_adaptive_button" enabled 1
+    toolkit_set_property "auto_cancel_button" enabled 0
+    # on error the result is the message, the state is gone
+    if {$status eq "error"} {
+        toolkit_send_message error "scan_hist: scan failed: $result"
+        return -code ok
+    }
+    if {$status eq "ok"} {
+        toolkit_send_message info "scan_hist: process ([dict get $result nstep]/[dict get $result nstep]), scan completed successful"	
+    } else {
+        toolkit_send_message warning "scan_hist: scan ${status} at window [dict get $result i]"
+    }
+    if {[dict get $result i] > 0} {
+        ::data_path_bts::gui::draw_stitch
+    }
+    return -code ok
+}
+
+proc ::data_path_bts::gui::adaptive_scan_hist {baseGroupName} {
+    variable fd_global_variable
+    if {[::histogram_statistics::adaptive::is_running]} {
+        toolkit_send_message warning "adaptive_scan_hist: a scan is already running"
+        return -code error
+    }
+    if {[catch {::histogram_statistics::adaptive::configure \
+        -csr_base [::mu3e::helpers::get_global_variable $fd_global_variable "histogram_statistics.csr_base_address"] \
+        -bin_base [::mu3e::helpers::get_global_variable $fd_global_variable "histogram_statistics.hist_bin_base_address"] \
+        -scan_min [toolkit_get_property "auto_min_textField" text] \
+        -step_sz [toolkit_get_property "auto_step_textField" text] \
+        -nstep [toolkit_get_property "auto_nstep_textField" text] \
+        -unsigned [toolkit_get_property ${baseGroupName}_csrrepresentation_checkBox checked] \
+        -target [toolkit_get_property "auto_target_textField" text] \
+        -coarse_ms [toolkit_get_property "auto_coarse_textField" text] \
+        -max_ms [toolkit_get_property "auto_max_textField" text]} error_msg]} {
+        toolkit_send_message error "adaptive_scan_hist: $error_msg"
+        return -code error
+    }
+    if {[catch {::data_path_bts::gui::hold_hist_ip "adaptive_scan_hist" ::histogram_statistics::adaptive} msg]} {
+        toolkit_send_message warning "adaptive_scan_hist: $msg"
+        return -code error
+    }
+    if {[catch {::histogram_statistics::adaptive::start -progress [list ::data_path_bts::gui::adaptive_scan_progress] \
+        -done [list ::data_path_bts::gui::adaptive_scan_done]} msg]} {
+        ::mu3e::jobs::cancel "adaptive_scan_hist"
+        toolkit_send_message error "adaptive_scan_hist: $msg"
+        return -code error
+    }
+    toolkit_set_property "auto_start_button" enabled 0
+    toolkit_set_property "auto_adaptive_button" enabled 0
+    toolkit_set_property "auto_cancel_button" enabled 1
+    return -code ok
+}
+
+proc ::data_path_bts::gui::adaptive_scan_progress {pass window n_todo} {
+    if {$pass eq "coarse"} {
+        toolkit_set_property "stitch_text" text "adaptive scan: coarse pass, window ${window}"
+    } else {
+        toolkit_set_property "stitch_text" text "adaptive scan: fine pass, window ${window}, ${n_todo} windows left"
+    }
+    return -code ok
+}
+
+proc ::data_path_bts::gui::adaptive_scan_done {completed} {
+    # release the IP now rather than on the next poll of the job
+    ::mu3e::jobs::cancel "adaptive_scan_hist"
+    toolkit_set_property "auto_start_button" enabled 1
+    toolkit_set_property "auto_adaptive_button" enabled 1
+    toolkit_set_property "auto_cancel_button" enabled 0
+    set report [::histogram_statistics::adaptive::get_report]
+    toolkit_send_message info [format "adaptive_scan_hist: %s, %d windows (%d at target, %d empty), %.1f s of dwell in %.1f s, fixed dwell would take %.1f s" \
+        [expr {$completed ? "completed" : "cancelled"}] [dict get $report n_window] [dict get $report n_target] \
+        [dict get $report n_empty] [dict get $report live_s] [dict get $report wall_s] [dict get $report fixed_s]]
+    if {[dict get $report n_window] > 0} {
+        ::data_path_bts::gui::draw_stitch
+    }
+    return -code ok
+}
+
+proc ::data_path_bts::gui::load_stitch {fileChooserButtonName} {
+    if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
+		toolkit_send_message warning "load_stitch: file selection cancelled, byte~"
+		return -code error
+	}
+    # any file of the set selects all steps of it
+    set file_path [toolkit_get_property $fileChooserButtonName paths]
+    regsub {_step-[0-9]+\.txt$} $file_path "" prefix
+    set files [lsort -dictionary [glob -nocomplain "${prefix}_step-*.txt"]]
+    if {[llength $files] == 0} {
+        toolkit_send_message warning "load_stitch: no scan files ${prefix}_step-*.txt found"
+        return -code error
+    }
+    ::histogram_statistics::stitch::reset
+    set n [::histogram_statistics::stitch::load_files $files]
+    toolkit_send_message info "load_stitch: ${n} windows of ${prefix} loaded"
+    ::data_path_bts::gui::draw_stitch
+    return -code ok
+}
+
+    # ---------------------------------------------------------------------------------------------------
+    # @name             draw_stitch 
+    #
+    # @berief           plot the stitched scan between the low and high edges at the chosen number of
+    #                   bins. the whole scan if the edges are empty.
+    # @param            none
+    # @return           -code ok
+    # ---------------------------------------------------------------------------------------------------
+proc ::data_path_bts::gui::draw_stitch {} {
+    variable stitch_chart_id
+    variable hist_chart_width
+    if {[catch {::histogram_statistics::stitch::get_info} info]} {
+        toolkit_send_message warning "draw_stitch: $info"
+        return -code error
+    }
+    set lo [toolkit_get_property "stitch_lo_textField" text]
+    set hi [toolkit_get_property "stitch_hi_textField" text]
+    set n_bin [toolkit_get_property "stitch_nbin_textField" text]
+    # one bar per bin, so the bin width in the label holds
+    if {$n_bin > $hist_chart_width} {
+        toolkit_send_message warning "draw_stitch: ${n_bin} bins do not fit the chart, drawing ${hist_chart_width}"
+        set n_bin $hist_chart_width
+    }
+    if {$lo eq ""} {
+        set lo [dict get $info left]
+    }
+    if {$hi eq ""} {
+        set hi [dict get $info right]
+    }
+    # recreate the chart to clear it
+    set chart_name "stitch_barChart"
+    if {[info exists stitch_chart_id]} {
+        set chart_name "stitch_barChart$stitch_chart_id"
+    }
+    toolkit_set_property $chart_name visible 0
+    toolkit_set_property $chart_name enabled 0
+    ::mu3e::render::forget $chart_name
+    set stitch_chart_id [clock clicks]
+    set chart_name "stitch_barChart$stitch_chart_id"
+    toolkit_add             $chart_name         barChart "hitsAutoStitchGroup"
+    toolkit_set_property    $chart_name         preferredWidth  1000
+    toolkit_set_property    $chart_name         title   "Stitched Scan"
+    toolkit_set_property    $chart_name         labelX  [format "\[%s : %s\]" $lo $hi]
+    toolkit_set_property    $chart_name         labelY  [format "rate (1/s) / %s" [expr {double($hi - $lo)/$n_bin}]]
+    set n_gap 0
+    set points [list]
+    foreach bin [::histogram_statistics::stitch::query $lo $hi $n_bin] {
+        lassign $bin center rate coverage
+        lappend points [list $center $rate]
+        if {$coverage < 1.0} {
+            incr n_gap
         }
     }
-    toolkit_send_message info "scan_hist: process (${nstep}/${nstep}), scan completed successful)"	
+    ::mu3e::render::series $chart_name $points -interval_ms 0 -width 0
+    toolkit_set_property "stitch_text" text [format "windows: %d, live: %.1f s\nscan: \[%s : %s\] in %d bins of %s, %d overlapping\nview bins not fully covered: %d" \
+        [dict get $info n_window] [dict get $info live_s] [dict get $info left] [dict get $info right] \
+        [dict get $info n_bin] [dict get $info bin_width] [dict get $info n_overlap] $n_gap]
     return -code ok
 }
 
@@ -1068,58 +1585,22 @@ proc ::data_path_bts::gui::scan_hist {fileChooserButtonName baseGroupName stepSi
 proc ::data_path_bts::gui::setup_deassembly {baseGroupName} {
     variable fd_global_variable
     # 1) PREPARATION  
-    # csr address map <- bsp 
-    array set csr_map [::frame_deassembly::bsp::get_address_map ]
-    # request opened master service
-    #set mpath [::mu3e::helpers::cget_opened_master_path]
-    # complete xml format for reg map, store reg map in tmp file
-    set fd [open "frame_deassembly_bsp_tmp.xml" w]
-    puts $fd "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
-    puts $fd "<registers>"
-    for {set i 0} {$i<[array size csr_map]} {incr i} {
-        puts $fd $csr_map(${i})
-    }
-    puts $fd "</registers>"
-	close $fd
-    # read this svd (xml) reg map file 
-    set fd [open "frame_deassembly_bsp_tmp.xml" r]
-    # build dom object
-    set xml_plain_text [read $fd]
-    # xml -> gvtable
-    ::mu3e::helpers::set_global_variable $fd_global_variable "frame_deassembly_doc_xml" $xml_plain_text
-    set xml_plain_text [::mu3e::helpers::get_global_variable $fd_global_variable "frame_deassembly_doc_xml"]
-    dom parse $xml_plain_text doc
-    
-    close $fd
+    # bsp -> compiled reg map
+    set registers [::mu3e::bspmap::bind "frame_deassembly" "frame_deassembly"]
+    
     # 2) SETUP 
-    # parse xml tree of reg map and create gui 
-    foreach i [$doc selectNodes "/registers/register"] {
+    # walk the reg map and create gui 
+    foreach reg $registers {
         # parse register
-        set regName [[[$i selectNodes "name"] childNodes] nodeValue]
-        set regDespt [[[$i selectNodes "description"] childNodes] nodeValue]
-        set regAddrOfst [[[$i selectNodes "addressOffset"] childNodes] nodeValue]
+        lassign $reg regName regAddrOfst regDespt fields
         # gui for register
         toolkit_add ${regName}_group group $baseGroupName
         toolkit_set_property ${regName}_group title "${regName}: ${regAddrOfst}"
         toolkit_set_property ${regName}_group itemsPerRow 4
         toolkit_set_property ${regName}_group toolTip $regDespt
-        foreach j [$i selectNodes "fields/field"] {
+        foreach field $fields {
             # parse field 
-            set bitName [[[$j selectNodes "name"] childNodes] nodeValue]
-            set bitRange [[[$j selectNodes "bitRange"] childNodes] nodeValue]
-            set bitAccess [[[$j selectNodes "access"] childNodes] nodeValue]
-            if {![catch [ $j selectNodes "description" ]]} {
-                # fail: not existed
-                set bitDescpt "none"
-            } else {
-                # success: 
-                set bitDescpt [[[$j selectNodes "description"] childNodes] nodeValue]
-            }
-            # -- parse the [msb:lsb] format
-            set bitMsb [lindex [regexp -all -inline {(\d)*:} $bitRange] 0]
-            set bitMsb [lindex [regexp -all -inline {(\d)*} $bitMsb] 0]
-            set bitLsb [lindex [regexp -all -inline {:(\d)*} $bitRange] 0]
-            set bitLsb [lindex [regexp -all -inline {(\w)*} $bitLsb] 2]
+            lassign $field bitName bitLsb bitMsb bitAccess bitDescpt
             #puts "${bitMsb} : ${bitLsb}"
             # gui for field
             # 1) setup checkBox for single bit
@@ -1152,7 +1633,6 @@ proc ::data_path_bts::gui::setup_deassembly {baseGroupName} {
 }
 
 proc ::data_path_bts::gui::setup_deassembly_controlPanel {baseGroupName} {
-    variable lvds_monitor_fd ""
     toolkit_add            "deassembly_controlPanel_write_button"     button      $baseGroupName
     toolkit_set_property   "deassembly_controlPanel_write_button"     text        "update registers"
     toolkit_set_property   "deassembly_controlPanel_write_button"     onClick      {::data_path_bts::gui::deassembly_update_registers_functor }
@@ -1176,32 +1656,26 @@ proc ::data_path_bts::gui::deassembly_update_registers_functor {} {
 }
 
 proc ::data_path_bts::gui::deassembly_monitor_registers_functor {} {
-    variable deassembly_monitor_fd
+    variable fd_global_variable
     set checked [toolkit_get_property "deassembly_controlPanel_monitor_checkBox" checked]
-    # hide button
-    toolkit_set_property "deassembly_controlPanel_write_button" enabled [expr ![expr $checked]]
-    # get selected master service path
-    set master_path [::mu3e::helpers::get_selected_servicePath "jtagMasterGroup_showmp_comboBox"]
     if {$checked} {
-        # open monitor serivce
-        if {$deassembly_monitor_fd ne ""} {
-            toolkit_send_message info "deassembly_monitor_registers_functor: monitor started..." 
-        } else {
-            #puts "monitor not created"
-            # open monitor service -> fd
-            set deassembly_monitor_fd [::mu3e::helpers::open_monitor_service]
-            monitor_set_interval $deassembly_monitor_fd 1000
-            monitor_set_callback $deassembly_monitor_fd [list ::data_path_bts::gui::read_deassembly]
-            monitor_add_range $deassembly_monitor_fd $master_path 0x0 4
-            toolkit_send_message info "deassembly_monitor_registers_functor: registered monitor service, monitor started..." 
+        # (re-)register one range per copy, adjacent copies are merged into one block read
+        set period [::mu3e::helpers::get_global_variable $fd_global_variable "deassembly_monitor_period_ms"]
+        set span [::data_path_bts::gui::get_reg_span "frame_deassembly"]
+        set n 0
+        foreach base [::mu3e::helpers::get_global_variable $fd_global_variable "mutrig_frame_deassembly.csr_base_address"] {
+            ::mu3e::monitor::register "deassembly$n" $base $span $period
+            ::mu3e::monitor::subscribe "deassembly$n" [list ::data_path_bts::gui::read_deassembly "deassemblyGroup${n}_"]
+            incr n
         }
-        monitor_set_enabled $deassembly_monitor_fd 1
+        ::mu3e::monitor::set_enabled "deassembly*" 1
+        toolkit_send_message info "deassembly_monitor_registers_functor: monitor started..." 
         # update loading gif
         toolkit_set_property    "deassembly_controlPanel_loading_bitmap"  label           "monitering..."
         toolkit_set_property    "deassembly_controlPanel_loading_bitmap"  visible         1
         toolkit_set_property    "deassembly_controlPanel_loading_bitmap"  toolTip         "press again to stop"
     } else {
-        monitor_set_enabled $deassembly_monitor_fd 0
+        ::mu3e::monitor::set_enabled "deassembly*" 0
         # update loading gif
         toolkit_set_property    "deassembly_controlPanel_loading_bitmap"  label           "stopped"
         toolkit_set_property    "deassembly_controlPanel_loading_bitmap"  visible         0
@@ -1210,22 +1684,78 @@ proc ::data_path_bts::gui::deassembly_monitor_registers_functor {} {
 
 }
 
-proc ::data_path_bts::gui::read_deassembly {} {
-    # init ...
+# monitor subscriber: register words of one copy -> gui
+proc ::data_path_bts::gui::read_deassembly {prefix name words} {
+    ::data_path_bts::gui::regwords2gui "frame_deassembly" $prefix $words
+    return -code ok
+}   
+
+proc ::data_path_bts::gui::deassembly_errors_functor {} {
     variable fd_global_variable
-    set master_fd [::mu3e::helpers::cget_opened_master_path]
-    # gvtable -> base address
-    set deassembly_base_list [::mu3e::helpers::get_global_variable $fd_global_variable "mutrig_frame_deassembly.csr_base_address"]
-    set span [expr 3*4]
-    foreach base $deassembly_base_list {
-        set registers [master_read_32 $master_fd $base 3]
-        foreach register $registers {
-            
+    set checked [toolkit_get_property "deassembly_errors_checkBox" checked]
+    if {$checked} {
+        # named deasm_err*, so the "deassembly*" toggle of the register monitor does not match them
+        set period [::mu3e::helpers::get_global_variable $fd_global_variable "deassembly_errors_period_ms"]
+        set bases [::mu3e::helpers::get_global_variable $fd_global_variable "mutrig_frame_deassembly.csr_base_address"]
+        ::frame_deassembly::errors::reset
+        # csr, error_counter and frame_counter of all copies in one block read, as long as the
+        # copies are close; otherwise one range per copy (adjacent ones are still merged)
+        set first [tcl::mathfunc::min {*}$bases]
+        set span [expr {[tcl::mathfunc::max {*}$bases] - $first + 0xc}]
+        if {$span <= 0x100*[llength $bases]} {
+            ::mu3e::monitor::register "deasm_err" $first $span $period
+            ::mu3e::monitor::subscribe "deasm_err" [list ::data_path_bts::gui::deassembly_errors_update $first $bases]
+        } else {
+            set n 0
+            foreach base $bases {
+                ::mu3e::monitor::register "deasm_err$n" $base 0xc $period
+                ::mu3e::monitor::subscribe "deasm_err$n" [list ::data_path_bts::gui::deassembly_errors_update $base [list $base]]
+                incr n
+            }
         }
+        ::mu3e::monitor::set_enabled "deasm_err*" 1
+        toolkit_send_message info "deassembly_errors_functor: error rate monitor started ($period ms)" 
+        toolkit_set_property    "deassembly_errors_loading_bitmap"  label           "monitering..."
+        toolkit_set_property    "deassembly_errors_loading_bitmap"  visible         1
+        toolkit_set_property    "deassembly_errors_loading_bitmap"  toolTip         "press again to stop"
+    } else {
+        ::mu3e::monitor::set_enabled "deasm_err*" 0
+        toolkit_set_property    "deassembly_errors_loading_bitmap"  label           "stopped"
+        toolkit_set_property    "deassembly_errors_loading_bitmap"  visible         0
     }
-    # read 
-   
-}   
+    return -code ok
+}
+
+# monitor subscriber: slices the block into the copies and feeds the error monitor, the display
+# follows at most twice a second
+proc ::data_path_bts::gui::deassembly_errors_update {first bases name words} {
+    variable fd_global_variable
+    variable deassembly_errors_shown_ms
+    set all_bases [::mu3e::helpers::get_global_variable $fd_global_variable "mutrig_frame_deassembly.csr_base_address"]
+    set t [expr {[clock milliseconds]/1000.0}]
+    foreach base $bases {
+        set offset [expr {($base - $first)/4}]
+        ::frame_deassembly::errors::update [lsearch -exact $all_bases $base] [lrange $words $offset [expr {$offset + 2}]] $t
+    }
+    set now [clock milliseconds]
+    if {[info exists deassembly_errors_shown_ms] && $now - $deassembly_errors_shown_ms < 500} {
+        return -code ok
+    }
+    set deassembly_errors_shown_ms $now
+    set rows [list]
+    for {set i 0} {$i < [llength $all_bases]} {incr i} {
+        set status [::frame_deassembly::errors::get_status $i]
+        if {[dict size $status] == 0} {
+            continue
+        }
+        lappend rows [list $i [format %.2f [dict get $status crc_rate]] [format %.2f [dict get $status bad_rate]] \
+            [dict get $status crc_total] [format %.2e [dict get $status ber]] \
+            "[format %.2e [dict get $status ber_lower]] - [format %.2e [dict get $status ber_upper]]" \
+            [dict get $status n_burst] [dict get $status n_coincident] [dict get $status n_lvds_only]]
+    }
+    ::mu3e::render::table "deassembly_errors_table" $rows
+    return -code ok
+}
 
     ###############################
     # lvds 
@@ -1234,61 +1764,22 @@ proc ::data_path_bts::gui::read_deassembly {} {
 proc ::data_path_bts::gui::setup_lvds {baseGroupName n_lane} {
     variable fd_global_variable
     # 1) PREPARATION  
-    # configure -> bsp
-    ::lvds_rx::bsp::configure -n_lane $n_lane
-    # csr address map <- bsp 
-    array set csr_map [::lvds_rx::bsp::get_address_map ]
-    # request opened master service
-    #set mpath [::mu3e::helpers::cget_opened_master_path]
-    # complete xml format for reg map, store reg map in tmp file
-    set fd [open "lvds_bsp_tmp.xml" w]
-    puts $fd "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
-    puts $fd "<registers>"
-    for {set i 0} {$i<[array size csr_map]} {incr i} {
-        puts $fd $csr_map(${i})
-    }
-    puts $fd "</registers>"
-	close $fd
-    # read this svd (xml) reg map file 
-    set fd [open "lvds_bsp_tmp.xml" r]
-    # build dom object
-    set xml_plain_text [read $fd]
-    # xml -> gvtable
-    ::mu3e::helpers::set_global_variable $fd_global_variable "lvds_doc_xml" $xml_plain_text
-    set xml_plain_text [::mu3e::helpers::get_global_variable $fd_global_variable "lvds_doc_xml"]
-    dom parse $xml_plain_text doc
-    
-    close $fd
+    # bsp (configured with the lane count) -> compiled reg map
+    set registers [::mu3e::bspmap::bind "lvds" "lvds_rx" [list -n_lane $n_lane]]
     
     # 2) SETUP 
-    # parse xml tree of reg map and create gui 
-    foreach i [$doc selectNodes "/registers/register"] {
+    # walk the reg map and create gui 
+    foreach reg $registers {
         # parse register
-        set regName [[[$i selectNodes "name"] childNodes] nodeValue]
-        set regDespt [[[$i selectNodes "description"] childNodes] nodeValue]
-        set regAddrOfst [[[$i selectNodes "addressOffset"] childNodes] nodeValue]
+        lassign $reg regName regAddrOfst regDespt fields
         # gui for register
         toolkit_add ${regName}_group group $baseGroupName
         toolkit_set_property ${regName}_group title "${regName}: ${regAddrOfst}"
         toolkit_set_property ${regName}_group itemsPerRow 4
         toolkit_set_property ${regName}_group toolTip $regDespt
-        foreach j [$i selectNodes "fields/field"] {
+        foreach field $fields {
             # parse field 
-            set bitName [[[$j selectNodes "name"] childNodes] nodeValue]
-            set bitRange [[[$j selectNodes "bitRange"] childNodes] nodeValue]
-            set bitAccess [[[$j selectNodes "access"] childNodes] nodeValue]
-            if {![catch [ $j selectNodes "description" ]]} {
-                # fail: not existed
-                set bitDescpt "none"
-            } else {
-                # success: 
-                set bitDescpt [[[$j selectNodes "description"] childNodes] nodeValue]
-            }
-            # -- parse the [msb:lsb] format
-            set bitMsb [lindex [regexp -all -inline {(\d)*:} $bitRange] 0]
-            set bitMsb [lindex [regexp -all -inline {(\d)*} $bitMsb] 0]
-            set bitLsb [lindex [regexp -all -inline {:(\d)*} $bitRange] 0]
-            set bitLsb [lindex [regexp -all -inline {(\w)*} $bitLsb] 2]
+            lassign $field bitName bitLsb bitMsb bitAccess bitDescpt
             #puts "${bitMsb} : ${bitLsb}"
             # gui for field
             # 1) setup checkBox for single bit
@@ -1318,7 +1809,6 @@ proc ::data_path_bts::gui::setup_lvds {baseGroupName n_lane} {
 
 
 proc ::data_path_bts::gui::setup_lvds_controlPanel {baseGroupName n_lane} {
-    variable lvds_monitor_fd ""
     toolkit_add            "lvds_controlPanel_read_button"     button      $baseGroupName
     toolkit_set_property   "lvds_controlPanel_read_button"     text        "update registers"
     toolkit_set_property   "lvds_controlPanel_read_button"     onClick      {::data_path_bts::gui::lvds_update_registers_functor }
@@ -1332,6 +1822,127 @@ proc ::data_path_bts::gui::setup_lvds_controlPanel {baseGroupName n_lane} {
     toolkit_set_property    "lvds_controlPanel_loading_bitmap"  label           "stopped"
     toolkit_set_property    "lvds_controlPanel_loading_bitmap"  visible         0
     
+    # lane health
+    ::lvds_rx::health::configure -n_lane $n_lane
+    toolkit_add            "lvds_health_checkBox"     checkBox      $baseGroupName
+    toolkit_set_property   "lvds_health_checkBox"     label         "monitor lane health"
+    toolkit_set_property   "lvds_health_checkBox"     onClick      {::data_path_bts::gui::lvds_health_functor}
+
+    toolkit_add            "lvds_health_action_comboBox"     comboBox      $baseGroupName
+    toolkit_set_property   "lvds_health_action_comboBox"     label         "recovery on burst"
+    toolkit_set_property   "lvds_health_action_comboBox"     options       "none soft_reset dpa_retrain"
+    toolkit_set_property   "lvds_health_action_comboBox"     selectedItem  "none"
+    toolkit_set_property   "lvds_health_action_comboBox"     onChange      {::lvds_rx::health::configure -action [toolkit_get_property "lvds_health_action_comboBox" selectedItem]}
+
+    set columns [list "copy" "lane" "state" "rate (1/s)" "fast" "slow" "trend" "errors" "bursts" "recoveries (1 h)"]
+    toolkit_add				lvds_health_table 	table			$baseGroupName
+    toolkit_set_property	lvds_health_table    preferredWidth  600
+	toolkit_set_property	lvds_health_table	rowCount		0
+	toolkit_set_property	lvds_health_table	columnCount		[llength $columns]
+    for {set i 0} {$i < [llength $columns]} {incr i} {
+        toolkit_set_property	lvds_health_table	columnIndex		$i
+        toolkit_set_property	lvds_health_table	columnHeader	[lindex $columns $i]
+    }
+
+    toolkit_add             "lvds_health_loading_bitmap"  bitmap          $baseGroupName
+    toolkit_set_property    "lvds_health_loading_bitmap"  path            ../../system_console/figures/loading.gif
+    toolkit_set_property    "lvds_health_loading_bitmap"  label           "stopped"
+    toolkit_set_property    "lvds_health_loading_bitmap"  visible         0
+    
+    # eye/phase sweep
+    toolkit_add            "lvds_sweep_dwell_textField"     textField      $baseGroupName
+    toolkit_set_property   "lvds_sweep_dwell_textField"     label         "sweep dwell (ms)"
+    toolkit_set_property   "lvds_sweep_dwell_textField"     text          1000
+
+    toolkit_add				"lvds_sweep_button"		fileChooserButton 			$baseGroupName
+	toolkit_set_property	"lvds_sweep_button"		text 						"eye/phase sweep"
+	toolkit_set_property	"lvds_sweep_button"		paths						"./scan_records/lvds_sweep.bin"; # some default path
+	toolkit_set_property	"lvds_sweep_button"		chooserButtonText 			"Save result"
+	toolkit_set_property	"lvds_sweep_button"		onChoose 		{::data_path_bts::gui::lvds_sweep_functor "lvds_sweep_button"}
+
+    toolkit_add            "lvds_sweep_cancel_button"     button      $baseGroupName
+    toolkit_set_property   "lvds_sweep_cancel_button"     text        "cancel sweep"
+    toolkit_set_property   "lvds_sweep_cancel_button"     enabled     0
+    toolkit_set_property   "lvds_sweep_cancel_button"     onClick     {::lvds_rx::sweep::cancel}
+
+    # one column per point {reset hold mode}
+    set columns [list "lane"]
+    foreach point $::lvds_rx::sweep::points {
+        lassign $point reset hold mode
+        lappend columns "[expr {$reset ? {rst} : {-}}]/[expr {$hold ? {hold} : {-}}]/[expr {$mode ? {adapt} : {slip}}]"
+    }
+    lappend columns "best"
+    toolkit_add				lvds_sweep_table 	table			$baseGroupName
+    toolkit_set_property	lvds_sweep_table    preferredWidth  600
+	toolkit_set_property	lvds_sweep_table	rowCount		0
+	toolkit_set_property	lvds_sweep_table	columnCount		[llength $columns]
+    for {set i 0} {$i < [llength $columns]} {incr i} {
+        toolkit_set_property	lvds_sweep_table	columnIndex		$i
+        toolkit_set_property	lvds_sweep_table	columnHeader	[lindex $columns $i]
+    }
+
+    toolkit_add             "lvds_sweep_loading_bitmap"  bitmap          $baseGroupName
+    toolkit_set_property    "lvds_sweep_loading_bitmap"  path            ../../system_console/figures/loading.gif
+    toolkit_set_property    "lvds_sweep_loading_bitmap"  label           "stopped"
+    toolkit_set_property    "lvds_sweep_loading_bitmap"  visible         0
+    
+    return -code ok
+}
+
+proc ::data_path_bts::gui::lvds_sweep_functor {fileChooserButtonName} {
+    variable fd_global_variable
+    if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
+		toolkit_send_message warning "lvds_sweep_functor: file selection cancelled, byte~"
+		return -code error
+	}
+    if {[::lvds_rx::sweep::is_running]} {
+        toolkit_send_message warning "lvds_sweep_functor: a sweep is already running"
+        return -code error
+    }
+    set file_path [toolkit_get_property $fileChooserButtonName paths]
+    # the sweep changes the lane settings, only the first ip is swept
+    set base [lindex [::mu3e::helpers::get_global_variable $fd_global_variable "lvds_rx_controller_pro.csr_base_address"] 0]
+    ::lvds_rx::sweep::configure -base $base -n_lane $::lvds_rx::health::n_lane \
+        -dwell_ms [toolkit_get_property "lvds_sweep_dwell_textField" text]
+    ::lvds_rx::sweep::start -progress [list ::data_path_bts::gui::lvds_sweep_progress] \
+        -done [list ::data_path_bts::gui::lvds_sweep_done $file_path]
+    toolkit_set_property    "lvds_sweep_button"  enabled  0
+    toolkit_set_property    "lvds_sweep_cancel_button"  enabled  1
+    toolkit_set_property    "lvds_sweep_loading_bitmap"  label           "sweeping..."
+    toolkit_set_property    "lvds_sweep_loading_bitmap"  visible         1
+    toolkit_send_message info "lvds_sweep_functor: sweep started, result goes to ${file_path}"
+    return -code ok
+}
+
+proc ::data_path_bts::gui::lvds_sweep_progress {n_done n_total} {
+    toolkit_set_property    "lvds_sweep_loading_bitmap"  label           "sweeping... ${n_done}/${n_total}"
+    return -code ok
+}
+
+proc ::data_path_bts::gui::lvds_sweep_done {file_path completed} {
+    ::lvds_rx::sweep::write_result $file_path
+    set rows [::lvds_rx::sweep::get_matrix]
+    toolkit_set_property "lvds_sweep_table" rowCount [llength $rows]
+    set row_index 0
+    foreach row $rows {
+        toolkit_set_property "lvds_sweep_table" rowIndex $row_index
+        set column_index 0
+        foreach cell $row {
+            toolkit_set_property "lvds_sweep_table" columnIndex $column_index
+            toolkit_set_property "lvds_sweep_table" cellText [expr {[string is double -strict $cell] && $column_index != 0 && $column_index != [llength $row] - 1 ? [format %.2f $cell] : $cell}]
+            incr column_index
+        }
+        incr row_index
+    }
+    toolkit_set_property    "lvds_sweep_button"  enabled  1
+    toolkit_set_property    "lvds_sweep_cancel_button"  enabled  0
+    toolkit_set_property    "lvds_sweep_loading_bitmap"  label           "stopped"
+    toolkit_set_property    "lvds_sweep_loading_bitmap"  visible         0
+    if {$completed} {
+        toolkit_send_message info "lvds_sweep_done: sweep completed, result saved to ${file_path}"
+    } else {
+        toolkit_send_message warning "lvds_sweep_done: sweep cancelled, partial result saved to ${file_path}"
+    }
     return -code ok
 }
 
@@ -1342,32 +1953,27 @@ proc ::data_path_bts::gui::lvds_update_registers_functor {} {
 }
 
 proc ::data_path_bts::gui::lvds_monitor_registers_functor {} {
-    variable lvds_monitor_fd
+    variable fd_global_variable
     set checked [toolkit_get_property "lvds_controlPanel_monitor_checkBox" checked]
     # hide button
     toolkit_set_property "lvds_controlPanel_read_button" enabled [expr ![expr $checked]]
-    # get selected master service path
-    set master_path [::mu3e::helpers::get_selected_servicePath "jtagMasterGroup_showmp_comboBox"]
     if {$checked} {
-        # open monitor serivce
-        if {$lvds_monitor_fd ne ""} {
-            toolkit_send_message info "lvds_monitor_registers_functor: monitor started..." 
-        } else {
-            #puts "monitor not created"
-            # open monitor service -> fd
-            set lvds_monitor_fd [::mu3e::helpers::open_monitor_service]
-            monitor_set_interval $lvds_monitor_fd 1000
-            monitor_set_callback $lvds_monitor_fd [list ::data_path_bts::gui::read_lvds]
-            monitor_add_range $lvds_monitor_fd $master_path 0x0 4
-            toolkit_send_message info "lvds_monitor_registers_functor: registered monitor service, monitor started..." 
+        set period [::mu3e::helpers::get_global_variable $fd_global_variable "lvds_monitor_period_ms"]
+        set span [::data_path_bts::gui::get_reg_span "lvds"]
+        set n 0
+        foreach base [::mu3e::helpers::get_global_variable $fd_global_variable "lvds_rx_controller_pro.csr_base_address"] {
+            ::mu3e::monitor::register "lvds$n" $base $span $period
+            ::mu3e::monitor::subscribe "lvds$n" [list ::data_path_bts::gui::lvds_monitor_update]
+            incr n
         }
-        monitor_set_enabled $lvds_monitor_fd 1
+        ::mu3e::monitor::set_enabled "lvds*" 1
+        toolkit_send_message info "lvds_monitor_registers_functor: monitor started..." 
         # update loading gif
         toolkit_set_property    "lvds_controlPanel_loading_bitmap"  label           "monitering..."
         toolkit_set_property    "lvds_controlPanel_loading_bitmap"  visible         1
         toolkit_set_property    "lvds_controlPanel_loading_bitmap"  toolTip         "press again to stop"
     } else {
-        monitor_set_enabled $lvds_monitor_fd 0
+        ::mu3e::monitor::set_enabled "lvds*" 0
         # update loading gif
         toolkit_set_property    "lvds_controlPanel_loading_bitmap"  label           "stopped"
         toolkit_set_property    "lvds_controlPanel_loading_bitmap"  visible         0
@@ -1375,6 +1981,56 @@ proc ::data_path_bts::gui::lvds_monitor_registers_functor {} {
     return -code ok
 }
 
+proc ::data_path_bts::gui::lvds_health_functor {} {
+    variable fd_global_variable
+    set checked [toolkit_get_property "lvds_health_checkBox" checked]
+    if {$checked} {
+        set period [::mu3e::helpers::get_global_variable $fd_global_variable "lvds_health_period_ms"]
+        ::lvds_rx::health::configure -log_file [::mu3e::helpers::get_global_variable $fd_global_variable "lvds_health_log"]
+        # lane_go and all error counters in one block
+        set span [expr {0x14 + 4*$::lvds_rx::health::n_lane}]
+        set n 0
+        foreach base [::mu3e::helpers::get_global_variable $fd_global_variable "lvds_rx_controller_pro.csr_base_address"] {
+            ::mu3e::monitor::register "health_lvds$n" $base $span $period
+            ::mu3e::monitor::subscribe "health_lvds$n" [list ::data_path_bts::gui::lvds_health_update $n $base]
+            incr n
+        }
+        ::mu3e::monitor::set_enabled "health_lvds*" 1
+        toolkit_send_message info "lvds_health_functor: lane health monitor started, events are logged to [::mu3e::helpers::get_global_variable $fd_global_variable "lvds_health_log"]"
+        toolkit_set_property    "lvds_health_loading_bitmap"  label           "monitering..."
+        toolkit_set_property    "lvds_health_loading_bitmap"  visible         1
+        toolkit_set_property    "lvds_health_loading_bitmap"  toolTip         "press again to stop"
+    } else {
+        ::mu3e::monitor::set_enabled "health_lvds*" 0
+        toolkit_set_property    "lvds_health_loading_bitmap"  label           "stopped"
+        toolkit_set_property    "lvds_health_loading_bitmap"  visible         0
+    }
+    return -code ok
+}
+
+# monitor subscriber: feeds the health engine and refreshes the table of all copies
+proc ::data_path_bts::gui::lvds_health_update {copy base name words} {
+    variable fd_global_variable
+    ::lvds_rx::health::update $copy $base $words
+    set rows [list]
+    set n 0
+    foreach ip_base [::mu3e::helpers::get_global_variable $fd_global_variable "lvds_rx_controller_pro.csr_base_address"] {
+        foreach lane_status [::lvds_rx::health::get_status $n] {
+            lassign $lane_status lane state rate fast slow trend total n_burst n_action
+            lappend rows [list $n $lane $state [format %.2f $rate] [format %.2f $fast] [format %.2f $slow] \
+                [expr {$trend eq "inf" ? $trend : [format %.2f $trend]}] $total $n_burst $n_action]
+        }
+        incr n
+    }
+    ::mu3e::render::table "lvds_health_table" $rows
+    return -code ok
+}
+
+# monitor subscriber: the lvds widgets are not prefixed (see setup_lvds)
+proc ::data_path_bts::gui::lvds_monitor_update {name words} {
+    ::data_path_bts::gui::regwords2gui "lvds" "" $words
+    return -code ok
+}
 
 proc ::data_path_bts::gui::read_lvds { } {
     
@@ -1401,43 +2057,27 @@ proc ::data_path_bts::gui::read_lvds { } {
     # gvtable -> base address
     set ipBases [::mu3e::helpers::get_global_variable $fd_global_variable "${typeName}_base_address"]
 
-    # gvtable - > xml (bsp structure)
-    if {![::mu3e::helpers::probe_global_variable $fd_global_variable ${bspPkgName}_doc_xml]} {
-        # fail: does not exist
+    # registry -> reg map
+    if {[catch {::mu3e::bspmap::registers $bspPkgName} registers]} {
         toolkit_send_message error "read_lvds: no bsp reg map found"
         return -code error 
-    } else {
-        # success: exists
-        set xml_plain_text [::mu3e::helpers::get_global_variable $fd_global_variable ${bspPkgName}_doc_xml]
     }
     
-    # xml -> dom 
-    dom parse $xml_plain_text doc
-    
     # ---------------------- set multiple copies -------------------------
     foreach ipBase $ipBases {
        
         # regValue -> gui
-        foreach i [$doc selectNodes "/registers/register"] {
+        foreach reg $registers {
             set regValue ""
             # ------------------- parse register --------------------
-            set regName [[[$i selectNodes "name"] childNodes] nodeValue]
-            set regDespt [[[$i selectNodes "description"] childNodes] nodeValue]
-            set regAddrOfst [[[$i selectNodes "addressOffset"] childNodes] nodeValue]
+            lassign $reg regName regAddrOfst regDespt fields
             # master -> regValue (d2h read)
             set regValue [master_read_32 $master_fd [expr ${ipBase}+${regAddrOfst}] 1]
             #puts [format "read: %x from %x" $regValue [expr ${ipBase}+${regAddrOfst}]]
             set regValueBits [::mu3e::helpers::hex2bin $regValue]
-            foreach j [$i selectNodes "fields/field"] {
+            foreach field $fields {
                 #  ------------------- parse field -------------------
-                set bitName [[[$j selectNodes "name"] childNodes] nodeValue]
-                set bitRange [[[$j selectNodes "bitRange"] childNodes] nodeValue]
-                set bitAccess [[[$j selectNodes "access"] childNodes] nodeValue]
-                # [msb:lsb] -> $bitMsb and $bitLsb
-                set bitMsb [lindex [regexp -all -inline {(\d)*:} $bitRange] 0]
-                set bitMsb [lindex [regexp -all -inline {(\d)*} $bitMsb] 0]
-                set bitLsb [lindex [regexp -all -inline {:(\d)*} $bitRange] 0]
-                set bitLsb [lindex [regexp -all -inline {(\w)*} $bitLsb] 2]
+                lassign $field bitName bitLsb bitMsb bitAccess bitDescpt
                 # bitValue -> bitBinary
                 set bitBinary [::mu3e::helpers::binary_trim_little_endien $regValueBits $bitLsb $bitMsb]
                 # bitBinary -> gui
@@ -1475,38 +2115,22 @@ proc ::data_path_bts::gui::write_lvds { } {
     # gvtable -> base address
     set ipBase [::mu3e::helpers::get_global_variable $fd_global_variable ${typeName}_base_address]
     
-    # gvtable - > xml
-    if {![::mu3e::helpers::probe_global_variable $fd_global_variable ${bspPkgName}_doc_xml]} {
-        # fail: does not exist
+    # registry -> reg map
+    if {[catch {::mu3e::bspmap::registers $bspPkgName} registers]} {
         toolkit_send_message error "write_lvds: no bsp reg map found"
         return -code error 
-    } else {
-        # success: exists
-        set xml_plain_text [::mu3e::helpers::get_global_variable $fd_global_variable ${bspPkgName}_doc_xml]
     }
     
-    # xml -> dom 
-    dom parse $xml_plain_text doc
-    
     # gui -> regValue
-    foreach i [$doc selectNodes "/registers/register"] {
+    foreach reg $registers {
         set regValue ""
         # --------------- parse register ---------------
-        set regName [[[$i selectNodes "name"] childNodes] nodeValue]
-        set regDespt [[[$i selectNodes "description"] childNodes] nodeValue]
-        set regAddrOfst [[[$i selectNodes "addressOffset"] childNodes] nodeValue]
+        lassign $reg regName regAddrOfst regDespt fields
         # init as "00000......00000" (32 zeros)
         set regValue [::mu3e::helpers::init_register32_value]
-        foreach j [$i selectNodes "fields/field"] {
+        foreach field $fields {
             # --------------- parse field ---------------
-            set bitName [[[$j selectNodes "name"] childNodes] nodeValue]
-            set bitRange [[[$j selectNodes "bitRange"] childNodes] nodeValue]
-            set bitAccess [[[$j selectNodes "access"] childNodes] nodeValue]
-            # [msb:lsb] -> $bitMsb and $bitLsb
-            set bitMsb [lindex [regexp -all -inline {(\d)*:} $bitRange] 0]
-            set bitMsb [lindex [regexp -all -inline {(\d)*} $bitMsb] 0]
-            set bitLsb [lindex [regexp -all -inline {:(\d)*} $bitRange] 0]
-            set bitLsb [lindex [regexp -all -inline {(\w)*} $bitLsb] 2]
+            lassign $field bitName bitLsb bitMsb bitAccess bitDescpt
             # gui -> bitValue
             # single bit: read checkBox 
             if {$bitLsb == $bitMsb} {
@@ -1566,30 +2190,25 @@ proc ::data_path_bts::gui::write_lvds { } {
     ###############################
 
 proc ::data_path_bts::gui::rate_monitor_registers_functor {} {
-    variable rate_monitor_fd
+    variable fd_global_variable
     set checked [toolkit_get_property "rateCtrl_checkBox" checked]
-    # get selected master service path
-    set master_path [::mu3e::helpers::get_selected_servicePath "jtagMasterGroup_showmp_comboBox"]
     if {$checked} {
-        # open monitor serivce
-        if {$rate_monitor_fd ne ""} {
-            toolkit_send_message info "rate_monitor_registers_functor: monitor started..." 
-        } else {
-            #puts "monitor not created"
-            # open monitor service -> fd
-            set rate_monitor_fd [::mu3e::helpers::open_monitor_service]
-            monitor_set_interval $rate_monitor_fd 1000
-            monitor_set_callback $rate_monitor_fd [list ::data_path_bts::gui::read_rate]
-            monitor_add_range $rate_monitor_fd $master_path 0x0 4
-            toolkit_send_message info "rate_monitor_registers_functor: registered monitor service, monitor started..." 
+        set period [::mu3e::helpers::get_global_variable $fd_global_variable "rate_monitor_period_ms"]
+        set i 0
+        foreach rate_base [::mu3e::helpers::get_global_variable $fd_global_variable "counter_avmm.avmm_counter_value_base_address"] {
+            ::mu3e::monitor::register "rate$i" $rate_base [expr 4*32] $period
+            ::mu3e::monitor::subscribe "rate$i" [list ::data_path_bts::gui::plot_rate $i]
+            ::mu3e::monitor::subscribe "rate$i" [list ::data_path_bts::gui::store_rate $i]
+            incr i
         }
-        monitor_set_enabled $rate_monitor_fd 1
+        ::mu3e::monitor::set_enabled "rate*" 1
+        toolkit_send_message info "rate_monitor_registers_functor: monitor started..." 
         # update loading gif
         toolkit_set_property    "rateCtrl_loading_bitmap"  label           "monitering..."
         toolkit_set_property    "rateCtrl_loading_bitmap"  visible         1
         toolkit_set_property    "rateCtrl_loading_bitmap"  toolTip         "press again to stop"
     } else {
-        monitor_set_enabled $rate_monitor_fd 0
+        ::mu3e::monitor::set_enabled "rate*" 0
         # update loading gif
         toolkit_set_property    "rateCtrl_loading_bitmap"  label           "stopped"
         toolkit_set_property    "rateCtrl_loading_bitmap"  visible         0
@@ -1597,33 +2216,424 @@ proc ::data_path_bts::gui::rate_monitor_registers_functor {} {
     return -code ok
 }
 
+# chart and table update cost since the last call
+proc ::data_path_bts::gui::render_stats {} {
+    set stats [::mu3e::render::get_stats]
+    toolkit_send_message info [format "render_stats: %.1f s, %d items/cells requested (%.1f/s), %d toolkit calls made (%.1f/s) in %d flushes" \
+        [dict get $stats elapsed_s] [dict get $stats n_request] [dict get $stats request_rate] \
+        [dict get $stats n_call] [dict get $stats call_rate] [dict get $stats n_flush]]
+    ::mu3e::render::reset_stats
+    return -code ok
+}
+
 proc ::data_path_bts::gui::read_rate {} {
     variable fd_global_variable
     set i 0
     set master_fd [::mu3e::helpers::cget_opened_master_path]
     # gvtable -> base address
     set rate_base_list [::mu3e::helpers::get_global_variable $fd_global_variable "counter_avmm.avmm_counter_value_base_address"]
-    # span
-    set rate_span [format 0x%x [expr 4*32]]
     # master -> value -> hist
     foreach rate_base $rate_base_list {
         # read rate for each asic
-        set histName "rateBarChart$i"
-        set rate_of_one_asic [master_read_32 $master_fd [expr ${rate_base}] 32]
-        # plot for each channel
-        set j 0
-        foreach rate $rate_of_one_asic {
-            set rate [format %i $rate]
-            toolkit_set_property $histName itemValue [list $j $rate]
-            incr j
-        }
-        #puts $rate_of_one_asic
+        ::data_path_bts::gui::plot_rate $i "" [master_read_32 $master_fd [expr ${rate_base}] 32]
         incr i
     }
     
     
 }
 
+# monitor subscriber: 32 channel counters of one asic -> bar chart
+proc ::data_path_bts::gui::plot_rate {asic name rate_of_one_asic} {
+    set histName "rateBarChart$asic"
+    # plot for each channel, only the channels that changed are redrawn
+    set points [list]
+    set j 0
+    foreach rate $rate_of_one_asic {
+        lappend points [list $j [format %i $rate]]
+        incr j
+    }
+    ::mu3e::render::series $histName $points
+    return -code ok
+}
+
+# monitor subscriber: 32 channel counters of one asic -> time-series store
+proc ::data_path_bts::gui::store_rate {asic name counters} {
+    ::counter_avmm::history::add_sample $asic $counters
+    return -code ok
+}
+
+proc ::data_path_bts::gui::plot_rate_history {} {
+    variable rate_history_chart
+    set asic [toolkit_get_property "rateHistory_asic_comboBox" selectedItem]
+    set ch [toolkit_get_property "rateHistory_ch_comboBox" selectedItem]
+    set seconds [toolkit_get_property "rateHistory_window_comboBox" selectedItem]
+    set points [::counter_avmm::history::query $asic $ch $seconds]
+    # replace the old plot
+    if {![info exists rate_history_chart]} {
+        set rate_history_chart "rateHistory_lineChart"
+    }
+    toolkit_set_property $rate_history_chart visible 0
+    ::mu3e::render::forget $rate_history_chart
+    set rate_history_chart "rateHistory_lineChart[clock clicks]"
+    toolkit_add             $rate_history_chart     lineChart   "rateHistoryGroup"
+    toolkit_set_property    $rate_history_chart     preferredWidth 800
+    toolkit_set_property    $rate_history_chart     title       "MuTRiG $asic channel $ch, last $seconds s"
+    toolkit_set_property    $rate_history_chart     labelX      "time to now (s)"
+    toolkit_set_property    $rate_history_chart     labelY      "mean hit rate (Hz)"
+    set now [expr {[clock milliseconds]/1000.0}]
+    set series [list]
+    foreach point $points {
+        lassign $point t min max mean
+        lappend series [list [format %.0f [expr {$t - $now}]] $mean]
+    }
+    # decimated to the width of the chart
+    ::mu3e::render::series $rate_history_chart $series -interval_ms 0 -width 800
+    toolkit_set_property "rateHistory_text" text "[llength $points] points"
+    return -code ok
+}
+
+proc ::data_path_bts::gui::show_rate_outliers {} {
+    variable fd_global_variable
+    set seconds [toolkit_get_property "rateHistory_window_comboBox" selectedItem]
+    set asics [list]
+    for {set i 0} {$i < [::mu3e::helpers::get_global_variable $fd_global_variable "n_asic"]} {incr i} {
+        lappend asics $i
+    }
+    set html_text ""
+    foreach outlier [::counter_avmm::history::find_outliers $asics $seconds] {
+        lassign $outlier asic ch mean flag
+        append html_text [format "MuTRiG %d ch %2d: %s (%.1f Hz)<br>" $asic $ch $flag $mean]
+    }
+    if {$html_text eq ""} {
+        set html_text "no hot or dead channels in the last $seconds s"
+    }
+    toolkit_set_property "rateHistory_text" htmlCapable true
+    toolkit_set_property "rateHistory_text" text $html_text
+    return -code ok
+}
+
+    ###############################
+    # injector stress test 
+    ###############################
+
+proc ::data_path_bts::gui::inj_stress_functor {fileChooserButtonName} {
+    variable fd_global_variable
+    if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
+		toolkit_send_message warning "inj_stress_functor: file selection cancelled, byte~"
+		return -code error
+	}
+    if {[::mutrig_injector::stress::is_running]} {
+        toolkit_send_message warning "inj_stress_functor: a stress test is already running"
+        return -code error
+    }
+    if {[::mu3e::accounting::is_running]} {
+        toolkit_send_message warning "inj_stress_functor: stop the hit accounting monitor first"
+        return -code error
+    }
+    set file_path [toolkit_get_property $fileChooserButtonName paths]
+    ::data_path_bts::gui::accounting_configure
+    ::mutrig_injector::stress::configure \
+        -inj_base [::mu3e::helpers::get_global_variable $fd_global_variable "mutrig_injector.csr_base_address"] \
+        -mode [toolkit_get_property "inj_stress_mode_comboBox" selectedItem] \
+        -intervals [toolkit_get_property "inj_stress_intervals_textField" text] \
+        -multiplicities [toolkit_get_property "inj_stress_multiplicities_textField" text] \
+        -settle_ms [toolkit_get_property "inj_stress_settle_textField" text] \
+        -dwell_ms [toolkit_get_property "inj_stress_dwell_textField" text]
+    ::mutrig_injector::stress::start -progress [list ::data_path_bts::gui::inj_stress_progress] \
+        -done [list ::data_path_bts::gui::inj_stress_done $file_path]
+    toolkit_set_property    "inj_stress_button"  enabled  0
+    toolkit_set_property    "inj_stress_cancel_button"  enabled  1
+    toolkit_set_property    "inj_stress_loading_bitmap"  label           "stressing..."
+    toolkit_set_property    "inj_stress_loading_bitmap"  visible         1
+    toolkit_send_message info "inj_stress_functor: stress test started, result goes to ${file_path}"
+    return -code ok
+}
+
+proc ::data_path_bts::gui::inj_stress_progress {n_done n_total} {
+    toolkit_set_property    "inj_stress_loading_bitmap"  label     "point ${n_done} of ${n_total}"
+    return -code ok
+}
+
+proc ::data_path_bts::gui::inj_stress_done {file_path completed} {
+    ::mutrig_injector::stress::write_result $file_path
+    set summary [::mutrig_injector::stress::write_summary "${file_path}.txt"]
+    set rows [::mutrig_injector::stress::get_curve]
+    toolkit_set_property "inj_stress_table" rowCount [llength $rows]
+    set row_index 0
+    foreach row $rows {
+        lassign $row interval multiplicity offered delivered efficiency first_stage
+        set cells [list $interval $multiplicity [format %.1f $offered] [format %.1f $delivered] \
+            [format %.2f [expr {100.0*$efficiency}]] [expr {$first_stage eq "" ? "-" : $first_stage}]]
+        toolkit_set_property "inj_stress_table" rowIndex $row_index
+        set column_index 0
+        foreach cell $cells {
+            toolkit_set_property "inj_stress_table" columnIndex $column_index
+            toolkit_set_property "inj_stress_table" cellText $cell
+            incr column_index
+        }
+        incr row_index
+    }
+    toolkit_set_property    "inj_stress_text"  text     [join [lrange [split [string trimright $summary] "\n"] end-1 end] "\n"]
+    toolkit_set_property    "inj_stress_button"  enabled  1
+    toolkit_set_property    "inj_stress_cancel_button"  enabled  0
+    toolkit_set_property    "inj_stress_loading_bitmap"  label           "stopped"
+    toolkit_set_property    "inj_stress_loading_bitmap"  visible         0
+    if {$completed} {
+        toolkit_send_message info "inj_stress_done: stress test completed, result saved to ${file_path} and ${file_path}.txt"
+    } else {
+        toolkit_send_message warning "inj_stress_done: stress test cancelled, partial result saved to ${file_path} and ${file_path}.txt"
+    }
+    return -code ok
+}
+
+    ###############################
+    # ring buffer cam telemetry 
+    ###############################
+
+proc ::data_path_bts::gui::cam_telemetry_functor {} {
+    variable fd_global_variable
+    set checked [toolkit_get_property "cam_telemetry_checkBox" checked]
+    if {$checked} {
+        set period [::mu3e::helpers::get_global_variable $fd_global_variable "cam_telemetry_period_ms"]
+        ::ring_buffer_cam::telemetry::reset
+        set n 0
+        foreach base [::mu3e::helpers::get_global_variable $fd_global_variable "ring_buffer_cam.csr_base_address"] {
+            ::mu3e::monitor::register "telemetry_cam$n" $base 0x20 $period
+            ::mu3e::monitor::subscribe "telemetry_cam$n" [list ::data_path_bts::gui::cam_telemetry_update $n]
+            incr n
+        }
+        ::mu3e::monitor::set_enabled "telemetry_cam*" 1
+        toolkit_send_message info "cam_telemetry_functor: occupancy sampling started ($period ms)" 
+        toolkit_set_property    "cam_telemetry_loading_bitmap"  label           "monitering..."
+        toolkit_set_property    "cam_telemetry_loading_bitmap"  visible         1
+        toolkit_set_property    "cam_telemetry_loading_bitmap"  toolTip         "press again to stop"
+    } else {
+        ::mu3e::monitor::set_enabled "telemetry_cam*" 0
+        toolkit_set_property    "cam_telemetry_loading_bitmap"  label           "stopped"
+        toolkit_set_property    "cam_telemetry_loading_bitmap"  visible         0
+    }
+    return -code ok
+}
+
+# monitor subscriber: feeds the sampler, the display follows at most twice a second
+proc ::data_path_bts::gui::cam_telemetry_update {copy name words} {
+    variable fd_global_variable
+    variable cam_telemetry_shown_ms
+    ::ring_buffer_cam::telemetry::update $copy $words
+    set now [clock milliseconds]
+    if {[info exists cam_telemetry_shown_ms] && $now - $cam_telemetry_shown_ms < 500} {
+        return -code ok
+    }
+    set cam_telemetry_shown_ms $now
+    set rows [list]
+    set n_stacks [llength [::mu3e::helpers::get_global_variable $fd_global_variable "ring_buffer_cam.csr_base_address"]]
+    for {set i 0} {$i < $n_stacks} {incr i} {
+        set status [::ring_buffer_cam::telemetry::get_status $i]
+        if {[dict size $status] == 0} {
+            continue
+        }
+        set residence [dict get $status residence_ns]
+        lappend rows [list $i [dict get $status fill] [format %.1f [dict get $status mean]] [dict get $status p99] \
+            [dict get $status peak] [dict get $status peak_all] [format %.1f [dict get $status push_rate]] \
+            [format %.2f [dict get $status overwrite_rate]] [format %.2f [dict get $status miss_rate]] \
+            [expr {$residence eq "" ? "-" : [format %.0f $residence]}] [expr {8*[dict get $status expected_latency]}]]
+    }
+    ::mu3e::render::table "cam_telemetry_table" $rows
+    lassign [::ring_buffer_cam::telemetry::get_distribution [toolkit_get_property "cam_telemetry_copy_comboBox" selectedItem]] bin_width counts
+    set points [list]
+    set bin 0
+    foreach count $counts {
+        lappend points [list [expr {$bin*$bin_width}] $count]
+        incr bin
+    }
+    ::mu3e::render::series "cam_telemetry_barChart" $points
+    return -code ok
+}
+
+    ###############################
+    # hit accounting 
+    ###############################
+
+# gvtable -> base addresses of the counted IPs
+proc ::data_path_bts::gui::accounting_configure {} {
+    variable fd_global_variable
+    ::mu3e::accounting::configure \
+        -counter_bases [::mu3e::helpers::get_global_variable $fd_global_variable "counter_avmm.avmm_counter_value_base_address"] \
+        -deassembly_bases [::mu3e::helpers::get_global_variable $fd_global_variable "mutrig_frame_deassembly.csr_base_address"] \
+        -mts_bases [::mu3e::helpers::get_global_variable $fd_global_variable "mts_preprocessor.csr_base_address"] \
+        -cam_bases [::mu3e::helpers::get_global_variable $fd_global_variable "ring_buffer_cam.csr_base_address"] \
+        -assembly_bases [::mu3e::helpers::get_global_variable $fd_global_variable "feb_frame_assembly.csr_base_address"] \
+        -period_ms [::mu3e::helpers::get_global_variable $fd_global_variable "accounting_period_ms"]
+    return -code ok
+}
+
+proc ::data_path_bts::gui::accounting_functor {} {
+    variable fd_global_variable
+    set checked [toolkit_get_property "accounting_checkBox" checked]
+    if {$checked} {
+        ::data_path_bts::gui::accounting_configure
+        ::mu3e::accounting::start -update ::data_path_bts::gui::accounting_update
+        toolkit_send_message info "accounting_functor: hit accounting started..." 
+        toolkit_set_property    "accounting_loading_bitmap"  label           "monitering..."
+        toolkit_set_property    "accounting_loading_bitmap"  visible         1
+        toolkit_set_property    "accounting_loading_bitmap"  toolTip         "press again to stop"
+    } else {
+        ::mu3e::accounting::stop
+        toolkit_set_property    "accounting_loading_bitmap"  label           "stopped"
+        toolkit_set_property    "accounting_loading_bitmap"  visible         0
+    }
+    return -code ok
+}
+
+# accounting update: per-stage throughput and loss over the selected window -> table
+proc ::data_path_bts::gui::accounting_update {} {
+    set result [::mu3e::accounting::analyse [toolkit_get_property "accounting_window_comboBox" selectedItem]]
+    set rows [list]
+    foreach row [dict get $result rows] {
+        lassign $row stage rate_in rate_out transfer_loss internal_loss flag
+        set cells [list $stage [format %.1f $rate_in] [format %.1f $rate_out]]
+        foreach loss [list $transfer_loss $internal_loss] {
+            lappend cells [expr {$loss eq "" ? "-" : [format %.2f [expr {100.0*$loss}]]}]
+        }
+        lappend cells $flag
+        lappend rows $cells
+    }
+    ::mu3e::render::table "accounting_table" $rows
+    toolkit_set_property "accounting_text" text [dict get $result verdict]
+    return -code ok
+}
+
+    ###############################
+    # board snapshot 
+    ###############################
+
+# gvtable -> list of {type map bases} of the linked slaves in the snapshot
+proc ::data_path_bts::gui::snapshot_ips {} {
+    variable fd_global_variable
+    set ips [list]
+    foreach {typeName mapName} [::mu3e::helpers::get_global_variable $fd_global_variable "snapshot_slaves"] {
+        if {![::mu3e::helpers::probe_global_variable $fd_global_variable "${typeName}_base_address"]} {
+            continue
+        }
+        # 0x0 is the value of the gvtable before link_slave found the ip, nothing to read there
+        set bases [list]
+        foreach base [::mu3e::helpers::get_global_variable $fd_global_variable "${typeName}_base_address"] {
+            if {$base ne "" && $base != 0} {
+                lappend bases $base
+            }
+        }
+        if {[llength $bases] == 0} {
+            continue
+        }
+        lappend ips [list $typeName $mapName $bases]
+    }
+    return $ips
+}
+
+proc ::data_path_bts::gui::snapshot_save {fileChooserButtonName} {
+    if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
+		toolkit_send_message warning "snapshot_save: file selection cancelled, byte~"
+		return -code error
+	}
+    set file_path [toolkit_get_property $fileChooserButtonName paths]
+    set snapshot [::mu3e::snapshot::capture [::mu3e::helpers::cget_opened_master_path] [::data_path_bts::gui::snapshot_ips]]
+    set n_byte [::mu3e::snapshot::save $snapshot $file_path]
+    set stats [::mu3e::snapshot::get_stats]
+    toolkit_set_property "snapshot_text" text [format "snapshot of %d IP(s): %d words in %d block reads, %d ms\nsaved to %s (%d bytes)" \
+        [llength [dict get $snapshot ips]] [dict get $stats n_word] [dict get $stats n_read] [dict get $stats elapsed_ms] $file_path $n_byte]
+    toolkit_send_message info "snapshot_save: board snapshot saved to ${file_path}"
+    return -code ok
+}
+
+proc ::data_path_bts::gui::snapshot_restore {fileChooserButtonName} {
+    if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
+		toolkit_send_message warning "snapshot_restore: file selection cancelled, byte~"
+		return -code error
+	}
+    set file_path [toolkit_get_property $fileChooserButtonName paths]
+    if {[catch {::mu3e::snapshot::load $file_path} snapshot]} {
+        toolkit_send_message error "snapshot_restore: $snapshot"
+        return -code error
+    }
+    set dry_run [toolkit_get_property "snapshot_dry_run_checkBox" checked]
+    set changes [::mu3e::snapshot::restore [::mu3e::helpers::cget_opened_master_path] $snapshot \
+        [::data_path_bts::gui::snapshot_ips] -dry_run $dry_run]
+    set rows [list]
+    foreach change $changes {
+        lassign $change typeName copy regName regAddrOfst current restored
+        lappend rows [list $typeName $copy $regName [format 0x%x $regAddrOfst] $current $restored]
+    }
+    ::mu3e::render::table "snapshot_table" $rows -interval_ms 0
+    set stats [::mu3e::snapshot::get_stats]
+    toolkit_set_property "snapshot_text" text [format "%s %s: %d register(s) %s, %d words compared in %d block reads, %d ms" \
+        [clock format [expr {[dict get $snapshot t_ms]/1000}] -format "%Y-%m-%d %H:%M:%S"] [file tail $file_path] [llength $changes] \
+        [expr {$dry_run ? "differ" : "written"}] [dict get $stats n_word] [dict get $stats n_read] [dict get $stats elapsed_ms]]
+    toolkit_send_message info "snapshot_restore: [llength $changes] register(s) [expr {$dry_run ? "differ from" : "restored from"}] ${file_path}"
+    return -code ok
+}
+
+    #########################################################################################################
+    # @name             get_reg_layout 
+    #
+    # @berief           register/field layout of the bsp reg map (bound by bsp2gui_setup/setup_lvds) for
+    #                   decoding monitored words
+    # @param            <bspPkgName> - BSP package name of this IP core ("lvds" for the lvds tab)
+    #
+    # @return           list of {regName wordOffset {{bitName lsb msb} ...}}
+    #########################################################################################################
+proc ::data_path_bts::gui::get_reg_layout {bspPkgName} {
+    set layout [list]
+    foreach reg [::mu3e::bspmap::registers $bspPkgName] {
+        lassign $reg regName regAddrOfst regDespt fields
+        set bits [list]
+        foreach field $fields {
+            lappend bits [lrange $field 0 2]
+        }
+        lappend layout [list $regName [expr {$regAddrOfst/4}] $bits]
+    }
+    return $layout
+}
+
+proc ::data_path_bts::gui::get_reg_span {bspPkgName} {
+    set span 4
+    foreach reg [::data_path_bts::gui::get_reg_layout $bspPkgName] {
+        set span [expr {max($span, 4*[lindex $reg 1] + 4)}]
+    }
+    return $span
+}
+
+    #########################################################################################################
+    # @name             regwords2gui 
+    #
+    # @berief           decode a block of register words of one IP copy into the field widgets
+    # @param            <bspPkgName> - BSP package name of this IP core 
+    #                   <prefix> - widget name prefix, "<baseGroupName>_" for bsp2gui_setup widgets
+    #                   <words> - register words, starting at the base address of the IP
+    #
+    # @return           -code ok : success
+    #########################################################################################################
+proc ::data_path_bts::gui::regwords2gui {bspPkgName prefix words} {
+    foreach reg [::data_path_bts::gui::get_reg_layout $bspPkgName] {
+        lassign $reg regName wordOffset fields
+        set regValue [lindex $words $wordOffset]
+        if {$regValue eq ""} {
+            continue
+        }
+        foreach field $fields {
+            lassign $field bitName bitLsb bitMsb
+            set bitValue [expr {($regValue >> $bitLsb) & ((1 << ($bitMsb - $bitLsb + 1)) - 1)}]
+            if {$bitLsb == $bitMsb} {
+                # single bit: write checkBox
+                toolkit_set_property ${prefix}${regName}${bitName}_checkBox checked $bitValue
+            } else {
+                # multiple bit: write textField
+                toolkit_set_property ${prefix}${regName}${bitName}_textField text [format 0x%x $bitValue]
+            }
+        }
+    }
+    return -code ok
+}
+
 
 
 
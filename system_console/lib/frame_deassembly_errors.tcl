@@ -0,0 +1,290 @@
+###########################################################################################################
+# @Name 		frame_deassembly_errors.tcl
+#
+# @Brief		Error rate monitor of the MuTRiG Frame Deassembly IP copies. Turns the CRC error and bad
+#				frame counters of every link into rates and a bit error rate estimate with confidence
+#				interval, keeps the history in fixed size rings and correlates error bursts with the
+#				error counters of the LVDS lane of the link (see lvds_rx::health).
+#
+# @Functions	configure, reset, update, get_status, get_history, ber_interval
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 24, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package provide frame_deassembly::errors 	1.0
+
+namespace eval ::frame_deassembly::errors:: {
+	namespace export \
+	configure \
+	reset \
+	update \
+	get_status \
+	get_history \
+	ber_interval
+
+	# line rate of a link in bit/s
+	variable line_rate_bps 1.25e9
+	# confidence level of the two-sided BER interval
+	variable confidence 0.95
+	# samples in the history ring of a copy, also the window of the rates (1200 = 60 s at 50 ms)
+	variable depth 1200
+	# copy -> {lvds_copy lane} of its LVDS lane, copies not listed use lane <copy> of lvds copy 0
+	variable lane_map [list]
+	# copy -> dict of the copy state
+	variable links
+	# copy -> ring of {t dt d_crc d_bad}
+	variable ring
+	array set links {}
+	array set ring {}
+}
+
+######################################################################################################
+##  Arguments:
+##		-line_rate_bps <bps>  - line rate of a link (default 1.25e9)
+##		-confidence <cl>      - confidence level of the BER interval (default 0.95)
+##		-depth <n>            - samples of the history ring (default 1200)
+##		-lane_map <list>      - {lvds_copy lane} per deassembly copy
+##
+##  Description:
+##  	Configures the monitor, resets the history.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::frame_deassembly::errors::configure {args} {
+	foreach {option value} $args {
+		switch -- $option {
+			-line_rate_bps - -confidence - -depth - -lane_map {
+				variable [string range $option 1 end]
+				set [string range $option 1 end] $value
+			}
+			default {
+				error "configure: unknown option \"${option}\", must be -line_rate_bps, -confidence, -depth or -lane_map"
+			}
+		}
+	}
+	::frame_deassembly::errors::reset
+	return -code ok
+}
+
+proc ::frame_deassembly::errors::reset {} {
+	variable links
+	variable ring
+	array unset links
+	array unset ring
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<k>          - number of errors
+##		<bits>       - number of bits transferred
+##		<confidence> - confidence level (default: configured)
+##
+##  Description:
+##  	Two-sided Poisson confidence interval of the bit error rate, with the Wilson-Hilferty
+##		approximation of the chi-square quantiles (within a few percent of the exact interval, also
+##		for k = 0, where the upper limit is about 3.7 errors at 95 %).
+##
+##	Returns:
+##  	{ber lower upper}
+##
+######################################################################################################
+proc ::frame_deassembly::errors::ber_interval {k bits {confidence ""}} {
+	if {$confidence eq ""} {
+		set confidence $::frame_deassembly::errors::confidence
+	}
+	if {$bits <= 0} {
+		return [list 0.0 0.0 1.0]
+	}
+	set z [::frame_deassembly::errors::normal_quantile [expr {1.0 - (1.0 - $confidence)/2.0}]]
+	set lower 0.0
+	if {$k > 0} {
+		set lower [expr {$k*pow(1.0 - 1.0/(9.0*$k) - $z/(3.0*sqrt($k)), 3)}]
+	}
+	set k1 [expr {$k + 1.0}]
+	set upper [expr {$k1*pow(1.0 - 1.0/(9.0*$k1) + $z/(3.0*sqrt($k1)), 3)}]
+	return [list [expr {double($k)/$bits}] [expr {max(0.0, $lower)/$bits}] [expr {$upper/$bits}]]
+}
+
+# quantile of the standard normal distribution (Acklam's rational approximation, central region
+# and tails, relative error below 1.2e-9)
+proc ::frame_deassembly::errors::normal_quantile {p} {
+	set a {-3.969683028665376e+01 2.209460984245205e+02 -2.759285104469687e+02 1.383577518672690e+02 -3.066479806614716e+01 2.506628277459239e+00}
+	set b {-5.447609879822406e+01 1.615858368580409e+02 -1.556989798598866e+02 6.680131188771972e+01 -1.328068155288572e+01}
+	set c {-7.784894002430293e-03 -3.223964580411365e-01 -2.400758277161838e+00 -2.549732539343734e+00 4.374664141464968e+00 2.938163982698783e+00}
+	set d {7.784695709041462e-03 3.224671290700398e-01 2.445134137142996e+00 3.754408661907416e+00}
+	if {$p < 0.02425 || $p > 0.97575} {
+		set q [expr {sqrt(-2.0*log($p < 0.5 ? $p : 1.0 - $p))}]
+		lassign $c c1 c2 c3 c4 c5 c6
+		lassign $d d1 d2 d3 d4
+		set x [expr {((((($c1*$q + $c2)*$q + $c3)*$q + $c4)*$q + $c5)*$q + $c6)/(((($d1*$q + $d2)*$q + $d3)*$q + $d4)*$q + 1.0)}]
+		return [expr {$p < 0.5 ? $x : -$x}]
+	}
+	set q [expr {$p - 0.5}]
+	set r [expr {$q*$q}]
+	lassign $a a1 a2 a3 a4 a5 a6
+	lassign $b b1 b2 b3 b4 b5
+	return [expr {((((($a1*$r + $a2)*$r + $a3)*$r + $a4)*$r + $a5)*$r + $a6)*$q/((((($b1*$r + $b2)*$r + $b3)*$r + $b4)*$r + $b5)*$r + 1.0)}]
+}
+
+######################################################################################################
+##  Arguments:
+##		<copy>  - index of the copy
+##		<words> - csr words from offset 0x0 to 0x8 (csr, error_counter, frame_counter)
+##		<t>     - time of the reading in s (default: now)
+##
+##  Description:
+##  	Adds a reading of a copy. The counter differences (32 bit wrap) go to the history ring and
+##		the totals. A sample with errors is a burst; it coincides with the LVDS lane of the link if
+##		the error total of that lane (as counted by lvds_rx::health) went up since the previous
+##		sample. LVDS errors without frame errors are counted as well. The first reading of a copy
+##		only sets the reference.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::frame_deassembly::errors::update {copy words {t ""}} {
+	variable depth
+	variable links
+	variable ring
+	if {$t eq ""} {
+		set t [expr {[clock milliseconds]/1000.0}]
+	}
+	lassign $words csr crc bad
+	set crc [expr {$crc & 0xffffffff}]
+	set bad [expr {$bad & 0xffffffff}]
+	set lvds_total [::frame_deassembly::errors::lane_errors $copy]
+	if {![info exists links($copy)]} {
+		set links($copy) [dict create t $t crc $crc bad $bad lvds $lvds_total status [expr {($csr >> 24) & 0xff}] \
+			live_s 0.0 crc_total 0 bad_total 0 pos 0 n 0 n_burst 0 n_coincident 0 n_lvds_only 0]
+		set ring($copy) [lrepeat $depth {}]
+		return -code ok
+	}
+	set link $links($copy)
+	set dt [expr {$t - [dict get $link t]}]
+	set d_crc [expr {($crc - [dict get $link crc]) & 0xffffffff}]
+	set d_bad [expr {($bad - [dict get $link bad]) & 0xffffffff}]
+	lset ring($copy) [dict get $link pos] [list $t $dt $d_crc $d_bad]
+	dict set link pos [expr {([dict get $link pos] + 1) % $depth}]
+	dict set link n [expr {min($depth, [dict get $link n] + 1)}]
+	dict set link live_s [expr {[dict get $link live_s] + $dt}]
+	dict incr link crc_total $d_crc
+	dict incr link bad_total $d_bad
+	# correlation with the lane
+	set lvds_moved [expr {$lvds_total ne "" && [dict get $link lvds] ne "" && $lvds_total > [dict get $link lvds]}]
+	if {$d_crc + $d_bad > 0} {
+		dict incr link n_burst
+		if {$lvds_moved} {
+			dict incr link n_coincident
+		}
+	} elseif {$lvds_moved} {
+		dict incr link n_lvds_only
+	}
+	dict set link t $t
+	dict set link crc $crc
+	dict set link bad $bad
+	dict set link lvds $lvds_total
+	dict set link status [expr {($csr >> 24) & 0xff}]
+	set links($copy) $link
+	return -code ok
+}
+
+# error total of the lvds lane of a copy, empty if the lane health engine has no state for it
+proc ::frame_deassembly::errors::lane_errors {copy} {
+	variable lane_map
+	if {[llength [info commands ::lvds_rx::health::get_status]] == 0} {
+		return ""
+	}
+	if {$copy < [llength $lane_map]} {
+		lassign [lindex $lane_map $copy] lvds_copy lane
+	} else {
+		set lvds_copy 0
+		set lane $copy
+	}
+	foreach lane_status [::lvds_rx::health::get_status $lvds_copy] {
+		if {[lindex $lane_status 0] == $lane} {
+			return [lindex $lane_status 6]
+		}
+	}
+	return ""
+}
+
+######################################################################################################
+##  Arguments:
+##		<copy>  - index of the copy
+##
+##  Description:
+##  	Gets the state of a link. Rates are over the history ring, the BER over everything since the
+##		reset, from the CRC errors (each is at least one bit error, so the BER is a lower estimate).
+##
+##	Returns:
+##  	dict with status (frame flags), n (samples in the ring), window_s, crc_rate, bad_rate (1/s),
+##		crc_total, bad_total, live_s, ber, ber_lower, ber_upper, n_burst, n_coincident (bursts with
+##		lane errors), n_lvds_only (lane errors without frame errors); empty before the second reading
+##
+######################################################################################################
+proc ::frame_deassembly::errors::get_status {copy} {
+	variable links
+	variable ring
+	variable line_rate_bps
+	if {![info exists links($copy)] || [dict get $links($copy) n] == 0} {
+		return [dict create]
+	}
+	set link $links($copy)
+	set window_s 0.0
+	set crc 0
+	set bad 0
+	foreach sample $ring($copy) {
+		if {$sample ne ""} {
+			lassign $sample t dt d_crc d_bad
+			set window_s [expr {$window_s + $dt}]
+			incr crc $d_crc
+			incr bad $d_bad
+		}
+	}
+	lassign [::frame_deassembly::errors::ber_interval [dict get $link crc_total] [expr {$line_rate_bps*[dict get $link live_s]}]] ber lower upper
+	return [dict create status [dict get $link status] n [dict get $link n] window_s $window_s \
+		crc_rate [expr {$window_s > 0 ? $crc/$window_s : 0.0}] bad_rate [expr {$window_s > 0 ? $bad/$window_s : 0.0}] \
+		crc_total [dict get $link crc_total] bad_total [dict get $link bad_total] live_s [dict get $link live_s] \
+		ber $ber ber_lower $lower ber_upper $upper n_burst [dict get $link n_burst] \
+		n_coincident [dict get $link n_coincident] n_lvds_only [dict get $link n_lvds_only]]
+}
+
+######################################################################################################
+##  Arguments:
+##		<copy>    - index of the copy
+##		<seconds> - time span, counted back from the last sample
+##
+##  Description:
+##  	Gets the history of a link out of its ring.
+##
+##	Returns:
+##  	list of {t dt d_crc d_bad}, oldest first
+##
+######################################################################################################
+proc ::frame_deassembly::errors::get_history {copy seconds} {
+	variable links
+	variable ring
+	set result [list]
+	if {![info exists links($copy)]} {
+		return $result
+	}
+	set link $links($copy)
+	set n [dict get $link n]
+	set depth [llength $ring($copy)]
+	set t_last [dict get $link t]
+	for {set i [expr {[dict get $link pos] - $n}]} {$i < [dict get $link pos]} {incr i} {
+		set sample [lindex $ring($copy) [expr {($i + $depth) % $depth}]]
+		if {$t_last - [lindex $sample 0] < $seconds} {
+			lappend result $sample
+		}
+	}
+	return $result
+}
@@ -0,0 +1,382 @@
+###########################################################################################################
+# @Name 		histogram_statistics_acq.tcl
+#
+# @Brief		Acquisition engine of the Histogram Statistics IP core. Knows the bin semantics of every
+#				mode, reads the bins and the under/overflow counters back to back per integration window
+#				and accumulates the windows into host-side histograms, with the live and dead time of the
+#				acquisition, so long low-rate measurements can be integrated over many windows.
+#
+# @Functions	configure, decode_csr, bin_semantics, start, cancel, is_running, reset, get_result
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 19, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require mu3e::helpers 	1.0
+package provide histogram_statistics::acq 	1.0
+
+namespace eval ::histogram_statistics::acq:: {
+	namespace export \
+	configure \
+	decode_csr \
+	bin_semantics \
+	start \
+	cancel \
+	is_running \
+	reset \
+	get_result
+
+	variable csr_base 0x0
+	variable bin_base 0x0
+	variable n_bin 256
+	variable window_ms 1000
+	# layout {nx ny} of the bins in the burstiness 2d scan (mode -6), row major
+	variable dim2 [list 16 16]
+	variable running 0
+	variable after_id ""
+	variable done_callback ""
+	variable progress_callback ""
+	variable n_window_todo 0
+	# window being integrated {t_clear_us underflow overflow}
+	variable window [list]
+	variable t_last_read_us ""
+	# accumulated result, see get_result
+	variable acc [dict create]
+}
+
+######################################################################################################
+##  Arguments:
+##		-csr_base <addr>   - base address of the csr slave
+##		-bin_base <addr>   - base address of the hist_bin slave
+##		-n_bin <n>         - number of bins of the IP (default 256)
+##		-window_ms <ms>    - length of one integration window (default 1000)
+##		-dim2 {nx ny}      - bin layout of the burstiness 2d scan (default 16 x 16)
+##
+##  Description:
+##  	Configures the engine. Not allowed during an acquisition.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::histogram_statistics::acq::configure {args} {
+	variable running
+	if {$running} {
+		error "configure: an acquisition is running"
+	}
+	foreach {option value} $args {
+		switch -- $option {
+			-csr_base - -bin_base - -n_bin - -window_ms - -dim2 {
+				variable [string range $option 1 end]
+				set [string range $option 1 end] $value
+			}
+			default {
+				error "configure: unknown option \"${option}\", must be -csr_base, -bin_base, -n_bin, -window_ms or -dim2"
+			}
+		}
+	}
+	return -code ok
+}
+
+proc ::histogram_statistics::acq::is_running {} {
+	variable running
+	return $running
+}
+
+proc ::histogram_statistics::acq::reset {} {
+	variable acc
+	set acc [dict create]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<words> - csr words from offset 0x0 to 0x1c
+##
+##  Description:
+##  	Decodes the csr. mode is the signed 4 bit mode field, left_bound is signed unless the
+##		representation is unsigned.
+##
+##	Returns:
+##  	dict with mode, unsigned, left, right, bin_width, error, underflow and overflow
+##
+######################################################################################################
+proc ::histogram_statistics::acq::decode_csr {words} {
+	lassign $words csr left right bin_width keys_location keys_value underflow overflow
+	set mode [expr {($csr >> 4) & 0xf}]
+	if {$mode >= 8} {
+		incr mode -16
+	}
+	set unsigned [expr {($csr >> 8) & 1}]
+	set left [expr {$left & 0xffffffff}]
+	set right [expr {$right & 0xffffffff}]
+	if {!$unsigned} {
+		set left [expr {$left >= 0x80000000 ? $left - 0x100000000 : $left}]
+		set right [expr {$right >= 0x80000000 ? $right - 0x100000000 : $right}]
+	}
+	return [dict create mode $mode unsigned $unsigned left $left right $right \
+		bin_width [expr {$bin_width & 0xffff}] error [expr {($csr >> 24) & 1}] \
+		underflow [expr {$underflow & 0xffffffff}] overflow [expr {$overflow & 0xffffffff}]]
+}
+
+######################################################################################################
+##  Arguments:
+##		<settings> - decoded csr (see decode_csr)
+##
+##  Description:
+##  	Gets the meaning of the bins for the mode of the IP:
+##		   0      normal, the key between left and right bound
+##		   1      local 16 bit timestamp difference (packet delay, aliased modulo 2^16)
+##		  -1      inferred 48 bit timestamp difference (packet delay, not aliased)
+##		  -2..-5  fill level pdf of the monitored buffer 0..3
+##		  -6      burstiness 2d scan, bins laid out as configured with -dim2
+##		The delay modes are unsigned by construction. A bin width of 0 falls back to the bounds.
+##
+##	Returns:
+##  	dict with kind ("1d" or "2d"), title, unit, left, bin_width and, for 2d, nx and ny
+##
+######################################################################################################
+proc ::histogram_statistics::acq::bin_semantics {settings} {
+	variable n_bin
+	variable dim2
+	set mode [dict get $settings mode]
+	set left [dict get $settings left]
+	set bin_width [dict get $settings bin_width]
+	if {$bin_width == 0} {
+		set bin_width [expr {max(1.0, double([dict get $settings right] - $left)/$n_bin)}]
+	}
+	set result [dict create kind "1d" left $left bin_width $bin_width]
+	switch -- $mode {
+		0 {
+			dict set result title "key"
+			dict set result unit "key value"
+		}
+		1 {
+			dict set result title "packet delay (16 bit, aliased)"
+			dict set result unit "timestamp ticks mod 2^16"
+			dict set result left [expr {$left & 0xffff}]
+		}
+		-1 {
+			dict set result title "packet delay (48 bit inferred)"
+			dict set result unit "timestamp ticks"
+			dict set result left [expr {$left & 0xffffffff}]
+		}
+		-2 - -3 - -4 - -5 {
+			dict set result title "fill level pdf [expr {-2 - $mode}]"
+			dict set result unit "fill level"
+		}
+		-6 {
+			lassign $dim2 nx ny
+			dict set result kind "2d"
+			dict set result title "burstiness 2d scan"
+			dict set result unit "bin = row*${nx} + column"
+			dict set result nx $nx
+			dict set result ny $ny
+		}
+		default {
+			dict set result title "mode ${mode} (unknown)"
+			dict set result unit "bin"
+		}
+	}
+	return $result
+}
+
+######################################################################################################
+##  Arguments:
+##		-windows <n>    - number of integration windows (default 1)
+##		-done <cmd>     - called when the acquisition ends, with 1 if it completed and 0 if cancelled
+##		-progress <cmd> - called after every window with the number of done and total windows
+##
+##  Description:
+##  	Starts an acquisition in the background (event loop), returns immediately. The windows are
+##		added to the accumulated result, a change of the histogram settings resets it.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::histogram_statistics::acq::start {args} {
+	variable running
+	variable done_callback
+	variable progress_callback
+	variable n_window_todo
+	variable t_last_read_us
+	if {$running} {
+		error "start: an acquisition is running"
+	}
+	set n_window_todo 1
+	set done_callback ""
+	set progress_callback ""
+	foreach {option value} $args {
+		switch -- $option {
+			-windows {
+				set n_window_todo $value
+			}
+			-done {
+				set done_callback $value
+			}
+			-progress {
+				set progress_callback $value
+			}
+			default {
+				error "start: unknown option \"${option}\", must be -windows, -done or -progress"
+			}
+		}
+	}
+	set running 1
+	# time before the first window is not dead time of this acquisition
+	set t_last_read_us ""
+	::histogram_statistics::acq::run_stage ::histogram_statistics::acq::open_window
+	return -code ok
+}
+
+# runs a stage, an error stops the acquisition instead of leaving it running
+proc ::histogram_statistics::acq::run_stage {stage} {
+	variable running
+	if {!$running} {
+		return -code ok
+	}
+	if {[catch {$stage} error_msg]} {
+		toolkit_send_message error "histogram_statistics::acq: [namespace tail $stage] failed, acquisition stopped: $error_msg"
+		::histogram_statistics::acq::finish 0
+	}
+	return -code ok
+}
+
+proc ::histogram_statistics::acq::cancel {} {
+	variable running
+	variable after_id
+	if {$running} {
+		after cancel $after_id
+		::histogram_statistics::acq::finish 0
+	}
+	return -code ok
+}
+
+proc ::histogram_statistics::acq::read_csr {} {
+	variable csr_base
+	return [master_read_32 [::mu3e::helpers::cget_opened_master_path] $csr_base 8]
+}
+
+# clear the bins and take the under/overflow reference
+proc ::histogram_statistics::acq::open_window {} {
+	variable bin_base
+	variable window_ms
+	variable window
+	variable after_id
+	master_write_32 [::mu3e::helpers::cget_opened_master_path] $bin_base 0x0
+	set t_clear_us [clock microseconds]
+	set settings [::histogram_statistics::acq::decode_csr [::histogram_statistics::acq::read_csr]]
+	set window [list $t_clear_us [dict get $settings underflow] [dict get $settings overflow]]
+	set after_id [after $window_ms [list ::histogram_statistics::acq::run_stage ::histogram_statistics::acq::close_window]]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Ends a window: reads all bins in one transaction, directly followed by the csr (settings and
+##		under/overflow counters) in a second one, since the two are separate slaves. The counters are
+##		taken as difference to the start of the window (32 bit wrap), so it does not matter whether
+##		the bin clear also clears them. Live time runs from the clear to the bin read, dead time from
+##		the bin read of the previous window to the clear of this one.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::histogram_statistics::acq::close_window {} {
+	variable bin_base
+	variable n_bin
+	variable window
+	variable acc
+	variable t_last_read_us
+	variable n_window_todo
+	variable progress_callback
+	variable after_id
+	set master_fd [::mu3e::helpers::cget_opened_master_path]
+	set t_read_us [clock microseconds]
+	set bins [master_read_32 $master_fd $bin_base $n_bin]
+	set settings [::histogram_statistics::acq::decode_csr [::histogram_statistics::acq::read_csr]]
+	lassign $window t_clear_us underflow_start overflow_start
+	set live_s [expr {($t_read_us - $t_clear_us)*1.0e-6}]
+	set dead_s [expr {$t_last_read_us eq "" ? 0.0 : ($t_clear_us - $t_last_read_us)*1.0e-6}]
+	set t_last_read_us $t_read_us
+	set underflow [expr {([dict get $settings underflow] - $underflow_start) & 0xffffffff}]
+	set overflow [expr {([dict get $settings overflow] - $overflow_start) & 0xffffffff}]
+	# the accumulated result is only valid for one setting
+	set key [list [dict get $settings mode] [dict get $settings unsigned] [dict get $settings left] [dict get $settings bin_width]]
+	if {[dict size $acc] != 0 && [dict get $acc key] ne $key} {
+		toolkit_send_message warning "histogram_statistics::acq: histogram settings changed, accumulated result reset"
+		set acc [dict create]
+	}
+	if {[dict size $acc] == 0} {
+		set acc [dict create key $key settings $settings counts [lrepeat $n_bin 0] underflow 0 overflow 0 \
+			live_s 0.0 dead_s 0.0 n_window 0 n_error 0]
+	}
+	set counts [list]
+	foreach count [dict get $acc counts] bin $bins {
+		lappend counts [expr {$count + ($bin & 0xffffffff)}]
+	}
+	dict set acc counts $counts
+	dict set acc settings $settings
+	dict incr acc underflow $underflow
+	dict incr acc overflow $overflow
+	dict set acc live_s [expr {[dict get $acc live_s] + $live_s}]
+	dict set acc dead_s [expr {[dict get $acc dead_s] + $dead_s}]
+	dict incr acc n_window
+	dict incr acc n_error [dict get $settings error]
+	incr n_window_todo -1
+	if {$progress_callback ne ""} {
+		{*}$progress_callback [dict get $acc n_window] $n_window_todo
+	}
+	if {$n_window_todo > 0} {
+		::histogram_statistics::acq::open_window
+	} else {
+		::histogram_statistics::acq::finish 1
+	}
+	return -code ok
+}
+
+proc ::histogram_statistics::acq::finish {completed} {
+	variable running
+	variable done_callback
+	variable after_id
+	after cancel $after_id
+	set running 0
+	if {$done_callback ne ""} {
+		if {[catch {{*}$done_callback $completed} error_msg]} {
+			toolkit_send_message error "histogram_statistics::acq: done callback failed: $error_msg"
+		}
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Gets the accumulated result. Counts are summed on the host without limit (the IP bins are
+##		32 bit per window), live and dead time are in s.
+##
+##	Returns:
+##  	dict with settings (see decode_csr), semantics (see bin_semantics), counts, underflow,
+##		overflow, live_s, dead_s, n_window and n_error (windows with the error flag set), empty if
+##		nothing was acquired
+##
+######################################################################################################
+proc ::histogram_statistics::acq::get_result {} {
+	variable acc
+	if {[dict size $acc] == 0} {
+		return [dict create]
+	}
+	set result [dict remove $acc key]
+	dict set result semantics [::histogram_statistics::acq::bin_semantics [dict get $acc settings]]
+	return $result
+}
@@ -0,0 +1,427 @@
+###########################################################################################################
+# @Name 		histogram_statistics_adaptive.tcl
+#
+# @Brief		Adaptive stepped scan of the Histogram Statistics IP core. A fast coarse pass measures
+#				the rate of every window, then each window gets the dwell needed to reach a target
+#				relative error of its counts, topped up until the target or the dwell limit is reached.
+#				Empty windows are not revisited. All acquisitions go to the stitching engine, which
+#				combines the coarse and fine passes by their live time.
+#
+# @Functions	configure, start, cancel, is_running, get_report
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 20, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require mu3e::helpers 	1.0
+package require histogram_statistics::stitch 	1.0
+package provide histogram_statistics::adaptive 	1.0
+
+namespace eval ::histogram_statistics::adaptive:: {
+	namespace export \
+	configure \
+	start \
+	cancel \
+	is_running \
+	get_report
+
+	variable csr_base 0x0
+	variable bin_base 0x0
+	variable n_bin 256
+	# scan: nstep windows of step_sz from scan_min, as scan_hist
+	variable scan_min 0
+	variable step_sz 256
+	variable nstep 256
+	variable unsigned 0
+	variable coarse_ms 100
+	# target relative error of the counts of a window (1/sqrt(N))
+	variable target 0.05
+	# dwell limit per window (coarse and fine together)
+	variable max_ms 10000
+	# least fine dwell, shorter ones are not worth the overhead of a window
+	variable min_ms 50
+	variable running 0
+	variable after_id ""
+	variable done_callback ""
+	variable progress_callback ""
+	# window index -> {counts live_s}
+	variable windows
+	array set windows {}
+	# pass ("coarse" or "fine"), window being acquired, windows left of the fine pass
+	variable pass ""
+	variable current 0
+	variable todo [list]
+	variable t_start_us 0
+	variable t_clear_us 0
+	variable n_poll 0
+	variable report [dict create]
+}
+
+######################################################################################################
+##  Arguments:
+##		-csr_base <addr> -bin_base <addr> - base addresses of the csr and hist_bin slaves
+##		-n_bin <n>            - bins of the IP (default 256)
+##		-scan_min <v> -step_sz <v> -nstep <n> - scan range, as scan_hist
+##		-unsigned <0|1>       - representation of the bounds
+##		-coarse_ms <ms>       - dwell of the coarse pass (default 100)
+##		-target <rel>         - target relative error of the counts per window (default 0.05)
+##		-max_ms <ms>          - dwell limit per window (default 10000)
+##		-min_ms <ms>          - least fine dwell (default 50)
+##
+##  Description:
+##  	Configures the scan. Not allowed while a scan is running. The IP takes an integer bin width,
+##		so step_sz must be a positive multiple of n_bin; otherwise nothing is changed.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::histogram_statistics::adaptive::configure {args} {
+	variable running
+	if {$running} {
+		error "configure: a scan is running"
+	}
+	variable n_bin
+	variable step_sz
+	set names {csr_base bin_base n_bin scan_min step_sz nstep unsigned coarse_ms target max_ms min_ms}
+	set new [dict create n_bin $n_bin step_sz $step_sz]
+	foreach {option value} $args {
+		set name [string range $option 1 end]
+		if {[lsearch -exact $names $name] < 0} {
+			error "configure: unknown option \"${option}\", must be one of -[join $names {, -}]"
+		}
+		dict set new $name $value
+	}
+	set new_n_bin [dict get $new n_bin]
+	set new_step_sz [dict get $new step_sz]
+	if {![string is integer -strict $new_n_bin] || ![string is integer -strict $new_step_sz] || $new_n_bin <= 0 \
+		|| $new_step_sz <= 0 || $new_step_sz % $new_n_bin != 0 || $new_step_sz/$new_n_bin > 0xffff} {
+		error "configure: step_sz (${new_step_sz}) must be a positive multiple of n_bin (${new_n_bin}), with a bin width up to 0xffff"
+	}
+	dict for {name value} $new {
+		variable $name
+		set $name $value
+	}
+	return -code ok
+}
+
+proc ::histogram_statistics::adaptive::is_running {} {
+	variable running
+	return $running
+}
+
+######################################################################################################
+##  Arguments:
+##		-done <cmd>     - called when the scan ends, with 1 if it completed and 0 if cancelled
+##		-progress <cmd> - called after every acquisition with the pass, window and windows left
+##
+##  Description:
+##  	Starts the scan in the background (event loop), returns immediately. The stitching engine is
+##		reset and receives every acquisition.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::histogram_statistics::adaptive::start {args} {
+	variable running
+	variable done_callback
+	variable progress_callback
+	variable windows
+	variable pass
+	variable current
+	variable t_start_us
+	variable report
+	if {$running} {
+		error "start: a scan is running"
+	}
+	set done_callback ""
+	set progress_callback ""
+	foreach {option value} $args {
+		switch -- $option {
+			-done {
+				set done_callback $value
+			}
+			-progress {
+				set progress_callback $value
+			}
+			default {
+				error "start: unknown option \"${option}\", must be -done or -progress"
+			}
+		}
+	}
+	array unset windows
+	::histogram_statistics::stitch::reset
+	set report [dict create]
+	set running 1
+	set pass "coarse"
+	set current 0
+	set t_start_us [clock microseconds]
+	::histogram_statistics::adaptive::run_stage ::histogram_statistics::adaptive::load_window
+	return -code ok
+}
+
+# runs a stage, an error stops the scan instead of leaving it running
+proc ::histogram_statistics::adaptive::run_stage {stage} {
+	variable running
+	if {!$running} {
+		return -code ok
+	}
+	if {[catch {$stage} error_msg]} {
+		toolkit_send_message error "histogram_statistics::adaptive: [namespace tail $stage] failed, scan stopped: $error_msg"
+		::histogram_statistics::adaptive::finish 0
+	}
+	return -code ok
+}
+
+proc ::histogram_statistics::adaptive::cancel {} {
+	variable running
+	variable after_id
+	if {$running} {
+		after cancel $after_id
+		::histogram_statistics::adaptive::finish 0
+	}
+	return -code ok
+}
+
+# bin width as programmed into the IP, configure keeps it an integer
+proc ::histogram_statistics::adaptive::bin_width {} {
+	variable step_sz
+	variable n_bin
+	return [expr {$step_sz/$n_bin}]
+}
+
+proc ::histogram_statistics::adaptive::window_left {index} {
+	variable scan_min
+	variable step_sz
+	variable unsigned
+	set left [expr {($scan_min + $index*$step_sz) & 0xffffffff}]
+	if {!$unsigned} {
+		set left [::mu3e::helpers:hex2signed $left]
+	}
+	return $left
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Stages of one acquisition: load_window writes left_bound and bin_width of the current window
+##		and sets the commit bit, wait_commit polls it until the IP has taken the settings, then the
+##		bins are cleared and read_window reads them after the dwell.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::histogram_statistics::adaptive::load_window {} {
+	variable csr_base
+	variable current
+	variable n_poll
+	set master_fd [::mu3e::helpers::cget_opened_master_path]
+	master_write_32 $master_fd [expr {$csr_base + 0x4}] [format 0x%08x [expr {[::histogram_statistics::adaptive::window_left $current] & 0xffffffff}]]
+	master_write_32 $master_fd [expr {$csr_base + 0xc}] [format 0x%08x [::histogram_statistics::adaptive::bin_width]]
+	set csr [master_read_32 $master_fd $csr_base 1]
+	master_write_32 $master_fd $csr_base [format 0x%08x [expr {$csr | 0x1}]]
+	set n_poll 0
+	::histogram_statistics::adaptive::wait_commit
+	return -code ok
+}
+
+proc ::histogram_statistics::adaptive::wait_commit {} {
+	variable csr_base
+	variable bin_base
+	variable n_poll
+	variable after_id
+	variable pass
+	variable current
+	variable coarse_ms
+	variable t_clear_us
+	set master_fd [::mu3e::helpers::cget_opened_master_path]
+	if {[master_read_32 $master_fd $csr_base 1] & 0x1} {
+		incr n_poll
+		if {$n_poll > 100} {
+			toolkit_send_message error "histogram_statistics::adaptive: commit of window ${current} not acknowledged, scan stopped"
+			::histogram_statistics::adaptive::finish 0
+			return -code ok
+		}
+		set after_id [after 1 [list ::histogram_statistics::adaptive::run_stage ::histogram_statistics::adaptive::wait_commit]]
+		return -code ok
+	}
+	master_write_32 $master_fd $bin_base 0x0
+	set t_clear_us [clock microseconds]
+	if {$pass eq "coarse"} {
+		set dwell_ms $coarse_ms
+	} else {
+		set dwell_ms [::histogram_statistics::adaptive::plan $current]
+	}
+	set after_id [after $dwell_ms [list ::histogram_statistics::adaptive::run_stage ::histogram_statistics::adaptive::read_window]]
+	return -code ok
+}
+
+# fine dwell (ms) of a window for the target, from its rate so far
+proc ::histogram_statistics::adaptive::plan {index} {
+	variable windows
+	variable target
+	variable max_ms
+	variable min_ms
+	lassign $windows($index) counts live_s
+	set n_total 0
+	foreach count $counts {
+		incr n_total $count
+	}
+	set n_needed [expr {1.0/($target*$target)}]
+	set rate [expr {$n_total/$live_s}]
+	set dwell_ms [expr {1000.0*($n_needed - $n_total)/$rate}]
+	set dwell_ms [expr {min($max_ms - 1000.0*$live_s, max($min_ms, $dwell_ms))}]
+	return [expr {int(ceil($dwell_ms))}]
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Reads the bins of the current window, adds them to the window and to the stitching engine and
+##		decides what comes next. After the coarse pass, the windows that have counts but not yet the
+##		target are queued for the fine pass, in scan order. A fine window is re-queued while it misses
+##		the target and has dwell left.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::histogram_statistics::adaptive::read_window {} {
+	variable bin_base
+	variable n_bin
+	variable windows
+	variable pass
+	variable current
+	variable todo
+	variable nstep
+	variable t_clear_us
+	variable progress_callback
+	set master_fd [::mu3e::helpers::cget_opened_master_path]
+	set live_s [expr {([clock microseconds] - $t_clear_us)*1.0e-6}]
+	set bins [master_read_32 $master_fd $bin_base $n_bin]
+	set counts [list]
+	foreach bin $bins {
+		lappend counts [expr {$bin & 0xffffffff}]
+	}
+	::histogram_statistics::stitch::add_window [::histogram_statistics::adaptive::window_left $current] \
+		[::histogram_statistics::adaptive::bin_width] $counts $live_s 1
+	if {[info exists windows($current)]} {
+		lassign $windows($current) counts_before live_before
+		set sums [list]
+		foreach count $counts count_before $counts_before {
+			lappend sums [expr {$count + $count_before}]
+		}
+		set windows($current) [list $sums [expr {$live_s + $live_before}]]
+	} else {
+		set windows($current) [list $counts $live_s]
+	}
+	if {$pass eq "coarse"} {
+		incr current
+		if {$current >= $nstep} {
+			set pass "fine"
+			set todo [list]
+			for {set index 0} {$index < $nstep} {incr index} {
+				if {[::histogram_statistics::adaptive::needs_dwell $index]} {
+					lappend todo $index
+				}
+			}
+		}
+	} elseif {![::histogram_statistics::adaptive::needs_dwell $current]} {
+		set todo [lrange $todo 1 end]
+	}
+	if {$progress_callback ne ""} {
+		{*}$progress_callback $pass $current [llength $todo]
+	}
+	if {$pass eq "fine"} {
+		if {[llength $todo] == 0} {
+			::histogram_statistics::adaptive::finish 1
+			return -code ok
+		}
+		set current [lindex $todo 0]
+	}
+	::histogram_statistics::adaptive::load_window
+	return -code ok
+}
+
+proc ::histogram_statistics::adaptive::needs_dwell {index} {
+	variable windows
+	variable target
+	variable max_ms
+	variable min_ms
+	lassign $windows($index) counts live_s
+	set n_total 0
+	foreach count $counts {
+		incr n_total $count
+	}
+	# empty windows stay at the upper limit of the coarse pass
+	if {$n_total == 0} {
+		return 0
+	}
+	return [expr {1.0/sqrt($n_total) > $target && 1000.0*$live_s + $min_ms <= $max_ms}]
+}
+
+proc ::histogram_statistics::adaptive::finish {completed} {
+	variable running
+	variable done_callback
+	variable report
+	variable windows
+	variable t_start_us
+	variable target
+	variable nstep
+	variable max_ms
+	variable after_id
+	after cancel $after_id
+	set running 0
+	set live_s 0.0
+	set n_target 0
+	set n_empty 0
+	foreach index [array names windows] {
+		lassign $windows($index) counts w_live_s
+		set live_s [expr {$live_s + $w_live_s}]
+		set n_total 0
+		foreach count $counts {
+			incr n_total $count
+		}
+		if {$n_total == 0} {
+			incr n_empty
+		} elseif {1.0/sqrt($n_total) <= $target} {
+			incr n_target
+		}
+	}
+	set report [dict create completed $completed n_window [array size windows] n_target $n_target \
+		n_empty $n_empty live_s $live_s wall_s [expr {([clock microseconds] - $t_start_us)*1.0e-6}] \
+		fixed_s [expr {$nstep*$max_ms/1000.0}]]
+	if {$done_callback ne ""} {
+		if {[catch {{*}$done_callback $completed} error_msg]} {
+			toolkit_send_message error "histogram_statistics::adaptive: done callback failed: $error_msg"
+		}
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Gets the report of the last scan.
+##
+##	Returns:
+##  	dict with completed, n_window, n_target (windows that reached the target), n_empty, live_s
+##		(sum of the dwells), wall_s and fixed_s (scan time with the dwell limit on every window, the
+##		time a fixed-dwell scan needs for the same worst case error)
+##
+######################################################################################################
+proc ::histogram_statistics::adaptive::get_report {} {
+	variable report
+	return $report
+}
@@ -0,0 +1,403 @@
+###########################################################################################################
+# @Name 		histogram_statistics_histogram.tcl
+#
+# @Brief		Host-side histogram object. Holds the counts together with the binning (left bound, bin
+#				width, signedness) and prefix sums, so slices are views without copy and the integral,
+#				mean and RMS of any range are O(1). Rebinning, cumulative sums, peak finding and file
+#				export work on the object, the GUI reads from it instead of re-stringified lists.
+#
+# @Functions	create, destroy, cget, slice, rebin, bin_center, integral, mean, rms, cumsum, peaks,
+#				export
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 19, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package provide histogram_statistics::histogram 	1.0
+
+namespace eval ::histogram_statistics::histogram:: {
+	namespace export \
+	create \
+	destroy \
+	cget \
+	slice \
+	rebin \
+	bin_center \
+	integral \
+	mean \
+	rms \
+	cumsum \
+	peaks \
+	export
+
+	variable n_handle 0
+	# data id -> dict with counts and the prefix sums s0 (counts), s1 (counts*x), s2 (counts*x^2), x being
+	# the bin centre relative to left, each with one leading 0, plus left, bin_width, unsigned, underflow,
+	# overflow and n_ref
+	variable data
+	# handle -> {data_id first n}, a view on bins [first, first+n) of the data
+	variable views
+	array set data {}
+	array set views {}
+}
+
+######################################################################################################
+##  Arguments:
+##		<left>      - lower edge of bin 0
+##		<bin_width> - width of one bin
+##		<counts>    - bin counts
+##		-unsigned <0|1>   - representation of the key (default 0, signed)
+##		-underflow <n>    - entries below the first bin (default 0)
+##		-overflow <n>     - entries above the last bin (default 0)
+##
+##  Description:
+##  	Creates a histogram. The bounds are taken as given, hex bounds of the signed representation
+##		are converted as with mu3e::helpers:hex2signed.
+##
+##	Returns:
+##  	handle of the histogram
+##
+######################################################################################################
+proc ::histogram_statistics::histogram::create {left bin_width counts args} {
+	variable n_handle
+	variable data
+	variable views
+	set options [dict create -unsigned 0 -underflow 0 -overflow 0]
+	foreach {option value} $args {
+		if {![dict exists $options $option]} {
+			error "create: unknown option \"${option}\", must be -unsigned, -underflow or -overflow"
+		}
+		dict set options $option $value
+	}
+	set unsigned [dict get $options -unsigned]
+	if {!$unsigned && [string match -nocase "0x*" $left]} {
+		set left [expr {($left & 0x80000000) ? ($left & 0x7fffffff) - 0x80000000 : $left & 0x7fffffff}]
+	}
+	set left [expr {$left}]
+	set s0 [list 0]
+	set s1 [list 0.0]
+	set s2 [list 0.0]
+	set sum0 0
+	set sum1 0.0
+	set sum2 0.0
+	set index 0
+	foreach count $counts {
+		# relative to the left bound, keeps the precision of the squares for large bounds
+		set x [expr {($index + 0.5)*$bin_width}]
+		set sum0 [expr {$sum0 + $count}]
+		set sum1 [expr {$sum1 + $count*$x}]
+		set sum2 [expr {$sum2 + $count*$x*$x}]
+		lappend s0 $sum0
+		lappend s1 $sum1
+		lappend s2 $sum2
+		incr index
+	}
+	incr n_handle
+	set handle "h${n_handle}"
+	set data($handle) [dict create counts $counts s0 $s0 s1 $s1 s2 $s2 left $left bin_width $bin_width \
+		unsigned $unsigned underflow [dict get $options -underflow] overflow [dict get $options -overflow] n_ref 1]
+	set views($handle) [list $handle 0 [llength $counts]]
+	return $handle
+}
+
+proc ::histogram_statistics::histogram::destroy {handle} {
+	variable data
+	variable views
+	if {![info exists views($handle)]} {
+		return -code ok
+	}
+	set data_id [lindex $views($handle) 0]
+	unset views($handle)
+	dict incr data($data_id) n_ref -1
+	if {[dict get $data($data_id) n_ref] <= 0} {
+		unset data($data_id)
+	}
+	return -code ok
+}
+
+proc ::histogram_statistics::histogram::get_view {handle} {
+	variable views
+	if {![info exists views($handle)]} {
+		error "histogram \"${handle}\" does not exist"
+	}
+	return $views($handle)
+}
+
+######################################################################################################
+##  Arguments:
+##		<handle> - histogram
+##		<key>    - n_bin, left, right, bin_width, unsigned, counts, underflow or overflow
+##
+##  Description:
+##  	Gets a property. The bounds are those of the view. Underflow and overflow of a slice include
+##		the bins of the parent left and right of the slice.
+##
+##	Returns:
+##  	value of the property
+##
+######################################################################################################
+proc ::histogram_statistics::histogram::cget {handle key} {
+	variable data
+	lassign [::histogram_statistics::histogram::get_view $handle] data_id first n
+	set d $data($data_id)
+	set bin_width [dict get $d bin_width]
+	switch -- $key {
+		n_bin {
+			return $n
+		}
+		left {
+			return [expr {[dict get $d left] + $first*$bin_width}]
+		}
+		right {
+			return [expr {[dict get $d left] + ($first + $n)*$bin_width}]
+		}
+		bin_width - unsigned {
+			return [dict get $d $key]
+		}
+		counts {
+			return [lrange [dict get $d counts] $first [expr {$first + $n - 1}]]
+		}
+		underflow {
+			return [expr {[dict get $d underflow] + [lindex [dict get $d s0] $first]}]
+		}
+		overflow {
+			set s0 [dict get $d s0]
+			return [expr {[dict get $d overflow] + [lindex $s0 end] - [lindex $s0 [expr {$first + $n}]]}]
+		}
+		default {
+			error "cget: unknown key \"${key}\", must be n_bin, left, right, bin_width, unsigned, counts, underflow or overflow"
+		}
+	}
+}
+
+######################################################################################################
+##  Arguments:
+##		<handle> - histogram
+##		<lo>     - first bin of the slice (index in the histogram)
+##		<hi>     - last bin of the slice (included)
+##
+##  Description:
+##  	Creates a view on a range of bins. No bin is copied, the view shares the data and its prefix
+##		sums with the histogram. Destroy it like any other histogram.
+##
+##	Returns:
+##  	handle of the slice
+##
+######################################################################################################
+proc ::histogram_statistics::histogram::slice {handle lo hi} {
+	variable n_handle
+	variable data
+	variable views
+	lassign [::histogram_statistics::histogram::get_view $handle] data_id first n
+	set lo [expr {max(0, $lo)}]
+	set hi [expr {min($n - 1, $hi)}]
+	incr n_handle
+	set slice "h${n_handle}"
+	set views($slice) [list $data_id [expr {$first + $lo}] [expr {max(0, $hi - $lo + 1)}]]
+	dict incr data($data_id) n_ref
+	return $slice
+}
+
+######################################################################################################
+##  Arguments:
+##		<handle> - histogram
+##		<factor> - number of bins merged into one
+##
+##  Description:
+##  	Creates a histogram with factor-times wider bins. A last incomplete group of bins goes to the
+##		overflow.
+##
+##	Returns:
+##  	handle of the new histogram
+##
+######################################################################################################
+proc ::histogram_statistics::histogram::rebin {handle factor} {
+	variable data
+	lassign [::histogram_statistics::histogram::get_view $handle] data_id first n
+	set s0 [dict get $data($data_id) s0]
+	set n_new [expr {$n/$factor}]
+	set counts [list]
+	for {set i 0} {$i < $n_new} {incr i} {
+		set lo [expr {$first + $i*$factor}]
+		lappend counts [expr {[lindex $s0 [expr {$lo + $factor}]] - [lindex $s0 $lo]}]
+	}
+	set rest [expr {[lindex $s0 [expr {$first + $n}]] - [lindex $s0 [expr {$first + $n_new*$factor}]]}]
+	return [::histogram_statistics::histogram::create [::histogram_statistics::histogram::cget $handle left] \
+		[expr {[dict get $data($data_id) bin_width]*$factor}] $counts \
+		-unsigned [dict get $data($data_id) unsigned] \
+		-underflow [::histogram_statistics::histogram::cget $handle underflow] \
+		-overflow [expr {[::histogram_statistics::histogram::cget $handle overflow] + $rest}]]
+}
+
+proc ::histogram_statistics::histogram::bin_center {handle index} {
+	return [expr {[::histogram_statistics::histogram::cget $handle left] + ($index + 0.5)*[::histogram_statistics::histogram::cget $handle bin_width]}]
+}
+
+# prefix sum <name> over bins [lo, hi] of the view
+proc ::histogram_statistics::histogram::range_sum {handle name lo hi} {
+	variable data
+	lassign [::histogram_statistics::histogram::get_view $handle] data_id first n
+	set lo [expr {max(0, $lo)}]
+	set hi [expr {min($n - 1, $hi)}]
+	if {$hi < $lo} {
+		return 0
+	}
+	set s [dict get $data($data_id) $name]
+	return [expr {[lindex $s [expr {$first + $hi + 1}]] - [lindex $s [expr {$first + $lo}]]}]
+}
+
+######################################################################################################
+##  Arguments:
+##		<handle> - histogram
+##		<lo>     - first bin (default: 0)
+##		<hi>     - last bin, included (default: last)
+##
+##  Description:
+##  	Integral, mean and RMS of the bin range, from the prefix sums in O(1). Bins are taken at
+##		their centre, under- and overflow are not included.
+##
+##	Returns:
+##  	integral in entries, mean and RMS in units of the key, empty for an empty range
+##
+######################################################################################################
+proc ::histogram_statistics::histogram::integral {handle {lo 0} {hi end}} {
+	if {$hi eq "end"} {
+		set hi [expr {[::histogram_statistics::histogram::cget $handle n_bin] - 1}]
+	}
+	return [::histogram_statistics::histogram::range_sum $handle s0 $lo $hi]
+}
+
+proc ::histogram_statistics::histogram::mean {handle {lo 0} {hi end}} {
+	variable data
+	set n [::histogram_statistics::histogram::integral $handle $lo $hi]
+	if {$n == 0} {
+		return ""
+	}
+	if {$hi eq "end"} {
+		set hi [expr {[::histogram_statistics::histogram::cget $handle n_bin] - 1}]
+	}
+	lassign [::histogram_statistics::histogram::get_view $handle] data_id
+	return [expr {[dict get $data($data_id) left] + [::histogram_statistics::histogram::range_sum $handle s1 $lo $hi]/$n}]
+}
+
+proc ::histogram_statistics::histogram::rms {handle {lo 0} {hi end}} {
+	set n [::histogram_statistics::histogram::integral $handle $lo $hi]
+	if {$n == 0} {
+		return ""
+	}
+	if {$hi eq "end"} {
+		set hi [expr {[::histogram_statistics::histogram::cget $handle n_bin] - 1}]
+	}
+	set mean [expr {[::histogram_statistics::histogram::range_sum $handle s1 $lo $hi]/$n}]
+	set mean2 [expr {[::histogram_statistics::histogram::range_sum $handle s2 $lo $hi]/$n}]
+	return [expr {sqrt(max(0.0, $mean2 - $mean*$mean))}]
+}
+
+######################################################################################################
+##  Arguments:
+##		<handle>     - histogram
+##		<normalized> - 1 to divide by the integral (cumulative distribution)
+##
+##  Description:
+##  	Cumulative sum of the bins of the view.
+##
+##	Returns:
+##  	list with one entry per bin, counting the bin itself
+##
+######################################################################################################
+proc ::histogram_statistics::histogram::cumsum {handle {normalized 0}} {
+	variable data
+	lassign [::histogram_statistics::histogram::get_view $handle] data_id first n
+	set s0 [lrange [dict get $data($data_id) s0] [expr {$first + 1}] [expr {$first + $n}]]
+	set base [lindex [dict get $data($data_id) s0] $first]
+	set total [expr {[lindex $s0 end] - $base}]
+	set result [list]
+	foreach s $s0 {
+		if {$normalized} {
+			lappend result [expr {$total > 0 ? double($s - $base)/$total : 0.0}]
+		} else {
+			lappend result [expr {$s - $base}]
+		}
+	}
+	return $result
+}
+
+######################################################################################################
+##  Arguments:
+##		<handle>       - histogram
+##		<min_height>   - least bin count of a peak (default 1)
+##		<min_distance> - least distance in bins between two peaks (default 1)
+##
+##  Description:
+##  	Finds local maxima (plateaus count once, at their first bin). Of two peaks closer than
+##		min_distance the higher one is kept.
+##
+##	Returns:
+##  	list of {bin center height}, highest first
+##
+######################################################################################################
+proc ::histogram_statistics::histogram::peaks {handle {min_height 1} {min_distance 1}} {
+	set counts [::histogram_statistics::histogram::cget $handle counts]
+	set n [llength $counts]
+	set candidates [list]
+	for {set i 0} {$i < $n} {incr i} {
+		set c [lindex $counts $i]
+		if {$c < $min_height} {
+			continue
+		}
+		# end of the plateau
+		set j $i
+		while {$j + 1 < $n && [lindex $counts [expr {$j + 1}]] == $c} {
+			incr j
+		}
+		set left_ok [expr {$i == 0 || [lindex $counts [expr {$i - 1}]] < $c}]
+		set right_ok [expr {$j == $n - 1 || [lindex $counts [expr {$j + 1}]] < $c}]
+		if {$left_ok && $right_ok} {
+			lappend candidates [list $i [::histogram_statistics::histogram::bin_center $handle $i] $c]
+		}
+		set i $j
+	}
+	set result [list]
+	foreach candidate [lsort -real -decreasing -index 2 $candidates] {
+		set keep 1
+		foreach peak $result {
+			if {abs([lindex $peak 0] - [lindex $candidate 0]) < $min_distance} {
+				set keep 0
+				break
+			}
+		}
+		if {$keep} {
+			lappend result $candidate
+		}
+	}
+	return $result
+}
+
+######################################################################################################
+##  Arguments:
+##		<handle>    - histogram
+##		<file_path> - file to write
+##
+##  Description:
+##  	Writes the histogram in the format of the saved histograms: the bin centres on the first line
+##		and the counts on the second one.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::histogram_statistics::histogram::export {handle file_path} {
+	set bin_mids [list]
+	set n [::histogram_statistics::histogram::cget $handle n_bin]
+	for {set i 0} {$i < $n} {incr i} {
+		lappend bin_mids [::histogram_statistics::histogram::bin_center $handle $i]
+	}
+	set fd [open $file_path w]
+	puts $fd $bin_mids
+	puts $fd [::histogram_statistics::histogram::cget $handle counts]
+	close $fd
+	return -code ok
+}
@@ -0,0 +1,298 @@
+###########################################################################################################
+# @Name 		histogram_statistics_stitch.tcl
+#
+# @Brief		Stitching engine for stepped histogram scans. Merges the windows of a scan (one per
+#				left_bound step) into one contiguous histogram on the finest common grid, normalised by
+#				the live time of each window. Overlapping windows are combined by summing counts and
+#				exposure. Prefix sums over the grid answer queries of any range and resolution in time
+#				proportional to the number of bins asked for, independent of the size of the scan.
+#
+# @Functions	reset, add_window, load_files, build, get_info, query, to_histogram
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 20, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require mu3e::helpers 	1.0
+package require histogram_statistics::histogram 	1.0
+package provide histogram_statistics::stitch 	1.0
+
+namespace eval ::histogram_statistics::stitch:: {
+	namespace export \
+	reset \
+	add_window \
+	load_files \
+	build \
+	get_info \
+	query \
+	to_histogram
+
+	# list of {left bin_width counts live_s}
+	variable windows [list]
+	# largest grid built, protects against a scan with a tiny bin width over a huge range
+	variable max_grid [expr {1 << 22}]
+	# grid, valid after build
+	variable grid [dict create]
+}
+
+proc ::histogram_statistics::stitch::reset {} {
+	variable windows
+	variable grid
+	set windows [list]
+	set grid [dict create]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<left>      - left bound of the window
+##		<bin_width> - bin width of the window
+##		<counts>    - bin counts
+##		<live_s>    - live time of the window in s
+##		<unsigned>  - representation of the bounds; signed hex bounds are converted as with
+##					  mu3e::helpers:hex2signed (default 0)
+##
+##  Description:
+##  	Adds a window of the scan. The right bound follows from the left bound and the bin width, so a
+##		signed window across the sign change stays contiguous.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::histogram_statistics::stitch::add_window {left bin_width counts live_s {unsigned 0}} {
+	variable windows
+	variable grid
+	if {!$unsigned && [string match -nocase "0x*" $left]} {
+		set left [::mu3e::helpers:hex2signed $left]
+	}
+	if {$live_s <= 0 || $bin_width <= 0} {
+		error "add_window: live time and bin width must be positive, got ${live_s} and ${bin_width}"
+	}
+	lappend windows [list [expr {$left}] [expr {$bin_width}] $counts [expr {double($live_s)}]]
+	set grid [dict create]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<files>  - histogram files of a scan (bin centres on the first line, counts on the second)
+##		<live_s> - live time of every window (default 1.0, the dwell of scan_hist)
+##
+##  Description:
+##  	Adds saved scan windows, e.g. the *_step-N.txt files of scan_hist.
+##
+##	Returns:
+##  	number of windows added
+##
+######################################################################################################
+proc ::histogram_statistics::stitch::load_files {files {live_s 1.0}} {
+	set n 0
+	foreach file_path $files {
+		set fd [open $file_path r]
+		gets $fd bin_mids
+		gets $fd counts
+		close $fd
+		if {[llength $bin_mids] < 2 || [llength $bin_mids] != [llength $counts]} {
+			toolkit_send_message warning "histogram_statistics::stitch: ${file_path} is not a histogram file, skipped"
+			continue
+		}
+		set bin_width [expr {[lindex $bin_mids 1] - [lindex $bin_mids 0]}]
+		if {$bin_width <= 0} {
+			toolkit_send_message warning "histogram_statistics::stitch: ${file_path} has no positive bin width, skipped"
+			continue
+		}
+		::histogram_statistics::stitch::add_window [expr {[lindex $bin_mids 0] - 0.5*$bin_width}] $bin_width $counts $live_s 1
+		incr n
+	}
+	return $n
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Builds the grid: the finest bin width of all windows from the lowest left to the highest right
+##		bound. Every window bin spreads its counts evenly over the grid bins it overlaps, and adds its
+##		live time, weighted by the overlap, to their exposure. The rate of a grid bin is the sum of
+##		counts over the sum of exposure, the Poisson estimate for overlapping windows. Grid bins of no
+##		window are gaps. Called by the queries when needed.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::histogram_statistics::stitch::build {} {
+	variable windows
+	variable max_grid
+	variable grid
+	if {[llength $windows] == 0} {
+		error "build: no window added"
+	}
+	set grid_width ""
+	set grid_left ""
+	set grid_right ""
+	foreach window $windows {
+		lassign $window left bin_width counts
+		set right [expr {$left + [llength $counts]*$bin_width}]
+		if {$grid_width eq "" || $bin_width < $grid_width} {
+			set grid_width $bin_width
+		}
+		if {$grid_left eq "" || $left < $grid_left} {
+			set grid_left $left
+		}
+		if {$grid_right eq "" || $right > $grid_right} {
+			set grid_right $right
+		}
+	}
+	set n_grid [expr {int(ceil(double($grid_right - $grid_left)/$grid_width - 1e-9))}]
+	if {$n_grid > $max_grid} {
+		error "build: grid of ${n_grid} bins exceeds the limit of ${max_grid}"
+	}
+	set contrib [lrepeat $n_grid 0.0]
+	set exposure [lrepeat $n_grid 0.0]
+	set n_cover [lrepeat $n_grid 0]
+	foreach window $windows {
+		lassign $window left bin_width counts live_s
+		set index 0
+		foreach count $counts {
+			set lo [expr {$left + $index*$bin_width}]
+			set hi [expr {$lo + $bin_width}]
+			set first [expr {int(floor(($lo - $grid_left)/double($grid_width)))}]
+			set last [expr {min($n_grid - 1, int(ceil(($hi - $grid_left)/double($grid_width))) - 1)}]
+			for {set k $first} {$k <= $last} {incr k} {
+				set k_lo [expr {$grid_left + $k*$grid_width}]
+				set overlap [expr {min($hi, $k_lo + $grid_width) - max($lo, $k_lo)}]
+				if {$overlap <= 0} {
+					continue
+				}
+				lset contrib $k [expr {[lindex $contrib $k] + $count*$overlap/double($bin_width)}]
+				lset exposure $k [expr {[lindex $exposure $k] + $live_s*$overlap/double($grid_width)}]
+				lset n_cover $k [expr {[lindex $n_cover $k] + 1}]
+			}
+			incr index
+		}
+	}
+	# prefix sums of rate (counts/s) and coverage
+	set prefix_rate [list 0.0]
+	set prefix_cover [list 0]
+	set sum_rate 0.0
+	set sum_cover 0
+	set n_overlap 0
+	foreach c $contrib e $exposure n $n_cover {
+		if {$e > 0} {
+			set sum_rate [expr {$sum_rate + $c/$e}]
+			incr sum_cover
+		}
+		if {$n > 1} {
+			incr n_overlap
+		}
+		lappend prefix_rate $sum_rate
+		lappend prefix_cover $sum_cover
+	}
+	set grid [dict create left $grid_left width $grid_width n $n_grid prefix_rate $prefix_rate \
+		prefix_cover $prefix_cover n_overlap $n_overlap]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Gets the shape of the stitched histogram.
+##
+##	Returns:
+##  	dict with n_window, left, right, bin_width (of the grid), n_bin, n_covered, n_overlap (grid
+##		bins covered by more than one window) and live_s (sum over the windows)
+##
+######################################################################################################
+proc ::histogram_statistics::stitch::get_info {} {
+	variable windows
+	variable grid
+	if {[dict size $grid] == 0} {
+		::histogram_statistics::stitch::build
+	}
+	set live_s 0.0
+	foreach window $windows {
+		set live_s [expr {$live_s + [lindex $window 3]}]
+	}
+	set left [dict get $grid left]
+	return [dict create n_window [llength $windows] left $left \
+		right [expr {$left + [dict get $grid n]*[dict get $grid width]}] bin_width [dict get $grid width] \
+		n_bin [dict get $grid n] n_covered [lindex [dict get $grid prefix_cover] end] \
+		n_overlap [dict get $grid n_overlap] live_s $live_s]
+}
+
+# prefix sum <name> at position x, linear within a grid bin
+proc ::histogram_statistics::stitch::prefix_at {name x} {
+	variable grid
+	set prefix [dict get $grid $name]
+	set u [expr {($x - [dict get $grid left])/double([dict get $grid width])}]
+	set u [expr {max(0.0, min(double([dict get $grid n]), $u))}]
+	set k [expr {int(floor($u))}]
+	set value [lindex $prefix $k]
+	if {$k < [dict get $grid n]} {
+		set value [expr {$value + ($u - $k)*([lindex $prefix [expr {$k + 1}]] - $value)}]
+	}
+	return $value
+}
+
+######################################################################################################
+##  Arguments:
+##		<lo>    - lower edge of the query
+##		<hi>    - upper edge of the query
+##		<n_bin> - number of bins
+##
+##  Description:
+##  	Gets the stitched histogram between lo and hi at any resolution, from the prefix sums.
+##
+##	Returns:
+##  	list of {centre rate coverage}, rate in counts/s in the bin and coverage the fraction of the
+##		bin covered by the scan (0 for a gap)
+##
+######################################################################################################
+proc ::histogram_statistics::stitch::query {lo hi n_bin} {
+	variable grid
+	if {[dict size $grid] == 0} {
+		::histogram_statistics::stitch::build
+	}
+	set width [expr {double($hi - $lo)/$n_bin}]
+	set result [list]
+	set rate_lo [::histogram_statistics::stitch::prefix_at prefix_rate $lo]
+	set cover_lo [::histogram_statistics::stitch::prefix_at prefix_cover $lo]
+	for {set i 0} {$i < $n_bin} {incr i} {
+		set x [expr {$lo + ($i + 1)*$width}]
+		set rate_hi [::histogram_statistics::stitch::prefix_at prefix_rate $x]
+		set cover_hi [::histogram_statistics::stitch::prefix_at prefix_cover $x]
+		lappend result [list [expr {$x - 0.5*$width}] [expr {$rate_hi - $rate_lo}] \
+			[expr {min(1.0, ($cover_hi - $cover_lo)*[dict get $grid width]/$width)}]]
+		set rate_lo $rate_hi
+		set cover_lo $cover_hi
+	}
+	return $result
+}
+
+######################################################################################################
+##  Arguments:
+##		<lo> <hi> <n_bin> - range and resolution, see query
+##
+##  Description:
+##  	Gets a range of the stitched histogram as histogram object, with the rates (counts/s) as bin
+##		contents, e.g. to plot, analyse or export it.
+##
+##	Returns:
+##  	handle of the histogram (see histogram_statistics::histogram)
+##
+######################################################################################################
+proc ::histogram_statistics::stitch::to_histogram {lo hi n_bin} {
+	set rates [list]
+	foreach bin [::histogram_statistics::stitch::query $lo $hi $n_bin] {
+		lappend rates [lindex $bin 1]
+	}
+	return [::histogram_statistics::histogram::create $lo [expr {double($hi - $lo)/$n_bin}] $rates -unsigned 1]
+}
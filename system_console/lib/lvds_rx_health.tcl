@@ -0,0 +1,272 @@
+###########################################################################################################
+# @Name 		lvds_rx_health.tcl
+#
+# @Brief		Lane health engine of the LVDS RX Controller Pro IP core. Turns the per-lane error
+#				counters into error rates with a fast and a slow average (trend), detects bursts and
+#				optionally recovers a lane by soft reset or DPA re-training. Recoveries are rate-limited
+#				per lane and every event is logged, so the engine can run unattended during soak runs.
+#
+# @Functions	configure, reset, update, get_status
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 18, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require mu3e::helpers 	1.0
+package provide lvds_rx::health 	1.0
+
+namespace eval ::lvds_rx::health:: {
+	namespace export \
+	configure \
+	reset \
+	update \
+	get_status
+
+	variable n_lane 9
+	# recovery on burst: "none", "soft_reset" or "dpa_retrain"
+	variable action "none"
+	# a burst is a rate above burst_rate (errors/s) and above burst_factor times the slow average
+	variable burst_rate 10.0
+	variable burst_factor 10.0
+	# time constants (s) of the fast and the slow average
+	variable tau_fast_s 10.0
+	variable tau_slow_s 600.0
+	# recovery limits per lane
+	variable holdoff_s 60.0
+	variable max_actions_per_hour 5
+	variable log_file "lvds_health.log"
+	# copy,lane -> dict of the lane state
+	variable lanes
+	array set lanes {}
+}
+
+######################################################################################################
+##  Arguments:
+##		-n_lane <n>                 - lanes per IP
+##		-action <action>            - none, soft_reset or dpa_retrain
+##		-burst_rate <errors/s>      - absolute burst threshold
+##		-burst_factor <factor>      - burst threshold relative to the slow average
+##		-tau_fast_s / -tau_slow_s   - time constants of the averages
+##		-holdoff_s <s>              - least time between two recoveries of a lane
+##		-max_actions_per_hour <n>   - recoveries of a lane within one hour before giving up
+##		-log_file <path>            - event log, appended to
+##
+##  Description:
+##  	Configures the engine. The lane states are kept.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::lvds_rx::health::configure {args} {
+	foreach {option value} $args {
+		set name [string range $option 1 end]
+		if {[lsearch -exact {n_lane action burst_rate burst_factor tau_fast_s tau_slow_s holdoff_s max_actions_per_hour log_file} $name] < 0} {
+			error "configure: unknown option \"${option}\""
+		}
+		if {$name eq "action" && [lsearch -exact {none soft_reset dpa_retrain} $value] < 0} {
+			error "configure: action must be none, soft_reset or dpa_retrain, got \"${value}\""
+		}
+		variable $name
+		set $name $value
+	}
+	return -code ok
+}
+
+proc ::lvds_rx::health::reset {} {
+	variable lanes
+	array unset lanes
+	return -code ok
+}
+
+proc ::lvds_rx::health::log {level msg} {
+	variable log_file
+	set line "[clock format [clock seconds] -format {%Y-%m-%d %H:%M:%S}] ${level} ${msg}"
+	if {![catch {open $log_file a} fd]} {
+		puts $fd $line
+		close $fd
+	}
+	if {$level ne "info"} {
+		toolkit_send_message $level "lvds_rx::health: ${msg}"
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<copy>  - index of the IP copy
+##		<base>  - base address of the IP (used for recoveries)
+##		<words> - register words of the IP from offset 0x0, at least up to the last error counter
+##		<t>     - time of the reading in s (default: now)
+##
+##  Description:
+##  	Updates all lanes of one IP from one block read. The first reading only sets the reference.
+##		Counters are 32 bit and may wrap. Lanes with lane_go cleared are skipped. A lane that was given
+##		up on stays in this state until reset, so the alarm is not lost in a long run.
+##
+##	Returns:
+##  	list of {lane event} for the bursts, recoveries and alarms of this update
+##
+######################################################################################################
+proc ::lvds_rx::health::update {copy base words {t ""}} {
+	variable n_lane
+	variable lanes
+	variable tau_fast_s
+	variable tau_slow_s
+	variable burst_rate
+	variable burst_factor
+	if {$t eq ""} {
+		set t [expr {[clock milliseconds]/1000.0}]
+	}
+	set lane_go [lindex $words 4]
+	set events [list]
+	for {set lane 0} {$lane < $n_lane} {incr lane} {
+		set counter [lindex $words [expr {5 + $lane}]]
+		if {$counter eq ""} {
+			break
+		}
+		set id "$copy,$lane"
+		if {![info exists lanes($id)]} {
+			set lanes($id) [dict create t $t counter $counter rate 0.0 fast 0.0 slow 0.0 total 0 \
+				state "ok" actions [list] n_burst 0]
+			continue
+		}
+		set state $lanes($id)
+		set dt [expr {$t - [dict get $state t]}]
+		if {$dt <= 0} {
+			continue
+		}
+		set delta [expr {($counter - [dict get $state counter]) & 0xffffffff}]
+		set rate [expr {$delta/$dt}]
+		# exponential averages with the time constants, independent of the polling period
+		set a_fast [expr {1.0 - exp(-$dt/$tau_fast_s)}]
+		set a_slow [expr {1.0 - exp(-$dt/$tau_slow_s)}]
+		set slow_before [dict get $state slow]
+		dict set state t $t
+		dict set state counter $counter
+		dict set state rate $rate
+		dict set state fast [expr {[dict get $state fast] + $a_fast*($rate - [dict get $state fast])}]
+		dict set state slow [expr {$slow_before + $a_slow*($rate - $slow_before)}]
+		dict set state total [expr {[dict get $state total] + $delta}]
+		# a stopped lane does not deliver data, its counter is meaningless
+		if {$lane_go ne "" && !(($lane_go >> $lane) & 1)} {
+			set lanes($id) $state
+			continue
+		}
+		if {$rate > $burst_rate && $rate > $burst_factor*$slow_before} {
+			dict incr state n_burst
+			if {[dict get $state state] eq "ok"} {
+				::lvds_rx::health::log warning [format "copy %d lane %d: error burst, %.1f errors/s (slow average %.2f)" \
+					$copy $lane $rate $slow_before]
+				lappend events [list $lane "burst"]
+			}
+			set state [::lvds_rx::health::recover $copy $lane $base $state $t events]
+			if {[dict get $state state] eq "ok"} {
+				dict set state state "burst"
+			}
+		} elseif {[dict get $state state] eq "burst" || [dict get $state state] eq "recovering"} {
+			::lvds_rx::health::log info [format "copy %d lane %d: back to normal, %.1f errors/s" $copy $lane $rate]
+			lappend events [list $lane "ok"]
+			dict set state state "ok"
+		}
+		set lanes($id) $state
+	}
+	return $events
+}
+
+######################################################################################################
+##  Arguments:
+##		<copy> <lane> <base> - lane to recover
+##		<state>              - lane state
+##		<t>                  - current time (s)
+##		<eventsVar>          - name of the event list of the caller
+##
+##  Description:
+##  	Applies the configured recovery if the lane is outside of its holdoff and has not exhausted
+##		its recoveries of the last hour, otherwise raises an alarm once and gives up on the lane.
+##		soft_reset requests the self-clearing soft reset of the lane, dpa_retrain releases dpa_hold
+##		and restarts the training by toggling lane_go.
+##
+##	Returns:
+##  	updated lane state
+##
+######################################################################################################
+proc ::lvds_rx::health::recover {copy lane base state t eventsVar} {
+	variable action
+	variable holdoff_s
+	variable max_actions_per_hour
+	upvar 1 $eventsVar events
+	if {$action eq "none" || [dict get $state state] eq "gave_up"} {
+		return $state
+	}
+	set recent [list]
+	foreach t_action [dict get $state actions] {
+		if {$t - $t_action < 3600} {
+			lappend recent $t_action
+		}
+	}
+	dict set state actions $recent
+	if {[llength $recent] != 0 && $t - [lindex $recent end] < $holdoff_s} {
+		return $state
+	}
+	if {[llength $recent] >= $max_actions_per_hour} {
+		::lvds_rx::health::log error [format "copy %d lane %d: %d recoveries within the last hour did not help, giving up on this lane" \
+			$copy $lane [llength $recent]]
+		lappend events [list $lane "gave_up"]
+		dict set state state "gave_up"
+		return $state
+	}
+	set master_fd [::mu3e::helpers::cget_opened_master_path]
+	set mask [expr {1 << $lane}]
+	switch -- $action {
+		soft_reset {
+			master_write_32 $master_fd [expr {$base + 0x8}] [format 0x%08x $mask]
+		}
+		dpa_retrain {
+			set dpa_hold [master_read_32 $master_fd [expr {$base + 0xc}] 1]
+			master_write_32 $master_fd [expr {$base + 0xc}] [format 0x%08x [expr {$dpa_hold & ~$mask & 0xffffffff}]]
+			set lane_go [master_read_32 $master_fd [expr {$base + 0x10}] 1]
+			master_write_32 $master_fd [expr {$base + 0x10}] [format 0x%08x [expr {$lane_go & ~$mask & 0xffffffff}]]
+			master_write_32 $master_fd [expr {$base + 0x10}] [format 0x%08x [expr {$lane_go | $mask}]]
+		}
+	}
+	dict lappend state actions $t
+	dict set state state "recovering"
+	::lvds_rx::health::log warning [format "copy %d lane %d: %s issued (%d within the last hour)" \
+		$copy $lane $action [llength [dict get $state actions]]]
+	lappend events [list $lane $action]
+	return $state
+}
+
+######################################################################################################
+##  Arguments:
+##		<copy> - index of the IP copy
+##
+##  Description:
+##  	Gets the health of all lanes of one IP copy.
+##
+##	Returns:
+##  	list of {lane state rate fast slow trend total n_burst n_action}, rates in errors/s and trend
+##		the fast over the slow average (1 = steady)
+##
+######################################################################################################
+proc ::lvds_rx::health::get_status {copy} {
+	variable n_lane
+	variable lanes
+	set result [list]
+	for {set lane 0} {$lane < $n_lane} {incr lane} {
+		if {![info exists lanes($copy,$lane)]} {
+			continue
+		}
+		set state $lanes($copy,$lane)
+		set fast [dict get $state fast]
+		set slow [dict get $state slow]
+		set trend [expr {$slow > 0 ? $fast/$slow : ($fast > 0 ? "inf" : 1.0)}]
+		lappend result [list $lane [dict get $state state] [dict get $state rate] $fast $slow $trend \
+			[dict get $state total] [dict get $state n_burst] [llength [dict get $state actions]]]
+	}
+	return $result
+}
@@ -0,0 +1,448 @@
+###########################################################################################################
+# @Name 		lvds_rx_sweep.tcl
+#
+# @Brief		Eye/phase characterisation sweep of the LVDS RX Controller Pro IP core. Sweeps the
+#				combinations of lane soft reset, DPA hold and alignment mode on all lanes in parallel,
+#				integrates the error counters for a dwell time per point and builds a per-lane quality
+#				matrix. The lanes are split into interleaved groups whose dwells are staggered, so the
+#				counter reads of one group happen while the others integrate. The run is stored in a
+#				compact binary result file.
+#
+# @Functions	configure, start, cancel, is_running, get_matrix, write_result, read_result
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 18, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require mu3e::helpers 	1.0
+package provide lvds_rx::sweep 	1.0
+
+namespace eval ::lvds_rx::sweep:: {
+	namespace export \
+	configure \
+	start \
+	cancel \
+	is_running \
+	get_matrix \
+	write_result \
+	read_result
+
+	variable n_lane 9
+	variable base 0x0
+	variable dwell_ms 1000
+	# wait after applying a point before the integration starts (reset and training)
+	variable settle_ms 100
+	variable n_group 2
+	# sweep points {reset hold mode}, default: all combinations
+	variable points [list]
+	foreach reset {0 1} {
+		foreach hold {0 1} {
+			foreach mode {0 1} {
+				lappend points [list $reset $hold $mode]
+			}
+		}
+	}
+	unset reset hold mode
+	variable running 0
+	variable after_ids [list]
+	variable done_callback ""
+	variable progress_callback ""
+	# registers at the start of the run {mode_mask dpa_hold lane_go}, restored at the end
+	variable saved_regs [list]
+	# group -> {point_index start_counters t_start mode_mask}
+	variable group_state
+	# lane,point -> {flags errors elapsed_us}, flags: bit0 reset, bit1 hold, bit2 mode, bit3 mode not applied
+	variable result
+	variable t_run 0
+	array set group_state {}
+	array set result {}
+}
+
+######################################################################################################
+##  Arguments:
+##		-n_lane <n>       - lanes of the IP
+##		-base <addr>      - base address of the IP
+##		-dwell_ms <ms>    - integration time per point
+##		-settle_ms <ms>   - wait between applying a point and the start of the integration
+##		-n_group <n>      - number of interleaved lane groups (lane i is in group i % n_group)
+##		-points <list>    - list of {reset hold mode}, see above
+##
+##  Description:
+##  	Configures the sweep. Not allowed while a sweep is running.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::lvds_rx::sweep::configure {args} {
+	variable running
+	if {$running} {
+		error "configure: a sweep is running"
+	}
+	foreach {option value} $args {
+		switch -- $option {
+			-n_lane - -base - -dwell_ms - -settle_ms - -n_group - -points {
+				variable [string range $option 1 end]
+				set [string range $option 1 end] $value
+			}
+			default {
+				error "configure: unknown option \"${option}\", must be -n_lane, -base, -dwell_ms, -settle_ms, -n_group or -points"
+			}
+		}
+	}
+	return -code ok
+}
+
+proc ::lvds_rx::sweep::is_running {} {
+	variable running
+	return $running
+}
+
+######################################################################################################
+##  Arguments:
+##		-done <cmd>     - called when the sweep ends, with 1 if it completed and 0 if cancelled
+##		-progress <cmd> - called after every measured point with the number of done and total
+##						  lane-points
+##
+##  Description:
+##  	Starts the sweep in the background (event loop), returns immediately. The mode_mask, dpa_hold
+##		and lane_go registers are saved and restored at the end. The mode_mask field is read-only in
+##		some firmware versions, the mode actually seen during the integration is recorded.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::lvds_rx::sweep::start {args} {
+	variable running
+	variable done_callback
+	variable progress_callback
+	variable n_group
+	variable n_lane
+	variable dwell_ms
+	variable base
+	variable saved_regs
+	variable group_state
+	variable result
+	variable t_run
+	if {$running} {
+		error "start: a sweep is running"
+	}
+	set done_callback ""
+	set progress_callback ""
+	foreach {option value} $args {
+		switch -- $option {
+			-done {
+				set done_callback $value
+			}
+			-progress {
+				set progress_callback $value
+			}
+			default {
+				error "start: unknown option \"${option}\", must be -done or -progress"
+			}
+		}
+	}
+	set n_group [expr {max(1, min($n_group, $n_lane))}]
+	set master_fd [::mu3e::helpers::cget_opened_master_path]
+	set saved_regs [master_read_32 $master_fd [expr {$base + 0x4}] 1]
+	lappend saved_regs [master_read_32 $master_fd [expr {$base + 0xc}] 1]
+	lappend saved_regs [master_read_32 $master_fd [expr {$base + 0x10}] 1]
+	array unset group_state
+	array unset result
+	set t_run [clock seconds]
+	set running 1
+	# stagger the groups over one dwell
+	for {set group 0} {$group < $n_group} {incr group} {
+		set group_state($group) [list 0 {} 0 0]
+		::lvds_rx::sweep::schedule [expr {$group*$dwell_ms/$n_group}] [list ::lvds_rx::sweep::apply_point $group]
+	}
+	return -code ok
+}
+
+proc ::lvds_rx::sweep::cancel {} {
+	variable running
+	variable after_ids
+	if {!$running} {
+		return -code ok
+	}
+	foreach id $after_ids {
+		after cancel $id
+	}
+	::lvds_rx::sweep::finish 0
+	return -code ok
+}
+
+proc ::lvds_rx::sweep::schedule {ms script} {
+	variable after_ids
+	set id [after $ms [list ::lvds_rx::sweep::run_stage $script]]
+	lappend after_ids $id
+	return $id
+}
+
+# runs a scheduled stage, an error stops the sweep (registers restored) instead of leaving it running
+proc ::lvds_rx::sweep::run_stage {script} {
+	variable running
+	variable after_ids
+	# forget the ids that have fired, this one included
+	set pending [after info]
+	set ids [list]
+	foreach id $after_ids {
+		if {[lsearch -exact $pending $id] >= 0} {
+			lappend ids $id
+		}
+	}
+	set after_ids $ids
+	if {!$running} {
+		return -code ok
+	}
+	if {[catch {uplevel #0 $script} error_msg]} {
+		toolkit_send_message error "lvds_rx::sweep: [lindex $script 0] failed, sweep stopped: $error_msg"
+		::lvds_rx::sweep::cancel
+	}
+	return -code ok
+}
+
+proc ::lvds_rx::sweep::group_mask {group} {
+	variable n_lane
+	variable n_group
+	set mask 0
+	for {set lane $group} {$lane < $n_lane} {incr lane $n_group} {
+		set mask [expr {$mask | (1 << $lane)}]
+	}
+	return $mask
+}
+
+# read-modify-write of the group bits of one register
+proc ::lvds_rx::sweep::write_bits {offset mask value} {
+	variable base
+	set master_fd [::mu3e::helpers::cget_opened_master_path]
+	set word [master_read_32 $master_fd [expr {$base + $offset}] 1]
+	if {$value} {
+		set word [expr {$word | $mask}]
+	} else {
+		set word [expr {$word & ~$mask & 0xffffffff}]
+	}
+	master_write_32 $master_fd [expr {$base + $offset}] [format 0x%08x $word]
+	return -code ok
+}
+
+# one transaction for all error counters
+proc ::lvds_rx::sweep::read_counters {} {
+	variable base
+	variable n_lane
+	set master_fd [::mu3e::helpers::cget_opened_master_path]
+	return [master_read_32 $master_fd [expr {$base + 0x14}] $n_lane]
+}
+
+######################################################################################################
+##  Arguments:
+##		<group> - lane group
+##
+##  Description:
+##  	Pipeline stages of one group: apply_point sets the point on the lanes of the group and waits for the
+##		settle time, begin_dwell reads the counters and waits for the dwell, end_dwell reads them again, stores
+##		the errors of every lane of the group and applies the next point.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::lvds_rx::sweep::apply_point {group} {
+	variable points
+	variable settle_ms
+	variable group_state
+	variable base
+	lassign $group_state($group) index
+	set mask [::lvds_rx::sweep::group_mask $group]
+	lassign [lindex $points $index] reset hold mode
+	::lvds_rx::sweep::write_bits 0x4 $mask $mode
+	::lvds_rx::sweep::write_bits 0xc $mask $hold
+	::lvds_rx::sweep::write_bits 0x10 $mask 1
+	if {$reset} {
+		# self-clearing, only the group bits are requested
+		master_write_32 [::mu3e::helpers::cget_opened_master_path] [expr {$base + 0x8}] [format 0x%08x $mask]
+	}
+	::lvds_rx::sweep::schedule $settle_ms [list ::lvds_rx::sweep::begin_dwell $group]
+	return -code ok
+}
+
+proc ::lvds_rx::sweep::begin_dwell {group} {
+	variable group_state
+	variable dwell_ms
+	variable base
+	set mode_mask [master_read_32 [::mu3e::helpers::cget_opened_master_path] [expr {$base + 0x4}] 1]
+	set group_state($group) [list [lindex $group_state($group) 0] [::lvds_rx::sweep::read_counters] \
+		[clock microseconds] $mode_mask]
+	::lvds_rx::sweep::schedule $dwell_ms [list ::lvds_rx::sweep::end_dwell $group]
+	return -code ok
+}
+
+proc ::lvds_rx::sweep::end_dwell {group} {
+	variable group_state
+	variable points
+	variable result
+	variable n_lane
+	variable n_group
+	variable progress_callback
+	set counters [::lvds_rx::sweep::read_counters]
+	set elapsed_us [expr {[clock microseconds] - [lindex $group_state($group) 2]}]
+	lassign $group_state($group) index counters_start t_start mode_mask
+	lassign [lindex $points $index] reset hold mode
+	for {set lane $group} {$lane < $n_lane} {incr lane $n_group} {
+		set errors [expr {([lindex $counters $lane] - [lindex $counters_start $lane]) & 0xffffffff}]
+		set flags [expr {$reset | ($hold << 1) | ($mode << 2)}]
+		if {(($mode_mask >> $lane) & 1) != $mode} {
+			set flags [expr {$flags | 0x8}]
+		}
+		set result($lane,$index) [list $flags $errors $elapsed_us]
+	}
+	if {$progress_callback ne ""} {
+		{*}$progress_callback [array size result] [expr {$n_lane*[llength $points]}]
+	}
+	incr index
+	if {$index < [llength $points]} {
+		set group_state($group) [list $index {} 0 0]
+		::lvds_rx::sweep::apply_point $group
+		return -code ok
+	}
+	unset group_state($group)
+	if {[array size group_state] == 0} {
+		::lvds_rx::sweep::finish 1
+	}
+	return -code ok
+}
+
+proc ::lvds_rx::sweep::finish {completed} {
+	variable running
+	variable after_ids
+	variable saved_regs
+	variable base
+	variable done_callback
+	# stopped first, so a failing restore or callback cannot leave the sweep marked as running
+	set after_ids [list]
+	set running 0
+	if {[catch {
+		set master_fd [::mu3e::helpers::cget_opened_master_path]
+		lassign $saved_regs mode_mask dpa_hold lane_go
+		master_write_32 $master_fd [expr {$base + 0x4}] $mode_mask
+		master_write_32 $master_fd [expr {$base + 0xc}] $dpa_hold
+		master_write_32 $master_fd [expr {$base + 0x10}] $lane_go
+	} error_msg]} {
+		toolkit_send_message error "lvds_rx::sweep: restoring the registers failed: $error_msg"
+	}
+	if {$done_callback ne ""} {
+		if {[catch {{*}$done_callback $completed} error_msg]} {
+			toolkit_send_message error "lvds_rx::sweep: done callback failed: $error_msg"
+		}
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Gets the quality matrix of the last sweep: the error rate of every lane at every point.
+##
+##	Returns:
+##  	list of rows {lane rate_point0 rate_point1 ... best_point}, rates in errors/s, "-" for points
+##		not measured. best_point is the point with the lowest rate.
+##
+######################################################################################################
+proc ::lvds_rx::sweep::get_matrix {} {
+	variable n_lane
+	variable points
+	variable result
+	set rows [list]
+	for {set lane 0} {$lane < $n_lane} {incr lane} {
+		set row [list $lane]
+		set best ""
+		set best_rate ""
+		for {set index 0} {$index < [llength $points]} {incr index} {
+			if {![info exists result($lane,$index)]} {
+				lappend row "-"
+				continue
+			}
+			lassign $result($lane,$index) flags errors elapsed_us
+			set rate [expr {$elapsed_us > 0 ? $errors*1.0e6/$elapsed_us : 0.0}]
+			lappend row $rate
+			if {$best_rate eq "" || $rate < $best_rate} {
+				set best $index
+				set best_rate $rate
+			}
+		}
+		lappend row $best
+		lappend rows $row
+	}
+	return $rows
+}
+
+######################################################################################################
+##  Arguments:
+##		<file_path> - result file to write
+##
+##  Description:
+##  	Writes the last sweep as binary file, little endian:
+##		header "LVSWP001", n_lane (i), n_point (i), dwell_ms (i), settle_ms (i), start time (w),
+##		then one 12 byte record per lane and point: lane (c), point (c), flags (c), pad (x),
+##		errors (i), elapsed_us (i).
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::lvds_rx::sweep::write_result {file_path} {
+	variable n_lane
+	variable points
+	variable dwell_ms
+	variable settle_ms
+	variable result
+	variable t_run
+	set fd [open $file_path w]
+	fconfigure $fd -translation binary
+	puts -nonewline $fd "LVSWP001"
+	puts -nonewline $fd [binary format iiiiw $n_lane [llength $points] $dwell_ms $settle_ms $t_run]
+	foreach id [lsort -dictionary [array names result]] {
+		lassign [split $id ","] lane index
+		lassign $result($id) flags errors elapsed_us
+		puts -nonewline $fd [binary format cccxii $lane $index $flags $errors $elapsed_us]
+	}
+	close $fd
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<file_path> - result file written by write_result
+##
+##  Description:
+##  	Reads a result file back.
+##
+##	Returns:
+##  	dict with n_lane, n_point, dwell_ms, settle_ms, t_run and records, a list of
+##		{lane point reset hold mode mode_not_applied errors elapsed_us}
+##
+######################################################################################################
+proc ::lvds_rx::sweep::read_result {file_path} {
+	set fd [open $file_path r]
+	fconfigure $fd -translation binary
+	set data [read $fd]
+	close $fd
+	if {[string range $data 0 7] ne "LVSWP001"} {
+		error "read_result: ${file_path} is not a sweep result file"
+	}
+	binary scan $data @8iiiiw n_lane n_point dwell_ms settle_ms t_run
+	set records [list]
+	for {set offset 32} {$offset + 12 <= [string length $data]} {incr offset 12} {
+		binary scan $data @${offset}cucucuxiuiu lane index flags errors elapsed_us
+		lappend records [list $lane $index [expr {$flags & 1}] [expr {($flags >> 1) & 1}] \
+			[expr {($flags >> 2) & 1}] [expr {($flags >> 3) & 1}] $errors $elapsed_us]
+	}
+	return [dict create n_lane $n_lane n_point $n_point dwell_ms $dwell_ms settle_ms $settle_ms \
+		t_run $t_run records $records]
+}
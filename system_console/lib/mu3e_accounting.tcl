@@ -0,0 +1,518 @@
+###########################################################################################################
+# @Name 		mu3e_accounting.tcl
+#
+# @Brief		Hit accounting along the data path IP chain: channel counters (counter_avmm), MuTRiG
+#				Timestamp Processor, resequencing buffer (ring_buffer_cam) and frame assembly. Takes
+#				snapshots of all hit counters in one batched readout, assembles the 48 bit hi/lo pairs
+#				safely, and turns consecutive snapshots into per-stage throughput and loss, so it shows
+#				where in the chain hits disappear under load.
+#
+# @Functions	configure, snapshot, deltas, chain, start, stop, is_running, reset, analyse, get_history, get_stats
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 23, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require mu3e::helpers 	1.0
+package require mu3e::monitor 	1.0
+package provide mu3e::accounting 	1.0
+
+namespace eval ::mu3e::accounting:: {
+	namespace export \
+	configure \
+	snapshot \
+	start \
+	stop \
+	is_running \
+	reset \
+	deltas \
+	chain \
+	analyse \
+	get_history \
+	get_stats
+
+	# base addresses of every copy, per stage
+	variable counter_bases [list]
+	variable deassembly_bases [list]
+	variable mts_bases [list]
+	variable cam_bases [list]
+	variable assembly_bases [list]
+	variable n_channel 32
+	# channel counters: "delta" (free running) or "gated" (counts of one gate), as counter_avmm::history
+	variable counter_mode "delta"
+	variable gate_s 1.0
+	# a low word below this is close enough to its wrap to re-read the high word
+	variable carry_window [expr {1 << 24}]
+	# loss fraction above which a stage is flagged
+	variable loss_threshold 0.01
+	# samples kept in the history
+	variable depth 3600
+	variable period_ms 1000
+	variable running 0
+	variable after_id ""
+	variable update_callback ""
+	# last snapshot, see snapshot
+	variable last [dict create]
+	# list of {t dt deltas}, oldest first
+	variable history [list]
+	# n_snapshot n_read n_carry
+	variable stats [list 0 0 0]
+	# counters of a snapshot, the 48 bit ones and the frame deassembly error counters
+	variable counter_names {channel deasm_crc deasm_bad mts_in mts_discard cam_push cam_pop cam_overwrite cam_miss asm_declared asm_actual asm_missing}
+	variable wide_names {mts_in asm_declared asm_actual asm_missing}
+}
+
+######################################################################################################
+##  Arguments:
+##		-counter_bases <list>  - base addresses of the counter_avmm copies (one per asic)
+##		-deassembly_bases <list> - base addresses of the mutrig_frame_deassembly copies (optional)
+##		-mts_bases <list>      - base addresses of the mts_processor copies
+##		-cam_bases <list>      - base addresses of the ring_buffer_cam copies
+##		-assembly_bases <list> - base addresses of the feb_frame_assembly copies
+##		-n_channel <n>         - channels per counter_avmm copy (default 32)
+##		-counter_mode <mode>   - "delta" (default) or "gated", see counter_avmm::history
+##		-gate_s <s>            - gate length of the "gated" mode (default 1.0)
+##		-loss_threshold <f>    - loss fraction that flags a stage (default 0.01)
+##		-depth <n>             - samples kept in the history (default 3600)
+##		-period_ms <ms>        - snapshot period of start (default 1000)
+##
+##  Description:
+##  	Configures the engine. A change of the copies resets the history.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::accounting::configure {args} {
+	set names {counter_bases deassembly_bases mts_bases cam_bases assembly_bases n_channel counter_mode gate_s loss_threshold depth period_ms}
+	set layout_changed 0
+	foreach {option value} $args {
+		set name [string range $option 1 end]
+		if {[lsearch -exact $names $name] < 0} {
+			error "configure: unknown option \"${option}\", must be one of -[join $names {, -}]"
+		}
+		if {$name eq "counter_mode" && $value ne "delta" && $value ne "gated"} {
+			error "configure: counter mode must be delta or gated, got \"${value}\""
+		}
+		variable $name
+		if {[string match "*_bases" $name] || $name eq "n_channel"} {
+			set layout_changed 1
+		}
+		set $name $value
+	}
+	if {$layout_changed} {
+		::mu3e::accounting::reset
+	}
+	return -code ok
+}
+
+proc ::mu3e::accounting::reset {} {
+	variable last
+	variable history
+	variable stats
+	set last [dict create]
+	set history [list]
+	set stats [list 0 0 0]
+	return -code ok
+}
+
+proc ::mu3e::accounting::is_running {} {
+	variable running
+	return $running
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Reads all hit counters of the chain. The register blocks of all copies are merged into as few
+##		block reads as possible (see mu3e::monitor::merge_intervals) and issued back to back, so the
+##		counters of all stages are taken within the time of one batch. The 48 bit counters are read
+##		high word first; a low word close to its wrap may have carried after the high word was read,
+##		so only then the high word is read again and taken if it moved on by one.
+##
+##	Returns:
+##  	dict with t (s, middle of the batch), skew_s (duration of the batch) and, per copy lists,
+##		channel (counters of all channels of one asic), deasm_crc, deasm_bad, mts_in, mts_discard, cam_push, cam_pop,
+##		cam_overwrite, cam_miss, asm_declared, asm_actual and asm_missing
+##
+######################################################################################################
+proc ::mu3e::accounting::snapshot {} {
+	variable counter_bases
+	variable deassembly_bases
+	variable mts_bases
+	variable cam_bases
+	variable assembly_bases
+	variable n_channel
+	variable stats
+	variable counter_names
+	# stage -> {bases span}
+	set blocks [dict create channel [list $counter_bases [expr {4*$n_channel}]] deasm [list $deassembly_bases 0xc] \
+		mts [list $mts_bases 0x14] \
+		cam [list $cam_bases 0x20] asm [list $assembly_bases 0x20]]
+	set intervals [list]
+	dict for {stage block} $blocks {
+		lassign $block bases span
+		foreach base $bases {
+			lappend intervals [list [expr {$base}] [expr {$base + $span}]]
+		}
+	}
+	lassign $stats n_snapshot n_read n_carry
+	set master_fd [::mu3e::helpers::cget_opened_master_path]
+	set reads [list]
+	set t_start_us [clock microseconds]
+	foreach interval [::mu3e::monitor::merge_intervals $intervals] {
+		lassign $interval start end
+		lappend reads [list $start [master_read_32 $master_fd $start [expr {($end - $start)/4}]]]
+		incr n_read
+	}
+	set t_end_us [clock microseconds]
+	# word at a byte address out of the batch
+	set word_at [list apply {{reads address} {
+		foreach block $reads {
+			lassign $block start words
+			set index [expr {($address - $start)/4}]
+			if {$index >= 0 && $index < [llength $words]} {
+				return [expr {[lindex $words $index] & 0xffffffff}]
+			}
+		}
+		error "snapshot: address [format 0x%x $address] not read"
+	}} $reads]
+	set result [dict create t [expr {($t_start_us + $t_end_us)*0.5e-6}] skew_s [expr {($t_end_us - $t_start_us)*1.0e-6}]]
+	foreach name $counter_names {
+		dict set result $name [list]
+	}
+	foreach base $counter_bases {
+		set counters [list]
+		for {set ch 0} {$ch < $n_channel} {incr ch} {
+			lappend counters [{*}$word_at [expr {$base + 4*$ch}]]
+		}
+		dict lappend result channel $counters
+	}
+	foreach base $deassembly_bases {
+		dict lappend result deasm_crc [{*}$word_at [expr {$base + 0x4}]]
+		dict lappend result deasm_bad [{*}$word_at [expr {$base + 0x8}]]
+	}
+	foreach base $mts_bases {
+		dict lappend result mts_discard [{*}$word_at [expr {$base + 0x4}]]
+		lassign [::mu3e::accounting::read_pair $master_fd $word_at [expr {$base + 0xc}] [expr {$base + 0x10}] 0xffff] value carried
+		dict lappend result mts_in $value
+		incr n_carry $carried
+	}
+	foreach base $cam_bases {
+		foreach name {cam_push cam_pop cam_overwrite cam_miss} offset {0x10 0x14 0x18 0x1c} {
+			dict lappend result $name [{*}$word_at [expr {$base + $offset}]]
+		}
+	}
+	foreach base $assembly_bases {
+		foreach name {asm_declared asm_actual asm_missing} offset {0x8 0x10 0x18} {
+			lassign [::mu3e::accounting::read_pair $master_fd $word_at [expr {$base + $offset}] [expr {$base + $offset + 4}] 0xffff] value carried
+			dict lappend result $name $value
+			incr n_carry $carried
+		}
+	}
+	incr n_snapshot
+	set stats [list $n_snapshot $n_read $n_carry]
+	return $result
+}
+
+# value of a hi/lo counter pair of the batch, {value carried}
+proc ::mu3e::accounting::read_pair {master_fd word_at hi_address lo_address hi_mask} {
+	variable carry_window
+	set hi [expr {[{*}$word_at $hi_address] & $hi_mask}]
+	set lo [{*}$word_at $lo_address]
+	set carried 0
+	if {$lo < $carry_window} {
+		set hi_again [expr {[master_read_32 $master_fd $hi_address 1] & $hi_mask}]
+		# the low word wrapped between the two reads of the batch
+		if {$hi_again == (($hi + 1) & $hi_mask)} {
+			set hi $hi_again
+			set carried 1
+		}
+	}
+	return [list [expr {($hi << 32) | $lo}] $carried]
+}
+
+######################################################################################################
+##  Arguments:
+##		<previous>  - previous snapshot
+##		<current>   - current snapshot
+##		<dt>        - time between the two in s
+##
+##  Description:
+##  	Differences of two snapshots, summed over the copies. 32 bit counters wrap at 2^32, the
+##		48 bit ones at 2^48. In "gated" mode the channel counters are taken as counts per gate.
+##
+##	Returns:
+##  	dict of counts per name (see snapshot)
+##
+######################################################################################################
+proc ::mu3e::accounting::deltas {previous current dt} {
+	variable counter_mode
+	variable gate_s
+	variable counter_names
+	variable wide_names
+	set result [dict create]
+	foreach name $counter_names {
+		set mask [expr {$name in $wide_names ? 0xffffffffffff : 0xffffffff}]
+		set sum 0
+		# channel counters wrap one by one
+		set current_words [dict get $current $name]
+		set previous_words [dict get $previous $name]
+		if {$name eq "channel"} {
+			set current_words [concat {*}$current_words]
+			set previous_words [concat {*}$previous_words]
+		}
+		foreach now $current_words before $previous_words {
+			if {$name eq "channel" && $counter_mode eq "gated"} {
+				incr sum [expr {round($now*$dt/$gate_s)}]
+			} else {
+				incr sum [expr {($now - $before) & $mask}]
+			}
+		}
+		dict set result $name $sum
+	}
+	return $result
+}
+
+######################################################################################################
+##  Arguments:
+##		-update <cmd> - called after every snapshot (except the first, which is the reference)
+##
+##  Description:
+##  	Takes a snapshot every period_ms in the background and adds the differences to the history.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::accounting::start {args} {
+	variable running
+	variable update_callback
+	variable last
+	if {$running} {
+		error "start: accounting is running"
+	}
+	set update_callback ""
+	foreach {option value} $args {
+		switch -- $option {
+			-update {
+				set update_callback $value
+			}
+			default {
+				error "start: unknown option \"${option}\", must be -update"
+			}
+		}
+	}
+	set running 1
+	set last [dict create]
+	::mu3e::accounting::tick
+	return -code ok
+}
+
+proc ::mu3e::accounting::stop {} {
+	variable running
+	variable after_id
+	if {$running} {
+		after cancel $after_id
+		set running 0
+	}
+	return -code ok
+}
+
+proc ::mu3e::accounting::tick {} {
+	variable running
+	variable after_id
+	variable period_ms
+	variable update_callback
+	if {[catch {::mu3e::accounting::add_snapshot [::mu3e::accounting::snapshot]} added]} {
+		toolkit_send_message error "mu3e::accounting: snapshot failed, stopped: $added"
+		set running 0
+		return -code ok
+	}
+	if {$added && $update_callback ne ""} {
+		if {[catch {{*}$update_callback} msg]} {
+			toolkit_send_message error "mu3e::accounting: update callback failed: $msg"
+		}
+	}
+	set after_id [after $period_ms ::mu3e::accounting::tick]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<current> - snapshot (see snapshot)
+##
+##  Description:
+##  	Adds the differences to the previous snapshot to the history. The first snapshot after a
+##		reset only sets the reference.
+##
+##	Returns:
+##  	1 if a sample was added, 0 for the reference
+##
+######################################################################################################
+proc ::mu3e::accounting::add_snapshot {current} {
+	variable last
+	variable history
+	variable depth
+	set added 0
+	if {[dict size $last] != 0} {
+		set dt [expr {[dict get $current t] - [dict get $last t]}]
+		if {$dt > 0} {
+			lappend history [list [dict get $current t] $dt [::mu3e::accounting::deltas $last $current $dt]]
+			if {[llength $history] > $depth} {
+				set history [lrange $history end-[expr {$depth - 1}] end]
+			}
+			set added 1
+		}
+	}
+	set last $current
+	return $added
+}
+
+######################################################################################################
+##  Arguments:
+##		<window_s> - time window to analyse, counted back from the last sample (default 10)
+##
+##  Description:
+##  	Per-stage throughput and loss over the window. The chain is
+##		   channel counters -> mts_processor ingress -(discard)-> ring_buffer_cam push
+##		   -(overwrite, cache miss)-> ring_buffer_cam pop -> feb_frame_assembly actual (missing)
+##		Transfer loss is the fraction of the upstream output that does not arrive at the stage, internal
+##		loss the fraction the stage drops itself by its own counters. Summing over the window evens out
+##		the hits in flight between the stages. The first stage with a loss above loss_threshold is
+##		where hits disappear.
+##
+##	Returns:
+##  	dict with rows (list of {stage rate_in rate_out transfer_loss internal_loss flag}, rates in
+##		hits/s, losses as fractions, "" where not defined), first, verdict (text), crc_rate,
+##		bad_frame_rate (see chain) and time_s
+##
+######################################################################################################
+proc ::mu3e::accounting::analyse {{window_s 10}} {
+	variable history
+	if {[llength $history] == 0} {
+		return [dict create rows [list] first -1 verdict "no samples yet"]
+	}
+	set t_last [lindex $history end 0]
+	set sum [dict create]
+	set time 0.0
+	foreach sample [lreverse $history] {
+		lassign $sample t dt deltas
+		if {$t_last - $t >= $window_s} {
+			break
+		}
+		set time [expr {$time + $dt}]
+		dict for {name count} $deltas {
+			dict incr sum $name $count
+		}
+	}
+	set result [::mu3e::accounting::chain $sum $time]
+	dict set result time_s $time
+	return $result
+}
+
+######################################################################################################
+##  Arguments:
+##		<sum>    - counts per name (see deltas), summed over a time
+##		<time_s> - the time in s
+##
+##  Description:
+##  	Per-stage throughput and loss of the counts, see analyse.
+##
+##	Returns:
+##  	dict with rows, first (index of the first flagged stage, -1 if none), verdict and the frame
+##		deassembly error rates crc_rate and bad_frame_rate
+##
+######################################################################################################
+proc ::mu3e::accounting::chain {sum time_s} {
+	variable loss_threshold
+	foreach name [dict keys $sum] {
+		set rate($name) [expr {[dict get $sum $name]/$time_s}]
+	}
+	set chain [list \
+		[list "channel counters" "" $rate(channel) $rate(channel) ""] \
+		[list "mts_processor" $rate(channel) $rate(mts_in) [expr {$rate(mts_in) - $rate(mts_discard)}] $rate(mts_discard)] \
+		[list "ring_buffer_cam" [expr {$rate(mts_in) - $rate(mts_discard)}] $rate(cam_push) $rate(cam_pop) \
+			[expr {$rate(cam_overwrite) + $rate(cam_miss)}]] \
+		[list "feb_frame_assembly" $rate(cam_pop) $rate(asm_actual) $rate(asm_actual) $rate(asm_missing)]]
+	set rows [list]
+	set verdict ""
+	set first -1
+	foreach stage $chain {
+		lassign $stage name upstream rate_in rate_out dropped
+		set transfer_loss ""
+		if {$upstream ne "" && $upstream > 0} {
+			set transfer_loss [expr {($upstream - $rate_in)/$upstream}]
+		}
+		set internal_loss ""
+		if {$dropped ne "" && $rate_in > 0} {
+			set internal_loss [expr {$dropped/$rate_in}]
+		}
+		set flag "ok"
+		if {$transfer_loss ne "" && $transfer_loss > $loss_threshold} {
+			set flag "lost before"
+		} elseif {$internal_loss ne "" && $internal_loss > $loss_threshold} {
+			set flag "dropping"
+		}
+		if {$flag ne "ok" && $verdict eq ""} {
+			set first [llength $rows]
+			if {$flag eq "lost before"} {
+				set verdict [format "%.1f %% of the hits are lost on the way into %s" [expr {100.0*$transfer_loss}] $name]
+			} else {
+				set verdict [format "%s drops %.1f %% of its hits" $name [expr {100.0*$internal_loss}]]
+			}
+		}
+		lappend rows [list $name $rate_in $rate_out $transfer_loss $internal_loss $flag]
+	}
+	if {$verdict eq ""} {
+		set verdict [format "no loss above %.1f %% along the chain" [expr {100.0*$loss_threshold}]]
+	}
+	return [dict create rows $rows first $first verdict $verdict crc_rate $rate(deasm_crc) bad_frame_rate $rate(deasm_bad)]
+}
+
+######################################################################################################
+##  Arguments:
+##		<seconds> - time span, counted back from the last sample
+##
+##  Description:
+##  	Gets the samples of the history, e.g. to plot the throughput of a stage over time.
+##
+##	Returns:
+##  	list of {t dt deltas}, oldest first, deltas a dict of counts (see snapshot)
+##
+######################################################################################################
+proc ::mu3e::accounting::get_history {seconds} {
+	variable history
+	set result [list]
+	if {[llength $history] == 0} {
+		return $result
+	}
+	set t_last [lindex $history end 0]
+	foreach sample $history {
+		if {$t_last - [lindex $sample 0] < $seconds} {
+			lappend result $sample
+		}
+	}
+	return $result
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Gets the engine counters.
+##
+##	Returns:
+##  	{n_snapshot n_read n_carry} - snapshots taken, block reads issued and carries caught
+##
+######################################################################################################
+proc ::mu3e::accounting::get_stats {} {
+	variable stats
+	return $stats
+}
@@ -0,0 +1,356 @@
+###########################################################################################################
+# @Name 		mu3e_bspmap.tcl
+#
+# @Brief		Register-map registry of the BSP packages. Compiles the XML address map of a BSP once per
+#				set of configure options into plain register and field lists, keeps them in memory and in
+#				a binary cache file per BSP package version, so a new session does not parse any XML. The
+#				cache is tied to the modification time and size of the BSP source file, so an edited BSP
+#				is parsed again even if its version stays the same.
+#				Consumers (GUI setup, register read/write, monitors) get the map by name.
+#
+# @Functions	configure, compile, bind, registers, xml, describe, clear_cache, get_stats
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 27, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require tdom
+package provide mu3e::bspmap 	1.0
+
+namespace eval ::mu3e::bspmap:: {
+	namespace export \
+	configure \
+	compile \
+	bind \
+	registers \
+	xml \
+	describe \
+	clear_cache \
+	get_stats
+
+	# directory of the binary cache files, empty for no disk cache. Relative to the library
+	# directory, not to the working directory of the console.
+	variable cache_dir ".bspmap_cache"
+	variable lib_dir [file dirname [file normalize [info script]]]
+	# "<bsp> <version> <stamp>" -> dict of options -> {xml registers}
+	variable maps
+	# "<bsp> <version> <stamp>" -> 1 once the cache file was looked at
+	variable loaded
+	# name -> {xml registers bsp version options} bound by bind
+	variable bound
+	# n_compile n_file_hit n_memory_hit
+	variable stats [list 0 0 0]
+	array set maps {}
+	array set loaded {}
+	array set bound {}
+}
+
+######################################################################################################
+##  Arguments:
+##		-cache_dir <dir>  - directory of the binary cache files (default ".bspmap_cache"), relative
+##							paths are taken from the library directory, empty to keep the maps in
+##							memory only
+##
+##  Description:
+##  	Configures the registry.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::bspmap::configure {args} {
+	foreach {option value} $args {
+		switch -- $option {
+			-cache_dir {
+				variable cache_dir
+				variable loaded
+				set cache_dir $value
+				array unset loaded
+			}
+			default {
+				error "configure: unknown option \"${option}\", must be -cache_dir"
+			}
+		}
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<bsp>      - namespace of the BSP package, e.g. "lvds_rx" for ::lvds_rx::bsp
+##		<options>  - configure options of the BSP, e.g. {-n_lane 9}
+##
+##  Description:
+##  	Gets the compiled map of a BSP for the options: from memory, from the cache file of the
+##		package version if it was written for the same BSP source file (see source_stamp), or by
+##		configuring the BSP and parsing its address map once.
+##
+##	Returns:
+##  	{xml registers}, registers is a list of {name offset description fields} in address map
+##		order, fields a list of {name lsb msb access description}
+##
+######################################################################################################
+proc ::mu3e::bspmap::compile {bsp {options {}}} {
+	variable maps
+	variable loaded
+	variable stats
+	lassign $stats n_compile n_file_hit n_memory_hit
+	set version [package present ${bsp}::bsp]
+	set key [list $bsp $version [::mu3e::bspmap::source_stamp $bsp $version]]
+	if {![info exists loaded($key)]} {
+		set loaded($key) 1
+		set maps($key) [::mu3e::bspmap::read_cache $key]
+		if {[dict size $maps($key)] > 0} {
+			incr n_file_hit
+		}
+	} elseif {[dict exists $maps($key) $options]} {
+		incr n_memory_hit
+	}
+	if {![dict exists $maps($key) $options]} {
+		incr n_compile
+		dict set maps($key) $options [::mu3e::bspmap::parse $bsp $options]
+		::mu3e::bspmap::write_cache $key $maps($key)
+	}
+	set stats [list $n_compile $n_file_hit $n_memory_hit]
+	return [dict get $maps($key) $options]
+}
+
+# "<mtime>-<size>" of the file the bsp package is sourced from, empty if it cannot be found
+proc ::mu3e::bspmap::source_stamp {bsp version} {
+	set script [package ifneeded ${bsp}::bsp $version]
+	if {[catch {lindex $script 0} command] || $command ne "source"} {
+		return ""
+	}
+	if {[catch {file stat [lindex $script end] stat}]} {
+		return ""
+	}
+	return "$stat(mtime)-$stat(size)"
+}
+
+# configures the bsp, builds the xml document of its address map and parses it into lists
+proc ::mu3e::bspmap::parse {bsp options} {
+	foreach {option value} $options {
+		::${bsp}::bsp::configure $option $value
+	}
+	array set csr_map [::${bsp}::bsp::get_address_map]
+	set xml_plain_text "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<registers>\n"
+	for {set i 0} {$i < [array size csr_map]} {incr i} {
+		append xml_plain_text $csr_map($i) "\n"
+	}
+	append xml_plain_text "</registers>\n"
+	dom parse $xml_plain_text doc
+	set registers [list]
+	foreach i [$doc selectNodes "/registers/register"] {
+		set fields [list]
+		foreach j [$i selectNodes "fields/field"] {
+			regexp {(\d+):(\d+)} [$j selectNodes "string(bitRange)"] -> bitMsb bitLsb
+			set bitDescpt [$j selectNodes "string(description)"]
+			if {[llength [$j selectNodes "description"]] == 0} {
+				set bitDescpt "none"
+			}
+			lappend fields [list [$j selectNodes "string(name)"] $bitLsb $bitMsb [$j selectNodes "string(access)"] $bitDescpt]
+		}
+		lappend registers [list [$i selectNodes "string(name)"] [$i selectNodes "string(addressOffset)"] \
+			[$i selectNodes "string(description)"] $fields]
+	}
+	$doc delete
+	return [list $xml_plain_text $registers]
+}
+
+######################################################################################################
+##  Arguments:
+##		<name>     - name the consumers use for the map, e.g. "lvds"
+##		<bsp>      - namespace of the BSP package
+##		<options>  - configure options of the BSP
+##
+##  Description:
+##  	Compiles (see compile) and binds the map to a name, registers and xml serve it from then on.
+##
+##	Returns:
+##  	the register list
+##
+######################################################################################################
+proc ::mu3e::bspmap::bind {name bsp {options {}}} {
+	variable bound
+	set bound($name) [concat [::mu3e::bspmap::compile $bsp $options] [list $bsp [package present ${bsp}::bsp] $options]]
+	return [lindex $bound($name) 1]
+}
+
+proc ::mu3e::bspmap::registers {name} {
+	variable bound
+	if {![info exists bound($name)]} {
+		error "registers: no bsp reg map bound to \"${name}\""
+	}
+	return [lindex $bound($name) 1]
+}
+
+proc ::mu3e::bspmap::xml {name} {
+	variable bound
+	if {![info exists bound($name)]} {
+		error "xml: no bsp reg map bound to \"${name}\""
+	}
+	return [lindex $bound($name) 0]
+}
+
+# dict with bsp, version and options of the map bound to a name
+proc ::mu3e::bspmap::describe {name} {
+	variable bound
+	if {![info exists bound($name)]} {
+		error "describe: no bsp reg map bound to \"${name}\""
+	}
+	lassign $bound($name) xml_plain_text registers bsp version options
+	return [dict create bsp $bsp version $version options $options]
+}
+
+# n_compile (xml parsed), n_file_hit (cache files used), n_memory_hit
+proc ::mu3e::bspmap::get_stats {} {
+	variable stats
+	lassign $stats n_compile n_file_hit n_memory_hit
+	return [dict create n_compile $n_compile n_file_hit $n_file_hit n_memory_hit $n_memory_hit]
+}
+
+# removes the cache files and the maps in memory (bound maps stay valid)
+proc ::mu3e::bspmap::clear_cache {} {
+	variable cache_dir
+	variable maps
+	variable loaded
+	array unset maps
+	array unset loaded
+	if {$cache_dir ne "" && [file isdirectory [::mu3e::bspmap::cache_root]]} {
+		foreach path [glob -nocomplain -directory [::mu3e::bspmap::cache_root] *.bspmap] {
+			file delete $path
+		}
+	}
+	return -code ok
+}
+
+	###############################
+	# cache file
+	###############################
+	# "BSPMAP02" stamp n_entry, then per entry: options xml n_register and per register: offset name
+	# description n_field, per field: lsb msb access name description. Strings are a 32 bit length
+	# followed by the utf-8 bytes, counts are 32 bit, little endian.
+
+# cache directory, relative paths from the library directory
+proc ::mu3e::bspmap::cache_root {} {
+	variable cache_dir
+	variable lib_dir
+	return [file join $lib_dir $cache_dir]
+}
+
+# one file per bsp version, the stamp inside tells whether it is still valid
+proc ::mu3e::bspmap::cache_path {key} {
+	lassign $key bsp version
+	return [file join [::mu3e::bspmap::cache_root] "${bsp}-${version}.bspmap"]
+}
+
+proc ::mu3e::bspmap::put_string {text} {
+	set bytes [encoding convertto utf-8 $text]
+	return [binary format i [string length $bytes]]$bytes
+}
+
+proc ::mu3e::bspmap::get_string {data cursor_var} {
+	upvar 1 $cursor_var cursor
+	binary scan $data @${cursor}i length
+	set text [encoding convertfrom utf-8 [string range $data [expr {$cursor + 4}] [expr {$cursor + 3 + $length}]]]
+	incr cursor [expr {4 + $length}]
+	return $text
+}
+
+proc ::mu3e::bspmap::write_cache {key entries} {
+	variable cache_dir
+	if {$cache_dir eq ""} {
+		return -code ok
+	}
+	set data "BSPMAP02[::mu3e::bspmap::put_string [lindex $key 2]][binary format i [dict size $entries]]"
+	dict for {options map} $entries {
+		lassign $map xml_plain_text registers
+		append data [::mu3e::bspmap::put_string $options] [::mu3e::bspmap::put_string $xml_plain_text] \
+			[binary format i [llength $registers]]
+		foreach reg $registers {
+			lassign $reg regName regAddrOfst regDespt fields
+			append data [::mu3e::bspmap::put_string $regAddrOfst] [::mu3e::bspmap::put_string $regName] \
+				[::mu3e::bspmap::put_string $regDespt] [binary format i [llength $fields]]
+			foreach field $fields {
+				lassign $field bitName bitLsb bitMsb bitAccess bitDescpt
+				append data [binary format cc $bitLsb $bitMsb] [::mu3e::bspmap::put_string $bitAccess] \
+					[::mu3e::bspmap::put_string $bitName] [::mu3e::bspmap::put_string $bitDescpt]
+			}
+		}
+	}
+	# a failing cache only costs the next session a parse
+	if {[catch {
+		file mkdir [::mu3e::bspmap::cache_root]
+		set path [::mu3e::bspmap::cache_path $key]
+		set fd [open "${path}.tmp" w]
+		fconfigure $fd -translation binary
+		puts -nonewline $fd $data
+		close $fd
+		file rename -force "${path}.tmp" $path
+	} msg]} {
+		toolkit_send_message warning "mu3e::bspmap: could not write the cache of \"[lindex $key 0]\": $msg"
+	}
+	return -code ok
+}
+
+# entries of the cache file of a bsp version, empty if there is none or it cannot be read
+proc ::mu3e::bspmap::read_cache {key} {
+	variable cache_dir
+	set entries [dict create]
+	if {$cache_dir eq ""} {
+		return $entries
+	}
+	set path [::mu3e::bspmap::cache_path $key]
+	if {![file isfile $path]} {
+		return $entries
+	}
+	if {[catch {
+		set fd [open $path r]
+		fconfigure $fd -translation binary
+		set data [read $fd]
+		close $fd
+		if {[string range $data 0 7] ne "BSPMAP02"} {
+			error "not a bspmap file"
+		}
+		set cursor 8
+		if {[::mu3e::bspmap::get_string $data cursor] ne [lindex $key 2]} {
+			# written for another revision of the bsp source, it is replaced on the next write
+			set n_entry 0
+		} else {
+			binary scan $data @${cursor}i n_entry
+			incr cursor 4
+		}
+		for {set e 0} {$e < $n_entry} {incr e} {
+			set options [::mu3e::bspmap::get_string $data cursor]
+			set xml_plain_text [::mu3e::bspmap::get_string $data cursor]
+			binary scan $data @${cursor}i n_register
+			incr cursor 4
+			set registers [list]
+			for {set r 0} {$r < $n_register} {incr r} {
+				set regAddrOfst [::mu3e::bspmap::get_string $data cursor]
+				set regName [::mu3e::bspmap::get_string $data cursor]
+				set regDespt [::mu3e::bspmap::get_string $data cursor]
+				binary scan $data @${cursor}i n_field
+				incr cursor 4
+				set fields [list]
+				for {set f 0} {$f < $n_field} {incr f} {
+					binary scan $data @${cursor}cucu bitLsb bitMsb
+					incr cursor 2
+					set bitAccess [::mu3e::bspmap::get_string $data cursor]
+					set bitName [::mu3e::bspmap::get_string $data cursor]
+					set bitDescpt [::mu3e::bspmap::get_string $data cursor]
+					lappend fields [list $bitName $bitLsb $bitMsb $bitAccess $bitDescpt]
+				}
+				lappend registers [list $regName $regAddrOfst $regDespt $fields]
+			}
+			dict set entries $options [list $xml_plain_text $registers]
+		}
+	} msg]} {
+		toolkit_send_message warning "mu3e::bspmap: ignoring the cache of \"[lindex $key 0]\": $msg"
+		return [dict create]
+	}
+	return $entries
+}
@@ -13,15 +13,30 @@
 ###########################################################################################################
 package require Tcl 			8.5
 package provide mu3e::helpers 	1.0
-package require dom::tcl 3.0
+package require dom::tdom 3.0
 
 namespace eval ::mu3e::helpers:: {
 	namespace export \
 	setup_base_group \
 	toolkit_setup_combobox \
-	dom_set_node_value 
-	 
-
+	dom_set_node_value \
+	discover_markers \
+	marker_find_type \
+	marker_find_hpath
+
+	# marker directory of the loaded firmware, see discover_markers
+	variable marker_index [dict create]
+	# system id -> marker directory, of every firmware seen in this session
+	variable marker_cache
+	array set marker_cache {}
+	# marker path set -> system id of the firmware it was last discovered with
+	variable marker_last_id
+	array set marker_last_id {}
+	# TYPE_NAME of the system id peripheral
+	variable sysid_type "altera_avalon_sysid_qsys"
+	# conflict widgets created by link_slave
+	variable link_widgets
+	array set link_widgets {}
 }
 
 ######################################################################################################
@@ -210,6 +225,10 @@ proc ::mu3e::helpers::toolkit_setup_slaveAddress {baseGroupName} {
 	toolkit_add				"autoLinkRV_button"	button		"autoLinkGroup"
 	toolkit_set_property	"autoLinkRV_button"	text		"revisit"
 	toolkit_set_property	"autoLinkRV_button"	onClick		{::mu3e::helpers::link_slave_revisit_callback}
+	# create a button to relink after enumerating the markers again
+	toolkit_add				"autoLinkRescan_button"	button		"autoLinkGroup"
+	toolkit_set_property	"autoLinkRescan_button"	text		"rescan markers"
+	toolkit_set_property	"autoLinkRescan_button"	onClick		{::mu3e::helpers::link_slave 1}
     
 	
 	return -code ok
@@ -347,11 +366,144 @@ proc ::mu3e::helpers::write_this_address {addr data displayTextBox} {
 
 
 
-proc ::mu3e::helpers::link_slave {} {
+######################################################################################################
+##  Arguments:
+##		<force> - 1 to enumerate the markers again, even if the firmware is known (default 0)
+##
+##  Description:
+##  	Builds the marker directory of the loaded firmware in one pass over the marker service paths:
+##		marker_get_info is called once per path and the slaves are indexed by TYPE_NAME and by
+##		FULL_HPATH, with base address and span. The directory is cached by the system id of the
+##		firmware, read from its sysid peripheral (id and timestamp), so relinking a known firmware
+##		costs one get_service_paths and one read. Without a sysid peripheral or an opened master,
+##		the set of marker paths is the id. Device roots (no TYPE_NAME) are not indexed.
+##
+##	Returns:
+##  	system id of the directory
+##
+######################################################################################################
+proc ::mu3e::helpers::discover_markers {{force 0}} {
+	variable marker_index
+	variable marker_cache
+	variable marker_last_id
+	set spaths [get_service_paths marker]
+	set path_key [lsort $spaths]
+	# known marker path set: the firmware is the same unless its system id changed
+	if {!$force && [info exists marker_last_id($path_key)]} {
+		set id $marker_last_id($path_key)
+		set index $marker_cache($id)
+		set current [::mu3e::helpers::read_system_id $index]
+		if {$current eq ""} {
+			set current $path_key
+		}
+		if {$current eq $id} {
+			set marker_index $index
+			return $id
+		}
+	}
+	set types [dict create]
+	set hpaths [dict create]
+	foreach path $spaths {
+		array unset minfo
+		array set minfo [marker_get_info $path]
+		if {![info exists minfo(TYPE_NAME)] || ![info exists minfo(FULL_HPATH)]} {
+			continue
+		}
+		set span ""
+		foreach name {SPAN ADDRESS_SPAN} {
+			if {[info exists minfo($name)]} {
+				set span $minfo($name)
+				break
+			}
+		}
+		set base [expr {[info exists minfo(BASE_ADDRESS)] ? $minfo(BASE_ADDRESS) : ""}]
+		set entry [dict create type $minfo(TYPE_NAME) hpath $minfo(FULL_HPATH) base $base span $span path $path]
+		dict lappend types $minfo(TYPE_NAME) $entry
+		dict lappend hpaths $minfo(FULL_HPATH) $entry
+	}
+	set marker_index [dict create types $types hpaths $hpaths]
+	set id [::mu3e::helpers::read_system_id $marker_index]
+	if {$id eq ""} {
+		set id $path_key
+	}
+	set marker_cache($id) $marker_index
+	set marker_last_id($path_key) $id
+	toolkit_send_message info "discover_markers: [llength $spaths] marker path(s), [dict size $types] slave type(s) indexed."
+	return $id
+}
+
+# system id {id timestamp} from the sysid peripheral of a marker directory, empty if it cannot be read
+proc ::mu3e::helpers::read_system_id {index} {
+	variable sysid_type
+	if {![dict exists $index types $sysid_type]} {
+		return ""
+	}
+	if {[catch {
+		set master_fd [::mu3e::helpers::cget_opened_master_path]
+		set words [master_read_32 $master_fd [dict get [lindex [dict get $index types $sysid_type] 0] base] 2]
+	}]} {
+		return ""
+	}
+	return [list [format 0x%08x [lindex $words 0]] [format 0x%08x [lindex $words 1]]]
+}
+
+######################################################################################################
+##  Arguments:
+##		<type_name> - TYPE_NAME of the slave
+##
+##  Description:
+##  	Looks up the copies of a slave in the marker directory (see discover_markers).
+##
+##	Returns:
+##  	FULL_HPATH of every copy, in marker path order
+##
+######################################################################################################
+proc ::mu3e::helpers::marker_find_type {type_name} {
+	variable marker_index
+	set result [list]
+	if {[dict exists $marker_index types $type_name]} {
+		foreach entry [dict get $marker_index types $type_name] {
+			lappend result [dict get $entry hpath]
+		}
+	}
+	return $result
+}
+
+######################################################################################################
+##  Arguments:
+##		<hpath>     - FULL_HPATH of the slave
+##		<type_name> - TYPE_NAME the slave must have, any if empty (default)
+##
+##  Description:
+##  	Looks up a slave in the marker directory (see discover_markers).
+##
+##	Returns:
+##  	dict with type, hpath, base, span and path (marker service path), empty if not found
+##
+######################################################################################################
+proc ::mu3e::helpers::marker_find_hpath {hpath {type_name ""}} {
+	variable marker_index
+	if {[dict exists $marker_index hpaths $hpath]} {
+		foreach entry [dict get $marker_index hpaths $hpath] {
+			if {$type_name eq "" || [dict get $entry type] eq $type_name} {
+				return $entry
+			}
+		}
+	}
+	return [dict create]
+}
+
+proc ::mu3e::helpers::link_slave {{rescan 0}} {
 	set fd_global_variable "globalVariableTable"; # must be the same name as the gui
-    ::mu3e::helpers::append_global_variable $fd_global_variable "conflict_slaves" ""
+    variable link_widgets
+    # relinking starts over from the marker directory
+    if {[::mu3e::helpers::probe_global_variable $fd_global_variable "conflict_slaves"]} {
+        ::mu3e::helpers::set_global_variable $fd_global_variable "conflict_slaves" ""
+    } else {
+        ::mu3e::helpers::append_global_variable $fd_global_variable "conflict_slaves" ""
+    }
 	set slave_list [::mu3e::helpers::get_global_variable $fd_global_variable "slaves"]
-	set spaths [get_service_paths marker]
+	::mu3e::helpers::discover_markers $rescan
     set err 0
 	# loop over all slave, for each slave loop over all paths
 	foreach slave $slave_list {
@@ -360,33 +512,18 @@ proc ::mu3e::helpers::link_slave {} {
         set occurance_count 0
         set slave_hpaths [list]
        
-        ::mu3e::helpers::append_global_variable $fd_global_variable "${slave}_hpaths" ""
+        if {![::mu3e::helpers::probe_global_variable $fd_global_variable "${slave}_hpaths"]} {
+            ::mu3e::helpers::append_global_variable $fd_global_variable "${slave}_hpaths" ""
+        }
 		# 1) set the required occurance 
         if {[::mu3e::helpers::probe_global_variable $fd_global_variable "${slave}_copies"]} {
             set occurance [::mu3e::helpers::get_global_variable $fd_global_variable "${slave}_copies"]
         } else {
             set occurance 1
         }
-        # 2) iterate through the the whole "marker" service paths
-		set set_count 0
-        set occurance_actual 0
-		foreach path $spaths {
-			array set minfo [marker_get_info $path]
-            # 2.1) no TYPE_NAME (usually it is a device root)
-			if {![info exists minfo(TYPE_NAME)]} {
-				continue
-            # 2.2) exist TYPE_NAME
-			} else {
-                # 2.2.1) found in the required "slaves" list? 
-				if {[string equal $minfo(TYPE_NAME) $slave]} {
-                    # yes! : 
-                    # 1) increase occurance_actual 
-                    incr occurance_actual
-                    # 2) record the hpath for callback if needed in case of wrong occurance counts
-                    lappend slave_hpaths $minfo(FULL_HPATH)
-				}
-			}
-		}
+        # 2) look up the slave in the marker directory, record the hpaths for callback if needed in case of wrong occurance counts
+        set slave_hpaths [::mu3e::helpers::marker_find_type $slave]
+        set occurance_actual [llength $slave_hpaths]
         # store hpaths -> gv_table 
         ::mu3e::helpers::set_global_variable $fd_global_variable "${slave}_hpaths" $slave_hpaths
          
@@ -399,17 +536,23 @@ proc ::mu3e::helpers::link_slave {} {
             set comboBox_hpaths [::mu3e::helpers::get_global_variable $fd_global_variable "${slave}_hpaths"]
             # 1) report 
             toolkit_send_message warning "link_slave: found ($occurance_actual) of ($occurance) required \"${slave}\" under connected marker paths, you need to manually select ones you wish to connect in this console. "
-            # 2) create gui group 
+            # 2) create gui group (once, relinking reuses it)
             # slave group
-            toolkit_add	"autoLinkConflictGroup_${slave}" group "autoLinkGroup"
+            if {![info exists link_widgets(autoLinkConflictGroup_${slave})]} {
+                toolkit_add	"autoLinkConflictGroup_${slave}" group "autoLinkGroup"
+                set link_widgets(autoLinkConflictGroup_${slave}) 1
+            }
             toolkit_set_property "autoLinkConflictGroup_${slave}" itemsPerRow 2
             toolkit_set_property "autoLinkConflictGroup_${slave}" expandableX true
             toolkit_set_property "autoLinkConflictGroup_${slave}" title "${slave} options"
             toolkit_set_property "autoLinkConflictGroup_${slave}" visible 1
             # slave group - checkBoxes (pair of checkBox and hpath text field)
             for {set i 0} {$i < $occurance_actual} {incr i} {
-                toolkit_add "autoLinkConflictCheckBox_${slave}_$i" checkBox "autoLinkConflictGroup_${slave}"
-                toolkit_add "autoLinkConflictText_${slave}_$i" text "autoLinkConflictGroup_${slave}"
+                if {![info exists link_widgets(autoLinkConflictText_${slave}_$i)]} {
+                    toolkit_add "autoLinkConflictCheckBox_${slave}_$i" checkBox "autoLinkConflictGroup_${slave}"
+                    toolkit_add "autoLinkConflictText_${slave}_$i" text "autoLinkConflictGroup_${slave}"
+                    set link_widgets(autoLinkConflictText_${slave}_$i) 1
+                }
                 toolkit_set_property "autoLinkConflictText_${slave}_$i" text [lindex $comboBox_hpaths $i]
                 toolkit_set_property "autoLinkConflictText_${slave}_$i" editable false 
                 toolkit_set_property "autoLinkConflictText_${slave}_$i" foregroundColor blue
@@ -431,23 +574,8 @@ proc ::mu3e::helpers::link_slave {} {
         # 4) if reach this point: no errors, we can write base address to gv_table
         set set_hpaths [::mu3e::helpers::get_global_variable $fd_global_variable "${slave}_hpaths"]
         # 4.1) find all base address(es)
-        for {set i 0} {$i < $occurance_actual} {incr i} {
-            # iterate the whole "marker" paths to set the base address 
-            foreach path $spaths {
-                array set minfo [marker_get_info $path]
-                # no FULL_HPATH (usually it is a device root)
-                if {![info exists minfo(FULL_HPATH)]} {
-                    continue
-                }
-                if {![info exists minfo(TYPE_NAME)]} {
-                    continue
-                }
-                if {[string equal $minfo(FULL_HPATH) [lindex $set_hpaths $i]] && [string equal $minfo(TYPE_NAME) $slave]} {
-                    lappend base_addresses [format 0x%x $minfo(BASE_ADDRESS)]
-                    break
-                }
-                
-            }
+        foreach hp $set_hpaths {
+            lappend base_addresses [format 0x%x [dict get [::mu3e::helpers::marker_find_hpath $hp $slave] base]]
         }
         # 4.2) store base_addr -> gv_table
         ::mu3e::helpers::set_global_variable $fd_global_variable "${slave}_base_address" $base_addresses
@@ -478,28 +606,13 @@ proc ::mu3e::helpers::link_slave {} {
 proc ::mu3e::helpers::link_slave_revisit_callback {} {
     set fd_global_variable "globalVariableTable"; # must be the same name as the gui
 	set conf_slave_list [::mu3e::helpers::get_global_variable $fd_global_variable "conflict_slaves"]
-	set spaths [get_service_paths marker]
+	::mu3e::helpers::discover_markers
     set err 0
     foreach conf_slave $conf_slave_list {
         set hpath2set [list]
         set base_addresses [list]
-        # 1) calculate occurance count again here
-        set occurance_actual 0
-		foreach path $spaths {
-			array set minfo [marker_get_info $path]
-            # no TYPE_NAME (usually it is a device root)
-			if {![info exists minfo(TYPE_NAME)]} {
-				continue
-            # exist TYPE_NAME
-			} else {
-                # found in the required "conf_slave" list? 
-				if {[string equal $minfo(TYPE_NAME) $conf_slave]} {
-                    # yes! : 
-                    # increase occurance_actual 
-                    incr occurance_actual
-				}
-			}
-		}
+        # 1) occurance count from the marker directory
+        set occurance_actual [llength [::mu3e::helpers::marker_find_type $conf_slave]]
         
         # 2) see if this hpath associated check box has been checked  
         for {set i 0} {$i < $occurance_actual} {incr i} {
@@ -510,20 +623,9 @@ proc ::mu3e::helpers::link_slave_revisit_callback {} {
         
         # 3) set the hpath 
         foreach hp $hpath2set {
-            foreach path $spaths {
-                array set minfo [marker_get_info $path]
-                # no FULL_HPATH
-                if {![info exists minfo(FULL_HPATH)]} {
-                    continue
-                }
-                # no TYPE_NAME
-                if {![info exists minfo(TYPE_NAME)]} {
-                    continue
-                }
-                # found in the required "hpath2set" list? 
-                if {[string equal $minfo(FULL_HPATH) $hp] && [string equal $minfo(TYPE_NAME) $conf_slave]} {
-                    lappend base_addresses [format 0x%x $minfo(BASE_ADDRESS)]
-                }  
+            set entry [::mu3e::helpers::marker_find_hpath $hp $conf_slave]
+            if {[dict size $entry]} {
+                lappend base_addresses [format 0x%x [dict get $entry base]]
             }
         }
         
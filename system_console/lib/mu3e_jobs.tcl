@@ -0,0 +1,183 @@
+###########################################################################################################
+# @Name 		mu3e_jobs.tcl
+#
+# @Brief		Small job runtime for long operations (scans, chip configuration, polling for completion).
+#				A job is a step command that does a short piece of work and tells how long to wait until
+#				its next step, so the event loop of the toolkit keeps running in between. Jobs can be
+#				cancelled, report progress and run side by side, as long as they claim different
+#				resources (usually the IP they drive).
+#
+# @Functions	start, cancel, progress, is_running, get_jobs
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 25, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package provide mu3e::jobs 	1.0
+
+namespace eval ::mu3e::jobs:: {
+	namespace export \
+	start \
+	cancel \
+	progress \
+	is_running \
+	get_jobs
+
+	# name -> dict {step state resource after_id progress done cleanup fraction text t_start}
+	variable jobs
+	array set jobs {}
+}
+
+######################################################################################################
+##  Arguments:
+##		<name>                - unique name of the job
+##		<step>                - command prefix, called as: {*}$step <name> <state>. It returns
+##								{<delay_ms> <state>} to be called again after delay_ms, or
+##								{done <state>} when the job is finished. Errors end the job.
+##		-state <dict>         - initial state (default empty)
+##		-resource <key>       - resource the job uses exclusively, e.g. the base address of the IP
+##		-progress <callback>  - called as: {*}$callback <name> <fraction> <text>
+##		-done <callback>      - called as: {*}$callback <name> <status> <state or error message>,
+##								status is ok, cancelled or error
+##		-cleanup <command>    - called as: {*}$command <name> <state> when the job is cancelled or
+##								fails, to put the hardware back into a safe state
+##
+##  Description:
+##  	Starts a job, its first step runs from the event loop. Refused while a job of the same name
+##		is running or another job holds the resource.
+##
+##	Returns:
+##  	<name>
+##
+######################################################################################################
+proc ::mu3e::jobs::start {name step args} {
+	variable jobs
+	set job [dict create step $step state [dict create] resource "" progress "" done "" cleanup "" \
+		fraction 0.0 text "" t_start [clock milliseconds]]
+	foreach {option value} $args {
+		switch -- $option {
+			-state - -resource - -progress - -done - -cleanup {
+				dict set job [string range $option 1 end] $value
+			}
+			default {
+				error "start: unknown option \"${option}\", must be -state, -resource, -progress, -done or -cleanup"
+			}
+		}
+	}
+	if {[info exists jobs($name)]} {
+		error "start: job \"${name}\" is already running"
+	}
+	if {[dict get $job resource] ne ""} {
+		foreach other [array names jobs] {
+			if {[dict get $jobs($other) resource] eq [dict get $job resource]} {
+				error "start: resource \"[dict get $job resource]\" is in use by job \"${other}\""
+			}
+		}
+	}
+	dict set job after_id [after 0 [list ::mu3e::jobs::run $name]]
+	set jobs($name) $job
+	return $name
+}
+
+# runs one step of a job and schedules the next one
+proc ::mu3e::jobs::run {name} {
+	variable jobs
+	if {![info exists jobs($name)]} {
+		return -code ok
+	}
+	if {[catch {{*}[dict get $jobs($name) step] $name [dict get $jobs($name) state]} result]} {
+		::mu3e::jobs::finish $name error $result
+		return -code ok
+	}
+	# the step may have cancelled its own job
+	if {![info exists jobs($name)]} {
+		return -code ok
+	}
+	lassign $result next state
+	dict set jobs($name) state $state
+	if {$next eq "done"} {
+		::mu3e::jobs::finish $name ok $state
+	} else {
+		dict set jobs($name) after_id [after $next [list ::mu3e::jobs::run $name]]
+	}
+	return -code ok
+}
+
+# ends a job, runs the cleanup unless it completed and tells the owner
+proc ::mu3e::jobs::finish {name status result} {
+	variable jobs
+	set job $jobs($name)
+	unset jobs($name)
+	if {$status ne "ok" && [dict get $job cleanup] ne ""} {
+		if {[catch {{*}[dict get $job cleanup] $name [dict get $job state]} msg]} {
+			toolkit_send_message error "mu3e::jobs: cleanup of \"${name}\" failed: $msg"
+		}
+	}
+	if {$status eq "error"} {
+		toolkit_send_message error "mu3e::jobs: job \"${name}\" failed: $result"
+	}
+	if {[dict get $job done] ne ""} {
+		if {[catch {{*}[dict get $job done] $name $status $result} msg]} {
+			toolkit_send_message error "mu3e::jobs: done callback of \"${name}\" failed: $msg"
+		}
+	}
+	return -code ok
+}
+
+proc ::mu3e::jobs::cancel {name} {
+	variable jobs
+	if {[info exists jobs($name)]} {
+		after cancel [dict get $jobs($name) after_id]
+		::mu3e::jobs::finish $name cancelled [dict get $jobs($name) state]
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<name>     - name of the job
+##		<fraction> - done fraction, 0 to 1
+##		<text>     - short description of the current step
+##
+##  Description:
+##  	Called by a step to report progress, forwards it to the progress callback of the job.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::jobs::progress {name fraction {text ""}} {
+	variable jobs
+	if {![info exists jobs($name)]} {
+		return -code ok
+	}
+	dict set jobs($name) fraction $fraction
+	dict set jobs($name) text $text
+	set callback [dict get $jobs($name) progress]
+	if {$callback ne ""} {
+		if {[catch {{*}$callback $name $fraction $text} msg]} {
+			toolkit_send_message error "mu3e::jobs: progress callback of \"${name}\" failed: $msg"
+		}
+	}
+	return -code ok
+}
+
+proc ::mu3e::jobs::is_running {name} {
+	variable jobs
+	return [info exists jobs($name)]
+}
+
+# list of {name resource fraction text elapsed_s} of the running jobs
+proc ::mu3e::jobs::get_jobs {} {
+	variable jobs
+	set result [list]
+	foreach name [lsort [array names jobs]] {
+		set job $jobs($name)
+		lappend result [list $name [dict get $job resource] [dict get $job fraction] [dict get $job text] \
+			[expr {([clock milliseconds] - [dict get $job t_start])/1000.0}]]
+	}
+	return $result
+}
@@ -0,0 +1,361 @@
+###########################################################################################################
+# @Name 		mu3e_monitor.tcl
+#
+# @Brief		Central polling scheduler for register monitoring. Panels register address ranges with
+#				their own period and decoder, the scheduler runs one monitor service, merges the due
+#				ranges of each tick into as few block reads as possible and fans the decoded results out
+#				to the subscribers of each range.
+#
+# @Functions	configure, register, unregister, subscribe, unsubscribe, set_enabled, get_stats
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 16, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require mu3e::helpers 	1.0
+package provide mu3e::monitor 	1.0
+
+namespace eval ::mu3e::monitor:: {
+	namespace export \
+	configure \
+	register \
+	unregister \
+	subscribe \
+	unsubscribe \
+	set_enabled \
+	get_stats
+
+	variable monitor_fd ""
+	variable running 0
+	# base tick of the monitor service, periods are rounded up to multiples of it
+	variable tick_ms 50
+	# holes (in bytes) up to this size are read through to save a transaction
+	variable max_gap 0
+	# name -> {base span period decoder enabled next_due}
+	variable ranges
+	# name -> list of callbacks
+	variable subscribers
+	# n_tick n_read n_word
+	variable stats [list 0 0 0]
+	# consecutive ticks with a failed block read, only the first of a streak is reported
+	variable read_errors 0
+	array set ranges {}
+	array set subscribers {}
+}
+
+######################################################################################################
+##  Arguments:
+##		-tick_ms <ms>    - interval of the monitor service (default 50)
+##		-max_gap <bytes> - merge ranges separated by holes up to this size (default 0, i.e. only
+##						   overlapping or adjacent ranges are merged)
+##
+##  Description:
+##  	Configures the scheduler. A new tick interval takes effect on the running monitor service.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::monitor::configure {args} {
+	variable tick_ms
+	variable max_gap
+	variable monitor_fd
+	foreach {option value} $args {
+		switch -- $option {
+			-tick_ms {
+				set tick_ms $value
+				if {$monitor_fd ne ""} {
+					monitor_set_interval $monitor_fd $tick_ms
+				}
+			}
+			-max_gap {
+				set max_gap $value
+			}
+			default {
+				error "configure: unknown option \"${option}\", must be -tick_ms or -max_gap"
+			}
+		}
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<name>    - unique name of the range, also used by subscribers
+##		<base>    - byte address of the first word
+##		<span>    - size of the range in bytes (multiple of 4)
+##		<period>  - polling period in ms
+##		<decoder> - command prefix called with the list of words read, its result is passed to the
+##					subscribers. Empty passes the raw words.
+##
+##  Description:
+##  	Registers (or re-registers) a range. It is polled once enabled with set_enabled.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::monitor::register {name base span period {decoder ""}} {
+	variable ranges
+	if {$span <= 0 || $span % 4 != 0} {
+		error "register: span of \"${name}\" must be a positive multiple of 4 bytes, got ${span}"
+	}
+	set enabled 0
+	if {[info exists ranges($name)]} {
+		set enabled [dict get $ranges($name) enabled]
+	}
+	set ranges($name) [dict create base [expr {$base}] span $span period $period decoder $decoder \
+		enabled $enabled next_due 0]
+	return -code ok
+}
+
+proc ::mu3e::monitor::unregister {name} {
+	variable ranges
+	variable subscribers
+	array unset ranges $name
+	array unset subscribers $name
+	::mu3e::monitor::update_service
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<name>     - name of the range
+##		<callback> - command prefix, called as: {*}$callback <name> <decoded result>
+##
+##  Description:
+##  	Subscribes to the results of a range. A range may have any number of subscribers.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::monitor::subscribe {name callback} {
+	variable subscribers
+	if {![info exists subscribers($name)] || [lsearch -exact $subscribers($name) $callback] < 0} {
+		lappend subscribers($name) $callback
+	}
+	return -code ok
+}
+
+proc ::mu3e::monitor::unsubscribe {name callback} {
+	variable subscribers
+	if {[info exists subscribers($name)]} {
+		set index [lsearch -exact $subscribers($name) $callback]
+		if {$index >= 0} {
+			set subscribers($name) [lreplace $subscribers($name) $index $index]
+		}
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<pattern> - glob pattern of range names
+##		<enabled> - 1 to poll, 0 to pause
+##
+##  Description:
+##  	Enables or pauses the matching ranges. The monitor service runs as long as any range is
+##		enabled, enabled ranges are polled on the next tick.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::monitor::set_enabled {pattern enabled} {
+	variable ranges
+	foreach name [array names ranges $pattern] {
+		dict set ranges($name) enabled $enabled
+		dict set ranges($name) next_due 0
+	}
+	::mu3e::monitor::update_service
+	return -code ok
+}
+
+proc ::mu3e::monitor::update_service {} {
+	variable ranges
+	variable monitor_fd
+	variable running
+	variable tick_ms
+	set any_enabled 0
+	foreach name [array names ranges] {
+		if {[dict get $ranges($name) enabled]} {
+			set any_enabled 1
+			break
+		}
+	}
+	if {$any_enabled && !$running} {
+		if {$monitor_fd eq ""} {
+			# the monitor service needs a range, the reads are issued by the tick itself
+			set master_path [::mu3e::helpers::get_selected_servicePath "jtagMasterGroup_showmp_comboBox"]
+			set monitor_fd [::mu3e::helpers::open_monitor_service]
+			monitor_set_interval $monitor_fd $tick_ms
+			monitor_set_callback $monitor_fd [list ::mu3e::monitor::tick]
+			monitor_add_range $monitor_fd $master_path 0x0 4
+			toolkit_send_message info "mu3e::monitor: registered monitor service (${tick_ms} ms tick)"
+		}
+		monitor_set_enabled $monitor_fd 1
+		set running 1
+	} elseif {!$any_enabled && $running} {
+		monitor_set_enabled $monitor_fd 0
+		set running 0
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<intervals> - list of {start end} byte intervals (end exclusive)
+##		<max_gap>   - largest hole in bytes to read through
+##
+##  Description:
+##  	Merges overlapping and adjacent (or nearly adjacent) intervals.
+##
+##	Returns:
+##  	list of merged {start end} intervals, sorted by start
+##
+######################################################################################################
+proc ::mu3e::monitor::merge_intervals {intervals {max_gap 0}} {
+	set merged [list]
+	foreach interval [lsort -integer -index 0 $intervals] {
+		lassign $interval start end
+		if {[llength $merged] != 0} {
+			lassign [lindex $merged end] last_start last_end
+			if {$start <= $last_end + $max_gap} {
+				lset merged end 1 [expr {max($end, $last_end)}]
+				continue
+			}
+		}
+		lappend merged [list $start $end]
+	}
+	return $merged
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Callback of the monitor service. Collects the due ranges, reads the merged blocks, slices them
+##		back into the ranges, decodes and notifies the subscribers. A failing decoder or subscriber is
+##		reported and does not stop the other ranges. A failing read skips the ranges of that block for
+##		this tick, they are read again when next due; the first failure of a streak and the recovery
+##		are reported.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::monitor::tick {} {
+	variable ranges
+	variable subscribers
+	variable max_gap
+	variable stats
+	variable read_errors
+	set now [clock milliseconds]
+	set due [list]
+	set intervals [list]
+	foreach name [array names ranges] {
+		set range $ranges($name)
+		if {![dict get $range enabled] || $now < [dict get $range next_due]} {
+			continue
+		}
+		lappend due $name
+		set base [dict get $range base]
+		lappend intervals [list $base [expr {$base + [dict get $range span]}]]
+		# keep the phase, but do not try to catch up after a stall
+		set next_due [expr {[dict get $range next_due] + [dict get $range period]}]
+		if {$next_due <= $now} {
+			set next_due [expr {$now + [dict get $range period]}]
+		}
+		dict set ranges($name) next_due $next_due
+	}
+	lassign $stats n_tick n_read n_word
+	incr n_tick
+	if {[llength $due] == 0} {
+		set stats [list $n_tick $n_read $n_word]
+		return -code ok
+	}
+	# master -> merged blocks
+	set blocks [list]
+	set error_msg ""
+	if {[catch {::mu3e::helpers::cget_opened_master_path} master_fd]} {
+		set error_msg $master_fd
+	} else {
+		foreach block [::mu3e::monitor::merge_intervals $intervals $max_gap] {
+			lassign $block start end
+			set n [expr {($end - $start)/4}]
+			if {[catch {master_read_32 $master_fd $start $n} words]} {
+				set error_msg [format "read of 0x%x (%d words) failed: %s" $start $n $words]
+				continue
+			}
+			lappend blocks [list $start $end $words]
+			incr n_read
+			incr n_word $n
+		}
+	}
+	set stats [list $n_tick $n_read $n_word]
+	if {$error_msg ne ""} {
+		if {$read_errors == 0} {
+			toolkit_send_message error "mu3e::monitor: $error_msg"
+		}
+		incr read_errors
+	} elseif {$read_errors != 0} {
+		toolkit_send_message info "mu3e::monitor: reads recovered after ${read_errors} failed ticks"
+		set read_errors 0
+	}
+	# blocks -> ranges -> subscribers
+	foreach name $due {
+		set range $ranges($name)
+		set base [dict get $range base]
+		set found 0
+		foreach block $blocks {
+			lassign $block start end words
+			if {$base >= $start && $base < $end} {
+				set first [expr {($base - $start)/4}]
+				set words [lrange $words $first [expr {$first + [dict get $range span]/4 - 1}]]
+				set found 1
+				break
+			}
+		}
+		if {!$found} {
+			# its block failed to read
+			continue
+		}
+		set decoder [dict get $range decoder]
+		if {$decoder ne ""} {
+			if {[catch {{*}$decoder $words} words]} {
+				toolkit_send_message error "mu3e::monitor: decoder of \"${name}\" failed: $words"
+				continue
+			}
+		}
+		if {![info exists subscribers($name)]} {
+			continue
+		}
+		foreach callback $subscribers($name) {
+			if {[catch {{*}$callback $name $words} msg]} {
+				toolkit_send_message error "mu3e::monitor: subscriber of \"${name}\" failed: $msg"
+			}
+		}
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Gets the scheduler counters.
+##
+##	Returns:
+##  	{n_tick n_read n_word} - ticks seen, block reads issued and words read since start
+##
+######################################################################################################
+proc ::mu3e::monitor::get_stats {} {
+	variable stats
+	return $stats
+}
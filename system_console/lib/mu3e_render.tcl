@@ -0,0 +1,338 @@
+###########################################################################################################
+# @Name 		mu3e_render.tcl
+#
+# @Brief		Coalesced update layer for chart and table widgets. Panels hand over the complete content
+#				of a widget, the layer keeps a host-side model of what is displayed and pushes only the
+#				points and cells that changed. Updates of a widget are rate limited (the latest content
+#				wins), series longer than the chart is wide are decimated, and every toolkit call is
+#				counted, so the cost of the GUI can be compared with what the panels asked for.
+#
+# @Functions	configure, series, table, flush, forget, get_stats, reset_stats
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 26, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package provide mu3e::render 	1.0
+
+namespace eval ::mu3e::render:: {
+	namespace export \
+	configure \
+	series \
+	table \
+	flush \
+	forget \
+	get_stats \
+	reset_stats
+
+	# default shortest time between two updates of a widget
+	variable interval_ms 200
+	# default width of a chart in points, longer series are decimated to it
+	variable max_points 1000
+	# widget -> dict {kind interval_ms width last_ms after_id dirty pending shown row_count row_count_shown}
+	variable widgets
+	# n_request (items and cells handed over), n_call (toolkit calls), n_flush, since (ms)
+	variable stats [list 0 0 0 0]
+	array set widgets {}
+}
+
+######################################################################################################
+##  Arguments:
+##		-interval_ms <ms>  - default shortest time between two updates of a widget (default 200)
+##		-max_points <n>    - default chart width in points (default 1000)
+##
+##  Description:
+##  	Configures the defaults, widgets keep the values they were first seen with.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::render::configure {args} {
+	foreach {option value} $args {
+		switch -- $option {
+			-interval_ms - -max_points {
+				variable [string range $option 1 end]
+				set [string range $option 1 end] $value
+			}
+			default {
+				error "configure: unknown option \"${option}\", must be -interval_ms or -max_points"
+			}
+		}
+	}
+	return -code ok
+}
+
+# widget state, created on first use
+proc ::mu3e::render::widget {name kind options} {
+	variable widgets
+	variable interval_ms
+	variable max_points
+	if {![info exists widgets($name)]} {
+		set widgets($name) [dict create kind $kind interval_ms $interval_ms width $max_points last_ms 0 \
+			after_id "" dirty 0 pending "" shown [dict create] row_count "" row_count_shown ""]
+	}
+	foreach {option value} $options {
+		switch -- $option {
+			-interval_ms - -width {
+				dict set widgets($name) [string range $option 1 end] $value
+			}
+			-first - -row_count {
+			}
+			default {
+				error "unknown option \"${option}\""
+			}
+		}
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<name>             - name of a barChart or lineChart
+##		<points>           - list of {x y}, the complete content
+##		-interval_ms <ms>  - shortest time between two updates (default: configured)
+##		-width <n>         - width of the chart in points (default: configured), 0 never decimates
+##
+##  Description:
+##  	Sets the content of a chart. It is drawn at the latest after interval_ms, an update arriving
+##		before replaces the pending one. Series longer than the width are cut into width buckets
+##		and every bucket is drawn as its first x and its largest y, so peaks stay visible. This
+##		changes what a bar means, so histograms are rebinned by the caller and drawn with -width 0.
+##		Points of an earlier content whose x is not given again are not removed from the chart,
+##		a chart whose x values change is recreated (see forget).
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::render::series {name points args} {
+	variable widgets
+	::mu3e::render::widget $name series $args
+	::mu3e::render::count [llength $points] 0
+	dict set widgets($name) pending $points
+	dict set widgets($name) dirty 1
+	::mu3e::render::schedule $name
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<name>             - name of a table
+##		<rows>             - list of rows, each a list of cell texts
+##		-first <row>       - index of the first row given (default 0)
+##		-row_count <n>     - rows of the table (default: first + number of rows given)
+##		-interval_ms <ms>  - shortest time between two updates (default: configured)
+##
+##  Description:
+##  	Sets rows of a table, rows outside the range given keep their content. Updates arriving
+##		within interval_ms are merged. Only changed cells are written, with the row and column index
+##		set only when they move.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::render::table {name rows args} {
+	variable widgets
+	::mu3e::render::widget $name table $args
+	set first 0
+	set row_count ""
+	foreach {option value} $args {
+		switch -- $option {
+			-first {set first $value}
+			-row_count {set row_count $value}
+		}
+	}
+	if {$row_count eq ""} {
+		set row_count [expr {$first + [llength $rows]}]
+	}
+	set pending [dict get $widgets($name) pending]
+	if {$pending eq ""} {
+		set pending [dict create]
+	}
+	set row $first
+	set n_cell 0
+	foreach cells $rows {
+		set column 0
+		foreach cell $cells {
+			dict set pending "$row,$column" $cell
+			incr column
+			incr n_cell
+		}
+		incr row
+	}
+	# cells of rows that are gone are not written
+	dict for {key cell} $pending {
+		if {[lindex [split $key ","] 0] >= $row_count} {
+			dict unset pending $key
+		}
+	}
+	::mu3e::render::count $n_cell 0
+	dict set widgets($name) pending $pending
+	dict set widgets($name) row_count $row_count
+	dict set widgets($name) dirty 1
+	::mu3e::render::schedule $name
+	return -code ok
+}
+
+# schedules the flush of a widget, at most one pending per widget
+proc ::mu3e::render::schedule {name} {
+	variable widgets
+	if {[dict get $widgets($name) after_id] ne ""} {
+		return -code ok
+	}
+	set delay [expr {max(0, [dict get $widgets($name) last_ms] + [dict get $widgets($name) interval_ms] - [clock milliseconds])}]
+	dict set widgets($name) after_id [after $delay [list ::mu3e::render::flush $name]]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<name>  - name of the widget
+##
+##  Description:
+##  	Draws the pending content of a widget now.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::render::flush {name} {
+	variable widgets
+	if {![info exists widgets($name)]} {
+		return -code ok
+	}
+	after cancel [dict get $widgets($name) after_id]
+	dict set widgets($name) after_id ""
+	if {![dict get $widgets($name) dirty]} {
+		return -code ok
+	}
+	dict set widgets($name) last_ms [clock milliseconds]
+	set pending [dict get $widgets($name) pending]
+	dict set widgets($name) pending ""
+	dict set widgets($name) dirty 0
+	set shown [dict get $widgets($name) shown]
+	set n_call 0
+	if {[dict get $widgets($name) kind] eq "series"} {
+		# the content is complete, the model is replaced so x values that are gone do not pile up
+		set shown_before $shown
+		set shown [dict create]
+		foreach point [::mu3e::render::decimate $pending [dict get $widgets($name) width]] {
+			lassign $point x y
+			if {![dict exists $shown_before $x] || [dict get $shown_before $x] != $y} {
+				toolkit_set_property $name itemValue [list $x $y]
+				incr n_call
+			}
+			dict set shown $x $y
+		}
+	} else {
+		set row_count [dict get $widgets($name) row_count]
+		if {[dict get $widgets($name) row_count_shown] ne $row_count} {
+			toolkit_set_property $name rowCount $row_count
+			incr n_call
+			dict set widgets($name) row_count_shown $row_count
+			dict for {key cell} $shown {
+				if {[lindex [split $key ","] 0] >= $row_count} {
+					dict unset shown $key
+				}
+			}
+		}
+		set row_index ""
+		set column_index ""
+		foreach key [lsort -dictionary [dict keys $pending]] {
+			set cell [dict get $pending $key]
+			if {[dict exists $shown $key] && [dict get $shown $key] eq $cell} {
+				continue
+			}
+			lassign [split $key ","] row column
+			if {$row ne $row_index} {
+				toolkit_set_property $name rowIndex $row
+				set row_index $row
+				incr n_call
+			}
+			if {$column ne $column_index} {
+				toolkit_set_property $name columnIndex $column
+				set column_index $column
+				incr n_call
+			}
+			toolkit_set_property $name cellText $cell
+			dict set shown $key $cell
+			incr n_call
+		}
+	}
+	dict set widgets($name) shown $shown
+	::mu3e::render::count 0 $n_call 1
+	return -code ok
+}
+
+# bucket maximum decimation of {x y} points to at most width points
+proc ::mu3e::render::decimate {points width} {
+	set n [llength $points]
+	if {$width <= 0 || $n <= $width} {
+		return $points
+	}
+	set size [expr {($n + $width - 1)/$width}]
+	set result [list]
+	for {set i 0} {$i < $n} {incr i $size} {
+		set bucket [lrange $points $i [expr {$i + $size - 1}]]
+		set x [lindex $bucket 0 0]
+		set y [lindex $bucket 0 1]
+		foreach point [lrange $bucket 1 end] {
+			set y [expr {max($y, [lindex $point 1])}]
+		}
+		lappend result [list $x $y]
+	}
+	return $result
+}
+
+# drops the model of a widget, to be called when the widget is replaced or cleared
+proc ::mu3e::render::forget {name} {
+	variable widgets
+	if {[info exists widgets($name)]} {
+		after cancel [dict get $widgets($name) after_id]
+		unset widgets($name)
+	}
+	return -code ok
+}
+
+proc ::mu3e::render::count {n_request n_call {n_flush 0}} {
+	variable stats
+	lassign $stats total_request total_call total_flush since
+	if {$since == 0} {
+		set since [clock milliseconds]
+	}
+	set stats [list [expr {$total_request + $n_request}] [expr {$total_call + $n_call}] [expr {$total_flush + $n_flush}] $since]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Gets the call statistics since the last reset. n_request is what the panels handed over
+##		(one item or cell each, i.e. the calls they would make drawing directly, row and column index
+##		calls not counted), n_call the toolkit calls actually made.
+##
+##	Returns:
+##  	dict with n_request, n_call, n_flush, elapsed_s, request_rate and call_rate (1/s)
+##
+######################################################################################################
+proc ::mu3e::render::get_stats {} {
+	variable stats
+	lassign $stats n_request n_call n_flush since
+	set elapsed_s [expr {$since == 0 ? 0.0 : ([clock milliseconds] - $since)/1000.0}]
+	return [dict create n_request $n_request n_call $n_call n_flush $n_flush elapsed_s $elapsed_s \
+		request_rate [expr {$elapsed_s > 0 ? $n_request/$elapsed_s : 0.0}] \
+		call_rate [expr {$elapsed_s > 0 ? $n_call/$elapsed_s : 0.0}]]
+}
+
+proc ::mu3e::render::reset_stats {} {
+	variable stats
+	set stats [list 0 0 0 [clock milliseconds]]
+	return -code ok
+}
@@ -0,0 +1,457 @@
+###########################################################################################################
+# @Name 		mu3e_snapshot.tcl
+#
+# @Brief		Snapshot and restore of the register state of the whole board. Every readable register of
+#				every linked IP copy (register maps from mu3e::bspmap, base addresses from link_slave) is
+#				read in as few block reads as possible and kept in a compact binary file with time stamps.
+#				Restore reads the current state the same way and writes back only the registers whose
+#				read-write fields differ from the snapshot.
+#
+# @Functions	configure, capture, restore, diff, save, load, get_words, get_stats
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 28, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require mu3e::bspmap 	1.0
+package provide mu3e::snapshot 	1.0
+
+namespace eval ::mu3e::snapshot:: {
+	namespace export \
+	configure \
+	capture \
+	restore \
+	diff \
+	save \
+	load \
+	get_words \
+	get_stats
+
+	# words a block read may skip over to join two registers (only if nothing in between is unreadable)
+	variable max_gap 8
+	# longest block read in words
+	variable max_block 256
+	# n_read n_word n_write elapsed_ms of the last capture or restore
+	variable stats [list 0 0 0 0]
+}
+
+######################################################################################################
+##  Arguments:
+##		-max_gap <n>    - words a block read may skip to join two registers (default 8)
+##		-max_block <n>  - longest block read in words (default 256)
+##
+##  Description:
+##  	Configures the block reads.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mu3e::snapshot::configure {args} {
+	foreach {option value} $args {
+		switch -- $option {
+			-max_gap - -max_block {
+				variable [string range $option 1 end]
+				set [string range $option 1 end] $value
+			}
+			default {
+				error "configure: unknown option \"${option}\", must be -max_gap or -max_block"
+			}
+		}
+	}
+	return -code ok
+}
+
+# read mask (bits of fields that are not write-only) and read-write mask of a register
+proc ::mu3e::snapshot::masks {fields} {
+	set read_mask 0
+	set rw_mask 0
+	foreach field $fields {
+		lassign $field bitName bitLsb bitMsb bitAccess
+		set mask [expr {((1 << ($bitMsb - $bitLsb + 1)) - 1) << $bitLsb}]
+		if {$bitAccess ne "write-only"} {
+			set read_mask [expr {$read_mask | $mask}]
+		}
+		if {$bitAccess eq "read-write"} {
+			set rw_mask [expr {$rw_mask | $mask}]
+		}
+	}
+	return [list $read_mask $rw_mask]
+}
+
+# reads a list of byte addresses in block reads, never touching an address in <avoid>.
+# Returns a dict address -> value
+proc ::mu3e::snapshot::read_words {master_fd addresses avoid} {
+	variable max_gap
+	variable max_block
+	variable stats
+	lassign $stats n_read n_word n_write elapsed_ms
+	set addresses [lsort -integer -unique $addresses]
+	set avoid [lsort -integer -unique $avoid]
+	set values [dict create]
+	set blocks [list]
+	set first ""
+	set last ""
+	set a 0
+	foreach address $addresses {
+		if {$first ne ""} {
+			# an unreadable register between the two ends the block
+			while {$a < [llength $avoid] && [lindex $avoid $a] <= $last} {
+				incr a
+			}
+			set blocked [expr {$a < [llength $avoid] && [lindex $avoid $a] < $address}]
+			if {$blocked || $address - $last > 4*$max_gap || ($address - $first)/4 >= $max_block} {
+				lappend blocks [list $first [expr {($last - $first)/4 + 1}]]
+				set first ""
+			}
+		}
+		if {$first eq ""} {
+			set first $address
+		}
+		set last $address
+	}
+	if {$first ne ""} {
+		lappend blocks [list $first [expr {($last - $first)/4 + 1}]]
+	}
+	foreach block $blocks {
+		lassign $block address n
+		set offset 0
+		foreach word [master_read_32 $master_fd $address $n] {
+			dict set values [expr {$address + $offset}] [expr {$word & 0xffffffff}]
+			incr offset 4
+		}
+		incr n_read
+		incr n_word $n
+	}
+	set stats [list $n_read $n_word $n_write $elapsed_ms]
+	return $values
+}
+
+######################################################################################################
+##  Arguments:
+##		<master_fd>  - opened master service path
+##		<ips>        - list of {type map bases}: type as in the gvtable (e.g. "ring_buffer_cam.csr"), map
+##					   the name the register map is bound to in mu3e::bspmap, bases the base addresses of
+##					   the copies
+##
+##  Description:
+##  	Reads every register with a field that is not write-only, of every copy of every IP. The
+##		reads of all IPs are sorted by address and joined into block reads over gaps of at most
+##		max_gap words, as long as no unreadable register lies in between.
+##
+##	Returns:
+##  	snapshot, a dict with t_ms (start of the capture), elapsed_ms and ips, a list of dicts with
+##		type, map, version (BSP package) and copies, a list of dicts with base, t_ms (end of the
+##		block reads) and words, a dict of register offset -> value
+##
+######################################################################################################
+proc ::mu3e::snapshot::capture {master_fd ips} {
+	variable stats
+	set stats [list 0 0 0 0]
+	set t_start [clock milliseconds]
+	set addresses [list]
+	set avoid [list]
+	foreach ip $ips {
+		lassign $ip type map bases
+		foreach base $bases {
+			foreach reg [::mu3e::bspmap::registers $map] {
+				lassign $reg regName regAddrOfst regDespt fields
+				if {[lindex [::mu3e::snapshot::masks $fields] 0] != 0} {
+					lappend addresses [expr {$base + $regAddrOfst}]
+				} else {
+					lappend avoid [expr {$base + $regAddrOfst}]
+				}
+			}
+		}
+	}
+	set values [::mu3e::snapshot::read_words $master_fd $addresses $avoid]
+	set t_read [clock milliseconds]
+	set snapshot_ips [list]
+	foreach ip $ips {
+		lassign $ip type map bases
+		set copies [list]
+		foreach base $bases {
+			set words [dict create]
+			foreach reg [::mu3e::bspmap::registers $map] {
+				set address [expr {$base + [lindex $reg 1]}]
+				if {[dict exists $values $address]} {
+					dict set words [expr {[lindex $reg 1]}] [dict get $values $address]
+				}
+			}
+			lappend copies [dict create base [expr {$base}] t_ms $t_read words $words]
+		}
+		lappend snapshot_ips [dict create type $type map $map version [::mu3e::snapshot::map_version $map] copies $copies]
+	}
+	lset stats 3 [expr {[clock milliseconds] - $t_start}]
+	return [dict create t_ms $t_start elapsed_ms [lindex $stats 3] ips $snapshot_ips]
+}
+
+# package version of the bsp behind a bound map
+proc ::mu3e::snapshot::map_version {map} {
+	return [dict get [::mu3e::bspmap::describe $map] version]
+}
+
+######################################################################################################
+##  Arguments:
+##		<master_fd>  - opened master service path
+##		<snapshot>   - snapshot (see capture and load)
+##		<ips>        - list of {type map bases} of the board now, copies are matched by type and index
+##		-dry_run <0|1>  - only compare, write nothing (default 0)
+##
+##  Description:
+##  	Reads the current value of every register with read-write fields (block reads as in capture)
+##		and writes the registers whose read-write fields differ from the snapshot. Read-only bits are
+##		kept as they are now. Registers are written in address order, copy by copy.
+##
+##	Returns:
+##  	list of {type copy regName offset current restored}, the registers written (or to be written)
+##
+######################################################################################################
+proc ::mu3e::snapshot::restore {master_fd snapshot ips args} {
+	variable stats
+	set dry_run 0
+	foreach {option value} $args {
+		switch -- $option {
+			-dry_run {set dry_run $value}
+			default {
+				error "restore: unknown option \"${option}\", must be -dry_run"
+			}
+		}
+	}
+	set stats [list 0 0 0 0]
+	set t_start [clock milliseconds]
+	# 1) match the snapshot to the board now -> candidates {type copy base regName offset rw_mask saved}
+	set candidates [list]
+	set addresses [list]
+	set avoid [list]
+	foreach ip $ips {
+		lassign $ip type map bases
+		set saved_ip ""
+		foreach entry [dict get $snapshot ips] {
+			if {[dict get $entry type] eq $type} {
+				set saved_ip $entry
+			}
+		}
+		if {$saved_ip eq ""} {
+			continue
+		}
+		set saved_copies [dict get $saved_ip copies]
+		if {[llength $saved_copies] != [llength $bases]} {
+			toolkit_send_message warning "mu3e::snapshot: \"${type}\" has [llength $bases] copies, the snapshot [llength $saved_copies]"
+		}
+		if {[dict get $saved_ip version] ne [::mu3e::snapshot::map_version $map]} {
+			toolkit_send_message warning "mu3e::snapshot: \"${type}\" was saved with bsp version [dict get $saved_ip version]"
+		}
+		set copy 0
+		foreach base $bases saved_copy $saved_copies {
+			if {$base eq "" || $saved_copy eq ""} {
+				break
+			}
+			set words [dict get $saved_copy words]
+			foreach reg [::mu3e::bspmap::registers $map] {
+				lassign $reg regName regAddrOfst regDespt fields
+				lassign [::mu3e::snapshot::masks $fields] read_mask rw_mask
+				set address [expr {$base + $regAddrOfst}]
+				if {$read_mask == 0} {
+					lappend avoid $address
+				} elseif {$rw_mask != 0 && [dict exists $words [expr {$regAddrOfst}]]} {
+					lappend addresses $address
+					lappend candidates [list $type $copy $address $regName $regAddrOfst $rw_mask [dict get $words [expr {$regAddrOfst}]]]
+				}
+			}
+			incr copy
+		}
+	}
+	# 2) current values, write what differs
+	set values [::mu3e::snapshot::read_words $master_fd $addresses $avoid]
+	set changes [list]
+	lassign $stats n_read n_word n_write
+	foreach candidate $candidates {
+		lassign $candidate type copy address regName regAddrOfst rw_mask saved
+		set current [dict get $values $address]
+		if {($current & $rw_mask) == ($saved & $rw_mask)} {
+			continue
+		}
+		set restored [expr {($current & ~$rw_mask & 0xffffffff) | ($saved & $rw_mask)}]
+		if {!$dry_run} {
+			master_write_32 $master_fd $address $restored
+			incr n_write
+		}
+		lappend changes [list $type $copy $regName $regAddrOfst [format 0x%08x $current] [format 0x%08x $restored]]
+	}
+	set stats [list $n_read $n_word $n_write [expr {[clock milliseconds] - $t_start}]]
+	return $changes
+}
+
+######################################################################################################
+##  Arguments:
+##		<a>  - old snapshot
+##		<b>  - new snapshot
+##
+##  Description:
+##  	Compares two snapshots field by field, with the register map each IP is bound to now. IPs
+##		and copies are matched by type and index; a register only in one snapshot has "" on the
+##		other side.
+##
+##	Returns:
+##  	list of {type copy regName bitName old new}, field values in hex
+##
+######################################################################################################
+proc ::mu3e::snapshot::diff {a b} {
+	set result [list]
+	foreach ip [dict get $b ips] {
+		set type [dict get $ip type]
+		set registers [::mu3e::bspmap::registers [dict get $ip map]]
+		for {set copy 0} {$copy < [llength [dict get $ip copies]]} {incr copy} {
+			set words_a [::mu3e::snapshot::get_words $a $type $copy]
+			set words_b [::mu3e::snapshot::get_words $b $type $copy]
+			if {$words_a eq $words_b} {
+				continue
+			}
+			foreach reg $registers {
+				lassign $reg regName regAddrOfst regDespt fields
+				set offset [expr {$regAddrOfst}]
+				set old [expr {[dict exists $words_a $offset] ? [dict get $words_a $offset] : ""}]
+				set new [expr {[dict exists $words_b $offset] ? [dict get $words_b $offset] : ""}]
+				if {$old eq $new} {
+					continue
+				}
+				foreach field $fields {
+					lassign $field bitName bitLsb bitMsb
+					set mask [expr {(1 << ($bitMsb - $bitLsb + 1)) - 1}]
+					set old_value ""
+					set new_value ""
+					if {$old ne ""} {
+						set old_value [format 0x%x [expr {($old >> $bitLsb) & $mask}]]
+					}
+					if {$new ne ""} {
+						set new_value [format 0x%x [expr {($new >> $bitLsb) & $mask}]]
+					}
+					if {$old_value ne $new_value} {
+						lappend result [list $type $copy $regName $bitName $old_value $new_value]
+					}
+				}
+			}
+		}
+	}
+	return $result
+}
+
+# words of a copy in a snapshot, empty dict if the snapshot has no such copy
+proc ::mu3e::snapshot::get_words {snapshot type copy} {
+	foreach entry [dict get $snapshot ips] {
+		if {[dict get $entry type] eq $type && $copy < [llength [dict get $entry copies]]} {
+			return [dict get [lindex [dict get $entry copies] $copy] words]
+		}
+	}
+	return [dict create]
+}
+
+# n_read (block reads), n_word (words read), n_write, elapsed_ms of the last capture or restore
+proc ::mu3e::snapshot::get_stats {} {
+	variable stats
+	lassign $stats n_read n_word n_write elapsed_ms
+	return [dict create n_read $n_read n_word $n_word n_write $n_write elapsed_ms $elapsed_ms]
+}
+
+	###############################
+	# snapshot file
+	###############################
+	# "MU3ESNP1" t_ms(64 bit) elapsed_ms n_ip, then per ip: type map version n_copy, per copy: base,
+	# t_ms relative to the snapshot, n_run and per run: offset n_word words. Strings as in the
+	# mu3e::bspmap cache, numbers are 32 bit little endian unless noted.
+
+######################################################################################################
+##  Arguments:
+##		<snapshot>  - snapshot (see capture)
+##		<path>      - file to write
+##
+##  Description:
+##  	Writes a snapshot to a binary file. Words at consecutive offsets are stored as runs, so a
+##		word costs little more than its 4 bytes.
+##
+##	Returns:
+##  	number of bytes written
+##
+######################################################################################################
+proc ::mu3e::snapshot::save {snapshot path} {
+	set data "MU3ESNP1[binary format wii [dict get $snapshot t_ms] [dict get $snapshot elapsed_ms] [llength [dict get $snapshot ips]]]"
+	foreach ip [dict get $snapshot ips] {
+		append data [::mu3e::bspmap::put_string [dict get $ip type]] [::mu3e::bspmap::put_string [dict get $ip map]] \
+			[::mu3e::bspmap::put_string [dict get $ip version]] [binary format i [llength [dict get $ip copies]]]
+		foreach copy [dict get $ip copies] {
+			set runs [list]
+			set offsets [lsort -integer [dict keys [dict get $copy words]]]
+			foreach offset $offsets {
+				if {[llength $runs] > 0 && $offset == [lindex $runs end 0] + 4*[llength [lindex $runs end 1]]} {
+					lset runs end 1 [concat [lindex $runs end 1] [list [dict get $copy words $offset]]]
+				} else {
+					lappend runs [list $offset [list [dict get $copy words $offset]]]
+				}
+			}
+			append data [binary format iii [dict get $copy base] [expr {[dict get $copy t_ms] - [dict get $snapshot t_ms]}] [llength $runs]]
+			foreach run $runs {
+				lassign $run offset words
+				append data [binary format ii $offset [llength $words]] [binary format i* $words]
+			}
+		}
+	}
+	set fd [open $path w]
+	fconfigure $fd -translation binary
+	puts -nonewline $fd $data
+	close $fd
+	return [string length $data]
+}
+
+######################################################################################################
+##  Arguments:
+##		<path>  - snapshot file
+##
+##  Description:
+##  	Reads a snapshot file written by save.
+##
+##	Returns:
+##  	snapshot (see capture)
+##
+######################################################################################################
+proc ::mu3e::snapshot::load {path} {
+	set fd [open $path r]
+	fconfigure $fd -translation binary
+	set data [read $fd]
+	close $fd
+	if {[string range $data 0 7] ne "MU3ESNP1"} {
+		error "load: \"${path}\" is not a snapshot file"
+	}
+	binary scan $data @8wii t_ms elapsed_ms n_ip
+	set cursor 24
+	set ips [list]
+	for {set i 0} {$i < $n_ip} {incr i} {
+		set type [::mu3e::bspmap::get_string $data cursor]
+		set map [::mu3e::bspmap::get_string $data cursor]
+		set version [::mu3e::bspmap::get_string $data cursor]
+		binary scan $data @${cursor}i n_copy
+		incr cursor 4
+		set copies [list]
+		for {set c 0} {$c < $n_copy} {incr c} {
+			binary scan $data @${cursor}iuii base t_copy n_run
+			incr cursor 12
+			set words [dict create]
+			for {set r 0} {$r < $n_run} {incr r} {
+				binary scan $data @${cursor}ii offset n_word
+				incr cursor 8
+				binary scan $data @${cursor}iu${n_word} values
+				incr cursor [expr {4*$n_word}]
+				foreach value $values {
+					dict set words $offset $value
+					incr offset 4
+				}
+			}
+			lappend copies [dict create base $base t_ms [expr {$t_ms + $t_copy}] words $words]
+		}
+		lappend ips [dict create type $type map $map version $version copies $copies]
+	}
+	return [dict create t_ms $t_ms elapsed_ms $elapsed_ms ips $ips]
+}
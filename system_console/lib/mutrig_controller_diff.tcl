@@ -0,0 +1,293 @@
+###########################################################################################################
+# @Name 		mutrig_controller_diff.tcl
+#
+# @Brief		Semantic diff of MuTRiG configuration files. Both sides are mapped into the packed parameter
+#				layout of the MuTRiG (the order and bit positions of mutrig_controller::bsp, as shifted
+#				into the chip), so the diff reports changed parameters instead of changed lines. Bulk mode
+#				compares all configs of a directory and groups them by similarity.
+#
+# @Functions	layout, load, diff, distance, cluster
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 29, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require tdom
+package require mutrig_controller::bsp 	24.0
+package provide mutrig_controller::diff 	1.0
+
+namespace eval ::mutrig_controller::diff:: {
+	namespace export \
+	layout \
+	load \
+	diff \
+	distance \
+	cluster
+
+	# packed layout, list of {block channel parameter length ordering bit_offset}, built on first use
+	variable layout_list [list]
+	# "<block> <channel> <parameter>" -> index in the layout
+	variable layout_index
+	# path -> {mtime size config} of the configs loaded
+	variable configs
+	array set layout_index {}
+	array set configs {}
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Gets the packed parameter layout of one MuTRiG: Header, Channel (ch0 to ch31), TDC and Footer,
+##		parameters in the order of mutrig_controller::bsp::get_parameter_info, as generate_bit_stream
+##		packs them. Channel is "" outside the Channel block.
+##
+##	Returns:
+##  	list of {block channel parameter length ordering bit_offset}
+##
+######################################################################################################
+proc ::mutrig_controller::diff::layout {} {
+	variable layout_list
+	variable layout_index
+	if {[llength $layout_list] > 0} {
+		return $layout_list
+	}
+	set bit_offset 0
+	foreach block {"Header" "Channel" "TDC" "Footer"} {
+		set param_info [::mutrig_controller::bsp::get_parameter_info $block]
+		set channels [list ""]
+		if {$block eq "Channel"} {
+			set channels [list]
+			for {set ch 0} {$ch < 32} {incr ch} {
+				lappend channels "ch${ch}"
+			}
+		}
+		foreach channel $channels {
+			foreach param $param_info {
+				lassign $param name len order
+				set layout_index([list $block $channel $name]) [llength $layout_list]
+				lappend layout_list [list $block $channel $name $len $order $bit_offset]
+				incr bit_offset $len
+			}
+		}
+	}
+	return $layout_list
+}
+
+######################################################################################################
+##  Arguments:
+##		<path>  - configuration file (xml, as saved by the MuTRiG controller gui)
+##
+##  Description:
+##  	Loads a configuration into the packed layout. Parameters missing in the file are "",
+##		parameters the layout does not know are kept aside. A file is parsed once as long as its
+##		modification time and size stay the same.
+##
+##	Returns:
+##  	config, a dict with path, parts (partsDB key -> value), asics (index -> list of values in
+##		layout order) and unknown (list of {asic block channel parameter value})
+##
+######################################################################################################
+proc ::mutrig_controller::diff::load {path} {
+	variable configs
+	variable layout_index
+	set layout_list [::mutrig_controller::diff::layout]
+	file stat $path stat
+	if {[info exists configs($path)]} {
+		lassign $configs($path) mtime size config
+		if {$mtime == $stat(mtime) && $size == $stat(size)} {
+			return $config
+		}
+	}
+	set fd [open $path r]
+	set plain_text [read $fd]
+	close $fd
+	# the doctype is of no use here, its dtd is not next to the files
+	regsub {<!DOCTYPE[^>]*>} $plain_text "" plain_text
+	dom parse $plain_text doc
+	set parts [dict create]
+	foreach node [$doc selectNodes scifi_configurations/SMB/info/partsDB/*] {
+		dict set parts [$node nodeName] [$node text]
+	}
+	set asics [dict create]
+	set unknown [list]
+	set empty [lrepeat [llength $layout_list] ""]
+	foreach mutrig [$doc selectNodes scifi_configurations/SMB/mutrig] {
+		set asic [string trim [$mutrig selectNodes string(index)]]
+		set values $empty
+		foreach subField [$mutrig selectNodes parameters/*] {
+			set block [$subField nodeName]
+			if {$block eq "Channel"} {
+				set groups [$subField selectNodes *]
+			} else {
+				set groups [list $subField]
+			}
+			foreach group $groups {
+				set channel [expr {$block eq "Channel" ? [$group nodeName] : ""}]
+				foreach param [$group selectNodes *] {
+					set key [list $block $channel [$param nodeName]]
+					if {[info exists layout_index($key)]} {
+						lset values $layout_index($key) [string trim [$param text]]
+					} else {
+						lappend unknown [concat [list $asic] $key [list [string trim [$param text]]]]
+					}
+				}
+			}
+		}
+		dict set asics $asic $values
+	}
+	$doc delete
+	set config [dict create path $path parts $parts asics $asics unknown $unknown]
+	set configs($path) [list $stat(mtime) $stat(size) $config]
+	return $config
+}
+
+# config of a path or config dict
+proc ::mutrig_controller::diff::as_config {config} {
+	if {![catch {dict exists $config asics} is_config] && $is_config} {
+		return $config
+	}
+	return [::mutrig_controller::diff::load $config]
+}
+
+######################################################################################################
+##  Arguments:
+##		<a>  - config or path of the old side
+##		<b>  - config or path of the new side
+##
+##  Description:
+##  	Compares two configurations parameter by parameter. MuTRiGs with equal values are skipped as
+##		a whole, a MuTRiG only on one side reports all its parameters with "" on the other side.
+##
+##	Returns:
+##  	list of {asic block channel parameter old new}, in asic and layout order
+##
+######################################################################################################
+proc ::mutrig_controller::diff::diff {a b} {
+	set layout_list [::mutrig_controller::diff::layout]
+	set asics_a [dict get [::mutrig_controller::diff::as_config $a] asics]
+	set asics_b [dict get [::mutrig_controller::diff::as_config $b] asics]
+	set empty [lrepeat [llength $layout_list] ""]
+	set result [list]
+	foreach asic [lsort -dictionary -unique [concat [dict keys $asics_a] [dict keys $asics_b]]] {
+		set values_a [expr {[dict exists $asics_a $asic] ? [dict get $asics_a $asic] : $empty}]
+		set values_b [expr {[dict exists $asics_b $asic] ? [dict get $asics_b $asic] : $empty}]
+		if {$values_a eq $values_b} {
+			continue
+		}
+		foreach entry $layout_list old $values_a new $values_b {
+			if {$old ne $new} {
+				lassign $entry block channel name
+				lappend result [list $asic $block $channel $name $old $new]
+			}
+		}
+	}
+	return $result
+}
+
+# number of parameters that differ between two configs
+proc ::mutrig_controller::diff::distance {a b} {
+	return [llength [::mutrig_controller::diff::diff $a $b]]
+}
+
+######################################################################################################
+##  Arguments:
+##		<dir>               - directory of the configuration files
+##		-pattern <glob>     - file pattern (default "*.xml")
+##		-threshold <n>      - configs at most n parameters apart are linked into one cluster (default 8)
+##
+##  Description:
+##  	Loads all configurations of a directory and clusters them: two configs within the threshold
+##		are in the same cluster, and so is everything linked through a chain of such pairs (single
+##		linkage). The representative of a cluster is its member with the smallest total distance to
+##		the others. Files that do not parse are reported and left out.
+##
+##	Returns:
+##  	list of clusters, largest first, each a dict with representative, members (list of
+##		{path distance_to_representative}) and diameter (largest distance within the cluster)
+##
+######################################################################################################
+proc ::mutrig_controller::diff::cluster {dir args} {
+	set pattern "*.xml"
+	set threshold 8
+	foreach {option value} $args {
+		switch -- $option {
+			-pattern {set pattern $value}
+			-threshold {set threshold $value}
+			default {
+				error "cluster: unknown option \"${option}\", must be -pattern or -threshold"
+			}
+		}
+	}
+	set paths [list]
+	foreach path [lsort -dictionary [glob -nocomplain -type f -directory $dir $pattern]] {
+		if {[catch {::mutrig_controller::diff::load $path} msg]} {
+			toolkit_send_message warning "mutrig_controller::diff: skipping \"[file tail $path]\": $msg"
+			continue
+		}
+		lappend paths $path
+	}
+	set n [llength $paths]
+	# distances and union-find over the links
+	array set dist {}
+	set parent [list]
+	for {set i 0} {$i < $n} {incr i} {
+		lappend parent $i
+		set dist($i,$i) 0
+	}
+	for {set i 0} {$i < $n} {incr i} {
+		for {set j [expr {$i + 1}]} {$j < $n} {incr j} {
+			set d [::mutrig_controller::diff::distance [lindex $paths $i] [lindex $paths $j]]
+			set dist($i,$j) $d
+			set dist($j,$i) $d
+			if {$d <= $threshold} {
+				set root_i [::mutrig_controller::diff::find_root $parent $i]
+				set root_j [::mutrig_controller::diff::find_root $parent $j]
+				lset parent $root_j $root_i
+			}
+		}
+	}
+	array set members {}
+	for {set i 0} {$i < $n} {incr i} {
+		lappend members([::mutrig_controller::diff::find_root $parent $i]) $i
+	}
+	set clusters [list]
+	foreach root [array names members] {
+		set best ""
+		set best_sum ""
+		set diameter 0
+		foreach i $members($root) {
+			set sum 0
+			foreach j $members($root) {
+				incr sum $dist($i,$j)
+				set diameter [expr {max($diameter, $dist($i,$j))}]
+			}
+			if {$best_sum eq "" || $sum < $best_sum} {
+				set best $i
+				set best_sum $sum
+			}
+		}
+		set cluster_members [list]
+		foreach i $members($root) {
+			lappend cluster_members [list [lindex $paths $i] $dist($best,$i)]
+		}
+		lappend clusters [list [llength $members($root)] [dict create representative [lindex $paths $best] \
+			members [lsort -integer -index 1 $cluster_members] diameter $diameter]]
+	}
+	set result [list]
+	foreach entry [lsort -integer -decreasing -index 0 $clusters] {
+		lappend result [lindex $entry 1]
+	}
+	return $result
+}
+
+proc ::mutrig_controller::diff::find_root {parent i} {
+	while {[lindex $parent $i] != $i} {
+		set i [lindex $parent $i]
+	}
+	return $i
+}
@@ -13,9 +13,12 @@
 ###########################################################################################################
 
 package require mu3e::helpers 1.0
+package require mu3e::jobs 1.0
+package require mu3e::render 1.0
 package provide mutrig_controller::gui 1.0
 package require mutrig_controller::bsp 24.0
-package require dom::tcl 3.0
+package require mutrig_controller::diff 1.0
+package require dom::tdom 3.0
 package require tdom
 
 namespace eval ::mutrig_controller::gui:: {
@@ -103,6 +106,11 @@ proc ::mutrig_controller::gui::configure_all_chips {} {
 	} else {
 		toolkit_send_message debug "found this variable! its value is $n_asic"
 	}
+    # a second press stops the continuous configuration
+    if {[::mu3e::jobs::is_running "configure_chips"]} {
+        ::mu3e::jobs::cancel "configure_chips"
+        return -code ok
+    }
     
     # get bank and calculate relative asic index
     set bank [toolkit_get_property "bank_comboBox" selectedItem]
@@ -111,30 +119,126 @@ proc ::mutrig_controller::gui::configure_all_chips {} {
     } else {
         set asic_base 0
     }
-    while {1} {
-        toolkit_send_message warning "tx_engine_h2d_data: ////////////////////////////////////////////////"
-        toolkit_send_message warning "tx_engine_h2d_data: starting configure..."
-        for {set asic $asic_base} {[expr $asic < $n_asic+$asic_base]} {incr asic} { 
-            set asic_relative [expr $asic%4]
-            ::mutrig_controller::gui::tx_engine_h2d_data [::mutrig_controller::gui::generate_bit_stream $asic_relative] $asic
-            # time between asic (no so needed)
-            after 1
+    set csr_base [::mutrig_controller::gui::get_global_variable $fd_global_variable "mutrig_controller2.csr_base_address"]
+    set state [dict create asic_base $asic_base n_asic $n_asic asic $asic_base busy 0 n_pass 0 csr_base $csr_base]
+    if {[catch {::mu3e::jobs::start "configure_chips" [list ::mutrig_controller::gui::configure_chips_step] -state $state \
+        -resource "mutrig_controller@${csr_base}" -cleanup [list ::mutrig_controller::gui::configure_chips_cleanup] \
+        -done [list ::mutrig_controller::gui::configure_chips_done]} msg]} {
+        toolkit_send_message warning "configure_all_chips: $msg"
+        return -code error
+    }
+    toolkit_set_property "configButton" text "Stop"
+	return -code ok
+}
+
+# job step of configure_all_chips: send the next asic or poll the engine, one pass after the other
+# while "Continuously" is checked
+proc ::mutrig_controller::gui::configure_chips_step {name state} {
+    dict with state {}
+    if {$busy} {
+        # poll for progress (10 ms)
+        if {[::mutrig_controller::gui::tx_engine_h2d_busy]} {
+            return [list 10 $state]
         }
-        toolkit_send_message warning "tx_engine_h2d_data: configure done."
+        toolkit_send_message info "tx_engine_h2d_data: configure mutrig #${asic} done."
+        dict set state busy 0
+        ::mu3e::jobs::progress $name [expr {double($asic + 1 - $asic_base)/$n_asic}] "mutrig #${asic} done"
+        dict set state asic [incr asic]
+        # time between asic (no so needed)
+        return [list 1 $state]
+    }
+    if {$asic == $asic_base} {
         toolkit_send_message warning "tx_engine_h2d_data: ////////////////////////////////////////////////"
-        if {![toolkit_get_property "configCheckBox" checked]} {
-            break
-        }
-        # time between continuous configurations
-        after 2000
+        toolkit_send_message warning "tx_engine_h2d_data: starting configure..."
     }
-    
-        
-	return -code ok
+    if {$asic < $n_asic + $asic_base} {
+        ::mutrig_controller::gui::tx_engine_h2d_data [::mutrig_controller::gui::generate_bit_stream [expr {$asic%4}]] $asic
+        dict set state busy 1
+        return [list 10 $state]
+    }
+    toolkit_send_message warning "tx_engine_h2d_data: configure done."
+    toolkit_send_message warning "tx_engine_h2d_data: ////////////////////////////////////////////////"
+    dict set state n_pass [incr n_pass]
+    if {![toolkit_get_property "configCheckBox" checked]} {
+        return [list done $state]
+    }
+    # time between continuous configurations
+    dict set state asic $asic_base
+    return [list 2000 $state]
 }
 
+# cleanup of configure_all_chips: a stop in the middle of a pass leaves the chips before the current
+# one with the new configuration and the others with the old one. A transfer in flight is not
+# interrupted, the controller stays claimed until it is idle.
+proc ::mutrig_controller::gui::configure_chips_cleanup {name state} {
+    dict with state {}
+    if {$busy} {
+        ::mutrig_controller::gui::hold_until_idle $csr_base 5000 "configuration of mutrig #${asic}"
+    }
+    if {$busy || $asic != $asic_base} {
+        set last [expr {$busy ? $asic : $asic - 1}]
+        toolkit_send_message warning "configure_all_chips: pass [expr {$n_pass + 1}] incomplete, only mutrig #${asic_base} to #${last} got the new configuration"
+    }
+    return -code ok
+}
 
+######################################################################################################
+##  Arguments:
+##		<csr_base>   - base address of the controller csr, nonzero while a routine is running
+##		<timeout_ms> - longest wait
+##		<what>       - routine waited for, for the messages
+##
+##  Description:
+##  	Keeps the controller claimed (job resource "mutrig_controller@<csr_base>") until its running
+##		routine has finished, so a cancelled job does not let the next one write to a busy controller.
+##		Called from the cleanup of the jobs. After the timeout the claim is released with a warning.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mutrig_controller::gui::hold_until_idle {csr_base timeout_ms what} {
+    if {[catch {::mu3e::jobs::start "mutrig_controller_idle" [list ::mutrig_controller::gui::hold_until_idle_step] \
+        -state [dict create base $csr_base t_end [expr {[clock milliseconds] + $timeout_ms}] what $what] \
+        -resource "mutrig_controller@${csr_base}"} msg]} {
+        toolkit_send_message warning "hold_until_idle: $msg"
+    }
+    return -code ok
+}
+
+proc ::mutrig_controller::gui::hold_until_idle_step {name state} {
+    if {[master_read_32 [::mu3e::helpers::cget_opened_master_path] [dict get $state base] 1] == 0} {
+        return [list done $state]
+    }
+    if {[clock milliseconds] > [dict get $state t_end]} {
+        toolkit_send_message warning "hold_until_idle: [dict get $state what] still running, controller released anyway"
+        return [list done $state]
+    }
+    ::mu3e::jobs::progress $name 0.0 "waiting for the [dict get $state what] to finish"
+    return [list 10 $state]
+}
+
+proc ::mutrig_controller::gui::configure_chips_done {name status result} {
+    toolkit_set_property "configButton" text "Configure"
+    if {$status eq "cancelled"} {
+        toolkit_send_message warning "configure_all_chips: stopped after [dict get $result n_pass] complete configuration(s)"
+    }
+    return -code ok
+}
 
+######################################################################################################
+##  Arguments:
+##		<data_list>    - configuration words of the asic
+##		<mutrig_index> - index of the asic
+##
+##  Description:
+##  	Writes the configuration to the ram and starts the controller on it. Does not wait for the
+##		controller, poll tx_engine_h2d_busy for that.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
 proc ::mutrig_controller::gui::tx_engine_h2d_data {data_list mutrig_index} {
 	set fd_master_path [::mu3e::helpers::cget_opened_master_path]
 	variable fd_global_variable
@@ -154,19 +258,17 @@ proc ::mutrig_controller::gui::tx_engine_h2d_data {data_list mutrig_index} {
 	master_write_32 $fd_master_path [expr $csr_base+4] $cmd1
 	# step 2: write descriptor to trigger irq
 	master_write_32 $fd_master_path $csr_base $cmd0
-	# step 3: polling for progress
-	set running 1
-	while {$running} {
-		set progress [master_read_32 $fd_master_path $csr_base 1]
-		# todo: support err return from device
-		toolkit_send_message warning "tx_engine_h2d_data: progress is ${progress}"
-		if {[expr $progress == 0x0]} {
-			set running 0
-			toolkit_send_message info "tx_engine_h2d_data: configure mutrig #${mutrig_index} done."
-            break
-		}
-		after 10
-	}
+	return -code ok
+}
+
+# step 3: one poll of the controller progress, 1 while it is still busy
+proc ::mutrig_controller::gui::tx_engine_h2d_busy {} {
+	variable fd_global_variable
+	set csr_base [::mutrig_controller::gui::get_global_variable $fd_global_variable "mutrig_controller2.csr_base_address"]
+	set progress [master_read_32 [::mu3e::helpers::cget_opened_master_path] $csr_base 1]
+	# todo: support err return from device
+	toolkit_send_message debug "tx_engine_h2d_data: progress is ${progress}"
+	return [expr {$progress != 0x0}]
 }
 
 proc ::mutrig_controller::gui::generate_bit_stream {asic_id} {
@@ -616,11 +718,83 @@ proc ::mutrig_controller::gui::get_config_settings_from_comboBox {} {
 	# end of all loops, start to pack things up 
 	#puts [::dom::document cget $doc -doctype]
 	set plain_text [::dom::DOMImplementation serialize $doc -indent true -method xml]
+	# free the document (and its doctype), only the serialized text is kept
+	::dom::DOMImplementation destroy $doc
 	# TODO: try need to remove the DOCTYPE section, otherwise error will be reported from the parser
 	regsub -all {<!(.|\n|\r)*]>} $plain_text "" plain_text; # does not work at this line
 	#puts "xml (clean) file is: \n${plain_text}"
 	::mutrig_controller::gui::set_global_variable $fd_global_variable "doc_xml" $plain_text
-#	::dom::DOMImplementation destroy $doc
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<fileChooserButtonName> - name of the file chooser button in the toolkit gui
+##
+##  Description:
+##  	Compares the chosen xml with the one of "Load from XML" parameter by parameter and lists
+##	the differences.
+##
+##	Returns:
+##		-code ok	- if the operation has been successful
+##		-code error - if the file choosing has been aborted or a file cannot be read
+##
+######################################################################################################
+proc ::mutrig_controller::gui::diff_config_settings {fileChooserButtonName} {
+	if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
+		toolkit_send_message warning "diff_config_settings: file selection cancelled, byte~"
+		return -code error
+	}
+	set path_old [toolkit_get_property "loadXmlButton" paths]
+	set path_new [toolkit_get_property $fileChooserButtonName paths]
+	set t_start [clock milliseconds]
+	if {[catch {::mutrig_controller::diff::diff $path_old $path_new} changes]} {
+		toolkit_send_message error "diff_config_settings: $changes"
+		return -code error
+	}
+	::mu3e::render::table "configDiff_table" $changes -interval_ms 0
+	toolkit_set_property "configDiff_text" text [format "%s -> %s: %d parameter(s) differ (%d ms)" \
+		[file tail $path_old] [file tail $path_new] [llength $changes] [expr {[clock milliseconds] - $t_start}]]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<fileChooserButtonName> - name of the file chooser button in the toolkit gui
+##
+##  Description:
+##  	Clusters all xml files in the folder of the chosen file, files differing by at most the
+##	threshold number of parameters end up in one cluster. The clusters are listed in the text box.
+##
+##	Returns:
+##		-code ok	- if the operation has been successful
+##		-code error - if the file choosing has been aborted
+##
+######################################################################################################
+proc ::mutrig_controller::gui::cluster_config_settings {fileChooserButtonName} {
+	if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
+		toolkit_send_message warning "cluster_config_settings: file selection cancelled, byte~"
+		return -code error
+	}
+	set dir [file dirname [toolkit_get_property $fileChooserButtonName paths]]
+	set threshold [toolkit_get_property "clusterThreshold_textField" text]
+	set t_start [clock milliseconds]
+	set clusters [::mutrig_controller::diff::cluster $dir -threshold $threshold]
+	set lines [list]
+	set index 0
+	foreach cluster $clusters {
+		lappend lines [format "cluster %d (%d file(s), diameter %d), representative %s" $index \
+			[llength [dict get $cluster members]] [dict get $cluster diameter] [file tail [dict get $cluster representative]]]
+		foreach member [dict get $cluster members] {
+			if {[lindex $member 0] eq [dict get $cluster representative]} {
+				continue
+			}
+			lappend lines [format "    %s (%d)" [file tail [lindex $member 0]] [lindex $member 1]]
+		}
+		incr index
+	}
+	lappend lines [format "%d cluster(s) in %s (%d ms)" [llength $clusters] $dir [expr {[clock milliseconds] - $t_start}]]
+	toolkit_set_property "configDiff_text" text [join $lines "\n"]
 	return -code ok
 }
 
@@ -706,6 +880,23 @@ proc ::mutrig_controller::gui::setup_config_group {groupName n_asic} {
 	toolkit_set_property	"loadXmlButton"		paths						"./trash_bin/config.xml"; # some default path
 	toolkit_set_property	"loadXmlButton"		chooserButtonText 			"Load"
 	toolkit_set_property	"loadXmlButton"		onChoose 		{::mutrig_controller::gui::load_config_settings "loadXmlButton"} 
+	# create a button to compare xml with the one of "Load from XML"
+	toolkit_add				"diffXmlButton"		fileChooserButton 			"controlPanelGroup"
+	toolkit_set_property	"diffXmlButton"		text 						"Compare XML"
+	toolkit_set_property	"diffXmlButton"		paths						"./trash_bin/config.xml"; # some default path
+	toolkit_set_property	"diffXmlButton"		chooserButtonText 			"Compare"
+	toolkit_set_property	"diffXmlButton"		toolTip 					"list the parameters that differ from the file of \"Load from XML\""
+	toolkit_set_property	"diffXmlButton"		onChoose 		{::mutrig_controller::gui::diff_config_settings "diffXmlButton"} 
+	# create a button to cluster the xml files of a directory
+	toolkit_add				"clusterXmlButton"		fileChooserButton 			"controlPanelGroup"
+	toolkit_set_property	"clusterXmlButton"		text 						"Cluster XML folder"
+	toolkit_set_property	"clusterXmlButton"		paths						"./trash_bin/config.xml"; # some default path
+	toolkit_set_property	"clusterXmlButton"		chooserButtonText 			"Cluster"
+	toolkit_set_property	"clusterXmlButton"		toolTip 					"group all xml files in the folder of the chosen file by similarity"
+	toolkit_set_property	"clusterXmlButton"		onChoose 		{::mutrig_controller::gui::cluster_config_settings "clusterXmlButton"} 
+	toolkit_add				"clusterThreshold_textField"	textField		"controlPanelGroup"
+	toolkit_set_property	"clusterThreshold_textField"	label			"cluster threshold (parameters)"
+	toolkit_set_property	"clusterThreshold_textField"	text			8
 	## setup copy panel
 	toolkit_add				"copyGroup"			group			"controlPanelGroup"
 	toolkit_set_property	"copyGroup"			itemsPerRow		2
@@ -777,6 +968,25 @@ proc ::mutrig_controller::gui::setup_config_group {groupName n_asic} {
 	toolkit_set_property	"SN_textfield"		text			"3.0-005"
 	toolkit_set_property	"SN_textfield"		expandableX		1
     
+	# create a diff group in the bottom
+	toolkit_add				"configDiffGroup"		group 			$groupName
+	toolkit_set_property	"configDiffGroup"		itemsPerRow		1
+	toolkit_set_property	"configDiffGroup"		title			"Config differences"
+	
+	set columns [list "asic" "block" "channel" "parameter" "old" "new"]
+	toolkit_add				configDiff_table 	table			"configDiffGroup"
+	toolkit_set_property	configDiff_table    preferredWidth  600
+	toolkit_set_property	configDiff_table	rowCount		0
+	toolkit_set_property	configDiff_table	columnCount		[llength $columns]
+	for {set i 0} {$i < [llength $columns]} {incr i} {
+		toolkit_set_property	configDiff_table	columnIndex		$i
+		toolkit_set_property	configDiff_table	columnHeader	[lindex $columns $i]
+	}
+	toolkit_add				"configDiff_text"		text		"configDiffGroup"
+	toolkit_set_property	"configDiff_text"		editable	false
+	toolkit_set_property	"configDiff_text"		preferredWidth	600
+	toolkit_set_property	"configDiff_text"		text		""
+    
     # create a connection group
 	toolkit_add				"conGroup"		    group 			$groupName
 	toolkit_set_property	"conGroup"		    itemsPerRow		1
@@ -891,6 +1101,11 @@ proc ::mutrig_controller::gui::setup_tsa_page {baseGroupName n_asic} {
     toolkit_set_property	run_all_tsa_set				text				"Run scan"
     toolkit_set_property	run_all_tsa_set				onClick				{::mutrig_controller::gui::run_tsa "mutrig_controller2.csr"}
     
+    toolkit_add				"tsa_cancel_button"			button				tsaCtlrGroup
+    toolkit_set_property	tsa_cancel_button			text				"Stop waiting"
+    toolkit_set_property	tsa_cancel_button			enabled				false
+    toolkit_set_property	tsa_cancel_button			onClick				{::mu3e::jobs::cancel "tsa"}
+    
     
     toolkit_add				"save_tsa_plots_to_file_set"	fileChooserButton		tsaCtlrGroup
     toolkit_set_property	save_tsa_plots_to_file_set		chooserButtonText		"Save"
@@ -932,34 +1147,66 @@ proc ::mutrig_controller::gui::run_tsa {typeName} {
     # gvtable -> base address
     set ipBase [::mu3e::helpers::get_global_variable $fd_global_variable ${typeName}_base_address]
     
+    # the controller runs one routine at a time
+    foreach job [::mu3e::jobs::get_jobs] {
+        if {[lindex $job 1] eq "mutrig_controller@${ipBase}"} {
+            toolkit_send_message warning "run_tsa: controller is in use by job \"[lindex $job 0]\""
+            return -code error
+        }
+    }
     # 1) h2d command
     # write to controller to start tsa routine
-    master_write_32	$master_fd $ipBase "0x${tsa_start_cmd}" 
+    if {[catch {master_write_32 $master_fd $ipBase "0x${tsa_start_cmd}"} msg]} {
+        toolkit_send_message error "run_tsa: threshold scan not started: $msg"
+        return -code error
+    }
+    # 2) poll job, claims the controller before the event loop runs again
+    ::mu3e::jobs::start "tsa" [list ::mutrig_controller::gui::run_tsa_step] -state [dict create base $ipBase] \
+        -resource "mutrig_controller@${ipBase}" -cleanup [list ::mutrig_controller::gui::run_tsa_cleanup] \
+        -done [list ::mutrig_controller::gui::run_tsa_done]
     toolkit_send_message info "run_tsa: threshold scan started, running..."
-    # 2) poll for completion
-    while {1} {
-        # toggle button
-        toolkit_set_property "run_all_tsa_set" enabled false
-        set ctrl_csr [master_read_32 $master_fd $ipBase 0x1]
-        set prog_info [format %d [expr $ctrl_csr%64]]
-        # compl'
-        if {[expr $ctrl_csr] == 0} {
-            toolkit_set_property "run_all_tsa_set" enabled true
-            toolkit_send_message debug "run_tsa: tth scan completed! (63 / 63) "
-            break
-        }
-        # update scan progress
-        toolkit_set_property "run_all_tsa_set" text "${prog_info} / 63"
-        toolkit_send_message debug "run_tsa: tth scan progress: ${prog_info} / 63"
-        after 1000
+    # toggle button
+    toolkit_set_property "run_all_tsa_set" enabled false
+    toolkit_set_property "tsa_cancel_button" enabled true
+    return -code ok
+
+}
+
+# job step of run_tsa: 2) poll for completion, once a second
+proc ::mutrig_controller::gui::run_tsa_step {name state} {
+    set ctrl_csr [master_read_32 [::mu3e::helpers::cget_opened_master_path] [dict get $state base] 0x1]
+    set prog_info [format %d [expr $ctrl_csr%64]]
+    # compl'
+    if {[expr $ctrl_csr] == 0} {
+        toolkit_send_message debug "run_tsa: tth scan completed! (63 / 63) "
+        return [list done $state]
     }
+    # update scan progress
+    toolkit_set_property "run_all_tsa_set" text "${prog_info} / 63"
+    toolkit_send_message debug "run_tsa: tth scan progress: ${prog_info} / 63"
+    ::mu3e::jobs::progress $name [expr {$prog_info/63.0}] "${prog_info} / 63"
+    return [list 1000 $state]
+}
+
+# cleanup of run_tsa: the controller finishes the scan on its own, keep it claimed until then
+proc ::mutrig_controller::gui::run_tsa_cleanup {name state} {
+    ::mutrig_controller::gui::hold_until_idle [dict get $state base] 300000 "threshold scan"
+    return -code ok
+}
+
+proc ::mutrig_controller::gui::run_tsa_done {name status result} {
+    toolkit_set_property "run_all_tsa_set" enabled true
     toolkit_set_property "run_all_tsa_set" text "Run scan"
+    toolkit_set_property "tsa_cancel_button" enabled false
+    if {$status ne "ok"} {
+        # the controller finishes the scan on its own, run_tsa_cleanup keeps it claimed until then
+        toolkit_send_message warning "run_tsa: stopped waiting for the threshold scan (${status})"
+        return -code ok
+    }
     toolkit_send_message info "run_tsa: threshold scan completed!"
     # 3) plot results
     ::mutrig_controller::gui::plot_tsa "mutrig_controller2.scan_result" 
-    
     return -code ok
-
 }
 
 
@@ -985,12 +1232,14 @@ proc ::mutrig_controller::gui::plot_tsa {typeName} {
             # 2) read result for this channel 
 			set result_of_one_channel [master_read_32 $master_fd "0x${read_starting_addr}" 64]
             # 3) plot for this channel 
+			set points [list]
 			set step_tth 0
 			foreach result_of_one_channel_one_step $result_of_one_channel {
-				set result_of_one_channel_one_step [format %i [expr $result_of_one_channel_one_step]]
-				toolkit_set_property "tsa${i}_${ch}LineC" itemValue [list $step_tth [expr $result_of_one_channel_one_step]]
+				lappend points [list $step_tth [format %i [expr $result_of_one_channel_one_step]]]
 				incr step_tth
 			}
+			# a repeated scan only redraws the points that changed
+			::mu3e::render::series "tsa${i}_${ch}LineC" $points -interval_ms 0
             # 4) store the result 
 			lappend tsa_all_plots $result_of_one_channel
 		}
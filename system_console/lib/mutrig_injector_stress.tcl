@@ -0,0 +1,437 @@
+###########################################################################################################
+# @Name 		mutrig_injector_stress.tcl
+#
+# @Brief		Throughput stress test of the data path, driven by the MuTRiG Injector IP core. Sweeps
+#				the injection rate and multiplicity; at every point the pipeline settles, then the hit
+#				counters of the downstream IPs are taken in one batch (see mu3e::accounting) before and
+#				after a dwell. The result is the saturation curve and the first stage dropping hits, as
+#				compact binary table and text summary.
+#
+# @Functions	configure, start, cancel, is_running, get_curve, write_result, read_result, write_summary
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 24, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package require mu3e::helpers 	1.0
+package require mu3e::accounting 	1.0
+package provide mutrig_injector::stress 	1.0
+
+namespace eval ::mutrig_injector::stress:: {
+	namespace export \
+	configure \
+	start \
+	cancel \
+	is_running \
+	get_curve \
+	write_result \
+	read_result \
+	write_summary
+
+	variable inj_base 0x0
+	# inject_mode of the sweep, see mutrig_injector::bsp
+	variable mode "header_sync"
+	# header_sync: header_interval (in headers), periodic*: pulse_interval (in clock cycles)
+	variable intervals [list 64 32 16 8 4 2 1]
+	# header_sync only: header_multiplicity (pulses per injection)
+	variable multiplicities [list 1]
+	variable pulse_high 4
+	variable settle_ms 500
+	variable dwell_ms 1000
+	variable running 0
+	variable after_id ""
+	variable done_callback ""
+	variable progress_callback ""
+	# sweep points {interval multiplicity}, current index
+	variable points [list]
+	variable index 0
+	# injector registers before the sweep, restored at the end
+	variable saved [list]
+	variable snapshot_start [dict create]
+	# list of {interval multiplicity time_s chain}, chain as mu3e::accounting::chain
+	variable results [list]
+	variable t_run 0
+}
+
+######################################################################################################
+##  Arguments:
+##		-inj_base <addr>        - base address of the injector csr
+##		-mode <mode>            - header_sync (default), periodic, periodic_async or random
+##		-intervals <list>       - injection intervals, header_interval for header_sync and
+##								  pulse_interval for the other modes
+##		-multiplicities <list>  - header_multiplicity values (header_sync only)
+##		-pulse_high <cycles>    - pulse_high of the periodic modes (default 4)
+##		-settle_ms <ms>         - time for the pipeline to settle after a change (default 500)
+##		-dwell_ms <ms>          - counting time per point (default 1000)
+##
+##  Description:
+##  	Configures the sweep. The counters are read with mu3e::accounting, configured separately.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mutrig_injector::stress::configure {args} {
+	variable running
+	if {$running} {
+		error "configure: a stress test is running"
+	}
+	set names {inj_base mode intervals multiplicities pulse_high settle_ms dwell_ms}
+	foreach {option value} $args {
+		set name [string range $option 1 end]
+		if {[lsearch -exact $names $name] < 0} {
+			error "configure: unknown option \"${option}\", must be one of -[join $names {, -}]"
+		}
+		if {$name eq "mode" && [lsearch -exact {header_sync periodic periodic_async random} $value] < 0} {
+			error "configure: mode must be header_sync, periodic, periodic_async or random, got \"${value}\""
+		}
+		variable $name
+		set $name $value
+	}
+	return -code ok
+}
+
+proc ::mutrig_injector::stress::is_running {} {
+	variable running
+	return $running
+}
+
+# inject_mode value of a mode name, -1 if unknown
+proc ::mutrig_injector::stress::mode_code {mode} {
+	return [lsearch -exact {off header_sync periodic periodic_async onclick random} $mode]
+}
+
+######################################################################################################
+##  Arguments:
+##		-done <cmd>     - called when the sweep ends, with 1 if it completed and 0 if cancelled
+##		-progress <cmd> - called after every point with the number of done and total points
+##
+##  Description:
+##  	Starts the sweep in the background (event loop), returns immediately. For every
+##		multiplicity, the intervals run from the longest to the shortest, so the rate goes up.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mutrig_injector::stress::start {args} {
+	variable running
+	variable done_callback
+	variable progress_callback
+	variable inj_base
+	variable mode
+	variable intervals
+	variable multiplicities
+	variable points
+	variable index
+	variable saved
+	variable results
+	variable t_run
+	if {$running} {
+		error "start: a stress test is running"
+	}
+	set done_callback ""
+	set progress_callback ""
+	foreach {option value} $args {
+		switch -- $option {
+			-done {
+				set done_callback $value
+			}
+			-progress {
+				set progress_callback $value
+			}
+			default {
+				error "start: unknown option \"${option}\", must be -done or -progress"
+			}
+		}
+	}
+	set points [list]
+	foreach multiplicity [expr {$mode eq "header_sync" ? $multiplicities : [list 1]}] {
+		foreach interval [lsort -integer -decreasing $intervals] {
+			lappend points [list $interval $multiplicity]
+		}
+	}
+	if {[llength $points] == 0} {
+		error "start: no sweep point"
+	}
+	set saved [master_read_32 [::mu3e::helpers::cget_opened_master_path] $inj_base 7]
+	set results [list]
+	set index 0
+	set t_run [clock seconds]
+	set running 1
+	::mutrig_injector::stress::run_stage ::mutrig_injector::stress::apply_point
+	return -code ok
+}
+
+# runs a stage, an error stops the sweep and restores the injector instead of leaving it injecting
+proc ::mutrig_injector::stress::run_stage {stage} {
+	variable running
+	if {!$running} {
+		return -code ok
+	}
+	if {[catch {$stage} error_msg]} {
+		toolkit_send_message error "mutrig_injector::stress: [namespace tail $stage] failed, stress test stopped: $error_msg"
+		::mutrig_injector::stress::finish 0
+	}
+	return -code ok
+}
+
+proc ::mutrig_injector::stress::cancel {} {
+	variable running
+	variable after_id
+	if {$running} {
+		after cancel $after_id
+		::mutrig_injector::stress::finish 0
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Stages of a point: apply_point stops the injection, writes the point and restarts it,
+##		begin_dwell takes the first snapshot once the pipeline settled and end_dwell the second one
+##		after the dwell, and adds the point to the result.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mutrig_injector::stress::apply_point {} {
+	variable inj_base
+	variable mode
+	variable pulse_high
+	variable settle_ms
+	variable points
+	variable index
+	variable after_id
+	set master_fd [::mu3e::helpers::cget_opened_master_path]
+	lassign [lindex $points $index] interval multiplicity
+	master_write_32 $master_fd $inj_base 0x0
+	if {$mode eq "header_sync"} {
+		master_write_32 $master_fd [expr {$inj_base + 0x8}] $interval
+		master_write_32 $master_fd [expr {$inj_base + 0xc}] $multiplicity
+	} else {
+		master_write_32 $master_fd [expr {$inj_base + 0x14}] $interval
+		master_write_32 $master_fd [expr {$inj_base + 0x18}] $pulse_high
+	}
+	master_write_32 $master_fd $inj_base [::mutrig_injector::stress::mode_code $mode]
+	set after_id [after $settle_ms [list ::mutrig_injector::stress::run_stage ::mutrig_injector::stress::begin_dwell]]
+	return -code ok
+}
+
+proc ::mutrig_injector::stress::begin_dwell {} {
+	variable dwell_ms
+	variable snapshot_start
+	variable after_id
+	set snapshot_start [::mu3e::accounting::snapshot]
+	set after_id [after $dwell_ms [list ::mutrig_injector::stress::run_stage ::mutrig_injector::stress::end_dwell]]
+	return -code ok
+}
+
+proc ::mutrig_injector::stress::end_dwell {} {
+	variable snapshot_start
+	variable points
+	variable index
+	variable results
+	variable progress_callback
+	set snapshot_end [::mu3e::accounting::snapshot]
+	set time_s [expr {[dict get $snapshot_end t] - [dict get $snapshot_start t]}]
+	set sum [::mu3e::accounting::deltas $snapshot_start $snapshot_end $time_s]
+	lassign [lindex $points $index] interval multiplicity
+	lappend results [list $interval $multiplicity $time_s [::mu3e::accounting::chain $sum $time_s]]
+	incr index
+	if {$progress_callback ne ""} {
+		{*}$progress_callback $index [llength $points]
+	}
+	if {$index < [llength $points]} {
+		::mutrig_injector::stress::apply_point
+	} else {
+		::mutrig_injector::stress::finish 1
+	}
+	return -code ok
+}
+
+# restores the injector as found
+proc ::mutrig_injector::stress::finish {completed} {
+	variable running
+	variable done_callback
+	variable inj_base
+	variable saved
+	variable after_id
+	after cancel $after_id
+	set running 0
+	if {[catch {
+		set master_fd [::mu3e::helpers::cget_opened_master_path]
+		master_write_32 $master_fd $inj_base 0x0
+		set offset 0x4
+		foreach word [lrange $saved 1 end] {
+			master_write_32 $master_fd [expr {$inj_base + $offset}] $word
+			incr offset 4
+		}
+		master_write_32 $master_fd $inj_base [lindex $saved 0]
+	} error_msg]} {
+		toolkit_send_message error "mutrig_injector::stress: restoring the injector failed: $error_msg"
+	}
+	if {$done_callback ne ""} {
+		if {[catch {{*}$done_callback $completed} error_msg]} {
+			toolkit_send_message error "mutrig_injector::stress: done callback failed: $error_msg"
+		}
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Gets the saturation curve of the last sweep: hits arriving at the first stage (offered)
+##		against hits leaving the last one (delivered). A point saturates when the end-to-end
+##		efficiency falls below 1 - loss_threshold of mu3e::accounting, or a stage is flagged.
+##
+##	Returns:
+##  	list of {interval multiplicity offered delivered efficiency first_stage saturated}, rates in
+##		hits/s, first_stage the name of the first stage dropping hits ("" if none)
+##
+######################################################################################################
+proc ::mutrig_injector::stress::get_curve {} {
+	variable results
+	set curve [list]
+	foreach result $results {
+		lassign $result interval multiplicity time_s chain
+		set rows [dict get $chain rows]
+		set offered [lindex $rows 0 1]
+		set delivered [lindex $rows end 2]
+		set efficiency [expr {$offered > 0 ? $delivered/$offered : 1.0}]
+		set first [dict get $chain first]
+		set first_stage [expr {$first < 0 ? "" : [lindex $rows $first 0]}]
+		set saturated [expr {$first >= 0 || $efficiency < 1.0 - $::mu3e::accounting::loss_threshold}]
+		lappend curve [list $interval $multiplicity $offered $delivered $efficiency $first_stage $saturated]
+	}
+	return $curve
+}
+
+######################################################################################################
+##  Arguments:
+##		<file_path> - result file
+##
+##  Description:
+##  	Writes the last sweep as binary table, little endian:
+##		   8 bytes  "INJST001"
+##		   header   n_point, n_stage, settle_ms, dwell_ms (int32), t_run (int64)
+##		   records  interval, multiplicity (int32), time_s (float32), first (int8, -1 if none),
+##		            3 pad bytes, then per stage rate_in, rate_out, transfer_loss, internal_loss
+##		            (float32, -1 where not defined), then crc_rate, bad_frame_rate (float32)
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::mutrig_injector::stress::write_result {file_path} {
+	variable results
+	variable settle_ms
+	variable dwell_ms
+	variable t_run
+	set n_stage [expr {[llength $results] ? [llength [dict get [lindex $results 0 3] rows]] : 0}]
+	set fd [open $file_path w]
+	fconfigure $fd -translation binary
+	puts -nonewline $fd "INJST001"
+	puts -nonewline $fd [binary format iiiiw [llength $results] $n_stage $settle_ms $dwell_ms $t_run]
+	foreach result $results {
+		lassign $result interval multiplicity time_s chain
+		set values [list]
+		foreach row [dict get $chain rows] {
+			foreach value [lrange $row 1 4] {
+				lappend values [expr {$value eq "" ? -1.0 : $value}]
+			}
+		}
+		lappend values [dict get $chain crc_rate] [dict get $chain bad_frame_rate]
+		puts -nonewline $fd [binary format iifcx3f* $interval $multiplicity $time_s [dict get $chain first] $values]
+	}
+	close $fd
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<file_path> - result file written by write_result
+##
+##  Description:
+##  	Reads a binary result table back.
+##
+##	Returns:
+##  	dict with n_point, n_stage, settle_ms, dwell_ms, t_run and points, a list of {interval
+##		multiplicity time_s first stages crc_rate bad_frame_rate}, stages a list of {rate_in rate_out
+##		transfer_loss internal_loss}
+##
+######################################################################################################
+proc ::mutrig_injector::stress::read_result {file_path} {
+	set fd [open $file_path r]
+	fconfigure $fd -translation binary
+	set data [read $fd]
+	close $fd
+	if {[string range $data 0 7] ne "INJST001"} {
+		error "read_result: ${file_path} is not a stress test result"
+	}
+	binary scan $data @8iiiiw n_point n_stage settle_ms dwell_ms t_run
+	set points [list]
+	set record_size [expr {16 + 4*(4*$n_stage + 2)}]
+	for {set i 0} {$i < $n_point} {incr i} {
+		set offset [expr {32 + $i*$record_size}]
+		binary scan $data @${offset}iiufcx3f[expr {4*$n_stage + 2}] interval multiplicity time_s first values
+		set stages [list]
+		for {set stage 0} {$stage < $n_stage} {incr stage} {
+			lappend stages [lrange $values [expr {4*$stage}] [expr {4*$stage + 3}]]
+		}
+		lappend points [list $interval $multiplicity $time_s $first $stages [lindex $values end-1] [lindex $values end]]
+	}
+	return [dict create n_point $n_point n_stage $n_stage settle_ms $settle_ms dwell_ms $dwell_ms t_run $t_run points $points]
+}
+
+######################################################################################################
+##  Arguments:
+##		<file_path> - summary file
+##
+##  Description:
+##  	Writes the text summary of the last sweep: the curve, the highest rate delivered without
+##		loss and the first stage dropping hits beyond it.
+##
+##	Returns:
+##  	summary text (also written to the file)
+##
+######################################################################################################
+proc ::mutrig_injector::stress::write_summary {file_path} {
+	variable mode
+	variable settle_ms
+	variable dwell_ms
+	variable t_run
+	set text "stress test [clock format $t_run -format {%Y-%m-%d %H:%M:%S}], mode ${mode}, settle ${settle_ms} ms, dwell ${dwell_ms} ms\n"
+	append text [format "%10s %6s %14s %14s %8s  %s\n" interval mult "offered (1/s)" "delivered (1/s)" "eff (%)" "first stage dropping"]
+	set best ""
+	set drop ""
+	foreach point [::mutrig_injector::stress::get_curve] {
+		lassign $point interval multiplicity offered delivered efficiency first_stage saturated
+		append text [format "%10d %6d %14.1f %14.1f %8.2f  %s\n" $interval $multiplicity $offered $delivered \
+			[expr {100.0*$efficiency}] [expr {$first_stage eq "" ? "-" : $first_stage}]]
+		if {!$saturated && ($best eq "" || $delivered > $best)} {
+			set best $delivered
+		}
+		if {$saturated && $drop eq "" && $first_stage ne ""} {
+			set drop $first_stage
+		}
+	}
+	if {$best ne ""} {
+		append text [format "highest rate delivered without loss: %.1f hits/s\n" $best]
+	}
+	append text "first stage dropping hits: [expr {$drop eq "" ? "none" : $drop}]\n"
+	set fd [open $file_path w]
+	puts -nonewline $fd $text
+	close $fd
+	return $text
+}
@@ -2,6 +2,24 @@
 
 # some helper packages 
 package ifneeded mu3e::helpers 1.0 [list source [file join $dir mu3e_helpers.tcl]]
+package ifneeded mu3e::monitor 1.0 [list source [file join $dir mu3e_monitor.tcl]]
+package ifneeded counter_avmm::history 1.0 [list source [file join $dir counter_avmm_history.tcl]]
+package ifneeded lvds_rx::health 1.0 [list source [file join $dir lvds_rx_health.tcl]]
+package ifneeded lvds_rx::sweep 1.0 [list source [file join $dir lvds_rx_sweep.tcl]]
+package ifneeded histogram_statistics::acq 1.0 [list source [file join $dir histogram_statistics_acq.tcl]]
+package ifneeded histogram_statistics::histogram 1.0 [list source [file join $dir histogram_statistics_histogram.tcl]]
+package ifneeded histogram_statistics::stitch 1.0 [list source [file join $dir histogram_statistics_stitch.tcl]]
+package ifneeded histogram_statistics::adaptive 1.0 [list source [file join $dir histogram_statistics_adaptive.tcl]]
+package ifneeded runctl_mgmt_host::latency 1.0 [list source [file join $dir runctl_latency.tcl]]
+package ifneeded mu3e::accounting 1.0 [list source [file join $dir mu3e_accounting.tcl]]
+package ifneeded ring_buffer_cam::telemetry 1.0 [list source [file join $dir ring_buffer_cam_telemetry.tcl]]
+package ifneeded mutrig_injector::stress 1.0 [list source [file join $dir mutrig_injector_stress.tcl]]
+package ifneeded frame_deassembly::errors 1.0 [list source [file join $dir frame_deassembly_errors.tcl]]
+package ifneeded mu3e::jobs 1.0 [list source [file join $dir mu3e_jobs.tcl]]
+package ifneeded mu3e::render 1.0 [list source [file join $dir mu3e_render.tcl]]
+package ifneeded mu3e::bspmap 1.0 [list source [file join $dir mu3e_bspmap.tcl]]
+package ifneeded mu3e::snapshot 1.0 [list source [file join $dir mu3e_snapshot.tcl]]
+package ifneeded mutrig_controller::diff 1.0 [list source [file join $dir mutrig_controller_diff.tcl]]
 # some gui packages
 package ifneeded mutrig_controller::gui 1.0 [list source [file join $dir mutrig_controller_toolkit_gui.tcl]]
 package ifneeded data_path_bts::gui 1.0 [list source [file join $dir data_path_toolkit_gui.tcl]]
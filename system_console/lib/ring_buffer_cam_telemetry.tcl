@@ -0,0 +1,278 @@
+###########################################################################################################
+# @Name 		ring_buffer_cam_telemetry.tcl
+#
+# @Brief		Occupancy and cache-miss telemetry of the ring-buffer CAM copies. Fed with the register
+#				block of every copy at a high rate (see mu3e::monitor), it keeps per copy a sliding-window
+#				fill-level distribution, push/pop/overwrite/cache-miss rates over the window and the peak
+#				occupancy, all in fixed memory, to size the expected latency against real rates.
+#
+# @Functions	configure, reset, update, get_status, get_distribution
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 23, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package provide ring_buffer_cam::telemetry 	1.0
+
+namespace eval ::ring_buffer_cam::telemetry:: {
+	namespace export \
+	configure \
+	reset \
+	update \
+	get_status \
+	get_distribution
+
+	# samples in the sliding window (1200 samples = 60 s at 50 ms)
+	variable window_n 1200
+	# fill-level distribution: n_bin bins of bin_width, the last bin takes everything above
+	variable bin_width 16
+	variable n_bin 64
+	# copy -> {pos n seq}, position in the ring, samples in the ring, samples seen
+	variable state
+	# copy -> ring of {fill bin dt d_push d_pop d_overwrite d_miss d_inerr}
+	variable ring
+	# copy -> fill-level counts of the window
+	variable hist
+	# copy -> window sums {dt push pop overwrite miss inerr fill}
+	variable sums
+	# copy -> {seq fill} candidates for the window peak, decreasing fill (monotonic queue)
+	variable peaks
+	# copy -> {fill t} of the highest fill level seen since reset
+	variable peak_all
+	# copy -> {t push pop overwrite miss inerr} of the last sample
+	variable last
+	# copy -> {csr expected_latency fill} of the last sample
+	variable current
+	array set state {}
+	array set ring {}
+	array set hist {}
+	array set sums {}
+	array set peaks {}
+	array set peak_all {}
+	array set last {}
+	array set current {}
+}
+
+######################################################################################################
+##  Arguments:
+##		-window_n <n>   - samples in the sliding window (default 1200)
+##		-bin_width <n>  - bin width of the fill-level distribution in hits (default 16)
+##		-n_bin <n>      - bins of the distribution (default 64)
+##
+##  Description:
+##  	Configures the sampler, resets all copies.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::ring_buffer_cam::telemetry::configure {args} {
+	foreach {option value} $args {
+		switch -- $option {
+			-window_n - -bin_width - -n_bin {
+				if {$value < 1} {
+					error "configure: ${option} must be positive, got ${value}"
+				}
+				variable [string range $option 1 end]
+				set [string range $option 1 end] $value
+			}
+			default {
+				error "configure: unknown option \"${option}\", must be -window_n, -bin_width or -n_bin"
+			}
+		}
+	}
+	::ring_buffer_cam::telemetry::reset
+	return -code ok
+}
+
+proc ::ring_buffer_cam::telemetry::reset {} {
+	foreach name {state ring hist sums peaks peak_all last current} {
+		variable $name
+		array unset $name
+	}
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<copy>  - index of the copy
+##		<words> - csr words from offset 0x0 to 0x1c (csr, latency, fill_level, inerr_count,
+##				  push_count, pop_count, overwrite_count, cache_miss_count)
+##		<t>     - time of the reading in s (default: now)
+##
+##  Description:
+##  	Adds a sample of a copy. The fill level goes to the distribution and the peak tracking, the
+##		counter differences (32 bit wrap) to the rates. When the window is full, the oldest sample
+##		is taken out of all of them, so every update costs the same and memory stays constant.
+##		The first sample of a copy only sets the counter reference.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::ring_buffer_cam::telemetry::update {copy words {t ""}} {
+	variable window_n
+	variable bin_width
+	variable n_bin
+	variable state
+	variable ring
+	variable hist
+	variable sums
+	variable peaks
+	variable peak_all
+	variable last
+	variable current
+	if {$t eq ""} {
+		set t [expr {[clock milliseconds]/1000.0}]
+	}
+	set values [list]
+	foreach word $words {
+		lappend values [expr {$word & 0xffffffff}]
+	}
+	lassign $values csr latency fill inerr push pop overwrite miss
+	set current($copy) [list $csr [expr {$latency & 0xffff}] $fill]
+	if {![info exists last($copy)]} {
+		set last($copy) [list $t $push $pop $overwrite $miss $inerr]
+		set state($copy) [list 0 0 0]
+		set ring($copy) [lrepeat $window_n {}]
+		set hist($copy) [lrepeat $n_bin 0]
+		set sums($copy) [list 0.0 0 0 0 0 0 0]
+		set peaks($copy) [list]
+		set peak_all($copy) [list $fill $t]
+		return -code ok
+	}
+	# counter differences
+	set sample [list $fill [expr {min($n_bin - 1, $fill/$bin_width)}] [expr {$t - [lindex $last($copy) 0]}]]
+	foreach now [list $push $pop $overwrite $miss $inerr] before [lrange $last($copy) 1 end] {
+		lappend sample [expr {($now - $before) & 0xffffffff}]
+	}
+	set last($copy) [list $t $push $pop $overwrite $miss $inerr]
+	lassign $state($copy) pos n seq
+	# take out the oldest sample
+	if {$n == $window_n} {
+		set old [lindex $ring($copy) $pos]
+		::ring_buffer_cam::telemetry::accumulate $copy $old -1
+	} else {
+		incr n
+	}
+	lset ring($copy) $pos $sample
+	::ring_buffer_cam::telemetry::accumulate $copy $sample 1
+	# window peak: drop the candidates that left the window or that the new sample dominates
+	set first_seq [expr {$seq - $n + 1}]
+	set candidates [list]
+	foreach peak $peaks($copy) {
+		lassign $peak peak_seq peak_fill
+		if {$peak_seq >= $first_seq && $peak_fill > $fill} {
+			lappend candidates $peak
+		}
+	}
+	lappend candidates [list $seq $fill]
+	set peaks($copy) $candidates
+	if {$fill > [lindex $peak_all($copy) 0]} {
+		set peak_all($copy) [list $fill $t]
+	}
+	set state($copy) [list [expr {($pos + 1) % $window_n}] $n [expr {$seq + 1}]]
+	return -code ok
+}
+
+# adds (sign 1) or removes (sign -1) a sample from the window sums and the distribution
+proc ::ring_buffer_cam::telemetry::accumulate {copy sample sign} {
+	variable hist
+	variable sums
+	lassign $sample fill bin dt d_push d_pop d_overwrite d_miss d_inerr
+	lset hist($copy) $bin [expr {[lindex $hist($copy) $bin] + $sign}]
+	set result [list]
+	foreach sum $sums($copy) value [list $dt $d_push $d_pop $d_overwrite $d_miss $d_inerr $fill] {
+		lappend result [expr {$sum + $sign*$value}]
+	}
+	set sums($copy) $result
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<copy>  - index of the copy
+##
+##  Description:
+##  	Gets the statistics of a copy over the window. The mean residence time follows from the mean
+##		fill level and the pop rate (Little's law) and is to be compared with the expected latency,
+##		which the buffer holds every hit for. Percentiles are the upper edges of the bins.
+##
+##	Returns:
+##  	dict with n (samples in the window), window_s, fill, mean, p50, p99, p999, peak (window),
+##		peak_all, peak_all_t, push_rate, pop_rate, overwrite_rate, miss_rate, inerr_rate (in 1/s),
+##		overwrite_fraction (of the pushes), expected_latency (8 ns) and residence_ns; empty before the
+##		second sample
+##
+######################################################################################################
+proc ::ring_buffer_cam::telemetry::get_status {copy} {
+	variable state
+	variable sums
+	variable peaks
+	variable peak_all
+	variable current
+	if {![info exists state($copy)] || [lindex $state($copy) 1] == 0} {
+		return [dict create]
+	}
+	set n [lindex $state($copy) 1]
+	lassign $sums($copy) dt push pop overwrite miss inerr fill_sum
+	lassign $current($copy) csr expected_latency fill
+	set mean [expr {double($fill_sum)/$n}]
+	set pop_rate [expr {$dt > 0 ? $pop/$dt : 0.0}]
+	set result [dict create n $n window_s $dt fill $fill mean $mean]
+	foreach name {p50 p99 p999} fraction {0.5 0.99 0.999} {
+		dict set result $name [::ring_buffer_cam::telemetry::percentile $copy $fraction]
+	}
+	dict set result peak [lindex $peaks($copy) 0 1]
+	dict set result peak_all [lindex $peak_all($copy) 0]
+	dict set result peak_all_t [lindex $peak_all($copy) 1]
+	foreach name {push_rate pop_rate overwrite_rate miss_rate inerr_rate} count [list $push $pop $overwrite $miss $inerr] {
+		dict set result $name [expr {$dt > 0 ? $count/$dt : 0.0}]
+	}
+	dict set result overwrite_fraction [expr {$push > 0 ? double($overwrite)/$push : 0.0}]
+	dict set result expected_latency $expected_latency
+	dict set result residence_ns [expr {$pop_rate > 0 ? 1.0e9*$mean/$pop_rate : ""}]
+	return $result
+}
+
+# fill level below which the given fraction of the window samples lie (upper bin edge)
+proc ::ring_buffer_cam::telemetry::percentile {copy fraction} {
+	variable hist
+	variable bin_width
+	variable state
+	set target [expr {$fraction*[lindex $state($copy) 1]}]
+	set cumulative 0
+	set bin 0
+	foreach count $hist($copy) {
+		incr cumulative $count
+		incr bin
+		if {$cumulative >= $target} {
+			break
+		}
+	}
+	return [expr {$bin*$bin_width}]
+}
+
+######################################################################################################
+##  Arguments:
+##		<copy>  - index of the copy
+##
+##  Description:
+##  	Gets the fill-level distribution of a copy over the window.
+##
+##	Returns:
+##  	{bin_width counts}, the last bin counts everything above the range
+##
+######################################################################################################
+proc ::ring_buffer_cam::telemetry::get_distribution {copy} {
+	variable hist
+	variable bin_width
+	variable n_bin
+	if {![info exists hist($copy)]} {
+		return [list $bin_width [lrepeat $n_bin 0]]
+	}
+	return [list $bin_width $hist($copy)]
+}
@@ -0,0 +1,290 @@
+###########################################################################################################
+# @Name 		runctl_latency.tcl
+#
+# @Brief		Streaming latency analyser of the run control management host log events.
+#				Keeps per-command latency (execution - receive) and per-transition timing (receive to
+#				receive of consecutive commands) statistics in fixed size histograms.
+#
+# @Functions	configure, reset, add_event, add_events, percentile, summary, export_summary
+#
+# @Author		Yifeng Wang (yifenwan@phys.ethz.ch)
+# @Date			Jun 16, 2025
+# @Version		1.0 (file created)
+#
+#
+###########################################################################################################
+package require Tcl 			8.5
+package provide runctl_mgmt_host::latency 	1.0
+
+namespace eval ::runctl_mgmt_host::latency:: {
+	namespace export \
+	configure \
+	reset \
+	add_event \
+	add_events \
+	percentile \
+	summary \
+	export_summary
+
+	# name decoder of the command code, empty = hex code
+	variable decoder ""
+	# period of one timestamp tick in ns, 0 = report in ticks
+	variable tick_ns 0
+	# log-linear histogram: values below 16 have their own bin, above 8 bins per power of two
+	# (<= 12.5% relative bin width) up to the 48 bit timestamp range
+	variable n_bins [expr {16 + 44*8}]
+	variable stats
+	variable hist
+	variable prev_timestamp ""
+	variable prev_command ""
+	variable n_wrap 0
+	variable n_no_exe 0
+	array set stats {}
+	array set hist {}
+}
+
+######################################################################################################
+##  Arguments:
+##		-decoder <cmd> - command prefix called with the command code, returns the command name
+##		-tick_ns <ns>  - period of one timestamp tick, 0 keeps the results in ticks
+##
+##  Description:
+##  	Configures the analyser.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::runctl_mgmt_host::latency::configure {args} {
+	variable decoder
+	variable tick_ns
+	foreach {option value} $args {
+		switch -- $option {
+			-decoder {
+				set decoder $value
+			}
+			-tick_ns {
+				set tick_ns $value
+			}
+			default {
+				error "configure: unknown option \"${option}\", must be -decoder or -tick_ns"
+			}
+		}
+	}
+	return -code ok
+}
+
+proc ::runctl_mgmt_host::latency::reset {} {
+	variable stats
+	variable hist
+	variable prev_timestamp ""
+	variable prev_command ""
+	variable n_wrap 0
+	variable n_no_exe 0
+	array unset stats
+	array unset hist
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<event> - decoded log event {timestamp command payload timestamp_execution}
+##
+##  Description:
+##  	Adds one event. The execution timestamp is taken as the lower 32 bit of the same counter as
+##		the 48 bit receive timestamp, so the latency is computed modulo 2^32 and the transition time
+##		modulo 2^48. Both survive one wraparound of the counter, a backwards going receive timestamp
+##		is counted as wrap. Events without execution timestamp (0) only contribute to the transitions.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::runctl_mgmt_host::latency::add_event {event} {
+	variable prev_timestamp
+	variable prev_command
+	variable n_wrap
+	variable n_no_exe
+	lassign $event timestamp command payload timestamp_exe
+	set name [::runctl_mgmt_host::latency::command_name $command]
+	# latency
+	if {$timestamp_exe != 0} {
+		::runctl_mgmt_host::latency::accumulate "latency" $name \
+			[expr {($timestamp_exe - ($timestamp & 0xffffffff)) & 0xffffffff}]
+	} else {
+		incr n_no_exe
+	}
+	# transition
+	if {$prev_timestamp ne ""} {
+		if {$timestamp < $prev_timestamp} {
+			incr n_wrap
+		}
+		::runctl_mgmt_host::latency::accumulate "transition" "${prev_command}->${name}" \
+			[expr {($timestamp - $prev_timestamp) & 0xffffffffffff}]
+	}
+	set prev_timestamp $timestamp
+	set prev_command $name
+	return -code ok
+}
+
+proc ::runctl_mgmt_host::latency::add_events {events} {
+	foreach event $events {
+		::runctl_mgmt_host::latency::add_event $event
+	}
+	return -code ok
+}
+
+proc ::runctl_mgmt_host::latency::command_name {command} {
+	variable decoder
+	if {$decoder eq ""} {
+		return [format 0x%02x $command]
+	}
+	return [{*}$decoder $command]
+}
+
+proc ::runctl_mgmt_host::latency::bin_index {value} {
+	if {$value < 16} {
+		return $value
+	}
+	# position of the leading one
+	set e 4
+	while {($value >> ($e + 1)) != 0} {
+		incr e
+	}
+	return [expr {16 + ($e - 4)*8 + (($value >> ($e - 3)) & 7)}]
+}
+
+proc ::runctl_mgmt_host::latency::bin_range {index} {
+	if {$index < 16} {
+		return [list $index [expr {$index + 1}]]
+	}
+	set e [expr {($index - 16)/8 + 4}]
+	set lo [expr {(8 + ($index - 16)%8) << ($e - 3)}]
+	return [list $lo [expr {$lo + (1 << ($e - 3))}]]
+}
+
+proc ::runctl_mgmt_host::latency::accumulate {kind key value} {
+	variable stats
+	variable hist
+	variable n_bins
+	set id "$kind,$key"
+	if {![info exists stats($id)]} {
+		# count min max sum sum2
+		set stats($id) [list 0 $value $value 0 0.0]
+		set hist($id) [lrepeat $n_bins 0]
+	}
+	lassign $stats($id) count min max sum sum2
+	incr count
+	if {$value < $min} {
+		set min $value
+	}
+	if {$value > $max} {
+		set max $value
+	}
+	set stats($id) [list $count $min $max [expr {$sum + $value}] [expr {$sum2 + double($value)*$value}]]
+	set index [::runctl_mgmt_host::latency::bin_index $value]
+	lset hist($id) $index [expr {[lindex $hist($id) $index] + 1}]
+	return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<kind> - "latency" or "transition"
+##		<key>  - command name, or "FROM->TO" for a transition
+##		<q>    - quantile between 0 and 1
+##
+##  Description:
+##  	Estimates the quantile from the histogram, interpolating linearly within the bin (narrowed to
+##		the observed minimum and maximum).
+##
+##	Returns:
+##  	quantile in ticks, empty if the key has no entries
+##
+######################################################################################################
+proc ::runctl_mgmt_host::latency::percentile {kind key q} {
+	variable stats
+	variable hist
+	set id "$kind,$key"
+	if {![info exists stats($id)]} {
+		return ""
+	}
+	lassign $stats($id) count min max
+	set rank [expr {$q*$count}]
+	set cumulated 0
+	set index 0
+	foreach n $hist($id) {
+		if {$n != 0 && $cumulated + $n >= $rank} {
+			lassign [::runctl_mgmt_host::latency::bin_range $index] lo hi
+			# narrow the bin to the observed range, matters for the outermost bins
+			set lo [expr {max($lo, $min)}]
+			set hi [expr {min($hi, $max + 1)}]
+			return [expr {min($lo + ($hi - $lo)*double($rank - $cumulated)/$n, $max)}]
+		}
+		incr cumulated $n
+		incr index
+	}
+	return $max
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Summarizes all keys, latencies first. Times are in ns if -tick_ns is set, otherwise in ticks.
+##
+##	Returns:
+##  	list of rows {kind key count min mean rms p50 p90 p99 p999 max}
+##
+######################################################################################################
+proc ::runctl_mgmt_host::latency::summary {} {
+	variable stats
+	variable tick_ns
+	set scale [expr {$tick_ns > 0 ? double($tick_ns) : 1.0}]
+	set rows [list]
+	foreach kind {latency transition} {
+		foreach id [lsort -dictionary [array names stats "$kind,*"]] {
+			set key [string range $id [string length "$kind,"] end]
+			lassign $stats($id) count min max sum sum2
+			set mean [expr {double($sum)/$count}]
+			set rms [expr {sqrt(max($sum2/$count - $mean*$mean, 0.0))}]
+			set row [list $kind $key $count]
+			foreach value [list $min $mean $rms \
+				[::runctl_mgmt_host::latency::percentile $kind $key 0.5] \
+				[::runctl_mgmt_host::latency::percentile $kind $key 0.9] \
+				[::runctl_mgmt_host::latency::percentile $kind $key 0.99] \
+				[::runctl_mgmt_host::latency::percentile $kind $key 0.999] $max] {
+				lappend row [format %.1f [expr {$value*$scale}]]
+			}
+			lappend rows $row
+		}
+	}
+	return $rows
+}
+
+######################################################################################################
+##  Arguments:
+##		<file_path> - text file to write
+##		<mode>      - "w" to overwrite, "a" to append a snapshot (e.g. periodically during soak tests)
+##
+##  Description:
+##  	Writes the summary as a whitespace separated table, preceded by a comment header with the time
+##		of the snapshot, the unit, the timestamp wrap count and the events without execution time.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::runctl_mgmt_host::latency::export_summary {file_path {mode w}} {
+	variable tick_ns
+	variable n_wrap
+	variable n_no_exe
+	set fd [open $file_path $mode]
+	puts $fd "# [clock format [clock seconds] -format {%Y-%m-%d %H:%M:%S}] unit=[expr {$tick_ns > 0 ? {ns} : {tick}}] wraps=$n_wrap no_exe=$n_no_exe"
+	puts $fd "# kind key count min mean rms p50 p90 p99 p999 max"
+	foreach row [::runctl_mgmt_host::latency::summary] {
+		puts $fd [join $row " "]
+	}
+	close $fd
+	return -code ok
+}
@@ -0,0 +1,989 @@
+# domtdom.tcl --
+#
+#	This file implements the TclDOM 3.0 Tcl language binding on top
+#	of tDOM.  The tree, the parser and the serializer are tDOM's
+#	C implementation; this layer only maps the ::dom::* command set
+#	of dom.tcl onto tDOM's domDoc/domNode commands, so that scripts
+#	written against dom::tcl run unchanged.
+#
+#	Node tokens are tDOM node and document tokens.  Differences to
+#	dom::tcl:
+#
+#	- Tokens are not Tcl commands, use the ::dom::* commands.
+#	- -childNodes and -attributes return the name of a variable
+#	  holding a snapshot, not a live list/array.
+#	- Document fragments, events and XPath node creation are not
+#	  supported.
+#
+# See the file "LICENSE" in this distribution for information on usage and
+# redistribution of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+#
+# $Id$
+
+package require Tcl 8.5
+package require tdom
+
+package provide dom::tdom 3.0
+
+namespace eval dom {
+    namespace export DOMImplementation
+    namespace export hasFeature createDocument create createDocumentType
+    namespace export createNode destroy isNode parse selectNode serialize
+    namespace export trim
+
+    namespace export document documentFragment node
+    namespace export element textNode attribute
+    namespace export processingInstruction
+    namespace export documenttype
+    namespace export event
+}
+
+namespace eval dom::tdom {
+    namespace export DOMImplementation
+    namespace export hasFeature createDocument create createDocumentType
+    namespace export createNode destroy isNode parse selectNode serialize
+    namespace export trim
+
+    namespace export document documentFragment node
+    namespace export element textNode attribute
+    namespace export processingInstruction
+    namespace export event
+
+    variable counter 0
+
+    # tDOM node types to dom::tcl node types
+    variable nodeTypes
+    array set nodeTypes {
+	ELEMENT_NODE			element
+	TEXT_NODE			textNode
+	CDATA_SECTION_NODE		textNode
+	COMMENT_NODE			comment
+	PROCESSING_INSTRUCTION_NODE	processingInstruction
+	ATTRIBUTE_NODE			attribute
+    }
+
+    variable documentOptionsRO doctype|implementation|documentElement
+    variable documentOptionsRW actualEncoding|encoding|standalone|version
+    variable documenttypeOptionsRO name|entities|notations|publicId|systemId|internalSubset
+    variable nodeOptionsRO nodeType|parentNode|childNodes|firstChild|lastChild|previousSibling|nextSibling|attributes|namespaceURI|prefix|localName|ownerDocument|cdatasection
+    variable nodeOptionsRW nodeValue|nodeName
+}
+
+foreach p {DOMImplementation hasFeature createDocument create createDocumentType createNode destroy isNode parse selectNode serialize trim document documentFragment node element textNode attribute processingInstruction event documenttype} {
+    interp alias {} ::dom::$p {} ::dom::tdom::$p
+}
+unset p
+
+# dom::tdom::Cmd --
+#
+#	Returns the tDOM command that handles the given token.
+#
+# Arguments:
+#	token	document or node token
+#
+# Results:
+#	domDoc or domNode
+
+proc dom::tdom::Cmd token {
+    if {[string match domDoc* $token]} {
+	return domDoc
+    }
+    return domNode
+}
+
+# dom::tdom::State --
+#
+#	Returns the name of the per-document state array, creating
+#	it on first use.  The state lives in a namespace named after
+#	the document token and is deleted with the document.
+#
+# Arguments:
+#	doc	document token
+#
+# Results:
+#	Fully qualified array name.
+
+proc dom::tdom::State doc {
+    set name [namespace current]::${doc}::Document
+    if {![info exists $name]} {
+	namespace eval [namespace current]::$doc {}
+	array set $name {
+	    document:xmldecl {version 1.0}
+	    document:doctype {}
+	}
+    }
+    return $name
+}
+
+# dom::tdom::OwnerDocument --
+#
+#	Returns the document a token belongs to.
+#
+# Arguments:
+#	token	document or node token
+#
+# Results:
+#	Document token.
+
+proc dom::tdom::OwnerDocument token {
+    if {[string match domDoc* $token]} {
+	return $token
+    }
+    return [domNode $token ownerDocument]
+}
+
+# dom::tdom::DOMImplementation --
+#
+#	Implementation-dependent functions.
+#
+# Arguments:
+#	method	method to invoke
+#	args	arguments for method
+#
+# Results:
+#	Depends on method used.
+
+proc dom::tdom::DOMImplementation {method args} {
+    variable counter
+
+    switch -- $method {
+
+	hasFeature {
+	    if {[llength $args] != 2} {
+		return -code error "wrong # args: should be dom::DOMImplementation method args..."
+	    }
+	    if {[regexp {create|destroy|parse|query|serialize|trim|isNode} [lindex $args 0]]} {
+		return [expr {[lindex $args 1] eq "1.0"}]
+	    }
+	    return 0
+	}
+
+	createDocument {
+	    if {[llength $args] != 3} {
+		return -code error "wrong # args: should be DOMImplementation nsURI name doctype"
+	    }
+	    lassign $args nsURI qname doctype
+
+	    if {[string length $nsURI]} {
+		set doc [dom createDocumentNS $nsURI $qname]
+	    } else {
+		set doc [dom createDocument $qname]
+	    }
+	    if {[string length $doctype]} {
+		upvar #0 $doctype dt
+		if {$dt(doctype:name) ne $qname} {
+		    domDoc $doc delete
+		    return -code error "mismatch between root element type in document type declaration \"$dt(doctype:name)\" and root element \"$qname\""
+		}
+		if {[string length $dt(doctype:publicId)]} {
+		    domDoc $doc publicId $dt(doctype:publicId)
+		}
+		if {[string length $dt(doctype:systemId)]} {
+		    domDoc $doc systemId $dt(doctype:systemId)
+		}
+		if {[string length $dt(doctype:internalSubset)]} {
+		    domDoc $doc internalSubset $dt(doctype:internalSubset)
+		}
+		set [State $doc](document:doctype) $doctype
+	    }
+	    return $doc
+	}
+
+	create {
+	    if {[llength $args] > 0} {
+		return -code error "wrong # args: should be DOMImplementation create"
+	    }
+	    return [dom createDocumentNode]
+	}
+
+	createDocumentType {
+	    if {[llength $args] < 3 || [llength $args] > 4} {
+		return -code error "wrong # args: should be: DOMImplementation createDocumentType qname publicid systemid ?internaldtd?"
+	    }
+	    lassign $args name publicid systemid internaldtd
+	    if {![dom isQName $name]} {
+		return -code error "invalid QName \"$name\""
+	    }
+	    if {[llength $internaldtd] == 1 && [string length [lindex $internaldtd 0]] == 0} {
+		set internaldtd {}
+	    }
+	    set token [namespace current]::doctype[incr counter]
+	    array set $token [list \
+		node:nodeType documentType \
+		node:nodeName $name \
+		doctype:name $name \
+		doctype:entities {} \
+		doctype:notations {} \
+		doctype:publicId $publicid \
+		doctype:systemId $systemid \
+		doctype:internalSubset $internaldtd \
+	    ]
+	    return $token
+	}
+
+	destroy {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be dom::DOMImplementation destroy token"
+	    }
+	    set token [lindex $args 0]
+	    if {[string match domDoc* $token]} {
+		# the document type belongs to the document, as in dom::tcl
+		set state [namespace current]::${token}::Document
+		if {[info exists $state] && [array exists [set ${state}(document:doctype)]]} {
+		    unset [set ${state}(document:doctype)]
+		}
+		catch {namespace delete [namespace current]::$token}
+		domDoc $token delete
+	    } elseif {[string match domNode* $token]} {
+		domNode $token delete
+	    } elseif {[array exists $token]} {
+		unset $token
+	    }
+	    return {}
+	}
+
+	isNode {
+	    set token [lindex $args 0]
+	    if {![regexp {^dom(Doc|Node)} $token]} {
+		return [expr {[string match [namespace current]::doctype* $token] && [array exists $token]}]
+	    }
+	    return [expr {![catch {[Cmd $token] $token nodeType}]}]
+	}
+
+	parse {
+	    if {[llength $args] < 1} {
+		return -code error "wrong # args: should be dom::DOMImplementation parse xml ?args...?"
+	    }
+	    # -parser, -progresscommand and -chunksize are accepted
+	    # for compatibility, tDOM always parses in one go.
+	    if {[llength $args] % 2 == 0} {
+		return -code error "bad configuration options"
+	    }
+	    return [dom parse -keepEmpties [lindex $args 0]]
+	}
+
+	selectNode {
+	    if {[llength $args] != 2} {
+		return -code error "wrong # args: should be dom::DOMImplementation selectNode token xpath"
+	    }
+	    lassign $args token xpath
+	    return [[Cmd $token] $token selectNodes $xpath]
+	}
+
+	serialize {
+	    if {[llength $args] < 1} {
+		return -code error "wrong # args: should be dom::DOMImplementation serialize token"
+	    }
+	    return [Serialize {*}$args]
+	}
+
+	trim {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be dom::DOMImplementation trim token"
+	    }
+	    set token [lindex $args 0]
+	    foreach text [[Cmd $token] $token selectNodes \
+			      {descendant-or-self::text()[normalize-space(.) = '']}] {
+		domNode $text delete
+	    }
+	    return {}
+	}
+
+	createNode {
+	    return -code error "method \"createNode\" is not supported by dom::tdom"
+	}
+
+	default {
+	    return -code error "unknown method \"$method\""
+	}
+
+    }
+}
+
+namespace eval dom::tdom {
+    foreach method {hasFeature createDocument create createDocumentType createNode destroy isNode parse selectNode serialize trim} {
+	proc $method args "[namespace current]::DOMImplementation $method {*}\$args"
+    }
+}
+
+# dom::tdom::Serialize --
+#
+#	Produce text for a document or node.
+#
+# Arguments:
+#	token	document or node token
+#	args	configuration options
+#
+# Results:
+#	XML (or HTML/text) format text.
+
+proc dom::tdom::Serialize {token args} {
+    array set opts {
+	-indent 0
+	-method xml
+	-showxmldecl 1
+	-showdoctypedecl 1
+	-newline {}
+    }
+    array set opts $args
+
+    set indent none
+    if {[string is true -strict $opts(-indent)]} {
+	set indent 2
+    }
+    set cmd [Cmd $token]
+
+    switch -- $opts(-method) {
+	html {
+	    return [$cmd $token asHTML]
+	}
+	text {
+	    return [$cmd $token asText]
+	}
+    }
+
+    if {$cmd eq "domNode"} {
+	return [domNode $token asXML -indent $indent]
+    }
+    if {[domDoc $token documentElement] eq ""} {
+	return -code error "document has no document element"
+    }
+
+    set result {}
+    if {[string is true -strict $opts(-showxmldecl)]} {
+	array set xmldecl {version 1.0}
+	set state [namespace current]::${token}::Document
+	if {[info exists $state]} {
+	    array set xmldecl [set ${state}(document:xmldecl)]
+	}
+	append result "<?xml"
+	foreach attr {version encoding standalone} {
+	    if {[info exists xmldecl($attr)] && [string length $xmldecl($attr)]} {
+		append result " $attr='$xmldecl($attr)'"
+	    }
+	}
+	append result "?>\n"
+    }
+    append result [domDoc $token asXML -indent $indent \
+		       -doctypeDeclaration [string is true -strict $opts(-showdoctypedecl)]]
+    return $result
+}
+
+# dom::tdom::document --
+#
+#	Functions for a document node.
+#
+# Arguments:
+#	method	method to invoke
+#	token	document token
+#	args	arguments for method
+#
+# Results:
+#	Depends on method used.
+
+proc dom::tdom::document {method token args} {
+    variable documentOptionsRO
+    variable documentOptionsRW
+
+    switch -- $method {
+	cget {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"dom::document method token ?args ...?\""
+	    }
+	    set doc [OwnerDocument $token]
+	    if {[regexp [format {^-(%s)$} $documentOptionsRO] [lindex $args 0] discard option]} {
+		switch -- $option {
+		    documentElement {
+			return [domDoc $doc documentElement]
+		    }
+		    implementation {
+			return [namespace current]::DOMImplementation
+		    }
+		    doctype {
+			return [set [State $doc](document:doctype)]
+		    }
+		}
+	    } elseif {[regexp [format {^-(%s)$} $documentOptionsRW] [lindex $args 0] discard option]} {
+		array set xmldecl [set [State $doc](document:xmldecl)]
+		if {[info exists xmldecl($option)]} {
+		    return $xmldecl($option)
+		}
+		return {}
+	    } else {
+		return -code error "bad option \"[lindex $args 0]\""
+	    }
+	}
+	configure {
+	    if {[llength $args] == 1} {
+		return [document cget $token [lindex $args 0]]
+	    } elseif {[llength $args] % 2} {
+		return -code error "no value specified for option \"[lindex $args end]\""
+	    }
+	    set state [State [OwnerDocument $token]]
+	    foreach {option value} $args {
+		if {[regexp [format {^-(%s)$} $documentOptionsRW] $option discard opt]} {
+		    array set xmldecl [set ${state}(document:xmldecl)]
+		    switch -- $opt {
+			standalone {
+			    if {![string is boolean -strict $value]} {
+				return -code error "unsupported value for option \"$option\" - must be boolean"
+			    }
+			    set xmldecl(standalone) [expr {$value ? "yes" : "no"}]
+			}
+			version {
+			    if {$value ne "1.0"} {
+				return -code error "unsupported value for option \"$option\""
+			    }
+			    set xmldecl(version) $value
+			}
+			default {
+			    set xmldecl($opt) $value
+			}
+		    }
+		    set ${state}(document:xmldecl) [array get xmldecl]
+		} elseif {[regexp [format {^-(%s)$} $documentOptionsRO] $option]} {
+		    return -code error "attribute \"$option\" is read-only"
+		} else {
+		    return -code error "bad option \"$option\""
+		}
+	    }
+	    return {}
+	}
+
+	createElement {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"document createElement token name\""
+	    }
+	    return [Append $token [domDoc [OwnerDocument $token] createElement [lindex $args 0]]]
+	}
+	createElementNS {
+	    if {[llength $args] != 2} {
+		return -code error "wrong # args: should be: \"createElementNS nsuri qualname\""
+	    }
+	    return [Append $token [domDoc [OwnerDocument $token] createElementNS {*}$args]]
+	}
+	createTextNode {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"document createTextNode token text\""
+	    }
+	    return [Append $token [domDoc [OwnerDocument $token] createTextNode [lindex $args 0]]]
+	}
+	createComment {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"document createComment token data\""
+	    }
+	    return [Append $token [domDoc [OwnerDocument $token] createComment [lindex $args 0]]]
+	}
+	createCDATASection {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"document createCDATASection token data\""
+	    }
+	    return [Append $token [domDoc [OwnerDocument $token] createCDATASection [lindex $args 0]]]
+	}
+	createProcessingInstruction {
+	    if {[llength $args] != 2} {
+		return -code error "wrong # args: should be \"document createProcessingInstruction token target data\""
+	    }
+	    return [Append $token [domDoc [OwnerDocument $token] createProcessingInstruction {*}$args]]
+	}
+	getElementsByTagName {
+	    if {[llength $args] < 1} {
+		return -code error "wrong # args: should be \"document getElementsByTagName token what\""
+	    }
+	    return [[Cmd $token] $token getElementsByTagName [lindex $args 0]]
+	}
+	createDocumentFragment -
+	createAttribute -
+	createAttributeNS -
+	createEntity -
+	createEntityReference -
+	createEvent -
+	importNode {
+	    return -code error "method \"$method\" is not supported by dom::tdom"
+	}
+	default {
+	    return -code error "unknown method \"$method\""
+	}
+    }
+}
+
+# dom::tdom::Append --
+#
+#	dom::tcl factory methods append the new node to the given
+#	parent.  A document only takes the first element as its
+#	document element, further elements stay unattached.
+#
+# Arguments:
+#	parent	document or node token
+#	child	new node token
+#
+# Results:
+#	The new node token.
+
+proc dom::tdom::Append {parent child} {
+    if {[string match domDoc* $parent]} {
+	if {[domNode $child nodeType] eq "ELEMENT_NODE"
+	    && [domDoc $parent documentElement] ne ""} {
+	    return $child
+	}
+	domDoc $parent appendChild $child
+    } else {
+	domNode $parent appendChild $child
+    }
+    return $child
+}
+
+# dom::tdom::documenttype --
+#
+#	Functions for a document type declaration node.
+#
+# Arguments:
+#	method	method to invoke
+#	token	token for node
+#	args	arguments for method
+#
+# Results:
+#	Depends on method used.
+
+proc dom::tdom::documenttype {method token args} {
+    variable documenttypeOptionsRO
+
+    upvar #0 $token node
+
+    switch -- $method {
+	cget {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"dom::documenttype method token ?args ...?\""
+	    }
+	    if {[regexp [format {^-(%s)$} $documenttypeOptionsRO] [lindex $args 0] discard option]} {
+		return $node(doctype:$option)
+	    }
+	    return -code error "bad option \"[lindex $args 0]\""
+	}
+	configure {
+	    if {[llength $args] == 1} {
+		return [documenttype cget $token [lindex $args 0]]
+	    }
+	    foreach {option value} $args {
+		if {[regexp [format {^-(%s)$} $documenttypeOptionsRO] $option]} {
+		    return -code error "attribute \"$option\" is read-only"
+		}
+		return -code error "bad option \"$option\""
+	    }
+	}
+    }
+    return {}
+}
+
+# dom::tdom::node --
+#
+#	Functions for a general node.
+#
+# Arguments:
+#	method	method to invoke
+#	token	token for node
+#	args	arguments for method
+#
+# Results:
+#	Depends on method used.
+
+proc dom::tdom::node {method token args} {
+    variable nodeOptionsRO
+    variable nodeOptionsRW
+
+    set cmd [Cmd $token]
+
+    switch -glob -- $method {
+	cg* {
+	    # cget
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"dom::node cget token option\""
+	    }
+	    if {![regexp [format {^-(%s|%s)$} $nodeOptionsRO $nodeOptionsRW] [lindex $args 0] discard option]} {
+		return -code error "unknown option \"[lindex $args 0]\""
+	    }
+	    if {$cmd eq "domDoc"} {
+		switch -- $option {
+		    nodeType {return document}
+		    nodeName {return #document}
+		    childNodes {return [Snapshot $token $token childNodes [domDoc $token childNodes]]}
+		    firstChild -
+		    lastChild {return [domDoc $token documentElement]}
+		    ownerDocument {return $token}
+		    default {return {}}
+		}
+	    }
+	    switch -- $option {
+		nodeType {
+		    variable nodeTypes
+		    return $nodeTypes([domNode $token nodeType])
+		}
+		nodeValue {
+		    if {[domNode $token nodeType] eq "ELEMENT_NODE"} {
+			return {}
+		    }
+		    return [domNode $token nodeValue]
+		}
+		parentNode {
+		    return [Parent $token]
+		}
+		childNodes {
+		    return [Snapshot [domNode $token ownerDocument] $token childNodes [domNode $token childNodes]]
+		}
+		attributes {
+		    if {[domNode $token nodeType] ne "ELEMENT_NODE"} {
+			return {}
+		    }
+		    set attrs {}
+		    foreach name [domNode $token attributeNames] {
+			lappend attrs $name [domNode $token getAttribute $name]
+		    }
+		    return [Snapshot [domNode $token ownerDocument] $token attributes $attrs]
+		}
+		cdatasection {
+		    return [expr {[domNode $token nodeType] eq "CDATA_SECTION_NODE"}]
+		}
+		namespaceURI -
+		prefix -
+		localName {
+		    if {[domNode $token nodeType] ne "ELEMENT_NODE"} {
+			return {}
+		    }
+		    set result [domNode $token $option]
+		    if {$option eq "localName" && $result eq ""} {
+			set result [domNode $token nodeName]
+		    }
+		    return $result
+		}
+		default {
+		    return [domNode $token $option]
+		}
+	    }
+	}
+	co* {
+	    # configure
+	    if {[llength $args] == 1} {
+		return [node cget $token [lindex $args 0]]
+	    } elseif {[llength $args] % 2} {
+		return -code error "wrong \# args: should be \"::dom::node configure node option\""
+	    }
+	    foreach {option value} $args {
+		if {[regexp [format {^-(%s)$} $nodeOptionsRW] $option discard opt]} {
+		    switch -- $opt {
+			nodeValue {
+			    if {[domNode $token nodeType] ne "ELEMENT_NODE"} {
+				domNode $token nodeValue $value
+			    }
+			}
+			nodeName {
+			    domDoc [domNode $token ownerDocument] renameNode [list $token] $value
+			}
+		    }
+		} elseif {[regexp [format {^-(%s)$} $nodeOptionsRO] $option]} {
+		    return -code error "attribute \"$option\" is read-only"
+		} else {
+		    return -code error "unknown option \"$option\""
+		}
+	    }
+	    return {}
+	}
+	in* {
+	    # insertBefore
+	    switch [llength $args] {
+		1 {
+		    $cmd $token appendChild [lindex $args 0]
+		}
+		2 {
+		    $cmd $token insertBefore {*}$args
+		}
+		default {
+		    return -code error "wrong # args: should be \"dom::node insertBefore token new ?ref?\""
+		}
+	    }
+	    return [lindex $args 0]
+	}
+	rep* {
+	    # replaceChild
+	    if {[llength $args] != 2} {
+		return -code error "wrong # args: should be \"dom::node replaceChild token new old\""
+	    }
+	    $cmd $token replaceChild {*}$args
+	    return [lindex $args 1]
+	}
+	removeC* {
+	    # removeChild
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"dom::node removeChild token child\""
+	    }
+	    $cmd $token removeChild [lindex $args 0]
+	    return [lindex $args 0]
+	}
+	ap* {
+	    # appendChild
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"dom::node appendChild token child\""
+	    }
+	    $cmd $token appendChild [lindex $args 0]
+	    return [lindex $args 0]
+	}
+	hasChildNodes {
+	    return [$cmd $token hasChildNodes]
+	}
+	isSameNode {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"dom::node isSameNode token ref\""
+	    }
+	    return [expr {$token eq [lindex $args 0]}]
+	}
+	cl* {
+	    # cloneNode
+	    set deep 0
+	    foreach {opt value} $args {
+		if {$opt ne "-deep"} {
+		    return -code error "bad option \"$opt\""
+		}
+		set deep [string is true -strict $value]
+	    }
+	    if {$cmd eq "domDoc"} {
+		return -code error "cloning documents is not supported by dom::tdom"
+	    }
+	    if {$deep} {
+		return [domNode $token cloneNode -deep]
+	    }
+	    return [domNode $token cloneNode]
+	}
+	ch* {
+	    # children -- non-standard method
+	    return [$cmd $token childNodes]
+	}
+	par* {
+	    # parent -- non-standard method
+	    if {$cmd eq "domDoc"} {
+		return {}
+	    }
+	    return [Parent $token]
+	}
+	pat* {
+	    # path -- non-standard method
+	    set result {}
+	    for {set ancestor $token} {$ancestor ne ""} {set ancestor [node parent $ancestor]} {
+		set result [linsert $result 0 $ancestor]
+	    }
+	    return $result
+	}
+	selectNode {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"dom::node selectNode token path\""
+	    }
+	    return [$cmd $token selectNodes [lindex $args 0]]
+	}
+	stringValue {
+	    if {[llength $args] > 0} {
+		return -code error "wrong # args: should be \"dom::node stringValue token\""
+	    }
+	    return [$cmd $token asText]
+	}
+	createNode -
+	addEv* -
+	removeE* -
+	disp* {
+	    return -code error "method \"$method\" is not supported by dom::tdom"
+	}
+	default {
+	    return -code error "unknown method \"$method\""
+	}
+    }
+}
+
+# dom::tdom::Parent --
+#
+#	dom::tcl reports the document as parent of its top level
+#	nodes, tDOM reports no parent.
+#
+# Arguments:
+#	token	node token
+#
+# Results:
+#	Parent node or document token.
+
+proc dom::tdom::Parent token {
+    set parent [domNode $token parentNode]
+    if {$parent ne ""} {
+	return $parent
+    }
+    set doc [domNode $token ownerDocument]
+    if {[lsearch -exact [domDoc $doc childNodes] $token] >= 0} {
+	return $doc
+    }
+    return {}
+}
+
+# dom::tdom::Snapshot --
+#
+#	dom::tcl returns the name of a variable for -childNodes and
+#	-attributes.  Store a copy of the current value in the
+#	document's namespace and return the variable name.
+#
+# Arguments:
+#	doc	document token
+#	token	node token
+#	kind	childNodes or attributes
+#	value	current value
+#
+# Results:
+#	Fully qualified variable name.
+
+proc dom::tdom::Snapshot {doc token kind value} {
+    State $doc
+    set name [namespace current]::${doc}::${kind}:$token
+    if {$kind eq "attributes"} {
+	catch {unset $name}
+	array set $name $value
+    } else {
+	set $name $value
+    }
+    return $name
+}
+
+# dom::tdom::element --
+#
+#	Functions for an element.
+#
+# Arguments:
+#	method	method to invoke
+#	token	token for node
+#	args	arguments for method
+#
+# Results:
+#	Depends on method used.
+
+proc dom::tdom::element {method token args} {
+    if {[string match domDoc* $token] || [domNode $token nodeType] ne "ELEMENT_NODE"} {
+	return -code error "malformed node token \"$token\""
+    }
+
+    switch -- $method {
+	cget {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"dom::element cget token option\""
+	    }
+	    switch -- [lindex $args 0] {
+		-tagName {
+		    return [domNode $token nodeName]
+		}
+		-empty {
+		    return 0
+		}
+		default {
+		    return -code error "bad option \"[lindex $args 0]\""
+		}
+	    }
+	}
+	configure {
+	    if {[llength $args] == 1} {
+		return [element cget $token [lindex $args 0]]
+	    }
+	    foreach {option value} $args {
+		if {$option in {-tagName -empty}} {
+		    return -code error "option \"$option\" cannot be modified"
+		}
+		return -code error "bad option \"$option\""
+	    }
+	}
+	getAttribute {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"dom::element getAttribute token name\""
+	    }
+	    return [domNode $token getAttribute [lindex $args 0] {}]
+	}
+	setAttribute {
+	    if {[llength $args] != 2} {
+		return -code error "wrong # args: should be \"dom::element setAttribute token name value\""
+	    }
+	    domNode $token setAttribute {*}$args
+	    return [lindex $args 1]
+	}
+	removeAttribute {
+	    if {[llength $args] != 1} {
+		return -code error "wrong # args: should be \"dom::element removeAttribute token name\""
+	    }
+	    domNode $token removeAttribute [lindex $args 0]
+	    return {}
+	}
+	getAttributeNS {
+	    if {[llength $args] != 2} {
+		return -code error "wrong # args: should be \"dom::element getAttributeNS token ns name\""
+	    }
+	    return [domNode $token getAttributeNS {*}$args]
+	}
+	setAttributeNS {
+	    if {[llength $args] != 3} {
+		return -code error "wrong # args: should be \"dom::element setAttributeNS token ns attr value\""
+	    }
+	    domNode $token setAttributeNS {*}$args
+	    return {}
+	}
+	removeAttributeNS {
+	    if {[llength $args] != 2} {
+		return -code error "wrong # args: should be \"dom::element removeAttributeNS token ns name\""
+	    }
+	    domNode $token removeAttributeNS {*}$args
+	    return {}
+	}
+	getElementsByTagName {
+	    if {[llength $args] < 1} {
+		return -code error "wrong # args: should be \"dom::element getElementsByTagName token name\""
+	    }
+	    return [domNode $token getElementsByTagName [lindex $args 0]]
+	}
+	normalize {
+	    domNode $token normalize
+	    return {}
+	}
+	default {
+	    return -code error "unknown method \"$method\""
+	}
+    }
+}
+
+# dom::tdom::processingInstruction --
+#
+#	Functions for a processing instruction.
+#
+# Arguments:
+#	method	method to invoke
+#	token	token for node
+#	args	arguments for method
+#
+# Results:
+#	Depends on method used.
+
+proc dom::tdom::processingInstruction {method token args} {
+    switch -- $method {
+	cget {
+	    switch -- [lindex $args 0] {
+		-target {
+		    return [domNode $token target]
+		}
+		-data {
+		    return [domNode $token data]
+		}
+		default {
+		    return -code error "bad option \"[lindex $args 0]\""
+		}
+	    }
+	}
+	default {
+	    return -code error "unknown method \"$method\""
+	}
+    }
+}
+
+# dom::tdom::documentFragment, event, textNode, attribute --
+#
+#	Not supported by this implementation.
+
+foreach p {documentFragment event textNode attribute} {
+    proc dom::tdom::$p {method args} "return -code error \"$p is not supported by dom::tdom\""
+}
+unset p
@@ -0,0 +1,233 @@
+# domtdom_conformance.tcl --
+#
+#	Runs the same ::dom::* scripts against dom::tcl and dom::tdom,
+#	compares the results and times the MuTRiG config save path
+#	(get_config_settings_from_comboBox) with both implementations.
+#
+#	Usage: tclsh domtdom_conformance.tcl ?n_asic? ?iterations?
+#
+#	tdom must be loadable (e.g. via TCLLIBPATH).
+#
+# $Id$
+
+set libDir [file dirname [file dirname [file normalize [info script]]]]
+lappend auto_path $libDir
+
+set n_asic [lindex $argv 0]
+if {$n_asic eq ""} {set n_asic 4}
+set iterations [lindex $argv 1]
+if {$iterations eq ""} {set iterations 3}
+
+# sgmlparser asks for tcllib's uri, which is only used for external
+# entities. Don't fail the comparison on hosts without tcllib.
+if {[catch {package require uri 1.1}]} {
+    package provide uri 1.1
+}
+package require tdom
+package require mutrig_controller::bsp 24.0
+package require dom::tcl 3.0
+package require dom::tdom 3.0
+
+# Canonical form of a serialization: reparse and drop the prolog,
+# so that quoting style and whitespace of the two serializers
+# don't matter.
+proc canonical {xml} {
+    set doc [dom parse $xml]
+    set result [[$doc documentElement] asXML -indent none]
+    $doc delete
+    return $result
+}
+
+# ----------------------------------------------------------------------
+# Conformance scripts. Each takes the implementation namespace and
+# returns a result which must be equal for both implementations.
+
+proc scenario_build {ns} {
+    set dtd [${ns}::DOMImplementation createDocumentType "cfg" "" "" ""]
+    set doc [${ns}::DOMImplementation createDocument "" "cfg" $dtd]
+    set root [${ns}::document cget $doc -documentElement]
+    set info [${ns}::document createElement $root "info"]
+    set version [${ns}::document createElement $info "version"]
+    set text [${ns}::document createTextNode $version "value"]
+    ${ns}::node configure $text -nodeValue 3
+    ${ns}::document createElement $info "comment"
+    ${ns}::document createComment $root " channels "
+    foreach ch {0 1} {
+        set chNode [${ns}::document createElement $root "ch$ch"]
+        ${ns}::element setAttribute $chNode index $ch
+        ${ns}::document createTextNode $chNode "a < b & c"
+    }
+    set result [list \
+        [canonical [${ns}::DOMImplementation serialize $doc -indent true -method xml]] \
+        [${ns}::documenttype cget [${ns}::document cget $doc -doctype] -name] \
+        [${ns}::node cget $text -nodeValue]]
+    ${ns}::DOMImplementation destroy $doc
+    return $result
+}
+
+# Element children only: the dom::tcl parser reports empty text
+# nodes between adjacent tags, tDOM does not create them.
+proc elements {ns node} {
+    set result {}
+    foreach child [${ns}::node children $node] {
+        if {[${ns}::node cget $child -nodeType] eq "element"} {
+            lappend result $child
+        }
+    }
+    return $result
+}
+
+proc scenario_navigate {ns} {
+    set doc [${ns}::DOMImplementation parse {<r a="1"><x>t1</x><y b="2"><z>t2</z>t3</y></r>}]
+    set root [${ns}::document cget $doc -documentElement]
+    set result {}
+    foreach child [elements $ns $root] {
+        lappend result [${ns}::node cget $child -nodeType] \
+            [${ns}::node cget $child -nodeName] \
+            [${ns}::node stringValue $child]
+    }
+    lassign [elements $ns $root] x y
+    set z [lindex [elements $ns $y] 0]
+    lappend result [${ns}::node cget [${ns}::node cget $y -parentNode] -nodeName]
+    lappend result [${ns}::node cget [${ns}::node parent $root] -nodeType]
+    lappend result [${ns}::element getAttribute $root a]
+    lappend result [${ns}::element getAttribute $y missing]
+    lappend result [${ns}::element cget $y -tagName]
+    lappend result [array get [${ns}::node cget $y -attributes]]
+    lappend result [${ns}::node hasChildNodes $z]
+    lappend result [llength [${ns}::node path $z]]
+    lappend result [${ns}::node cget [${ns}::node cget $z -firstChild] -nodeValue]
+    ${ns}::DOMImplementation destroy $doc
+    return $result
+}
+
+proc scenario_mutate {ns} {
+    set doc [${ns}::DOMImplementation createDocument "" "r" ""]
+    set root [${ns}::document cget $doc -documentElement]
+    foreach name {a b c} {
+        set $name [${ns}::document createElement $root $name]
+    }
+    set result [list \
+        [${ns}::node cget [${ns}::node cget $b -previousSibling] -nodeName] \
+        [${ns}::node cget [${ns}::node cget $b -nextSibling] -nodeName] \
+        [${ns}::node cget [${ns}::node cget $root -firstChild] -nodeName] \
+        [${ns}::node cget [${ns}::node cget $root -lastChild] -nodeName] \
+        [llength [set [${ns}::node cget $root -childNodes]]]]
+    ${ns}::node removeChild $root $b
+    ${ns}::node insertBefore $root $b $a
+    set d [${ns}::document createElement $root "d"]
+    ${ns}::node replaceChild $root $d $c
+    ${ns}::node appendChild $a $c
+    set e [${ns}::node cloneNode $a -deep 1]
+    ${ns}::node appendChild $root $e
+    lappend result [canonical [${ns}::DOMImplementation serialize $doc]]
+    ${ns}::DOMImplementation destroy $doc
+    return $result
+}
+
+proc scenario_document {ns} {
+    set doc [${ns}::DOMImplementation createDocument "" "r" ""]
+    ${ns}::document configure $doc -encoding UTF-8 -standalone 1
+    set result [list \
+        [${ns}::document cget $doc -encoding] \
+        [${ns}::document cget $doc -standalone] \
+        [${ns}::document cget $doc -version] \
+        [${ns}::node cget $doc -nodeType] \
+        [${ns}::DOMImplementation hasFeature create 1.0] \
+        [${ns}::DOMImplementation isNode $doc] \
+        [catch {${ns}::document configure $doc -documentElement x}]]
+    ${ns}::DOMImplementation destroy $doc
+    return $result
+}
+
+# ----------------------------------------------------------------------
+# Benchmark: the body of get_config_settings_from_comboBox, with the
+# combo box values replaced by the parameter index.
+
+proc config_save {ns n_asic} {
+    set dtd [${ns}::DOMImplementation createDocumentType "scifi_configurations" "" "" ""]
+    set doc [${ns}::DOMImplementation createDocument "" "scifi_configurations" $dtd]
+    set doc_ele [${ns}::document cget $doc -documentElement]
+    set smb [${ns}::document createElement $doc_ele "SMB"]
+    set smb_info [${ns}::document createElement $smb "info"]
+    foreach name {version n_mutrig good_mutrig_mask bad_mutrig_mask comment} {
+        set token [${ns}::document createElement $smb_info $name]
+        ${ns}::node configure [${ns}::document createTextNode $token "value"] -nodeValue 0
+    }
+    for {set index 0} {$index < $n_asic} {incr index} {
+        set smb_mutrig [${ns}::document createElement $smb "mutrig"]
+        set smb_mutrig_index [${ns}::document createElement $smb_mutrig "index"]
+        ${ns}::node configure [${ns}::document createTextNode $smb_mutrig_index "value"] -nodeValue $index
+        set smb_mutrig_param [${ns}::document createElement $smb_mutrig "parameters"]
+        foreach subgroupname {Header Channel TDC Footer} {
+            set sub [${ns}::document createElement $smb_mutrig_param $subgroupname]
+            set param_info [::mutrig_controller::bsp::get_parameter_info $subgroupname]
+            if {$subgroupname eq "Channel"} {
+                set parents {}
+                for {set i 0} {$i < 32} {incr i} {
+                    lappend parents [${ns}::document createElement $sub "ch${i}"]
+                }
+            } else {
+                set parents [list $sub]
+            }
+            foreach parent $parents {
+                foreach param $param_info {
+                    set token [${ns}::document createElement $parent [lindex $param 0]]
+                    ${ns}::node configure [${ns}::document createTextNode $token "value"] -nodeValue [lindex $param 2]
+                }
+            }
+        }
+    }
+    set xml [${ns}::DOMImplementation serialize $doc -indent true -method xml]
+    ${ns}::DOMImplementation destroy $doc
+    return $xml
+}
+
+set failed 0
+foreach scenario {scenario_build scenario_navigate scenario_mutate scenario_document} {
+    set expected [$scenario ::dom::tcl]
+    set actual [$scenario ::dom::tdom]
+    if {$expected eq $actual} {
+        puts [format "%-22s ok" $scenario]
+    } else {
+        incr failed
+        puts [format "%-22s FAILED" $scenario]
+        puts "    dom::tcl:  $expected"
+        puts "    dom::tdom: $actual"
+    }
+}
+
+set xmlTcl [config_save ::dom::tcl $n_asic]
+set xmlTdom [config_save ::dom::tdom $n_asic]
+set doc [dom parse $xmlTdom]
+set nElements [llength [$doc selectNodes //*]]
+$doc delete
+if {[canonical $xmlTcl] eq [canonical $xmlTdom]} {
+    puts [format "%-22s ok (%d elements)" config_save $nElements]
+} else {
+    incr failed
+    puts [format "%-22s FAILED" config_save]
+}
+
+foreach ns {::dom::tcl ::dom::tdom} {
+    set us [lindex [time {config_save $ns $n_asic} $iterations] 0]
+    puts [format "%-22s %-11s %10.1f ms" "config_save n_asic=$n_asic" [namespace tail $ns] [expr {$us / 1000.0}]]
+}
+
+# Everything config_save created must be gone after destroy: no
+# tDOM documents, per-document namespaces or doctype arrays.
+set docsBefore [llength [info commands domDoc0x*]]
+config_save ::dom::tdom $n_asic
+set leftover [concat \
+    [lrange [info commands domDoc0x*] $docsBefore end] \
+    [namespace children ::dom::tdom domDoc*] \
+    [info vars ::dom::tdom::doctype*]]
+if {[llength $leftover] == 0} {
+    puts [format "%-22s ok" config_save_destroy]
+} else {
+    incr failed
+    puts [format "%-22s FAILED" config_save_destroy]
+    puts "    left over: $leftover"
+}
+
+exit [expr {$failed != 0}]
@@ -275,6 +275,9 @@ static char doc_usage[] =
     "    getElementById id                       \n"
     "    baseURI ?URI?                           \n"
     "    appendFromList nestedList               \n"
+    "    appendFromDict ?-nested patternList? dict\n"
+    "    applyEdits editList                     \n"
+    "    diffPaths otherDoc                      \n"
     "    appendFromScript script                 \n"        
     "    insertBeforeFromScript script ref       \n"
     "    appendXML xmlString                     \n"
@@ -341,12 +344,16 @@ static char node_usage[] =
     "    getColumn                    \n"
     "    @<attrName> ?defaultValue?   \n"
     "    asList                       \n"
+    "    asDict                       \n"
     "    asXML ?-indent <none,tabs,0..8>? ?-channel <channel>? ?other options - see manual?>\n"
     "    asCanonicalXML ?-channel <channel>? ?-comments <boolean>\n"
     "    asHTML ?-channel <channelId>? ?-escapeNonASCII? ?-htmlEntities?\n"
     "    asText                       \n"
     "    asJSON ?-indent <none,0..8>? \n"
     "    appendFromList nestedList    \n"
+    "    appendFromDict ?-nested patternList? dict\n"
+    "    applyEdits editList          \n"
+    "    diffPaths otherNode          \n"
     "    appendFromScript script      \n"
     "    insertBeforeFromScript script ref \n"
     "    appendXML xmlString          \n"
@@ -2382,6 +2389,579 @@ Tcl_Obj * tcldom_treeAsTclList (
     return Tcl_NewListObj(3, objv);
 }
 
+/*----------------------------------------------------------------------------
+|   tcldom_treeAsTclDict
+|
+|   Returns the element children of node as key/value list, keyed by
+|   the element name. An element without element children is mapped
+|   to its text content. Repeated element names are kept in document
+|   order (the result is a dict only if the names are unique).
+|   Attributes, comments and processing instructions are ignored.
+|
+\---------------------------------------------------------------------------*/
+static
+Tcl_Obj * tcldom_treeAsTclDict (
+    domNode *node
+)
+{
+    Tcl_Obj *result;
+    domNode *child;
+    int      hasElementChild = 0;
+
+    if (node->nodeType != ELEMENT_NODE) {
+        if (   (node->nodeType == TEXT_NODE)
+            || (node->nodeType == CDATA_SECTION_NODE)) {
+            return Tcl_NewStringObj(((domTextNode*)node)->nodeValue,
+                                    ((domTextNode*)node)->valueLength);
+        }
+        return Tcl_NewObj();
+    }
+    child = node->firstChild;
+    while (child) {
+        if (child->nodeType == ELEMENT_NODE) {
+            hasElementChild = 1;
+            break;
+        }
+        child = child->nextSibling;
+    }
+    result = Tcl_NewObj();
+    child = node->firstChild;
+    if (!hasElementChild) {
+        while (child) {
+            if (   (child->nodeType == TEXT_NODE)
+                || (child->nodeType == CDATA_SECTION_NODE)) {
+                Tcl_AppendToObj(result, ((domTextNode*)child)->nodeValue,
+                                ((domTextNode*)child)->valueLength);
+            }
+            child = child->nextSibling;
+        }
+        return result;
+    }
+    while (child) {
+        if (child->nodeType == ELEMENT_NODE) {
+            Tcl_ListObjAppendElement(NULL, result,
+                                     Tcl_NewStringObj(child->nodeName, -1));
+            Tcl_ListObjAppendElement(NULL, result,
+                                     tcldom_treeAsTclDict(child));
+        }
+        child = child->nextSibling;
+    }
+    return result;
+}
+
+/*----------------------------------------------------------------------------
+|   tcldom_isNestedKey
+|
+|   Only the values of keys matching one of the glob patterns of the
+|   -nested option are taken as nested key/value lists, all others are
+|   text content, whatever they look like.
+|
+\---------------------------------------------------------------------------*/
+static
+int tcldom_isNestedKey (
+    const char *key,
+    domLength   patternc,
+    Tcl_Obj   **patternv
+)
+{
+    domLength i;
+
+    for (i = 0; i < patternc; i++) {
+        if (Tcl_StringMatch(key, Tcl_GetString(patternv[i]))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------------------
+|   tcldom_appendFromTclDict
+|
+\---------------------------------------------------------------------------*/
+static
+int tcldom_appendFromTclDict (
+    Tcl_Interp *interp,
+    domNode    *node,
+    Tcl_Obj    *dictObj,
+    domLength   patternc,
+    Tcl_Obj   **patternv
+)
+{
+    domLength    objc, i, valueLength;
+    Tcl_Obj    **objv;
+    char        *tag_name, *value;
+    domNode     *newnode;
+    domTextNode *textnode;
+    int          rc;
+
+    GetTcldomDATA;
+
+    if (Tcl_ListObjGetElements(interp, dictObj, &objc, &objv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (objc % 2) {
+        SetResult("invalid dict format!");
+        return TCL_ERROR;
+    }
+    for (i = 0; i < objc; i += 2) {
+        tag_name = Tcl_GetString(objv[i]);
+        CheckName (interp, tag_name, "tag", 0);
+        newnode = domNewElementNode(node->ownerDocument, tag_name);
+        domAppendChild(node, newnode);
+        if (tcldom_isNestedKey(tag_name, patternc, patternv)) {
+            rc = tcldom_appendFromTclDict(interp, newnode, objv[i+1],
+                                          patternc, patternv);
+            if (rc != TCL_OK) {
+                return rc;
+            }
+        } else {
+            value = Tcl_GetStringFromObj(objv[i+1], &valueLength);
+            if (valueLength) {
+                CheckText (interp, value, "text");
+                textnode = domNewTextNode(node->ownerDocument, value,
+                                          valueLength, TEXT_NODE);
+                domAppendChild(newnode, (domNode*)textnode);
+            }
+        }
+    }
+    return TCL_OK;
+}
+
+/*----------------------------------------------------------------------------
+|   tcldom_hasElementChild
+|
+\---------------------------------------------------------------------------*/
+static
+int tcldom_hasElementChild (
+    domNode *node
+)
+{
+    domNode *child;
+
+    if (node->nodeType != ELEMENT_NODE) {
+        return 0;
+    }
+    child = node->firstChild;
+    while (child) {
+        if (child->nodeType == ELEMENT_NODE) {
+            return 1;
+        }
+        child = child->nextSibling;
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------------------
+|   tcldom_leafText
+|
+|   Appends the text content (text and CDATA children) of a leaf
+|   element to dStr.
+|
+\---------------------------------------------------------------------------*/
+static
+void tcldom_leafText (
+    domNode     *node,
+    Tcl_DString *dStr
+)
+{
+    domNode *child;
+
+    if (node->nodeType != ELEMENT_NODE) {
+        if (   (node->nodeType == TEXT_NODE)
+            || (node->nodeType == CDATA_SECTION_NODE)) {
+            Tcl_DStringAppend(dStr, ((domTextNode*)node)->nodeValue,
+                              ((domTextNode*)node)->valueLength);
+        }
+        return;
+    }
+    child = node->firstChild;
+    while (child) {
+        if (   (child->nodeType == TEXT_NODE)
+            || (child->nodeType == CDATA_SECTION_NODE)) {
+            Tcl_DStringAppend(dStr, ((domTextNode*)child)->nodeValue,
+                              ((domTextNode*)child)->valueLength);
+        }
+        child = child->nextSibling;
+    }
+}
+
+/*----------------------------------------------------------------------------
+|   tcldom_setLeafValue
+|
+|   Sets the text content of a leaf element. A single text child is
+|   updated in place, otherwise the text and CDATA children are
+|   replaced. Returns 1 if the value changed, 0 if not and -1 if node
+|   has element children.
+|
+\---------------------------------------------------------------------------*/
+static
+int tcldom_setLeafValue (
+    Tcl_Interp *interp,
+    domNode    *node,
+    const char *value,
+    domLength   valueLength
+)
+{
+    domNode     *child, *next;
+    domTextNode *textnode;
+    Tcl_DString  dStr;
+    int          changed;
+
+    if (tcldom_hasElementChild(node)) {
+        return -1;
+    }
+    child = node->firstChild;
+    if (child && child == node->lastChild && child->nodeType == TEXT_NODE) {
+        textnode = (domTextNode*)child;
+        if (textnode->valueLength == valueLength
+            && memcmp(textnode->nodeValue, value, valueLength) == 0) {
+            return 0;
+        }
+        if (valueLength) {
+            domSetNodeValue(child, value, valueLength);
+        } else {
+            domDeleteNode(child, tcldom_deleteNode, interp);
+        }
+        return 1;
+    }
+    Tcl_DStringInit(&dStr);
+    tcldom_leafText(node, &dStr);
+    changed = (Tcl_DStringLength(&dStr) != valueLength
+               || memcmp(Tcl_DStringValue(&dStr), value, valueLength) != 0);
+    Tcl_DStringFree(&dStr);
+    if (!changed) {
+        return 0;
+    }
+    while (child) {
+        next = child->nextSibling;
+        if (   (child->nodeType == TEXT_NODE)
+            || (child->nodeType == CDATA_SECTION_NODE)) {
+            domDeleteNode(child, tcldom_deleteNode, interp);
+        }
+        child = next;
+    }
+    if (valueLength) {
+        textnode = domNewTextNode(node->ownerDocument, value, valueLength,
+                                  TEXT_NODE);
+        domAppendChild(node, (domNode*)textnode);
+    }
+    return 1;
+}
+
+/*----------------------------------------------------------------------------
+|   tcldom_applyEdits
+|
+|   Applies a list of {path value} edits below node. A path is a
+|   relative location path of element name steps, optionally with a
+|   1 based position predicate (e.g. "a/b[2]/c"), as returned by
+|   diffPaths. Missing elements are appended if the position is one
+|   past the existing ones. Only the addressed leaves are touched;
+|   structural changes leave the renumbering of the document to the
+|   next operation that needs document order. Sets the interp result
+|   to the number of leaves whose value changed.
+|
+\---------------------------------------------------------------------------*/
+static
+int tcldom_applyEdits (
+    Tcl_Interp *interp,
+    domNode    *node,
+    Tcl_Obj    *editsObj
+)
+{
+    domLength    objc, editc, i, nameLength, position, count, valueLength;
+    domLength    changed = 0;
+    Tcl_Obj    **objv, **editv;
+    char        *path, *p, *start, *value, *end;
+    domNode     *current, *child;
+    Tcl_DString  name;
+    int          rc;
+
+    GetTcldomDATA;
+
+    if (Tcl_ListObjGetElements(interp, editsObj, &objc, &objv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    Tcl_DStringInit(&name);
+    for (i = 0; i < objc; i++) {
+        if (Tcl_ListObjGetElements(interp, objv[i], &editc, &editv)
+            != TCL_OK) {
+            goto error;
+        }
+        if (editc != 2) {
+            SetResult("invalid edit format, expected {path value}!");
+            goto error;
+        }
+        path = Tcl_GetString(editv[0]);
+        current = node;
+        p = path;
+        while (*p) {
+            if (*p == '/') {
+                p++;
+                continue;
+            }
+            start = p;
+            while (*p && *p != '/' && *p != '[') p++;
+            nameLength = p - start;
+            position = 1;
+            if (*p == '[') {
+                position = strtol(p + 1, &end, 10);
+                if (end == p + 1 || *end != ']' || position < 1) {
+                    SetResult3("invalid position predicate in path '",
+                               path, "'");
+                    goto error;
+                }
+                p = end + 1;
+            }
+            if (nameLength == 0 || (*p && *p != '/')) {
+                SetResult3("invalid path '", path, "'");
+                goto error;
+            }
+            count = 0;
+            child = current->firstChild;
+            while (child) {
+                if (child->nodeType == ELEMENT_NODE
+                    && strncmp(child->nodeName, start, nameLength) == 0
+                    && child->nodeName[nameLength] == '\0') {
+                    if (++count == position) break;
+                }
+                child = child->nextSibling;
+            }
+            if (!child) {
+                Tcl_DStringSetLength(&name, 0);
+                Tcl_DStringAppend(&name, start, nameLength);
+                if (position != count + 1) {
+                    SetResult3("no element '", Tcl_DStringValue(&name),
+                               "' at this position in path '");
+                    AppendResult(path);
+                    AppendResult("'");
+                    goto error;
+                }
+                if (!TcldomDATA(dontCheckName)
+                    && !tcldom_nameCheck(interp, Tcl_DStringValue(&name),
+                                         "tag", 0)) {
+                    goto error;
+                }
+                child = domNewElementNode(node->ownerDocument,
+                                          Tcl_DStringValue(&name));
+                domAppendChild(current, child);
+            }
+            current = child;
+        }
+        if (current == node) {
+            SetResult("empty path in edit list!");
+            goto error;
+        }
+        value = Tcl_GetStringFromObj(editv[1], &valueLength);
+        if (!TcldomDATA(dontCheckCharData)
+            && !tcldom_textCheck(interp, value, "text")) {
+            goto error;
+        }
+        rc = tcldom_setLeafValue(interp, current, value, valueLength);
+        if (rc < 0) {
+            SetResult3("path '", path, "' addresses an element with"
+                       " element children");
+            goto error;
+        }
+        changed += rc;
+    }
+    Tcl_DStringFree(&name);
+    SetIntResult(changed);
+    return TCL_OK;
+
+ error:
+    Tcl_DStringFree(&name);
+    return TCL_ERROR;
+}
+
+/*----------------------------------------------------------------------------
+|   tcldom_diffTrees
+|
+|   Compares the element trees below a and b and appends the location
+|   path (relative to the start nodes) of every leaf element with a
+|   different text content to result. Element children are paired by
+|   name and position among their same named siblings. Elements which
+|   exist in only one tree, and elements which are a leaf in one tree
+|   only, are reported with their own path. Attributes, comments and
+|   processing instructions are ignored.
+|
+\---------------------------------------------------------------------------*/
+typedef struct tcldom_diffEntry {
+    domLength countA;
+    domLength countB;
+    domLength seenA;
+    domLength seenB;
+    domLength offsetB;
+} tcldom_diffEntry;
+
+static void tcldom_diffTrees (domNode *a, domNode *b, Tcl_DString *path,
+                              Tcl_Obj *result);
+
+static
+void tcldom_diffAppendPath (
+    Tcl_DString *path,
+    Tcl_Obj     *result
+)
+{
+    if (Tcl_DStringLength(path)) {
+        Tcl_ListObjAppendElement(NULL, result,
+                                 Tcl_NewStringObj(Tcl_DStringValue(path),
+                                                  Tcl_DStringLength(path)));
+    } else {
+        Tcl_ListObjAppendElement(NULL, result, Tcl_NewStringObj(".", 1));
+    }
+}
+
+static
+void tcldom_diffPathStep (
+    Tcl_DString      *path,
+    domNode          *node,
+    tcldom_diffEntry *entry,
+    domLength         position
+)
+{
+    char buf[32];
+
+    if (Tcl_DStringLength(path)) {
+        Tcl_DStringAppend(path, "/", 1);
+    }
+    Tcl_DStringAppend(path, node->nodeName, -1);
+    if (entry->countA > 1 || entry->countB > 1) {
+        sprintf(buf, "[" domLengthConversion "]", position);
+        Tcl_DStringAppend(path, buf, -1);
+    }
+}
+
+static
+void tcldom_diffChildren (
+    domNode     *a,
+    domNode     *b,
+    Tcl_DString *path,
+    Tcl_Obj     *result
+)
+{
+    Tcl_HashTable     names;
+    Tcl_HashEntry    *h;
+    Tcl_HashSearch    search;
+    tcldom_diffEntry *entry;
+    domNode          *child, **bNodes = NULL;
+    domLength         nB = 0, offset = 0, pathLength;
+    int               hnew;
+
+    Tcl_InitHashTable(&names, TCL_STRING_KEYS);
+    for (child = a->firstChild; child; child = child->nextSibling) {
+        if (child->nodeType != ELEMENT_NODE) continue;
+        h = Tcl_CreateHashEntry(&names, child->nodeName, &hnew);
+        if (hnew) {
+            entry = (tcldom_diffEntry*)MALLOC(sizeof(tcldom_diffEntry));
+            memset(entry, 0, sizeof(tcldom_diffEntry));
+            Tcl_SetHashValue(h, entry);
+        }
+        ((tcldom_diffEntry*)Tcl_GetHashValue(h))->countA++;
+    }
+    for (child = b->firstChild; child; child = child->nextSibling) {
+        if (child->nodeType != ELEMENT_NODE) continue;
+        h = Tcl_CreateHashEntry(&names, child->nodeName, &hnew);
+        if (hnew) {
+            entry = (tcldom_diffEntry*)MALLOC(sizeof(tcldom_diffEntry));
+            memset(entry, 0, sizeof(tcldom_diffEntry));
+            Tcl_SetHashValue(h, entry);
+        }
+        ((tcldom_diffEntry*)Tcl_GetHashValue(h))->countB++;
+        nB++;
+    }
+    /* Group the element children of b by name, in document order,
+       so that the n-th element of a name is found in O(1). */
+    if (nB) {
+        bNodes = (domNode**)MALLOC(nB * sizeof(domNode*));
+        for (h = Tcl_FirstHashEntry(&names, &search); h;
+             h = Tcl_NextHashEntry(&search)) {
+            entry = (tcldom_diffEntry*)Tcl_GetHashValue(h);
+            entry->offsetB = offset;
+            offset += entry->countB;
+        }
+        for (child = b->firstChild; child; child = child->nextSibling) {
+            if (child->nodeType != ELEMENT_NODE) continue;
+            entry = (tcldom_diffEntry*)Tcl_GetHashValue(
+                Tcl_FindHashEntry(&names, child->nodeName));
+            bNodes[entry->offsetB + entry->seenB++] = child;
+        }
+    }
+    pathLength = Tcl_DStringLength(path);
+    for (child = a->firstChild; child; child = child->nextSibling) {
+        if (child->nodeType != ELEMENT_NODE) continue;
+        entry = (tcldom_diffEntry*)Tcl_GetHashValue(
+            Tcl_FindHashEntry(&names, child->nodeName));
+        tcldom_diffPathStep(path, child, entry, entry->seenA + 1);
+        if (entry->seenA < entry->countB) {
+            tcldom_diffTrees(child, bNodes[entry->offsetB + entry->seenA],
+                             path, result);
+        } else {
+            tcldom_diffAppendPath(path, result);
+        }
+        entry->seenA++;
+        Tcl_DStringSetLength(path, pathLength);
+    }
+    for (h = Tcl_FirstHashEntry(&names, &search); h;
+         h = Tcl_NextHashEntry(&search)) {
+        entry = (tcldom_diffEntry*)Tcl_GetHashValue(h);
+        entry->seenB = 0;
+    }
+    for (child = b->firstChild; child; child = child->nextSibling) {
+        if (child->nodeType != ELEMENT_NODE) continue;
+        entry = (tcldom_diffEntry*)Tcl_GetHashValue(
+            Tcl_FindHashEntry(&names, child->nodeName));
+        entry->seenB++;
+        if (entry->seenB > entry->countA) {
+            tcldom_diffPathStep(path, child, entry, entry->seenB);
+            tcldom_diffAppendPath(path, result);
+            Tcl_DStringSetLength(path, pathLength);
+        }
+    }
+    for (h = Tcl_FirstHashEntry(&names, &search); h;
+         h = Tcl_NextHashEntry(&search)) {
+        FREE(Tcl_GetHashValue(h));
+    }
+    Tcl_DeleteHashTable(&names);
+    if (bNodes) {
+        FREE(bNodes);
+    }
+}
+
+static
+void tcldom_diffTrees (
+    domNode     *a,
+    domNode     *b,
+    Tcl_DString *path,
+    Tcl_Obj     *result
+)
+{
+    int         aHasElements, bHasElements, differ;
+    Tcl_DString aText, bText;
+
+    aHasElements = tcldom_hasElementChild(a);
+    bHasElements = tcldom_hasElementChild(b);
+    if (aHasElements && bHasElements) {
+        tcldom_diffChildren(a, b, path, result);
+        return;
+    }
+    if (aHasElements != bHasElements) {
+        tcldom_diffAppendPath(path, result);
+        return;
+    }
+    Tcl_DStringInit(&aText);
+    Tcl_DStringInit(&bText);
+    tcldom_leafText(a, &aText);
+    tcldom_leafText(b, &bText);
+    differ = (Tcl_DStringLength(&aText) != Tcl_DStringLength(&bText)
+              || memcmp(Tcl_DStringValue(&aText), Tcl_DStringValue(&bText),
+                        Tcl_DStringLength(&aText)) != 0);
+    Tcl_DStringFree(&aText);
+    Tcl_DStringFree(&bText);
+    if (differ) {
+        tcldom_diffAppendPath(path, result);
+    }
+}
+
 #if TCL_MAJOR_VERSION < 9
 static
 int tcldom_UtfToUniChar (
@@ -4828,6 +5408,8 @@ int tcldom_NodeObjCmd (
     int          nsIndex, bool, hnew, legacy, jsonType;
     Tcl_Obj     *namePtr, *resultPtr;
     Tcl_Obj     *mobjv[MAX_REWRITE_ARGS];
+    Tcl_Obj    **patternv;
+    domLength    patternc;
     Tcl_CmdInfo  cmdInfo;
     Tcl_HashEntry *h;
 
@@ -4849,7 +5431,8 @@ int tcldom_NodeObjCmd (
         "disableOutputEscaping",             "precedes",         "asText",
         "insertBeforeFromScript",            "normalize",        "baseURI",
         "asJSON",          "jsonType",       "attributeNames",   "asCanonicalXML",
-        "getByteIndex",
+        "getByteIndex",    "asDict",         "appendFromDict",  "applyEdits",
+        "diffPaths",
 #ifdef TCL_THREADS
         "readlock",        "writelock",
 #endif
@@ -4873,7 +5456,8 @@ int tcldom_NodeObjCmd (
         m_disableOutputEscaping,             m_precedes,        m_asText,
         m_insertBeforeFromScript,            m_normalize,       m_baseURI,
         m_asJSON,          m_jsonType,       m_attributeNames,  m_asCanonicalXML,
-        m_getByteIndex
+        m_getByteIndex,    m_asDict,         m_appendFromDict,  m_applyEdits,
+        m_diffPaths
 #ifdef TCL_THREADS
         ,m_readlock,       m_writelock
 #endif
@@ -5152,6 +5736,11 @@ int tcldom_NodeObjCmd (
             Tcl_SetObjResult(interp, tcldom_treeAsTclList(interp, node));
             break;
 
+        case m_asDict:
+            CheckArgs(2,2,2,"");
+            Tcl_SetObjResult(interp, tcldom_treeAsTclDict(node));
+            break;
+
         case m_asXML:
             Tcl_ResetResult(interp);
             if (serializeAsXML(node, interp, objc, objv) != TCL_OK) {
@@ -5385,6 +5974,71 @@ int tcldom_NodeObjCmd (
             CheckArgs(3,3,2,"list");
             return tcldom_appendFromTclList(interp, node, objv[2]);
 
+        case m_appendFromDict:
+            CheckArgs(3,5,2,"?-nested patternList? dict");
+            if (node->nodeType != ELEMENT_NODE) {
+                SetResult("NOT_SUPPORTED_ERR: node must be an element");
+                return TCL_ERROR;
+            }
+            patternc = 0;
+            patternv = NULL;
+            if (objc == 5) {
+                if (strcmp(Tcl_GetString(objv[2]), "-nested") != 0) {
+                    SetResult("bad option, must be -nested");
+                    return TCL_ERROR;
+                }
+                if (Tcl_ListObjGetElements(interp, objv[3], &patternc,
+                                           &patternv) != TCL_OK) {
+                    return TCL_ERROR;
+                }
+            } else if (objc == 4) {
+                SetResult("wrong # args: should be \"appendFromDict ?-nested patternList? dict\"");
+                return TCL_ERROR;
+            }
+            if (tcldom_appendFromTclDict(interp, node, objv[objc-1], patternc,
+                                         patternv) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            return tcldom_setInterpAndReturnVar(interp, node, 0, NULL);
+
+        case m_applyEdits:
+            CheckArgs(3,3,2,"editList");
+            if (node->nodeType != ELEMENT_NODE) {
+                SetResult("NOT_SUPPORTED_ERR: node must be an element");
+                return TCL_ERROR;
+            }
+            return tcldom_applyEdits(interp, node, objv[2]);
+
+        case m_diffPaths:
+            CheckArgs(3,3,2,"otherNode");
+            {
+                domDocument *otherDoc;
+                char        *errMsg;
+                Tcl_DString  path;
+
+                str = Tcl_GetString(objv[2]);
+                if (strncmp(str, "domDoc", 6) == 0) {
+                    otherDoc = tcldom_getDocumentFromName(interp, str,
+                                                          &errMsg);
+                    if (otherDoc == NULL) {
+                        SetResult(errMsg);
+                        return TCL_ERROR;
+                    }
+                    refNode = otherDoc->rootNode;
+                } else {
+                    refNode = tcldom_getNodeFromObj(interp, objv[2]);
+                    if (refNode == NULL) {
+                        return TCL_ERROR;
+                    }
+                }
+                resultPtr = Tcl_NewObj();
+                Tcl_DStringInit(&path);
+                tcldom_diffTrees(node, refNode, &path, resultPtr);
+                Tcl_DStringFree(&path);
+                Tcl_SetObjResult(interp, resultPtr);
+            }
+            break;
+
         case m_appendFromScript:
             CheckArgs(3,3,2,"script");
             result = nodecmd_appendFromScript(interp, node, objv[2]);
@@ -5976,7 +6630,8 @@ int tcldom_DocObjCmd (
         "replaceChild",    "appendFromList",             "appendXML",
         "selectNodes",     "baseURI",                    "appendFromScript",
         "insertBeforeFromScript",                        "asJSON",
-        "jsonType",        
+        "jsonType",        "asDict",                     "appendFromDict",
+        "applyEdits",      "diffPaths",
 #ifdef TCL_THREADS
         "readlock",        "writelock",                  "renumber",
 #endif
@@ -6002,7 +6657,8 @@ int tcldom_DocObjCmd (
         m_replaceChild,     m_appendFromList,             m_appendXML,
         m_selectNodes,      m_baseURI,                    m_appendFromScript,
         m_insertBeforeFromScript,                         m_asJSON,
-        m_jsonType
+        m_jsonType,         m_asDict,                     m_appendFromDict,
+        m_applyEdits,       m_diffPaths
 #ifdef TCL_THREADS
        ,m_readlock,         m_writelock,                  m_renumber
 #endif
@@ -6425,6 +7081,8 @@ int tcldom_DocObjCmd (
         case m_insertBefore:
         case m_replaceChild:
         case m_appendFromList:
+        case m_appendFromDict:
+        case m_applyEdits:
         case m_appendXML:
         case m_appendFromScript:
         case m_insertBeforeFromScript:
@@ -6439,6 +7097,8 @@ int tcldom_DocObjCmd (
         case m_baseURI:
         case m_asJSON:
         case m_jsonType:
+        case m_asDict:
+        case m_diffPaths:
         case m_getElementById:
             /* We dispatch the method call to tcldom_NodeObjCmd */
             if (TcldomDATA(domCreateCmdMode) == DOM_CREATECMDMODE_AUTO) {
@@ -137,6 +137,10 @@ static int      TclExpatCget (Tcl_Interp *interp,
 static int	TclExpatGet (Tcl_Interp *interp,
 		    TclGenExpatInfo *expat, int objc, Tcl_Obj *const objv[]);
 static void	TclExpatDispatchPCDATA (TclGenExpatInfo *expat);
+static void	TclExpatDispatchPendingStart (TclGenExpatInfo *expat);
+static void	TclExpatDispatchLeaf (TclGenExpatInfo *expat);
+static void	TclExpatFreePendingLeaf (TclGenExpatInfo *expat);
+static int	TclExpatCdataSectionReported (TclGenExpatInfo *expat);
 static void TclGenExpatElementStartHandler (void *userdata,
                                             const XML_Char *name,
                                             const XML_Char **atts);
@@ -261,6 +265,7 @@ CreateTclHandlerSet (
     handlerSet->endDoctypeDeclCommand    = NULL;
     handlerSet->xmlDeclCommand           = NULL;
     handlerSet->entityDeclCommand        = NULL;
+    handlerSet->leafcommand              = NULL;
     return handlerSet;
 }
 
@@ -533,6 +538,7 @@ TclExpatInitializeParser(
         Tcl_DecrRefCount (expat->cdata);
     }
     expat->cdata                  = NULL;
+    TclExpatFreePendingLeaf (expat);
     eContent = expat->eContents;
     while (eContent) {
         XML_FreeContentModel (expat->parser, eContent->content);
@@ -1015,7 +1021,8 @@ TclExpatParse (
       expat->parsingState = 2;
       do {
           done = (len < PARSE_CHUNK_SIZE);
-          result = XML_Parse(expat->parser, data, (int)len,
+          result = XML_Parse(expat->parser, data,
+                             (int)(done ? len : PARSE_CHUNK_SIZE),
                              done ? expat->final : 0);
           if (!done) {
               data += PARSE_CHUNK_SIZE;
@@ -1215,6 +1222,7 @@ TclExpatConfigure (
     "-handlerset",
     "-noexpand",
     "-fastcall",
+    "-leafcommand",
 #ifndef TDOM_NO_SCHEMA
     "-validateCmd",
 #endif
@@ -1246,7 +1254,8 @@ TclExpatConfigure (
     EXPAT_NOWHITESPACE,
     EXPAT_HANDLERSET,
     EXPAT_NOEXPAND,
-    EXPAT_FASTCALL
+    EXPAT_FASTCALL,
+    EXPAT_LEAFCMD
 #ifndef TDOM_NO_SCHEMA
     ,EXPAT_VALIDATECMD
 #endif
@@ -1721,6 +1730,22 @@ TclExpatConfigure (
 
           break;
 
+      case EXPAT_LEAFCMD:               /* -leafcommand */
+          CheckDefaultTclHandlerSet;
+          if (activeTclHandlerSet->leafcommand != NULL) {
+              Tcl_DecrRefCount (activeTclHandlerSet->leafcommand);
+              activeTclHandlerSet->leafcommand = NULL;
+          }
+          /* The empty script switches back to the start tag, text
+           * and end tag callbacks for leaf elements. */
+          Tcl_GetStringFromObj (objPtr[1], &len);
+          if (len) {
+              activeTclHandlerSet->leafcommand = objPtr[1];
+              Tcl_IncrRefCount (activeTclHandlerSet->leafcommand);
+          }
+
+          break;
+
       case EXPAT_PARAMENTITYPARSING: /* -paramentityparsing */
 	  if (Tcl_GetIndexFromObj(interp, objPtr[1], paramEntityParsingValues,
 		  "value", 0, &value) != TCL_OK) {
@@ -1887,6 +1912,7 @@ TclExpatCget (
         "-noexpand",
         "-namespace",
         "-namespaceseparator",
+        "-leafcommand",
         (char *) NULL
     };
     enum switches {
@@ -1912,7 +1938,8 @@ TclExpatCget (
         EXPAT_HANDLERSET,
         EXPAT_NOEXPAND,
         EXPAT_NAMESPACE,
-        EXPAT_NAMESPACESEPARATOR
+        EXPAT_NAMESPACESEPARATOR,
+        EXPAT_LEAFCMD
     };
     int optionIndex, len;
     TclHandlerSet *activeTclHandlerSet = NULL;
@@ -2245,6 +2272,15 @@ TclExpatCget (
         }
         return TCL_OK;
 
+      case EXPAT_LEAFCMD: /* -leafcommand */
+
+        if (activeTclHandlerSet->leafcommand) {
+            Tcl_SetObjResult(interp, activeTclHandlerSet->leafcommand);
+        } else {
+            Tcl_SetResult(interp, "", NULL);
+        }
+        return TCL_OK;
+
       default:
           /* do nothing */
           break;
@@ -2439,7 +2475,7 @@ TclGenExpatElementStartHandler(
   TclGenExpatInfo *expat = (TclGenExpatInfo *) userData;
   Tcl_Obj *atList = NULL;
   const char **atPtr;
-  int result;
+  int result, deferStart = 0;
   Tcl_Obj *vector[3];
   TclHandlerSet *activeTclHandlerSet;
   CHandlerSet *activeCHandlerSet;
@@ -2473,7 +2509,13 @@ TclGenExpatElementStartHandler(
       if (activeTclHandlerSet->status == TCL_CONTINUE) {
       }
 
-      if (activeTclHandlerSet->elementstartcommand == NULL) {
+      /*
+       * Handler sets with a -leafcommand get the start tag reported
+       * not until it is clear if the element is a leaf.
+       */
+      if (activeTclHandlerSet->leafcommand != NULL) {
+          deferStart = 1;
+      } else if (activeTclHandlerSet->elementstartcommand == NULL) {
           goto nextTcl;
       }
 
@@ -2491,6 +2533,10 @@ TclGenExpatElementStartHandler(
           vector[2] = atList;
       }
 
+      if (activeTclHandlerSet->leafcommand != NULL) {
+          goto nextTcl;
+      }
+
       if (activeTclHandlerSet->elementstartObjProc != NULL) {
           vector[0] = activeTclHandlerSet->elementstartcommand;
           Tcl_IncrRefCount (vector[0]);
@@ -2528,7 +2574,11 @@ TclGenExpatElementStartHandler(
   nextTcl:
       activeTclHandlerSet = activeTclHandlerSet->nextHandlerSet;
   }
-  if (atList) {
+  if (deferStart) {
+      expat->leafName = Tcl_NewStringObj((char *)name, -1);
+      Tcl_IncrRefCount (expat->leafName);
+      expat->leafAtts = atList;
+  } else if (atList) {
       Tcl_DecrRefCount (atList);
   }
   
@@ -2593,6 +2643,9 @@ TclGenExpatElementEndHandler(
       return;
   }
 
+  if (expat->leafName) {
+      TclExpatDispatchLeaf(expat);
+  }
   TclExpatDispatchPCDATA(expat);
 
   activeTclHandlerSet = expat->firstTclHandlerSet;
@@ -2620,6 +2673,10 @@ TclGenExpatElementEndHandler(
           goto nextTcl;
       }
 
+      if (expat->leafEnd && activeTclHandlerSet->leafcommand) {
+          goto nextTcl;
+      }
+
       if (activeTclHandlerSet->elementendObjProc != NULL) {
           if (ename == NULL) {
               ename = Tcl_NewStringObj ((char *)name, -1);
@@ -2663,6 +2720,7 @@ TclGenExpatElementEndHandler(
   if (ename) {
       Tcl_DecrRefCount (ename);
   }
+  expat->leafEnd = 0;
 
   activeCHandlerSet = expat->firstCHandlerSet;
   while (activeCHandlerSet) {
@@ -2944,9 +3002,15 @@ TclExpatDispatchPCDATA(
   Tcl_Obj* cmdPtr;
   char *s;
 
-  if (expat->cdata       == NULL ||
-      expat->status      != TCL_OK
-  ) {
+  if (expat->status != TCL_OK) {
+    return;
+  }
+  if (expat->leafName) {
+    /* Some other event than the end tag follows the start tag: the
+     * element isn't a leaf, report the start tag as such first. */
+    TclExpatDispatchPendingStart(expat);
+  }
+  if (expat->cdata == NULL) {
     return;
   }
 
@@ -2971,6 +3035,13 @@ TclExpatDispatchPCDATA(
           goto nextTcl;
       }
 
+      /*
+       * The text was already reported by the -leafcommand script
+       */
+      if (expat->leafEnd && activeTclHandlerSet->leafcommand) {
+          goto nextTcl;
+      }
+
       /*
        * Check whether we are in 'trim' mode
        */
@@ -3039,6 +3110,253 @@ TclExpatDispatchPCDATA(
   return;
 }
 
+/*
+ *----------------------------------------------------------------------------
+ *
+ * TclExpatFreePendingLeaf --
+ *
+ *	Forgets the start tag kept back for the -leafcommand handler
+ *	sets.
+ *
+ * Results:
+ *	None.
+ *
+ * Side Effects:
+ *	Frees the kept name and attribute list.
+ *
+ *----------------------------------------------------------------------------
+ */
+
+static void
+TclExpatFreePendingLeaf(
+    TclGenExpatInfo *expat
+) {
+  if (expat->leafName) {
+      Tcl_DecrRefCount (expat->leafName);
+      Tcl_DecrRefCount (expat->leafAtts);
+      expat->leafName = NULL;
+      expat->leafAtts = NULL;
+  }
+  expat->leafEnd = 0;
+}
+
+/*
+ *----------------------------------------------------------------------------
+ *
+ * TclExpatCdataSectionReported --
+ *
+ *	Checks, if any handler set wants to see CDATA section starts
+ *	or ends.
+ *
+ * Results:
+ *	1 if there is such a handler set, otherwise 0.
+ *
+ * Side Effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------------
+ */
+
+static int
+TclExpatCdataSectionReported(
+    TclGenExpatInfo *expat
+) {
+  TclHandlerSet *activeTclHandlerSet;
+  CHandlerSet *activeCHandlerSet;
+
+  activeTclHandlerSet = expat->firstTclHandlerSet;
+  while (activeTclHandlerSet) {
+      if (activeTclHandlerSet->startCdataSectionCommand
+          || activeTclHandlerSet->endCdataSectionCommand) {
+          return 1;
+      }
+      activeTclHandlerSet = activeTclHandlerSet->nextHandlerSet;
+  }
+  activeCHandlerSet = expat->firstCHandlerSet;
+  while (activeCHandlerSet) {
+      if (activeCHandlerSet->startCdataSectionCommand
+          || activeCHandlerSet->endCdataSectionCommand) {
+          return 1;
+      }
+      activeCHandlerSet = activeCHandlerSet->nextHandlerSet;
+  }
+  return 0;
+}
+
+/*
+ *----------------------------------------------------------------------------
+ *
+ * TclExpatDispatchPendingStart --
+ *
+ *	Called if the start tag kept back for the -leafcommand handler
+ *	sets turns out not to be the start of a leaf element. Invokes
+ *	the -elementstartcommand of these handler sets.
+ *
+ * Results:
+ *	None.
+ *
+ * Side Effects:
+ *	Callback scripts are invoked.
+ *
+ *----------------------------------------------------------------------------
+ */
+
+static void
+TclExpatDispatchPendingStart(
+    TclGenExpatInfo *expat
+) {
+  int result;
+  Tcl_Obj *vector[3], *name, *atList;
+  TclHandlerSet *activeTclHandlerSet;
+  Tcl_Obj      *cmdPtr;
+
+  name = expat->leafName;
+  atList = expat->leafAtts;
+  expat->leafName = NULL;
+  expat->leafAtts = NULL;
+
+  activeTclHandlerSet = expat->firstTclHandlerSet;
+  while (activeTclHandlerSet) {
+      switch (activeTclHandlerSet->status) {
+      case TCL_CONTINUE:
+      case TCL_BREAK:
+          goto nextTcl;
+          break;
+      default:
+          ;
+      }
+
+      if (activeTclHandlerSet->leafcommand == NULL
+          || activeTclHandlerSet->elementstartcommand == NULL) {
+          goto nextTcl;
+      }
+
+      if (activeTclHandlerSet->elementstartObjProc != NULL) {
+          vector[0] = activeTclHandlerSet->elementstartcommand;
+          vector[1] = name;
+          vector[2] = atList;
+          result = activeTclHandlerSet->elementstartObjProc(
+              activeTclHandlerSet->elementstartclientData, expat->interp,
+              3, vector);
+          TclExpatHandlerResult(expat, activeTclHandlerSet, result);
+      } else {
+          cmdPtr = Tcl_DuplicateObj(activeTclHandlerSet->elementstartcommand);
+          Tcl_IncrRefCount(cmdPtr);
+          Tcl_Preserve((ClientData) expat->interp);
+
+          Tcl_ListObjAppendElement(expat->interp, cmdPtr, name);
+          Tcl_ListObjAppendElement(expat->interp, cmdPtr, atList);
+          result = Tcl_EvalObjEx(expat->interp, cmdPtr,
+                                 TCL_EVAL_GLOBAL | TCL_EVAL_DIRECT);
+
+          Tcl_DecrRefCount(cmdPtr);
+          Tcl_Release((ClientData) expat->interp);
+
+          TclExpatHandlerResult(expat, activeTclHandlerSet, result);
+      }
+  nextTcl:
+      activeTclHandlerSet = activeTclHandlerSet->nextHandlerSet;
+  }
+  Tcl_DecrRefCount (name);
+  Tcl_DecrRefCount (atList);
+}
+
+/*
+ *----------------------------------------------------------------------------
+ *
+ * TclExpatDispatchLeaf --
+ *
+ *	Called at the end tag of an element without element children
+ *	(and without comments or processing instructions). Invokes
+ *	the -leafcommand scripts with the element name, the attribute
+ *	list and the text content of the element, instead of the
+ *	start tag, character data and end tag callbacks.
+ *
+ * Results:
+ *	None.
+ *
+ * Side Effects:
+ *	Callback scripts are invoked.
+ *
+ *----------------------------------------------------------------------------
+ */
+
+static void
+TclExpatDispatchLeaf(
+    TclGenExpatInfo *expat
+) {
+  int result, onlyWhiteSpace = -1;
+  domLength len = 0;
+  char *s = "";
+  Tcl_Obj *name, *atList, *text = NULL;
+  TclHandlerSet *activeTclHandlerSet;
+  Tcl_Obj      *cmdPtr;
+
+  name = expat->leafName;
+  atList = expat->leafAtts;
+  expat->leafName = NULL;
+  expat->leafAtts = NULL;
+  if (expat->cdata) {
+      s = Tcl_GetStringFromObj (expat->cdata, &len);
+  }
+
+  activeTclHandlerSet = expat->firstTclHandlerSet;
+  while (activeTclHandlerSet) {
+      switch (activeTclHandlerSet->status) {
+      case TCL_CONTINUE:
+      case TCL_BREAK:
+          goto nextTcl;
+          break;
+      default:
+          ;
+      }
+
+      if (activeTclHandlerSet->leafcommand == NULL) {
+          goto nextTcl;
+      }
+
+      cmdPtr = Tcl_DuplicateObj(activeTclHandlerSet->leafcommand);
+      Tcl_IncrRefCount(cmdPtr);
+      Tcl_Preserve((ClientData) expat->interp);
+
+      Tcl_ListObjAppendElement(expat->interp, cmdPtr, name);
+      Tcl_ListObjAppendElement(expat->interp, cmdPtr, atList);
+      if (activeTclHandlerSet->ignoreWhiteCDATAs) {
+          if (onlyWhiteSpace < 0) {
+              onlyWhiteSpace = TclExpatCheckWhiteData (s, len);
+          }
+      }
+      if (activeTclHandlerSet->ignoreWhiteCDATAs && onlyWhiteSpace) {
+          Tcl_ListObjAppendElement(expat->interp, cmdPtr, Tcl_NewObj());
+      } else {
+          if (text == NULL) {
+              text = Tcl_NewStringObj (s, len);
+              Tcl_IncrRefCount (text);
+          }
+          Tcl_ListObjAppendElement(expat->interp, cmdPtr, text);
+      }
+      result = Tcl_EvalObjEx(expat->interp, cmdPtr,
+                             TCL_EVAL_GLOBAL | TCL_EVAL_DIRECT);
+
+      Tcl_DecrRefCount(cmdPtr);
+      Tcl_Release((ClientData) expat->interp);
+
+      /* There is nothing left to skip inside a leaf. */
+      if (result == TCL_CONTINUE) {
+          result = TCL_OK;
+      }
+      TclExpatHandlerResult(expat, activeTclHandlerSet, result);
+  nextTcl:
+      activeTclHandlerSet = activeTclHandlerSet->nextHandlerSet;
+  }
+  if (text) {
+      Tcl_DecrRefCount (text);
+  }
+  Tcl_DecrRefCount (name);
+  Tcl_DecrRefCount (atList);
+  expat->leafEnd = 1;
+}
+
 
 /*
  *----------------------------------------------------------------------------
@@ -3971,6 +4289,12 @@ TclGenExpatStartCdataSectionHandler(
       return;
   }
 
+  if (expat->leafName && !TclExpatCdataSectionReported(expat)) {
+      /* Keep the section content together with the other text of
+       * a possible -leafcommand leaf element. */
+      return;
+  }
+
   TclExpatDispatchPCDATA(expat);
 
   activeTclHandlerSet = expat->firstTclHandlerSet;
@@ -4047,6 +4371,12 @@ TclGenExpatEndCdataSectionHandler(
       return;
   }
 
+  if (expat->leafName && !TclExpatCdataSectionReported(expat)) {
+      /* Keep the section content together with the other text of
+       * a possible -leafcommand leaf element. */
+      return;
+  }
+
   TclExpatDispatchPCDATA(expat);
 
   activeTclHandlerSet = expat->firstTclHandlerSet;
@@ -4652,6 +4982,7 @@ TclExpatDeleteCmd(
     Tcl_DecrRefCount(expat->cdata);
     expat->cdata = NULL;
   }
+  TclExpatFreePendingLeaf (expat);
 
   if (expat->result) {
       Tcl_DecrRefCount(expat->result);
@@ -4721,6 +5052,9 @@ TclExpatDeleteCmd(
       if (activeTclHandlerSet->entityDeclCommand) {
           Tcl_DecrRefCount (activeTclHandlerSet->entityDeclCommand);
       }
+      if (activeTclHandlerSet->leafcommand) {
+          Tcl_DecrRefCount (activeTclHandlerSet->leafcommand);
+      }
 
       tmpTclHandlerSet = activeTclHandlerSet;
       activeTclHandlerSet = activeTclHandlerSet->nextHandlerSet;
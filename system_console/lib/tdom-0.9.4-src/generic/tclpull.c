@@ -478,6 +478,235 @@ tDOM_resumeParseing (
     return TCL_OK;
 }
 
+/* Advances the parser to the next event. This is the work of the
+ * next method, without reporting the new state, so that it can be
+ * looped over from C for the batch methods. */
+static int
+tDOM_PullParserNext (
+    Tcl_Interp *interp,
+    tDOM_PullParserInfo *pullInfo
+    )
+{
+    int result, done;
+    domLength len;
+    char *data;
+
+    if (pullInfo->state == PULLPARSERSTATE_TEXT) {
+        Tcl_DStringSetLength (pullInfo->cdata, 0);
+    }
+    if (pullInfo->next2State) {
+        pullInfo->state = pullInfo->nextState;
+        pullInfo->nextState = pullInfo->next2State;
+        pullInfo->next2State = 0;
+    } else if (pullInfo->nextState) {
+        pullInfo->state = pullInfo->nextState;
+        pullInfo->nextState = 0;
+    } else {
+        switch (pullInfo->state) {
+        case PULLPARSERSTATE_READY:
+            SetResult ("No input");
+            return TCL_ERROR;
+        case PULLPARSERSTATE_PARSE_ERROR:
+            SetResult ("Parsing stopped with XML parsing error.");
+            return TCL_ERROR;
+        case PULLPARSERSTATE_END_DOCUMENT:
+            SetResult ("No next event after END_DOCUMENT");
+            return TCL_ERROR;
+        case PULLPARSERSTATE_TEXT:
+            /* Since PULLPARSERSTATE_TEXT always has nextState set
+             * this case is handled in the if part of this if else
+             * and this is never reached. It's just here to eat up
+             * this case in the switch. */
+            break;
+        case PULLPARSERSTATE_START_DOCUMENT:
+            if (pullInfo->inputfd) {
+                do {
+                    char *fbuf =
+                        XML_GetBuffer (pullInfo->parser,
+                                       TDOM_EXPAT_READ_SIZE);
+                    len = read(pullInfo->inputfd, fbuf,
+                               TDOM_EXPAT_READ_SIZE);
+                    result = XML_ParseBuffer (pullInfo->parser,
+                                              (int)len, len == 0);
+                } while (result == XML_STATUS_OK);
+            } else if (pullInfo->inputChannel) {
+                do {
+                    len = Tcl_ReadChars (pullInfo->inputChannel,
+                                         pullInfo->channelReadBuf,
+                                         1024, 0);
+                    data = Tcl_GetString (pullInfo->channelReadBuf);
+                    result = XML_Parse (pullInfo->parser, data, (int)len,
+                                        len == 0);
+                } while (result == XML_STATUS_OK);
+            } else {
+                data = Tcl_GetStringFromObj(pullInfo->inputString, &len);
+                do {
+                    done = (len < PARSE_CHUNK_SIZE);
+                    result = XML_Parse (pullInfo->parser, data, (int)len,
+                                        done);
+                    if (!done) {
+                        data += PARSE_CHUNK_SIZE;
+                        len -= PARSE_CHUNK_SIZE;
+                    }
+                } while (!done && result == XML_STATUS_OK);
+            }
+            switch (result) {
+            case XML_STATUS_OK:
+                tDOM_CleanupInputSource (pullInfo);
+                pullInfo->state = PULLPARSERSTATE_END_DOCUMENT;
+                break;
+            case XML_STATUS_ERROR:
+                tDOM_CleanupInputSource (pullInfo);
+                tDOM_ReportXMLError (interp, pullInfo);
+                pullInfo->state = PULLPARSERSTATE_PARSE_ERROR;
+                return TCL_ERROR;
+            case XML_STATUS_SUSPENDED:
+                /* Nothing to do here, state was set in handler, just
+                 * take care to report */
+                break;
+            }
+            break;
+        default:
+            DBG (printParserState(pullInfo->parser));
+            if (tDOM_resumeParseing (interp, pullInfo) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            DBG (printParserState(pullInfo->parser));
+            break;
+        }
+    }
+    return TCL_OK;
+}
+
+/* Appends the current event as (event, tag, text) tuple to listPtr.
+ * Tag is empty for TEXT and END_DOCUMENT events, text is empty for
+ * all but TEXT events. */
+static void
+tDOM_PullParserAppendEvent (
+    Tcl_Interp *interp,
+    tDOM_PullParserInfo *pullInfo,
+    Tcl_Obj *listPtr,
+    Tcl_Obj *emptyObj
+    )
+{
+    switch (pullInfo->state) {
+    case PULLPARSERSTATE_START_TAG:
+        Tcl_ListObjAppendElement (interp, listPtr, pullInfo->start_tag);
+        Tcl_ListObjAppendElement (interp, listPtr, pullInfo->currentElm);
+        Tcl_ListObjAppendElement (interp, listPtr, emptyObj);
+        break;
+    case PULLPARSERSTATE_END_TAG:
+        Tcl_ListObjAppendElement (interp, listPtr, pullInfo->end_tag);
+        Tcl_ListObjAppendElement (interp, listPtr, pullInfo->currentElm);
+        Tcl_ListObjAppendElement (interp, listPtr, emptyObj);
+        break;
+    case PULLPARSERSTATE_TEXT:
+        Tcl_ListObjAppendElement (interp, listPtr, pullInfo->text);
+        Tcl_ListObjAppendElement (interp, listPtr, emptyObj);
+        Tcl_ListObjAppendElement (
+            interp, listPtr,
+            Tcl_NewStringObj (Tcl_DStringValue (pullInfo->cdata),
+                              Tcl_DStringLength (pullInfo->cdata))
+            );
+        break;
+    case PULLPARSERSTATE_END_DOCUMENT:
+        Tcl_ListObjAppendElement (interp, listPtr,
+                                  Tcl_NewStringObj ("END_DOCUMENT", 12));
+        Tcl_ListObjAppendElement (interp, listPtr, emptyObj);
+        Tcl_ListObjAppendElement (interp, listPtr, emptyObj);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Parses from the current START_TAG event to the corresponding
+ * END_TAG event and appends the path (relative to the start element,
+ * steps separated by '/') and the text of every element without
+ * element children to listPtr. The start element itself, if it is
+ * such a leaf, is reported with the path ".". */
+static int
+tDOM_PullParserLeafValues (
+    Tcl_Interp *interp,
+    tDOM_PullParserInfo *pullInfo,
+    Tcl_Obj *listPtr
+    )
+{
+    Tcl_DString path, text;
+    domLength *pathLen;
+    char *hasChild;
+    int depth = 1, size = 32, result = TCL_OK;
+
+    pathLen = (domLength *) MALLOC (size * sizeof (domLength));
+    hasChild = (char *) MALLOC (size);
+    pathLen[0] = 0;
+    hasChild[0] = 0;
+    Tcl_DStringInit (&path);
+    Tcl_DStringInit (&text);
+    while (depth > 0) {
+        if (tDOM_PullParserNext (interp, pullInfo) != TCL_OK) {
+            result = TCL_ERROR;
+            break;
+        }
+        switch (pullInfo->state) {
+        case PULLPARSERSTATE_START_TAG:
+            hasChild[depth-1] = 1;
+            if (depth == size) {
+                size *= 2;
+                pathLen = (domLength *) REALLOC ((char *) pathLen,
+                                                 size * sizeof (domLength));
+                hasChild = (char *) REALLOC (hasChild, size);
+            }
+            pathLen[depth] = Tcl_DStringLength (&path);
+            hasChild[depth] = 0;
+            depth++;
+            if (Tcl_DStringLength (&path)) {
+                Tcl_DStringAppend (&path, "/", 1);
+            }
+            Tcl_DStringAppend (&path, Tcl_GetString (pullInfo->currentElm),
+                               -1);
+            Tcl_DStringSetLength (&text, 0);
+            break;
+        case PULLPARSERSTATE_TEXT:
+            Tcl_DStringAppend (&text, Tcl_DStringValue (pullInfo->cdata),
+                               Tcl_DStringLength (pullInfo->cdata));
+            break;
+        case PULLPARSERSTATE_END_TAG:
+            depth--;
+            if (!hasChild[depth]) {
+                if (depth) {
+                    Tcl_ListObjAppendElement (
+                        interp, listPtr,
+                        Tcl_NewStringObj (Tcl_DStringValue (&path),
+                                          Tcl_DStringLength (&path))
+                        );
+                } else {
+                    Tcl_ListObjAppendElement (interp, listPtr,
+                                              Tcl_NewStringObj (".", 1));
+                }
+                Tcl_ListObjAppendElement (
+                    interp, listPtr,
+                    Tcl_NewStringObj (Tcl_DStringValue (&text),
+                                      Tcl_DStringLength (&text))
+                    );
+            }
+            Tcl_DStringSetLength (&path, pathLen[depth]);
+            Tcl_DStringSetLength (&text, 0);
+            break;
+        default:
+            /* Not reached with well-formed input, expat reports
+             * unbalanced tags as parsing error. */
+            depth = 0;
+            break;
+        }
+    }
+    Tcl_DStringFree (&path);
+    Tcl_DStringFree (&text);
+    FREE (pathLen);
+    FREE (hasChild);
+    return result;
+}
+
 static int
 tDOM_PullParserInstanceCmd (
     ClientData  clientdata,
@@ -487,18 +716,17 @@ tDOM_PullParserInstanceCmd (
     )
 {
     tDOM_PullParserInfo *pullInfo = clientdata;
-    int methodIndex, result, mode, fd, optionIndex, done;
-    domLength len;
-    char *data;
+    int methodIndex, result, mode, fd, optionIndex, count, i;
     const char **atts;
-    Tcl_Obj *resultPtr;
+    Tcl_Obj *resultPtr, *emptyObj;
     Tcl_Channel channel;
     
     static const char *const methods[] = {
         "input", "inputchannel", "inputfile",
         "next", "state", "tag", "attributes",
         "text", "delete", "reset", "skip",
-        "find-element", "line", "column", NULL
+        "find-element", "line", "column", "nextBatch",
+        "leafValues", NULL
     };
     static const char *const findelement_options[] = {
         "-names", NULL
@@ -508,7 +736,8 @@ tDOM_PullParserInstanceCmd (
         m_input, m_inputchannel, m_inputfile,
         m_next, m_state, m_tag, m_attributes,
         m_text, m_delete, m_reset, m_skip,
-        m_find_element, m_line, m_column
+        m_find_element, m_line, m_column, m_nextBatch,
+        m_leafValues
     };
 
     if (objc == 1) {
@@ -593,89 +822,8 @@ tDOM_PullParserInstanceCmd (
             Tcl_WrongNumArgs (interp, 2, objv, "");
             return TCL_ERROR;
         }
-        if (pullInfo->state == PULLPARSERSTATE_TEXT) {
-            Tcl_DStringSetLength (pullInfo->cdata, 0);
-        }
-        if (pullInfo->next2State) {
-            pullInfo->state = pullInfo->nextState;
-            pullInfo->nextState = pullInfo->next2State;
-            pullInfo->next2State = 0;
-        } else if (pullInfo->nextState) {
-            pullInfo->state = pullInfo->nextState;
-            pullInfo->nextState = 0;
-        } else {
-            switch (pullInfo->state) {
-            case PULLPARSERSTATE_READY:
-                SetResult ("No input");
-                return TCL_ERROR;
-            case PULLPARSERSTATE_PARSE_ERROR:
-                SetResult ("Parsing stopped with XML parsing error.");
-                return TCL_ERROR;
-            case PULLPARSERSTATE_END_DOCUMENT:
-                SetResult ("No next event after END_DOCUMENT");
-                return TCL_ERROR;
-            case PULLPARSERSTATE_TEXT:
-                /* Since PULLPARSERSTATE_TEXT always has nextState set
-                 * this case is handled in the if part of this if else
-                 * and this is never reached. It's just here to eat up
-                 * this case in the switch. */
-                break;
-            case PULLPARSERSTATE_START_DOCUMENT:
-                if (pullInfo->inputfd) {
-                    do {
-                        char *fbuf =
-                            XML_GetBuffer (pullInfo->parser,
-                                           TDOM_EXPAT_READ_SIZE);
-                        len = read(pullInfo->inputfd, fbuf,
-                                   TDOM_EXPAT_READ_SIZE);
-                        result = XML_ParseBuffer (pullInfo->parser,
-                                                  (int)len, len == 0);
-                    } while (result == XML_STATUS_OK);
-                } else if (pullInfo->inputChannel) {
-                    do {
-                        len = Tcl_ReadChars (pullInfo->inputChannel,
-                                             pullInfo->channelReadBuf,
-                                             1024, 0);
-                        data = Tcl_GetString (pullInfo->channelReadBuf);
-                        result = XML_Parse (pullInfo->parser, data, (int)len,
-                                            len == 0);
-                    } while (result == XML_STATUS_OK);
-                } else {
-                    data = Tcl_GetStringFromObj(pullInfo->inputString, &len);
-                    do {
-                        done = (len < PARSE_CHUNK_SIZE);
-                        result = XML_Parse (pullInfo->parser, data, (int)len,
-                                            done);
-                        if (!done) {
-                            data += PARSE_CHUNK_SIZE;
-                            len -= PARSE_CHUNK_SIZE;
-                        }
-                    } while (!done && result == XML_STATUS_OK);
-                }
-                switch (result) {
-                case XML_STATUS_OK:
-                    tDOM_CleanupInputSource (pullInfo);
-                    pullInfo->state = PULLPARSERSTATE_END_DOCUMENT;
-                    break;
-                case XML_STATUS_ERROR:
-                    tDOM_CleanupInputSource (pullInfo);
-                    tDOM_ReportXMLError (interp, pullInfo);
-                    pullInfo->state = PULLPARSERSTATE_PARSE_ERROR;
-                    return TCL_ERROR;
-                case XML_STATUS_SUSPENDED:
-                    /* Nothing to do here, state was set in handler, just
-                     * take care to report */
-                    break;
-                }
-                break;
-            default:
-                DBG (printParserState(pullInfo->parser));
-                if (tDOM_resumeParseing (interp, pullInfo) != TCL_OK) {
-                    return TCL_ERROR;
-                }
-                DBG (printParserState(pullInfo->parser));
-                break;
-            }
+        if (tDOM_PullParserNext (interp, pullInfo) != TCL_OK) {
+            return TCL_ERROR;
         }
         /* To report state:*/
         /* fall through */
@@ -852,6 +1000,63 @@ tDOM_PullParserInstanceCmd (
         }
         break;
 
+    case m_nextBatch:
+        if (objc != 3) {
+            Tcl_WrongNumArgs (interp, 2, objv, "count");
+            return TCL_ERROR;
+        }
+        if (Tcl_GetIntFromObj (interp, objv[2], &count) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (count < 1) {
+            SetResult ("count must be a positive integer");
+            return TCL_ERROR;
+        }
+        if (pullInfo->state == PULLPARSERSTATE_END_DOCUMENT) {
+            Tcl_ResetResult (interp);
+            break;
+        }
+        resultPtr = Tcl_NewListObj (0, NULL);
+        Tcl_IncrRefCount (resultPtr);
+        emptyObj = Tcl_NewObj ();
+        Tcl_IncrRefCount (emptyObj);
+        result = TCL_OK;
+        for (i = 0; i < count; i++) {
+            if (tDOM_PullParserNext (interp, pullInfo) != TCL_OK) {
+                result = TCL_ERROR;
+                break;
+            }
+            tDOM_PullParserAppendEvent (interp, pullInfo, resultPtr,
+                                        emptyObj);
+            if (pullInfo->state == PULLPARSERSTATE_END_DOCUMENT) {
+                break;
+            }
+        }
+        Tcl_DecrRefCount (emptyObj);
+        if (result == TCL_OK) {
+            Tcl_SetObjResult (interp, resultPtr);
+        }
+        Tcl_DecrRefCount (resultPtr);
+        return result;
+
+    case m_leafValues:
+        if (objc != 2) {
+            Tcl_WrongNumArgs (interp, 2, objv, "");
+            return TCL_ERROR;
+        }
+        if (pullInfo->state != PULLPARSERSTATE_START_TAG) {
+            SetResult("Invalid state - leafValues method is only valid in state START_TAG.");
+            return TCL_ERROR;
+        }
+        resultPtr = Tcl_NewListObj (0, NULL);
+        Tcl_IncrRefCount (resultPtr);
+        result = tDOM_PullParserLeafValues (interp, pullInfo, resultPtr);
+        if (result == TCL_OK) {
+            Tcl_SetObjResult (interp, resultPtr);
+        }
+        Tcl_DecrRefCount (resultPtr);
+        return result;
+
     case m_line:
     case m_column:
         if (objc != 2) {
@@ -111,6 +111,8 @@ typedef struct TclHandlerSet {
     Tcl_Obj *endDoctypeDeclCommand;    /* Script for <!DOCTYPE decl ends */
     Tcl_Obj *xmlDeclCommand;           /* Script for <?XML decl's */
     Tcl_Obj *entityDeclCommand;        /* Script for <!ENTITY decl's */
+    Tcl_Obj *leafcommand;              /* Script for elements without
+                                          element children */
 } TclHandlerSet;
 
 typedef struct expatElemContent {
@@ -151,6 +153,11 @@ typedef struct TclGenExpatInfo {
  
     TclHandlerSet *firstTclHandlerSet;
     CHandlerSet *firstCHandlerSet;
+    Tcl_Obj *leafName;          /* Name and attribute list of the */
+    Tcl_Obj *leafAtts;          /* last start tag, as long as it may
+                                   be a leaf for -leafcommand */
+    int leafEnd;                /* The current end tag was reported
+                                   by -leafcommand */
 } TclGenExpatInfo;
 
 /*--------------------------------------------------------------------------
@@ -13,6 +13,8 @@
 ###########################################################################################################
 
 package require mu3e::helpers 1.0
+package require mu3e::render 1.0
+package require runctl_mgmt_host::latency 1.0
 package require tdom
 
 package provide upload_subsystem_bts::gui 1.0
@@ -57,6 +59,10 @@ proc ::upload_subsystem_bts::gui::setup_all {} {
     ::mu3e::helpers::append_global_variable $fd_global_variable "runctl_mgmt_host.log_encountered" 0
     # counters
     ::mu3e::helpers::append_global_variable $fd_global_variable "logTable_current_row" 0
+    # log fifo reader
+    ::mu3e::helpers::append_global_variable $fd_global_variable "logFifo_poll_interval_ms" 200
+    ::mu3e::helpers::append_global_variable $fd_global_variable "logFifo_max_tuples_per_poll" 256
+    ::mu3e::helpers::append_global_variable $fd_global_variable "logFifo_binary_log" "runctl_log.bin"
     
     toolkit_set_property	"globalVariableTable" visible 1
     
@@ -88,6 +94,26 @@ proc ::upload_subsystem_bts::gui::setup_all {} {
     toolkit_set_property    "rcClr_button"   text         "flush"
     toolkit_set_property    "rcClr_button"   onClick      {::upload_subsystem_bts::gui::clearLogFifo "rc_table"}
     
+    variable log_monitor_fd ""
+    toolkit_add             "rcMonitor_checkBox"    checkBox      "rcCtrlGroup"
+    toolkit_set_property    "rcMonitor_checkBox"    label         "continuous read"
+    toolkit_set_property    "rcMonitor_checkBox"    onClick       {::upload_subsystem_bts::gui::log_monitor_functor}
+    
+    toolkit_add             "rcMonitor_loading_bitmap"  bitmap          "rcCtrlGroup"
+    toolkit_set_property    "rcMonitor_loading_bitmap"  path            ../../system_console/figures/loading.gif
+    toolkit_set_property    "rcMonitor_loading_bitmap"  label           "stopped"
+    toolkit_set_property    "rcMonitor_loading_bitmap"  visible         0
+    
+    toolkit_add             "rcStat_text"    text         "rcCtrlGroup"
+    toolkit_set_property    "rcStat_text"    editable     false
+    toolkit_set_property    "rcStat_text"    text         "events: 0"
+    
+    # -- latency group
+    toolkit_add 			"rcLatencyGroup" 	group 				"rcTab"	
+	toolkit_set_property 	"rcLatencyGroup" 	title 				"Command Latency"
+	toolkit_set_property 	"rcLatencyGroup" 	itemsPerRow 		1
+    ::upload_subsystem_bts::gui::setup_rc_latency "rcLatencyGroup"
+    
     
     
     
@@ -102,7 +128,11 @@ proc ::upload_subsystem_bts::gui::setup_all {} {
 proc ::upload_subsystem_bts::gui::setup_rc {groupName} {
     variable fd_global_variable
     # 1) PREPARATION  
-    
+    # decoded event ring, the table only displays its tail
+    variable log_ring_size 4096
+    variable log_table_size 256
+    ::upload_subsystem_bts::gui::log_ring_reset
+    ::runctl_mgmt_host::latency::configure -decoder ::upload_subsystem_bts::gui::decRunCommand
 
     # 2) SETUP GUI
     toolkit_add				rc_table 	table			"rcGroup"
@@ -122,56 +152,355 @@ proc ::upload_subsystem_bts::gui::setup_rc {groupName} {
     return -code ok
 }
 
+######################################################################################################
+##  Arguments:
+##		<groupName> - name of the group to hold the latency widgets
+##
+##  Description:
+##  	Adds the run control latency table (one row per kind and command, with count, mean, RMS and
+##		percentiles), a file chooser to export the summary and a button to reset the statistics.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::setup_rc_latency {groupName} {
+    set columns [list "Kind" "Command" "Count" "Min" "Mean" "RMS" "P50" "P90" "P99" "P99.9" "Max"]
+    toolkit_add				rc_latency_table 	table			$groupName
+    toolkit_set_property	rc_latency_table    preferredWidth  600
+	toolkit_set_property	rc_latency_table	rowCount		0
+	toolkit_set_property	rc_latency_table	columnCount		[llength $columns]
+    for {set i 0} {$i < [llength $columns]} {incr i} {
+        toolkit_set_property	rc_latency_table	columnIndex		$i
+        toolkit_set_property	rc_latency_table	columnHeader	[lindex $columns $i]
+    }
+	toolkit_set_property	rc_latency_table	visible			1
+    
+    toolkit_add				"rcLatencySave_button"		fileChooserButton 			$groupName
+	toolkit_set_property	"rcLatencySave_button"		text 						"export summary"
+	toolkit_set_property	"rcLatencySave_button"		paths						"./trash_bin/runctl_latency.txt"; # some default path
+	toolkit_set_property	"rcLatencySave_button"		chooserButtonText 			"Save"
+	toolkit_set_property	"rcLatencySave_button"		onChoose 		{::upload_subsystem_bts::gui::save_latency "rcLatencySave_button"}
+    
+    toolkit_add             "rcLatencyReset_button"   button       $groupName
+    toolkit_set_property    "rcLatencyReset_button"   text         "reset statistics"
+    toolkit_set_property    "rcLatencyReset_button"   onClick      {::runctl_mgmt_host::latency::reset; ::mu3e::render::forget "rc_latency_table"; toolkit_set_property "rc_latency_table" rowCount 0}
+    return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<tableName> - name of the latency table
+##
+##  Description:
+##  	Shows the current summary of ::runctl_mgmt_host::latency in the table. Only changed cells
+##		are sent to the gui.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::refreshLatencyTable {tableName} {
+    set rows [::runctl_mgmt_host::latency::summary]
+    ::mu3e::render::table $tableName $rows
+    return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<fileChooserButtonName> - name of the file chooser button in the toolkit gui
+##
+##  Description:
+##  	Appends the latency summary to the chosen file, so repeated exports form a time series.
+##
+##	Returns:
+##  	-code ok
+##		-code error - if the file selection is cancelled
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::save_latency {fileChooserButtonName} {
+    if {![catch [toolkit_get_property $fileChooserButtonName paths]]} {
+		toolkit_send_message warning "save_latency: file selection cancelled, byte~"
+		return -code error
+	}
+    set file_path [toolkit_get_property $fileChooserButtonName paths]
+    # append, so repeated exports of a soak test form a time series of snapshots
+    ::runctl_mgmt_host::latency::export_summary $file_path a
+    toolkit_send_message info "save_latency: latency summary appended to (${file_path})"
+    return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<tableName> - name of the table to display the log events
+##
+##  Description:
+##  	Drains the run control log FIFO until it reports empty (ts = 0) and refreshes the table once
+##		with all new events. The events are kept in the decoded event ring and appended to the
+##		binary log (global variable "logFifo_binary_log").
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
 proc ::upload_subsystem_bts::gui::readbackLogFifo {tableName} {
+    set n_event [::upload_subsystem_bts::gui::drainLogFifo]
+    if {$n_event == 0} {
+        toolkit_send_message info "readbackLogFifo: FIFO might be empty now (ts = 0)"
+        return -code ok
+    }
+    ::upload_subsystem_bts::gui::refreshLogTable $tableName
+    ::upload_subsystem_bts::gui::refreshLatencyTable "rc_latency_table"
+    return -code ok
+
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Reads event tuples from the log FIFO until an empty tuple (ts = 0) is seen or the per-poll
+##		limit (global variable "logFifo_max_tuples_per_poll") is reached, so one call does not hold
+##		the console for an unbounded time during a run. Each tuple is decoded, pushed into the
+##		event ring, and the whole batch is appended to the binary log with a single write.
+##
+##	Returns:
+##  	number of events read
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::drainLogFifo {} {
     variable fd_global_variable
-    # what row is now ?
-    set currentRow [::mu3e::helpers::get_global_variable $fd_global_variable "logTable_current_row"]
     # request opened master service
     set master_fd [::mu3e::helpers::cget_opened_master_path]
     # get the base address of log fifo in qsys
     set baseLog [::mu3e::helpers::get_global_variable $fd_global_variable "runctl_mgmt_host.log_base_address"]
-    # d2h
-    set logTuple [master_read_32 $master_fd $baseLog 4]; # always read 4 words as an event tuple
-    #puts $logTuple
-     
-    # tuple -> info, the tcl list 0 1 2 3 corresponding to word 3 2 1 0. tcl-2 = word-1 (info)
-    set infoTimestamp [::mu3e::helpers::hex2bin [lindex $logTuple 3]]
-    set infoTimestamp ${infoTimestamp}[::mu3e::helpers::hex2bin [lindex $logTuple 2]]
-    set infoTimestamp [::mu3e::helpers::binary_trim_little_endien $infoTimestamp 16 63]
-    set infoTimestamp [::mu3e::helpers::bin2hex $infoTimestamp]
-    set infoCommand [::mu3e::helpers::hex2bin [lindex $logTuple 2]]
-    set infoCommand [::mu3e::helpers::binary_trim_little_endien $infoCommand 0 7]
-    set infoCommand [::upload_subsystem_bts::gui::decRunCommand $infoCommand]
-    set infoPayload [lindex $logTuple 1]
-    set infoTimestampExe [lindex $logTuple 0]
-    # surpress empty tuple
-    if {$infoTimestamp == 0x0} {
-        toolkit_send_message info "readbackLogFifo: FIFO might be empty now (ts = 0)"
-        return -code ok 
+    set max_tuples [::mu3e::helpers::get_global_variable $fd_global_variable "logFifo_max_tuples_per_poll"]
+    # d2h: the fifo pops one event tuple (4 words) per read
+    set events [list]
+    for {set i 0} {$i < $max_tuples} {incr i} {
+        set event [::upload_subsystem_bts::gui::decodeLogTuple [master_read_32 $master_fd $baseLog 4]]
+        # surpress empty tuple
+        if {[lindex $event 0] == 0} {
+            break
+        }
+        ::upload_subsystem_bts::gui::log_ring_push $event
+        lappend events $event
     }
-    
+    if {[llength $events] != 0} {
+        ::upload_subsystem_bts::gui::log_binary_append $events
+        ::runctl_mgmt_host::latency::add_events $events
+    }
+    if {[llength $events] == $max_tuples} {
+        toolkit_send_message warning "drainLogFifo: read limit of ($max_tuples) tuples reached, FIFO is not yet empty"
+    }
+    return [llength $events]
+}
+
+######################################################################################################
+##  Arguments:
+##		<logTuple> - list of 4 words as returned by master_read_32
+##
+##  Description:
+##  	Decodes one event tuple. The tcl list 0 1 2 3 corresponds to word 3 2 1 0:
+##		word 3 + word 2 [63:16] is the timestamp (48 bit), word 2 [7:0] the command, word 1 the
+##		payload and word 0 the execution timestamp.
+##
+##	Returns:
+##  	{timestamp command payload timestamp_execution} as integers
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::decodeLogTuple {logTuple} {
+    set word_hi [lindex $logTuple 3]
+    set word_lo [lindex $logTuple 2]
+    set timestamp [expr {((wide($word_hi) << 32) | $word_lo) >> 16}]
+    set command [expr {$word_lo & 0xff}]
+    set payload [expr {[lindex $logTuple 1] & 0xffffffff}]
+    set timestamp_exe [expr {[lindex $logTuple 0] & 0xffffffff}]
+    return [list $timestamp $command $payload $timestamp_exe]
+}
+
+######################################################################################################
+##  Arguments:
+##		none
+##
+##  Description:
+##  	Empties the decoded event ring. The ring holds the last "log_ring_size" events, older events
+##		are overwritten but remain in the binary log.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::log_ring_reset {} {
+    variable log_ring
+    variable log_ring_head 0
+    variable log_ring_count 0
+    variable log_ring_total 0
+    variable log_table_shown 0
+    variable log_table_rows 0
+    array unset log_ring
+    return -code ok
+}
+
+proc ::upload_subsystem_bts::gui::log_ring_push {event} {
+    variable log_ring
+    variable log_ring_size
+    variable log_ring_head
+    variable log_ring_count
+    variable log_ring_total
+    set log_ring($log_ring_head) $event
+    set log_ring_head [expr {($log_ring_head + 1) % $log_ring_size}]
+    if {$log_ring_count < $log_ring_size} {
+        incr log_ring_count
+    }
+    incr log_ring_total
+    return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<n> - number of events to return, -1 for all events in the ring
+##
+##  Description:
+##  	Gets the latest <n> events of the ring.
+##
+##	Returns:
+##  	list of events, oldest first
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::log_ring_get {{n -1}} {
+    variable log_ring
+    variable log_ring_size
+    variable log_ring_head
+    variable log_ring_count
+    if {$n < 0 || $n > $log_ring_count} {
+        set n $log_ring_count
+    }
+    set events [list]
+    set slot [expr {($log_ring_head - $n + $log_ring_size) % $log_ring_size}]
+    for {set i 0} {$i < $n} {incr i} {
+        lappend events $log_ring($slot)
+        set slot [expr {($slot + 1) % $log_ring_size}]
+    }
+    return $events
+}
+
+######################################################################################################
+##  Arguments:
+##		<tableName> - name of the table to display the log events
+##
+##  Description:
+##  	Brings the table up to date with the event ring in one batch. The table shows the latest
+##		"log_table_size" events. As long as the new events fit below the shown ones only the new rows
+##		are written, otherwise the table is rewritten from the ring.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::refreshLogTable {tableName} {
+    variable fd_global_variable
+    variable log_ring_size
+    variable log_ring_count
+    variable log_ring_total
+    variable log_table_size
+    variable log_table_shown
+    variable log_table_rows
+    set n_new [expr {$log_ring_total - $log_table_shown}]
+    if {$n_new == 0} {
+        return -code ok
+    }
+    if {$log_table_rows + $n_new <= $log_table_size} {
+        # append new rows
+        set row $log_table_rows
+        set events [::upload_subsystem_bts::gui::log_ring_get $n_new]
+    } else {
+        # scroll, rewrite the whole table
+        set row 0
+        set events [::upload_subsystem_bts::gui::log_ring_get $log_table_size]
+    }
+    set log_table_rows [expr {$row + [llength $events]}]
     # info -> table
-    toolkit_set_property $tableName rowIndex $currentRow
-    toolkit_set_property $tableName columnIndex 0
-    toolkit_set_property $tableName cellText $infoTimestamp
-    toolkit_set_property $tableName columnIndex 1
-    toolkit_set_property $tableName cellText $infoCommand
-    toolkit_set_property $tableName columnIndex 2
-    toolkit_set_property $tableName cellText $infoPayload
-    toolkit_set_property $tableName columnIndex 3
-    toolkit_set_property $tableName cellText $infoTimestampExe
-    
-    # enlongate table
-    if {[toolkit_get_property $tableName rowCount] <= [expr $currentRow + 1]} {
-        toolkit_set_property $tableName rowCount [expr [toolkit_get_property $tableName rowCount] + 1]
+    set rows [list]
+    foreach event $events {
+        lassign $event timestamp command payload timestamp_exe
+        lappend rows [list [format 0x%012lx $timestamp] [::upload_subsystem_bts::gui::decRunCommand $command] \
+            [format 0x%08x $payload] [format 0x%08x $timestamp_exe]]
     }
-    # incr row count 
-    ::mu3e::helpers::set_global_variable $fd_global_variable "logTable_current_row" [expr $currentRow + 1]
-    
-    
-    
+    ::mu3e::render::table $tableName $rows -first $row -row_count $log_table_rows
+    set log_table_shown $log_ring_total
+    ::mu3e::helpers::set_global_variable $fd_global_variable "logTable_current_row" $log_table_rows
+    toolkit_set_property "rcStat_text" text "events: $log_ring_total (ring $log_ring_count/$log_ring_size)"
+    return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<events> - list of decoded events
+##
+##  Description:
+##  	Appends the events to the binary log. The file starts with the 8 byte magic "RCLOG001",
+##		followed by 20 byte little endian records:
+##			timestamp (64 bit) | command (8 bit) | 3 byte padding | payload (32 bit) | timestamp_exe (32 bit)
+##		An existing file is never truncated, a new run appends after the old records. The file is
+##		opened and closed per call, so no handle is held between readbacks and a changed
+##		"logFifo_binary_log" takes effect with the next append.
+##
+##	Returns:
+##  	-code ok
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::log_binary_append {events} {
+    variable fd_global_variable
+    set file_path [::mu3e::helpers::get_global_variable $fd_global_variable "logFifo_binary_log"]
+    set is_new [expr {![file exists $file_path] || [file size $file_path] == 0}]
+    if {[catch {open $file_path a} log_bin_fd]} {
+        toolkit_send_message error "log_binary_append: cannot open \"${file_path}\": $log_bin_fd"
+        return -code ok
+    }
+    fconfigure $log_bin_fd -translation binary
+    set data ""
+    if {$is_new} {
+        append data "RCLOG001"
+    }
+    foreach event $events {
+        lassign $event timestamp command payload timestamp_exe
+        append data [binary format wcx3ii $timestamp $command $payload $timestamp_exe]
+    }
+    if {[catch {puts -nonewline $log_bin_fd $data} error_msg]} {
+        toolkit_send_message error "log_binary_append: cannot write \"${file_path}\": $error_msg"
+    }
+    catch {close $log_bin_fd}
     return -code ok
-    
+}
+
+######################################################################################################
+##  Arguments:
+##		<file_path> - binary log written by log_binary_append
+##
+##  Description:
+##  	Reads back the binary log for offline analysis.
+##
+##	Returns:
+##  	list of events {timestamp command payload timestamp_execution}, in file order
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::read_binary_log {file_path} {
+    set fd [open $file_path r]
+    fconfigure $fd -translation binary
+    set data [read $fd]
+    close $fd
+    if {[string range $data 0 7] ne "RCLOG001"} {
+        error "read_binary_log: \"${file_path}\" is not a run control log"
+    }
+    set events [list]
+    set n_record [expr {([string length $data] - 8) / 20}]
+    for {set i 0} {$i < $n_record} {incr i} {
+        binary scan $data "@[expr {8 + 20*$i}]wcux3iuiu" timestamp command payload timestamp_exe
+        lappend events [list $timestamp $command $payload $timestamp_exe]
+    }
+    return $events
 }
 
 proc ::upload_subsystem_bts::gui::clearLogFifo {tableName} {
@@ -182,17 +511,75 @@ proc ::upload_subsystem_bts::gui::clearLogFifo {tableName} {
     set baseLog [::mu3e::helpers::get_global_variable $fd_global_variable "runctl_mgmt_host.log_base_address"]
     # h2d
     master_write_32 $master_fd $baseLog 0x0
-    # also clear the logTable 
-    # ... todo 
+    # also clear the ring and the logTable (the binary log is kept)
+    ::upload_subsystem_bts::gui::log_ring_reset
+    ::mu3e::render::forget $tableName
+    toolkit_set_property $tableName rowCount 0
+    ::mu3e::helpers::set_global_variable $fd_global_variable "logTable_current_row" 0
+    toolkit_set_property "rcStat_text" text "events: 0"
     toolkit_send_message info "readbackLogFifo: LOG FIFO flushed"
     return -code ok
 }
 
-proc ::upload_subsystem_bts::gui::decRunCommand {binaryCommand} {
-    switch [::mu3e::helpers::bin2hex $binaryCommand] {
+proc ::upload_subsystem_bts::gui::log_monitor_functor {} {
+    variable fd_global_variable
+    variable log_monitor_fd
+    set checked [toolkit_get_property "rcMonitor_checkBox" checked]
+    # single read is done by the monitor now
+    toolkit_set_property "rcRead_button" enabled [expr {!$checked}]
+    # get selected master service path
+    set master_path [::mu3e::helpers::get_selected_servicePath "jtagMasterGroup_showmp_comboBox"]
+    if {$checked} {
+        # open monitor serivce
+        if {$log_monitor_fd ne ""} {
+            toolkit_send_message info "log_monitor_functor: monitor started..."
+        } else {
+            # open monitor service -> fd
+            # NOTE: the monitored range must not cover the log fifo, the monitor's own read would pop events
+            set log_monitor_fd [::mu3e::helpers::open_monitor_service]
+            monitor_set_interval $log_monitor_fd [::mu3e::helpers::get_global_variable $fd_global_variable "logFifo_poll_interval_ms"]
+            monitor_set_callback $log_monitor_fd [list ::upload_subsystem_bts::gui::log_monitor_callback]
+            monitor_add_range $log_monitor_fd $master_path 0x0 4
+            toolkit_send_message info "log_monitor_functor: registered monitor service, monitor started..."
+        }
+        monitor_set_enabled $log_monitor_fd 1
+        # update loading gif
+        toolkit_set_property    "rcMonitor_loading_bitmap"  label           "monitering..."
+        toolkit_set_property    "rcMonitor_loading_bitmap"  visible         1
+        toolkit_set_property    "rcMonitor_loading_bitmap"  toolTip         "press again to stop"
+    } else {
+        monitor_set_enabled $log_monitor_fd 0
+        # update loading gif
+        toolkit_set_property    "rcMonitor_loading_bitmap"  label           "stopped"
+        toolkit_set_property    "rcMonitor_loading_bitmap"  visible         0
+    }
+    return -code ok
+}
+
+proc ::upload_subsystem_bts::gui::log_monitor_callback {} {
+    if {[::upload_subsystem_bts::gui::drainLogFifo] != 0} {
+        ::upload_subsystem_bts::gui::refreshLogTable "rc_table"
+        ::upload_subsystem_bts::gui::refreshLatencyTable "rc_latency_table"
+    }
+    return -code ok
+}
+
+######################################################################################################
+##  Arguments:
+##		<command> - 8 bit run command code (integer)
+##
+##  Description:
+##  	Decodes the run command code into its name.
+##
+##	Returns:
+##  	name of the run command, "WRONG COMMAND!" if unknown
+##
+######################################################################################################
+proc ::upload_subsystem_bts::gui::decRunCommand {command} {
+    switch [format 0x%02x $command] {
         0x30 {
             set command "RESET"
-        } 
+        }
         0x31 {
             set command "STOP_RESET"
         }
@@ -212,7 +599,7 @@ proc ::upload_subsystem_bts::gui::decRunCommand {binaryCommand} {
             set command "START_RUN"
         }
         0x13 {
-            set command "END_RUN" 
+            set command "END_RUN"
         }
         0x14 {
             set command "ABORT_RUN"
@@ -220,12 +607,12 @@ proc ::upload_subsystem_bts::gui::decRunCommand {binaryCommand} {
         default {
             set command "WRONG COMMAND!"
         }
-    
+
     }
-    
+
     return $command
 
-} 
+}
 
 
 